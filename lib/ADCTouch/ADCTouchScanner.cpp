@@ -0,0 +1,179 @@
+/*
+  ADCTouchScanner.cpp - interrupt-driven ADCTouch scan, see ADCTouchScanner.h
+*/
+#include "Arduino.h"
+#include "ADCTouchScanner.h"
+
+#if defined(__AVR__)
+#include <avr/interrupt.h>
+#endif
+
+// the scanner the ADC interrupt is delivered to
+static ADCTouchScanner *activeScanner = NULL;
+
+#if defined(__AVR_ATmega2560__) || defined(__AVR_ATmega1280__)
+ISR(ADC_vect)
+{
+	if (activeScanner != NULL) {
+		activeScanner->onConversion(ADC);
+	}
+}
+#endif
+
+ADCTouchScanner::ADCTouchScanner()
+{
+	count = 0;
+	samples = 1;
+	active = false;
+	published = 0;
+	completed = 0;
+	lastScanMicros = 0;
+	lastRead = 0;
+	memset(frames, 0, sizeof(frames));
+	memset(times, 0, sizeof(times));
+}
+
+bool ADCTouchScanner::begin(const int *analogPins, uint8_t pinCount, uint8_t samplesPerScan)
+{
+	if (pinCount == 0 || pinCount > ADCTOUCH_SCAN_MAX_PINS
+			|| samplesPerScan == 0 || samplesPerScan > ADCTOUCH_SCAN_MAX_SAMPLES) {
+		return false;
+	}
+	end();
+	for (uint8_t i = 0; i < pinCount; i++) {
+		if (analogPins[i] < A0 || analogPins[i] > A15) {
+			return false;
+		}
+		pins[i] = analogPins[i];
+		pinMode(pins[i], INPUT);
+	}
+	count = pinCount;
+	samples = samplesPerScan;
+	memset(sums, 0, sizeof(sums));
+	pin = 0;
+	sample = 0;
+	completed = 0;
+	lastRead = published;
+	scanStart = micros();
+
+	activeScanner = this;
+	active = true;
+	startDischarge();
+	return true;
+}
+
+void ADCTouchScanner::end()
+{
+	if (!active) {
+		return;
+	}
+	noInterrupts();
+	ADCSRA &= ~(1 << ADIE);
+	active = false;
+	activeScanner = NULL;
+	interrupts();
+	// let a conversion in progress finish before analogRead() gets the ADC back
+	while (ADCSRA & (1 << ADSC));
+	pinMode(pins[pin], INPUT);
+}
+
+// charge the pad through its pull-up while a conversion of the GND channel empties the
+// sample-and-hold capacitor
+void ADCTouchScanner::startDischarge()
+{
+	pinMode(pins[pin], INPUT_PULLUP);
+	ADMUX = (1 << REFS0) | 0x1F;
+	ADCSRB &= ~(1 << MUX5);
+	measuring = false;
+	ADCSRA = (1 << ADEN) | (1 << ADSC) | (1 << ADIE) | (1 << ADIF) | (1 << ADPS2) | (1 << ADPS1) | (1 << ADPS0);
+}
+
+// release the pad and let it share its charge with the sample-and-hold capacitor
+void ADCTouchScanner::startMeasure()
+{
+	uint8_t channel = pins[pin] - A0;
+	pinMode(pins[pin], INPUT);
+	ADMUX = (1 << REFS0) | (channel & 0x07);
+	if (channel & 0x08) {
+		ADCSRB |= (1 << MUX5);
+	} else {
+		ADCSRB &= ~(1 << MUX5);
+	}
+	measuring = true;
+	ADCSRA = (1 << ADEN) | (1 << ADSC) | (1 << ADIE) | (1 << ADIF) | (1 << ADPS2) | (1 << ADPS1) | (1 << ADPS0);
+}
+
+void ADCTouchScanner::onConversion(uint16_t value)
+{
+	if (!active) {
+		return;
+	}
+	if (!measuring) {
+		startMeasure();
+		return;
+	}
+
+	sums[pin] += value;
+	pinMode(pins[pin], INPUT);
+	if (++pin == count) {
+		pin = 0;
+		if (++sample == samples) {
+			uint8_t next = (published + 1) & 1;
+			int *frame = frames[next];
+			for (uint8_t i = 0; i < count; i++) {
+				frame[i] = sums[i] / samples;
+				sums[i] = 0;
+			}
+			// the samples of every pin are spread over the scan: its middle is their average time
+			unsigned long now = micros();
+			times[next] = scanStart + (now - scanStart) / 2;
+			sample = 0;
+			published++;
+			completed++;
+			lastScanMicros = now - scanStart;
+			scanStart = now;
+		}
+	}
+	startDischarge();
+}
+
+bool ADCTouchScanner::read(int *values, unsigned long *time)
+{
+	// a scan takes far longer than this copy, so retrying once is all it can ever need
+	uint8_t seen;
+	unsigned long scanTime;
+	do {
+		seen = published;
+		memcpy(values, frames[seen & 1], count * sizeof(int));
+		scanTime = times[seen & 1];
+	} while (seen != published);
+	if (time != NULL) {
+		*time = scanTime;
+	}
+
+	bool fresh = seen != lastRead;
+	lastRead = seen;
+	return fresh;
+}
+
+uint32_t ADCTouchScanner::scans()
+{
+	noInterrupts();
+	uint32_t n = completed;
+	interrupts();
+	return n;
+}
+
+unsigned long ADCTouchScanner::scanMicros()
+{
+	noInterrupts();
+	unsigned long us = lastScanMicros;
+	interrupts();
+	return us;
+}
+
+float ADCTouchScanner::scansPerSecond()
+{
+	unsigned long us = scanMicros();
+	return us ? 1000000.0f / us : 0.0f;
+}
@@ -0,0 +1,69 @@
+/*
+  ADCTouchScanner.h - ADCTouch measurements on a set of pins, driven by the ADC conversion-complete
+  interrupt instead of busy waiting (ATmega2560).
+
+  Each sample is the same two conversions as ADCTouchClass::read: one on the GND channel while the
+  pad charges through its pull-up (this discharges the sample-and-hold capacitor), then one on the
+  released pad. The interrupt handler sets up the next conversion and returns, so a scan costs the
+  CPU only the handlers. Samples go round the pins so each pin's oversampling is spread over the
+  whole scan.
+
+  Completed scans are published into one of two frames; read() copies the latest one.
+  While the scanner runs the ADC belongs to it: do not call analogRead() or ADCTouch.read().
+*/
+#ifndef ADCT_SCANNER_h
+#define ADCT_SCANNER_h
+
+#include "Arduino.h"
+
+#define ADCTOUCH_SCAN_MAX_PINS 16
+#define ADCTOUCH_SCAN_MAX_SAMPLES 64	// 64 x 1023 still fits the 16-bit sums
+
+class ADCTouchScanner
+{
+	public:
+		ADCTouchScanner();
+
+		// pins: A0..A15; samples: conversions averaged per pin and per scan
+		bool begin(const int *pins, uint8_t count, uint8_t samples = 16);
+		void end();
+		bool running() const { return active; }
+
+		// copies the latest completed scan (averaged like ADCTouch.read) and returns true if it is
+		// newer than the one the previous call returned; time: micros() halfway through that scan
+		bool read(int *values, unsigned long *time = NULL);
+
+		// completed scans since begin() and the duration of the last one
+		uint32_t scans();
+		unsigned long scanMicros();
+		float scansPerSecond();
+
+		// body of the ADC interrupt; public so that a simulated board can deliver it
+		void onConversion(uint16_t value);
+
+	private:
+		void startDischarge();
+		void startMeasure();
+
+		uint8_t pins[ADCTOUCH_SCAN_MAX_PINS];
+		uint8_t count;
+		uint8_t samples;
+		bool active;
+
+		// interrupt state
+		bool measuring;
+		uint8_t pin;
+		uint8_t sample;
+		uint16_t sums[ADCTOUCH_SCAN_MAX_PINS];
+		unsigned long scanStart;
+
+		// published by the interrupt: frames[published & 1] is the latest complete scan
+		int frames[2][ADCTOUCH_SCAN_MAX_PINS];
+		unsigned long times[2];
+		volatile uint8_t published;
+		volatile uint32_t completed;
+		volatile unsigned long lastScanMicros;
+		uint8_t lastRead;
+};
+
+#endif
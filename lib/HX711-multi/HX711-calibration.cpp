@@ -0,0 +1,103 @@
+#include <Arduino.h>
+#include <HX711-multi.h>
+#include <HX711-calibration.h>
+#include <math.h>
+
+static uint8_t shiftFor(float coefficient) {
+	if (coefficient == 0) {
+		return 62;
+	}
+	int exponent;
+	frexpf(fabsf(coefficient), &exponent);	// |coefficient| < 2^exponent
+	int shift = 30 - exponent;
+	return shift < 0 ? 0 : (shift > 62 ? 62 : shift);
+}
+
+HX711Calibration HX711Calibration::fromFloat(float unitsPerCount, float unitsPerCount2) {
+	HX711Calibration cal;
+	uint8_t shift = shiftFor(unitsPerCount);
+	if (unitsPerCount2 != 0) {
+		uint8_t quadShift = shiftFor(unitsPerCount2 * 16777216.0f);
+		shift = quadShift < shift ? quadShift : shift;
+	}
+	cal.shift = shift;
+	cal.gain = (int32_t) lroundf(ldexpf(unitsPerCount, shift));
+	cal.quad = (int32_t) lroundf(ldexpf(unitsPerCount2 * 16777216.0f, shift));
+	return cal;
+}
+
+float HX711Calibration::unitsPerCount() const {
+	return ldexpf((float) gain, -shift);
+}
+
+HX711Calibrator::HX711Calibrator(HX711MULTI &s) : scales(s) {
+	channel = 0;
+	points = 0;
+	times = 0;
+	remaining = 0;
+}
+
+void HX711Calibrator::begin(byte ch) {
+	channel = ch;
+	points = 0;
+	remaining = 0;
+	scales.hold_auto_tare(true);
+}
+
+bool HX711Calibrator::addPoint(float weight, byte count) {
+	if (points >= HX711_CAL_MAX_POINTS || count == 0 || channel >= scales.get_count() || collecting()) {
+		return false;
+	}
+	Y[points] = weight;
+	sum = 0;
+	times = remaining = count;
+	return true;
+}
+
+bool HX711Calibrator::feed(const long *tared) {
+	if (!collecting()) {
+		return false;
+	}
+	sum += tared[channel];
+	if (--remaining != 0) {
+		return false;
+	}
+	X[points] = sum / times;
+	++points;
+	return true;
+}
+
+bool HX711Calibrator::fit(bool secondOrder) {
+	if (collecting()) {
+		return false;
+	}
+	// normal equations of y = a x (+ b x^2), in double: this runs once, not per sample
+	double sxx = 0, sxxx = 0, sxxxx = 0, sxy = 0, sxxy = 0;
+	for (int i = 0; i < points; ++i) {
+		double x = X[i], y = Y[i];
+		sxx += x * x;
+		sxxx += x * x * x;
+		sxxxx += x * x * x * x;
+		sxy += x * y;
+		sxxy += x * x * y;
+	}
+
+	double a, b = 0;
+	if (secondOrder) {
+		double det = sxx * sxxxx - sxxx * sxxx;
+		if (points < 2 || fabs(det) < 1e-12 * sxx * sxxxx) {
+			return false;
+		}
+		a = (sxy * sxxxx - sxxx * sxxy) / det;
+		b = (sxx * sxxy - sxxx * sxy) / det;
+	} else {
+		if (points < 1 || sxx == 0) {
+			return false;
+		}
+		a = sxy / sxx;
+	}
+
+	scales.set_calibration(channel, HX711Calibration::fromFloat((float) a, (float) b));
+	scales.hold_auto_tare(false);
+	return true;
+}
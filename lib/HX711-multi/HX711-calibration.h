@@ -0,0 +1,79 @@
+#ifndef HX711_CALIBRATION_h
+#define HX711_CALIBRATION_h
+
+#if ARDUINO >= 100
+#include "Arduino.h"
+#else
+#include "WProgram.h"
+#endif
+
+#ifndef HX711_CAL_MAX_POINTS
+#define HX711_CAL_MAX_POINTS 8	// reference weights remembered per channel by HX711Calibrator
+#endif
+
+// Per-channel conversion from a tared reading x to calibrated units:
+//   units = (x * gain + ((x * x) >> 24) * quad + 2^(shift-1)) >> shift	(rounded to nearest)
+// gain and quad are fixed point, precomputed from the float coefficients so the
+// per-sample cost is one or two 64-bit multiplies and a shift, with no division.
+struct HX711Calibration
+{
+	int32_t gain;	// units per count, scaled by 2^shift
+	int32_t quad;	// units per count^2, scaled by 2^(shift + 24); 0 for a linear cell
+	uint8_t shift;
+
+	// picks the largest shift that keeps both coefficients in 31 bits
+	static HX711Calibration fromFloat(float unitsPerCount, float unitsPerCount2 = 0);
+
+	inline long apply(long x) const {
+		int64_t acc = (int64_t) x * gain + (((int64_t) 1 << shift) >> 1);
+		if (quad != 0) {
+			acc += (((int64_t) x * x) >> 24) * quad;
+		}
+		return (long) (acc >> shift);
+	}
+
+	float unitsPerCount() const;
+};
+
+class HX711MULTI;
+
+// Multi-point calibration with known weights. Put a reference weight on the cell, call addPoint() with its
+// value (in the units the calibrated readings should have), feed() it the tared samples the application
+// reads anyway until collecting() turns false, repeat for a few weights, then fit().
+// The background re-tare (set_auto_tare) is held off from begin() until a fit succeeds: it would take a
+// light reference weight resting on the plank for drift and tare it away before its point is taken.
+class HX711Calibrator
+{
+	private:
+		HX711MULTI &scales;
+		float X[HX711_CAL_MAX_POINTS];	// averaged tared readings of the channel being calibrated
+		float Y[HX711_CAL_MAX_POINTS];	// reference weights
+		byte points;
+		byte channel;
+		float sum;			// of the point being collected
+		byte times;
+		byte remaining;		// samples the point still needs, 0 when none is being collected
+
+	public:
+		HX711Calibrator(HX711MULTI &scales);
+
+		// forgets the points and starts over on another channel
+		void begin(byte channel);
+
+		// starts averaging the next 'times' tared samples with 'weight' on the plank; returns false when the
+		// point table is full or a point is still being collected
+		bool addPoint(float weight, byte times = 20);
+
+		// a tared sample of every channel (HX711MULTI::readLatest() or drain()); returns true when it
+		// completes the point
+		bool feed(const long *tared);
+
+		bool collecting() const { return remaining != 0; }
+		byte get_points() { return points; }
+
+		// least-squares fit through the points and the origin (the readings are tared), first or second order,
+		// installed on the channel. needs at least one point per coefficient.
+		bool fit(bool secondOrder = false);
+};
+
+#endif /* HX711_CALIBRATION_h */
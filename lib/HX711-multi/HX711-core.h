@@ -0,0 +1,658 @@
+/*
+  HX711-core.h - what HX711MULTI and HX711Static do with the conversions once they are clocked out:
+  tare, noise learning, background re-tare, calibration and the sample rings.
+
+  Each HX711 measures one of three inputs per conversion: channel A at gain 128 or 64, or channel B
+  at gain 32. The clock pulses after a readout choose the input of the next conversion, so a setting
+  takes effect one conversion late. The core keeps the input the chips are converting on, tags every
+  conversion with it, and keeps a tare, noise figure, calibration and sample ring per input. A
+  schedule (set_schedule) picks the input of each conversion in turn, e.g. A128, B32, A128, B32:
+  one bridge on each channel of a chip, read at half the rate each, with no conversion wasted on
+  the switch. set_gain() is the schedule of one input.
+
+  The readout that clocks them out is a template parameter, so that a readout known at compile time
+  (HX711Static) gets every per-channel loop with a constant trip count, and no call through a pointer.
+  A readout provides:
+
+    static const byte CAPACITY            most channels it can hold; sizes the per-channel storage
+    byte count()                          channels read
+    bool ready()                          every DOUT line is low
+    void clockOut(long *result, byte pulses)
+                                          clocks one conversion out of chips that are known to be
+                                          ready, then 'pulses' - 24 more; result may be NULL
+    void writeClock(bool high)            drives PD_SCK
+*/
+#ifndef HX711_CORE_h
+#define HX711_CORE_h
+
+#if ARDUINO >= 100
+#include "Arduino.h"
+#else
+#include "WProgram.h"
+#endif
+
+#include <array>
+#include <cmath>
+#include "HX711-calibration.h"
+#include "SpscRing.h"
+#include "TaskMeter.h"
+
+#ifndef HX711_MAX_CHANNELS
+#define HX711_MAX_CHANNELS 8	// upper bound on 'count', sizes the fixed per-channel storage
+#endif
+
+#ifndef HX711_RING_SIZE
+#define HX711_RING_SIZE 32		// samples buffered between the acquisition context and the reader (power of two)
+#endif
+
+#define HX711_NOISE_TOLERANCE_FACTOR 6	// auto tolerance = factor * best recently seen noise (standard deviation)
+#define HX711_NOISE_LEARN_SAMPLES 8		// conversions needed before the noise figure counts as learned
+
+#ifndef HX711_SCHEDULE_MAX
+#define HX711_SCHEDULE_MAX 8	// longest conversion schedule
+#endif
+
+// the inputs a conversion is measured on
+#define HX711_A128 0		// channel A, gain 128
+#define HX711_B32 1			// channel B, gain 32
+#define HX711_A64 2			// channel A, gain 64
+#define HX711_INPUTS 3
+#define HX711_PRIMARY 0xFF	// argument default: the first input of the schedule, the one set_gain() chose
+
+// the input measured at 'gain', HX711_INPUTS if there is none
+constexpr byte hx711Input(byte gain) {
+	return gain == 128 ? HX711_A128 : (gain == 32 ? HX711_B32 : (gain == 64 ? HX711_A64 : HX711_INPUTS));
+}
+
+constexpr byte hx711Gain(byte input) {
+	return input == HX711_B32 ? 32 : (input == HX711_A64 ? 64 : 128);
+}
+
+// clock pulses of a readout that select 'input' for the next conversion: 25, 26 or 27
+constexpr byte hx711Pulses(byte input) {
+	return 25 + input;
+}
+
+// one conversion of every channel, with the tare applied
+struct HX711Sample
+{
+	unsigned long timestamp;	// micros() when the conversion was clocked out
+	byte input;					// HX711_A128, HX711_B32 or HX711_A64: what the conversion was measured on
+	long values[HX711_MAX_CHANNELS];
+};
+
+template <class Readout>
+class HX711Core
+{
+	public:
+		static const byte CAPACITY = Readout::CAPACITY;
+		static_assert(CAPACITY <= HX711_MAX_CHANNELS, "an HX711Sample holds HX711_MAX_CHANNELS values");
+
+	protected:
+		// what is kept per input: each one is a bridge of its own
+		struct Input
+		{
+			std::array<long, CAPACITY> OFFSETS;	// used for tare weight
+			std::array<HX711Calibration, CAPACITY> CAL;	// used to return weight in grams, kg, ounces, whatever
+
+			// noise learning, updated with every conversion
+			std::array<long, CAPACITY> LAST;			// previous raw reading
+			std::array<float, CAPACITY> NOISE;			// running variance estimate, from squared sample-to-sample differences
+			std::array<float, CAPACITY> NOISE_FLOOR;	// best recently seen variance: follows NOISE down at once, creeps back up slowly
+			uint16_t noiseSamples;
+			bool noiseLearned;
+
+			// rest detection for the background re-tare: a window of tared readings that stayed within the auto tolerance
+			std::array<long, CAPACITY> REST_MIN;
+			std::array<long, CAPACITY> REST_MAX;
+			std::array<long long, CAPACITY> REST_SUM;
+			uint16_t restCount;
+			uint32_t retares;
+
+			SpscRing<HX711Sample, HX711_RING_SIZE> samples;	// filled by poll(), emptied by readLatest()/drain()
+		};
+
+		Readout readout;
+
+		bool debugEnabled; //print debug messages?
+
+		Input inputs[HX711_INPUTS];
+		uint16_t restSamples;	// window length that counts as 'at rest', 0 disables the background re-tare
+		long restDrift;			// largest offset correction the background re-tare may apply
+		volatile bool restHeld;	// hold_auto_tare(): set by the consumer, acted on by trackRest()
+
+		// conversion schedule, owned by the context that clocks the conversions out
+		byte schedule[HX711_SCHEDULE_MAX];	// input of each conversion, repeated
+		byte scheduleLength;
+		byte step;			// entry of the schedule the next readout selects
+		byte converting;	// input of the conversion under way, selected by the last readout
+		byte lastInput;		// input of the conversion last clocked out
+
+		TaskMeter meter;	// the readouts of the acquisition task
+
+		// clocks out the conversion the chips are ready with, selecting the next input of the schedule;
+		// returns the input the conversion was measured on
+		byte convert(long *raw);
+		void learnNoise(Input &in, const long *raw);
+		void trackRest(Input &in, const long *tared);
+		long noiseTolerance(const Input &in, int channel);
+		bool tareWithin(byte times, uint16_t tolerance, bool autoTolerance);
+		byte resolve(byte input) { return input == HX711_PRIMARY || input >= HX711_INPUTS ? schedule[0] : input; }
+
+		HX711Core();
+
+	public:
+		//returns the number of channels
+		byte get_count() { return readout.count(); }
+
+		// check if HX711 is ready
+		// from the datasheet: When output data is not ready for retrieval, digital output pin DOUT is high. Serial clock
+		// input PD_SCK should be low. When DOUT goes to low, it indicates data is ready for retrieval.
+		bool is_ready() { return readout.ready(); }
+
+		// set the gain factor; takes effect only after a call to read()
+		// channel A can be set for a 128 or 64 gain; channel B has a fixed 32 gain
+		// depending on the parameter, the channel is also set to either A or B
+		void set_gain(byte gain = 128);
+
+		// measure the conversions on gains[0], gains[1], ... gains[length - 1], then again from gains[0]
+		// (128 or 64: channel A, 32: channel B). The next readout selects gains[0]; the conversion under
+		// way is still tagged with the input it runs on, so no conversion is lost to the switch.
+		// false, and the schedule left alone, if it is empty, too long or has another gain.
+		// set it before acquisition starts.
+		bool set_schedule(const byte *gains, byte length);
+
+		// input (HX711_A128, HX711_B32, HX711_A64) of the conversion last read or polled
+		byte last_input() const { return lastInput; }
+
+		// waits for the chip to be ready and returns a reading, tared for the input it was measured on
+		void read(long *result = NULL);
+
+		// same as read, but does not offset the values according to the tare
+		void readRaw(long *result = NULL);
+
+		// set the OFFSET value for tare weight
+		// times: how many times to read the tare value; of each input, with a schedule: 'times' rounds of it
+		// returns true iff the offsets have been reset for the scale during this call.
+		// tolerance: the maximum deviation of samples, above which to reject the attempt to tare. (if set to 0, ignored)
+		//   every other value, 0xFFFF included, is a deviation in raw counts.
+		// works in O(count) fixed storage whatever 'times' is.
+		bool tare(byte times = 10, uint16_t tolerance = 0);
+
+		// same as tare, with each cell's tolerance derived from its learned noise (HX711_NOISE_TOLERANCE_FACTOR).
+		// rejects the attempt while nothing has been learned yet, and the samples read during that attempt are
+		// learned from, so a retry can succeed.
+		bool tare_auto(byte times = 10);
+
+		// standard deviation of the recent noise of a channel, in raw counts (0 until learned)
+		float get_noise(byte channel, byte input = HX711_PRIMARY);
+
+		// re-tare in the background (from read()/poll()) whenever every channel stays within its auto tolerance
+		// for 'samples' conversions in a row and the resting value is within 'maxDrift' of the current zero.
+		// the drift bound keeps a steady load on the plank from being tared away. samples = 0 disables it.
+		void set_auto_tare(uint16_t samples, long maxDrift);
+
+		// holds the background re-tare off while a load has to stay on the readings, e.g. a calibration
+		// weight, and lets it resume; unlike set_auto_tare() it may be called while acquisition runs
+		void hold_auto_tare(bool held) { restHeld = held; }
+
+		// number of background re-tares so far, of every input
+		uint32_t get_auto_tare_count();
+
+		// asynchronous acquisition: poll() is the producer, readLatest()/drain() the consumer.
+		// Do not mix with read()/readRaw()/tare() while acquisition is running.
+
+		// non-blocking: if every chip is ready, clocks out one conversion, applies the tare,
+		// timestamps it and queues it on the ring of its input. returns true iff a sample was taken.
+		bool poll();
+
+		// copies the newest queued sample of an input into result and discards older ones.
+		// returns false (and leaves result alone) if nothing arrived since the last call.
+		bool readLatest(long *result, unsigned long *timestamp = NULL, byte input = HX711_PRIMARY);
+
+		// moves up to 'max' queued samples of an input, oldest first, and returns how many were copied
+		size_t drain(HX711Sample *out, size_t max, byte input = HX711_PRIMARY);
+
+		// waits for the next tared conversion of the primary input
+		void read_next(long *result);
+
+		// samples lost because the reader did not keep up, and the most that ever waited for it, over every input
+		uint32_t droppedSamples();
+		uint32_t queueHighWater() const;
+		// cost of the acquisition task; a host loop calling poll() may bracket it with the same meter
+		TaskMeter &taskMeter() { return meter; }
+
+		// per-channel calibration; the default is one unit per count
+		void set_calibration(byte channel, const HX711Calibration &calibration, byte input = HX711_PRIMARY);
+		HX711Calibration get_calibration(byte channel, byte input = HX711_PRIMARY);
+
+		// converts tared readings (from read() or the sample ring) to calibrated units, in place
+		void apply_calibration(long *values, byte input = HX711_PRIMARY);
+
+		// read() followed by apply_calibration()
+		void read_calibrated(long *result);
+
+		// puts the chip into power down mode
+		void power_down();
+
+		// wakes up the chip after power down mode; it comes back on channel A, gain 128
+		void power_up();
+
+		void setDebugEnable(bool debugEnable = true) { debugEnabled = debugEnable; }
+};
+
+template <class Readout>
+HX711Core<Readout>::HX711Core() : meter("hx711") {
+	debugEnabled = false;
+	restSamples = 0;
+	restDrift = 0;
+	restHeld = false;
+	for (int i = 0; i < HX711_INPUTS; ++i) {
+		Input &in = inputs[i];
+		in.noiseLearned = false;
+		in.noiseSamples = 0;
+		in.restCount = 0;
+		in.retares = 0;
+		in.OFFSETS.fill(0);
+		in.CAL.fill(HX711Calibration::fromFloat(1.0f));
+		in.NOISE.fill(0);
+		in.NOISE_FLOOR.fill(0);
+	}
+	// the chips power up on channel A, gain 128
+	schedule[0] = HX711_A128;
+	scheduleLength = 1;
+	step = 0;
+	converting = HX711_A128;
+	lastInput = HX711_A128;
+}
+
+template <class Readout>
+void HX711Core<Readout>::set_gain(byte gain) {
+	byte input = hx711Input(gain);
+	if (input < HX711_INPUTS) {
+		schedule[0] = input;
+		scheduleLength = 1;
+		step = 0;
+	}
+
+	readout.writeClock(false);
+	read(); //a read is needed to get gain setting to come into effect. (for the next read)
+}
+
+template <class Readout>
+bool HX711Core<Readout>::set_schedule(const byte *gains, byte length) {
+	if (length == 0 || length > HX711_SCHEDULE_MAX) {
+		return false;
+	}
+	for (int i = 0; i < length; ++i) {
+		if (hx711Input(gains[i]) >= HX711_INPUTS) {
+			return false;
+		}
+	}
+	for (int i = 0; i < length; ++i) {
+		schedule[i] = hx711Input(gains[i]);
+	}
+	scheduleLength = length;
+	step = 0;
+	return true;
+}
+
+template <class Readout>
+byte HX711Core<Readout>::convert(long *raw) {
+	lastInput = converting;
+	converting = schedule[step];
+	step = step + 1 < scheduleLength ? step + 1 : 0;
+	readout.clockOut(raw, hx711Pulses(converting));
+	return lastInput;
+}
+
+template <class Readout>
+bool HX711Core<Readout>::tare(byte times, uint16_t tolerance) {
+	return tareWithin(times, tolerance, false);
+}
+
+template <class Readout>
+bool HX711Core<Readout>::tare_auto(byte times) {
+	return tareWithin(times, 0, true);
+}
+
+template <class Readout>
+bool HX711Core<Readout>::tareWithin(byte times, uint16_t tolerance, bool autoTolerance) {
+	long values[CAPACITY];
+	long minValues[HX711_INPUTS][CAPACITY];
+	long maxValues[HX711_INPUTS][CAPACITY];
+	long long sums[HX711_INPUTS][CAPACITY];
+	uint16_t counts[HX711_INPUTS];
+
+	if (times == 0) {
+		return false;
+	}
+
+	// the auto tolerance has to be known before this attempt's samples are learned from
+	long tolerances[HX711_INPUTS][CAPACITY];
+	bool canCheck[HX711_INPUTS];
+	for (int i = 0; i < HX711_INPUTS; ++i) {
+		canCheck[i] = !autoTolerance || inputs[i].noiseLearned;
+		counts[i] = 0;
+		for (int j = 0; j < readout.count(); ++j) {
+			tolerances[i][j] = autoTolerance ? noiseTolerance(inputs[i], j) : tolerance;
+			minValues[i][j] = LONG_MAX;
+			maxValues[i][j] = LONG_MIN;
+			sums[i][j] = 0;
+		}
+	}
+
+	// running min, max and sum per input and channel
+	for (int n = 0; n < times * scheduleLength; ++n) {
+		readRaw(values);
+		byte i = lastInput;
+		learnNoise(inputs[i], values);
+		++counts[i];
+		for (int j = 0; j < readout.count(); ++j) {
+			if (values[j] < minValues[i][j]) {
+				minValues[i][j] = values[j];
+			}
+			if (values[j] > maxValues[i][j]) {
+				maxValues[i][j] = values[j];
+			}
+			sums[i][j] += values[j];
+		}
+	}
+
+	for (int i = 0; i < HX711_INPUTS; ++i) {
+		if (counts[i] == 0) {
+			continue;
+		}
+		if (!canCheck[i]) {
+			if (debugEnabled) {
+				Serial.println("Rejecting tare: noise not learned yet");
+			}
+			return false;
+		}
+
+		// Check if the fluctuation is within the tolerance
+		for (int j = 0; j < readout.count(); ++j) {
+			if ((autoTolerance || tolerance != 0) && counts[i] > 1) {
+				if (maxValues[i][j] - minValues[i][j] > tolerances[i][j]) {
+					// One of the cells fluctuated more than the allowed tolerance, reject tare attempt
+					if (debugEnabled) {
+						Serial.print("Rejecting tare: (");
+						Serial.print(j);
+						Serial.print(") ");
+						Serial.println(maxValues[i][j] - minValues[i][j]);
+					}
+					return false;
+				}
+			}
+		}
+	}
+
+	// Set the offsets to the mean values
+	for (int i = 0; i < HX711_INPUTS; ++i) {
+		if (counts[i] == 0) {
+			continue;
+		}
+		for (int j = 0; j < readout.count(); ++j) {
+			inputs[i].OFFSETS[j] = (long) (sums[i][j] / counts[i]);
+		}
+		inputs[i].restCount = 0;
+	}
+
+	return true;
+}
+
+// The difference of two successive readings removes the load and any slow drift, and its variance is twice the
+// noise variance; a running average of it follows the cell's noise figure without storing any history.
+template <class Readout>
+void HX711Core<Readout>::learnNoise(Input &in, const long *raw) {
+	if (in.noiseSamples > 0) {
+		// plain average over the first differences, then a running average over about 16
+		float weight = 1.0f / (in.noiseSamples < 16 ? in.noiseSamples : 16);
+		for (int j = 0; j < readout.count(); ++j) {
+			float d = (float) (raw[j] - in.LAST[j]);
+			in.NOISE[j] = in.noiseSamples == 1 ? d * d / 2 : in.NOISE[j] + (d * d / 2 - in.NOISE[j]) * weight;
+			if (!in.noiseLearned || in.NOISE[j] < in.NOISE_FLOOR[j]) {
+				in.NOISE_FLOOR[j] = in.NOISE[j];
+			} else {
+				in.NOISE_FLOOR[j] += (in.NOISE[j] - in.NOISE_FLOOR[j]) / 256;
+			}
+		}
+		in.noiseLearned = in.noiseSamples >= HX711_NOISE_LEARN_SAMPLES;
+	}
+	if (in.noiseSamples < 0xFFFF) {
+		++in.noiseSamples;
+	}
+	memcpy(in.LAST.data(), raw, readout.count() * sizeof(long));
+}
+
+template <class Readout>
+long HX711Core<Readout>::noiseTolerance(const Input &in, int channel) {
+	return (long) (HX711_NOISE_TOLERANCE_FACTOR * sqrtf(in.NOISE_FLOOR[channel])) + 1;
+}
+
+template <class Readout>
+float HX711Core<Readout>::get_noise(byte channel, byte input) {
+	const Input &in = inputs[resolve(input)];
+	if (channel >= readout.count() || !in.noiseLearned) {
+		return 0;
+	}
+	return sqrtf(in.NOISE[channel]);
+}
+
+template <class Readout>
+void HX711Core<Readout>::trackRest(Input &in, const long *tared) {
+	if (restSamples == 0 || !in.noiseLearned) {
+		return;
+	}
+	if (restHeld) {
+		in.restCount = 0;	// the window starts over once released
+		return;
+	}
+
+	bool restart = (in.restCount == 0);
+	if (!restart) {
+		for (int j = 0; j < readout.count(); ++j) {
+			long lo = tared[j] < in.REST_MIN[j] ? tared[j] : in.REST_MIN[j];
+			long hi = tared[j] > in.REST_MAX[j] ? tared[j] : in.REST_MAX[j];
+			if (hi - lo > noiseTolerance(in, j)) {
+				restart = true;
+				break;
+			}
+		}
+	}
+	if (restart) {
+		for (int j = 0; j < readout.count(); ++j) {
+			in.REST_MIN[j] = in.REST_MAX[j] = tared[j];
+			in.REST_SUM[j] = tared[j];
+		}
+		in.restCount = 1;
+		return;
+	}
+
+	for (int j = 0; j < readout.count(); ++j) {
+		if (tared[j] < in.REST_MIN[j]) {
+			in.REST_MIN[j] = tared[j];
+		}
+		if (tared[j] > in.REST_MAX[j]) {
+			in.REST_MAX[j] = tared[j];
+		}
+		in.REST_SUM[j] += tared[j];
+	}
+	if (++in.restCount < restSamples) {
+		return;
+	}
+
+	// at rest: re-zero, unless the resting value is a load rather than drift
+	in.restCount = 0;
+	long means[CAPACITY];
+	for (int j = 0; j < readout.count(); ++j) {
+		means[j] = (long) (in.REST_SUM[j] / restSamples);
+		if (labs(means[j]) > restDrift) {
+			return;
+		}
+	}
+	for (int j = 0; j < readout.count(); ++j) {
+		in.OFFSETS[j] += means[j];
+	}
+	++in.retares;
+}
+
+template <class Readout>
+void HX711Core<Readout>::set_auto_tare(uint16_t samples, long maxDrift) {
+	restSamples = samples;
+	restDrift = maxDrift;
+	for (int i = 0; i < HX711_INPUTS; ++i) {
+		inputs[i].restCount = 0;
+	}
+}
+
+template <class Readout>
+uint32_t HX711Core<Readout>::get_auto_tare_count() {
+	uint32_t total = 0;
+	for (int i = 0; i < HX711_INPUTS; ++i) {
+		total += inputs[i].retares;
+	}
+	return total;
+}
+
+//reads from all cahnnels and sets the values into the passed long array pointer (which must have at least 'count' cells allocated)
+//if you are only reading to toggle the line, and not to get values (such as in the case of setting gains) you can pass NULL.
+template <class Readout>
+void HX711Core<Readout>::read(long *result) {
+	long values[CAPACITY];
+
+	readRaw(values);
+	Input &in = inputs[lastInput];
+	learnNoise(in, values);
+
+	for (int j = 0; j < readout.count(); ++j) {
+		values[j] -= in.OFFSETS[j];
+	}
+	trackRest(in, values);
+
+	if (NULL!=result) {
+		memcpy(result, values, readout.count() * sizeof(long));
+	}
+}
+
+template <class Readout>
+void HX711Core<Readout>::readRaw(long *result) {
+	// wait for all the chips to become ready
+	while (!readout.ready());
+
+	convert(result);
+}
+
+template <class Readout>
+void HX711Core<Readout>::read_next(long *result) {
+	do {
+		read(result);
+	} while (lastInput != schedule[0]);
+}
+
+template <class Readout>
+void HX711Core<Readout>::set_calibration(byte channel, const HX711Calibration &calibration, byte input) {
+	if (channel < readout.count()) {
+		inputs[resolve(input)].CAL[channel] = calibration;
+	}
+}
+
+template <class Readout>
+HX711Calibration HX711Core<Readout>::get_calibration(byte channel, byte input) {
+	return inputs[resolve(input)].CAL[channel < readout.count() ? channel : 0];
+}
+
+template <class Readout>
+void HX711Core<Readout>::apply_calibration(long *values, byte input) {
+	const Input &in = inputs[resolve(input)];
+	for (int j = 0; j < readout.count(); ++j) {
+		values[j] = in.CAL[j].apply(values[j]);
+	}
+}
+
+template <class Readout>
+void HX711Core<Readout>::read_calibrated(long *result) {
+	read(result);
+	apply_calibration(result, lastInput);
+}
+
+template <class Readout>
+bool HX711Core<Readout>::poll() {
+	if (!readout.ready()) {
+		return false;
+	}
+
+	HX711Sample sample;
+	sample.timestamp = micros();
+	sample.input = convert(sample.values);
+	Input &in = inputs[sample.input];
+	learnNoise(in, sample.values);
+	for (int j = 0; j < readout.count(); ++j) {
+		sample.values[j] -= in.OFFSETS[j];
+	}
+	trackRest(in, sample.values);
+	in.samples.push(sample);
+	return true;
+}
+
+template <class Readout>
+bool HX711Core<Readout>::readLatest(long *result, unsigned long *timestamp, byte input) {
+	SpscRing<HX711Sample, HX711_RING_SIZE> &ring = inputs[resolve(input)].samples;
+	HX711Sample sample;
+	bool fresh = false;
+	while (ring.pop(sample)) {
+		fresh = true;
+	}
+	if (fresh) {
+		memcpy(result, sample.values, readout.count() * sizeof(long));
+		if (NULL != timestamp) {
+			*timestamp = sample.timestamp;
+		}
+	}
+	return fresh;
+}
+
+template <class Readout>
+size_t HX711Core<Readout>::drain(HX711Sample *out, size_t max, byte input) {
+	SpscRing<HX711Sample, HX711_RING_SIZE> &ring = inputs[resolve(input)].samples;
+	size_t n = 0;
+	while (n < max && ring.pop(out[n])) {
+		++n;
+	}
+	return n;
+}
+
+template <class Readout>
+uint32_t HX711Core<Readout>::droppedSamples() {
+	uint32_t total = 0;
+	for (int i = 0; i < HX711_INPUTS; ++i) {
+		total += inputs[i].samples.dropped();
+	}
+	return total;
+}
+
+template <class Readout>
+uint32_t HX711Core<Readout>::queueHighWater() const {
+	uint32_t most = 0;
+	for (int i = 0; i < HX711_INPUTS; ++i) {
+		uint32_t peak = inputs[i].samples.highWater();
+		most = peak > most ? peak : most;
+	}
+	return most;
+}
+
+template <class Readout>
+void HX711Core<Readout>::power_down() {
+	readout.writeClock(false);
+	readout.writeClock(true);
+	// the chips come back on channel A, gain 128; the next readout selects the schedule again
+	converting = HX711_A128;
+	step = 0;
+}
+
+template <class Readout>
+void HX711Core<Readout>::power_up() {
+	readout.writeClock(false);
+}
+
+#endif /* HX711_CORE_h */
@@ -1,183 +1,201 @@
 #include <Arduino.h>
 #include <HX711-multi.h>
-#include <vector>
-#include <cmath>
 
-HX711MULTI::HX711MULTI(int count, byte *dout, byte pd_sck, byte gain) {
-	PD_SCK 	= pd_sck;
-	DOUT 	= dout; //TODO - make the input of dout to the function a const, or otherwise copy the values for local storage
-	COUNT   = count;
+#if defined(ARDUINO_ARCH_ESP32)
+#include <driver/gpio.h>
+#include <Preferences.h>
+#endif
 
-	debugEnabled = false;
+#define HX711_CAL_STORE_VERSION 1
 
-	pinMode(PD_SCK, OUTPUT);
-	for (int i=0; i<count; i++) {
-		pinMode(DOUT[i], INPUT);
-	}
+HX711MULTI::HX711MULTI(int count, const byte *dout, byte pd_sck, byte gain, HX711PinIO *pinIO) {
+#if defined(ARDUINO_ARCH_ESP32)
+	asyncTask = NULL;
+#endif
+
+	readout.begin(count > HX711_MAX_CHANNELS ? HX711_MAX_CHANNELS : count, dout, pd_sck, pinIO);
 	set_gain(gain);
+}
 
-	OFFSETS = (long *) malloc(COUNT*sizeof(long));
+HX711MULTI::~HX711MULTI() {
+	endAsync();
+}
 
-	for (int i=0; i<COUNT; ++i) {
-		OFFSETS[i] = 0;
-	}
+void HX711PinIOReadout::begin(byte count, const byte *dout, byte pd_sck, HX711PinIO *pinIO) {
+	PD_SCK = pd_sck;
+	COUNT = count;
+	memcpy(DOUT, dout, COUNT);
+	io = (NULL != pinIO) ? pinIO : &defaultIO;
+	io->begin(PD_SCK, DOUT, COUNT);
 }
 
-HX711MULTI::~HX711MULTI() {
-	free(OFFSETS);
+void HX711PinIOReadout::clockOut(long *result, byte pulses) {
+	int i;
+	uint32_t lines[24];
+
+	if (!io->clockOut(lines, pulses)) {
+		// pulse the clock pin 24 times to read the data, latching every channel at once on each edge
+		for (i = 0; i < 24; ++i) {
+			io->writeClock(true);
+			lines[i] = io->readDataLines();
+			io->writeClock(false);
+		}
+
+		// set the channel and the gain factor for the next reading using the clock pin
+		for (i = 24; i < pulses; ++i) {
+			io->writeClock(true);
+			io->writeClock(false);
+		}
+	}
+
+	if (NULL!=result) {
+		HX711MULTI::deinterleave(lines, COUNT, result);
+	}
 }
 
-bool HX711MULTI::is_ready() { 
-	bool result = true;
-	for (int i = 0; i<COUNT; ++i) {
-		if (digitalRead(DOUT[i]) == HIGH) {
-			result = false;
+void HX711MULTI::deinterleave(const uint32_t *lines, byte count, long *result) {
+	for (int j = 0; j < count; ++j) {
+		uint32_t value = 0;
+		for (int i = 0; i < 24; ++i) {
+			value = (value << 1) | ((lines[i] >> j) & 1);
 		}
+		// Datasheet indicates the value is returned as a two's complement value, so 'stretch' the 24th bit to fit into 32 bits. 
+		result[j] = (long) ((int32_t) (value << 8) >> 8);
 	}
-	return result;
 }
 
-void HX711MULTI::set_gain(byte gain) {
+#if defined(ARDUINO_ARCH_ESP32)
 
-	switch (gain) {
-		case 128:		// channel A, gain factor 128
-			GAIN = 1;
-			break;
-		case 64:		// channel A, gain factor 64
-			GAIN = 3;
-			break;
-		case 32:		// channel B, gain factor 32
-			GAIN = 2;
-			break;
-	}
+// A128 under "cal", as before there were inputs; B32 and A64 under "cal32" and "cal64"
+static const char *const CAL_KEYS[HX711_INPUTS] = {"cal", "cal32", "cal64"};
 
-	digitalWrite(PD_SCK, LOW);
-	read(); //a read is needed to get gain setting to come into effect. (for the next read)
-}
-
-byte HX711MULTI::get_count() {
-	return COUNT;
-}
-
-//TODO: write a function / state variable that 'learns' (stores/tracks) the expected noise figure from the cells, and automatically selects a reasonable 'tolerance' for tare.
-//		i.e. a 'best recently seen stability'. Keep it up-to-date automatically by updating it with every read. (reads will probably need to be time-aware)
-
-bool HX711MULTI::tare(byte times, uint16_t tolerance) {
-    // Array to hold the readings for each load cell
-    long values[COUNT];
-    std::vector<std::vector<long>> allValues(COUNT, std::vector<long>(times));
-
-    // Read multiple samples
-    for (int i = 0; i < times; ++i) {
-        readRaw(values);
-        for (int j = 0; j < COUNT; ++j) {
-            allValues[j][i] = values[j];
-        }
-    }
-
-    // Calculate min, max, and mean values
-    std::vector<long> minValues(COUNT, LONG_MAX);
-    std::vector<long> maxValues(COUNT, LONG_MIN);
-    std::vector<long> meanValues(COUNT, 0);
-
-    for (int i = 0; i < COUNT; ++i) {
-        for (int j = 0; j < times; ++j) {
-            if (allValues[i][j] < minValues[i]) {
-                minValues[i] = allValues[i][j];
-            }
-            if (allValues[i][j] > maxValues[i]) {
-                maxValues[i] = allValues[i][j];
-            }
-            meanValues[i] += allValues[i][j];
-        }
-        meanValues[i] /= times;
-    }
-
-    // Check if the fluctuation is within the tolerance
-    for (int i = 0; i < COUNT; ++i) {
-        if (tolerance != 0 && times > 1) {
-            if (abs(maxValues[i] - minValues[i]) > tolerance) {
-                // One of the cells fluctuated more than the allowed tolerance, reject tare attempt
-                if (debugEnabled) {
-                    Serial.print("Rejecting tare: (");
-                    Serial.print(i);
-                    Serial.print(") ");
-                    Serial.println(abs(maxValues[i] - minValues[i]));
-                }
-                return false;
-            }
-        }
-    }
-
-    // Set the offsets to the mean values
-    for (int i = 0; i < COUNT; ++i) {
-        OFFSETS[i] = meanValues[i];
-    }
-
-    return true;
-}
-
-
-//reads from all cahnnels and sets the values into the passed long array pointer (which must have at least 'count' cells allocated)
-//if you are only reading to toggle the line, and not to get values (such as in the case of setting gains) you can pass NULL.
-void HX711MULTI::read(long *result) {
-    
-    readRaw(result);
-    
-    // Datasheet indicates the value is returned as a two's complement value, so 'stretch' the 24th bit to fit into 32 bits. 
-	if (NULL!=result) {
-		for (int j = 0; j < COUNT; ++j) {
-		    result[j] -= OFFSETS[j];
+bool HX711MULTI::save_calibration(const char *name) {
+	Preferences prefs;
+	if (!prefs.begin(name, false)) {
+		return false;
+	}
+	size_t size = get_count() * sizeof(HX711Calibration);
+	bool ok = prefs.putUChar("version", HX711_CAL_STORE_VERSION) == 1
+		&& prefs.putUChar("count", get_count()) == 1;
+	for (int i = 0; ok && i < HX711_INPUTS; ++i) {
+		ok = prefs.putBytes(CAL_KEYS[i], inputs[i].CAL.data(), size) == size;
+	}
+	prefs.end();
+	return ok;
+}
 
+bool HX711MULTI::load_calibration(const char *name) {
+	Preferences prefs;
+	if (!prefs.begin(name, true)) {
+		return false;
+	}
+	size_t size = get_count() * sizeof(HX711Calibration);
+	bool ok = prefs.getUChar("version", 0) == HX711_CAL_STORE_VERSION
+		&& prefs.getUChar("count", 0) == get_count()
+		&& prefs.getBytesLength(CAL_KEYS[HX711_A128]) == size;
+	for (int i = 0; ok && i < HX711_INPUTS; ++i) {
+		// stores older than the inputs only have A128
+		if (prefs.getBytesLength(CAL_KEYS[i]) == size) {
+			prefs.getBytes(CAL_KEYS[i], inputs[i].CAL.data(), size);
 		}
 	}
+	prefs.end();
+	return ok;
 }
 
+#else
 
-void HX711MULTI::readRaw(long *result) {
-	int i,j;
-	// wait for all the chips to become ready
-	while (!is_ready());
+bool HX711MULTI::save_calibration(const char *) {
+	return false;
+}
 
-	// pulse the clock pin 24 times to read the data
-	for (i = 0; i < 24; ++i) {
-		digitalWrite(PD_SCK, HIGH);
-		if (NULL!=result) {
-			for (j = 0; j < COUNT; ++j) {
-				bitWrite(result[j], 23-i, digitalRead(DOUT[j]));
-			}
+bool HX711MULTI::load_calibration(const char *) {
+	return false;
+}
+
+#endif
+
+void HX711MULTI::read_next(long *result) {
+#if defined(ARDUINO_ARCH_ESP32)
+	if (NULL != asyncTask) {
+		HX711Sample sample;
+		while (!inputs[schedule[0]].samples.pop(sample)) {
+			delay(1);
 		}
-		digitalWrite(PD_SCK, LOW);
+		memcpy(result, sample.values, get_count() * sizeof(long));
+		return;
 	}
-   
-	// set the channel and the gain factor for the next reading using the clock pin
-	for (i = 0; i < GAIN; ++i) {
-		digitalWrite(PD_SCK, HIGH);
-		digitalWrite(PD_SCK, LOW);
+#endif
+	HX711Core<HX711PinIOReadout>::read_next(result);
+}
+
+#if defined(ARDUINO_ARCH_ESP32)
+
+// DOUT falling edge: a conversion finished on the watched chip
+void IRAM_ATTR HX711MULTI::readyISR(void *arg) {
+	HX711MULTI *self = (HX711MULTI *) arg;
+	BaseType_t woken = pdFALSE;
+	vTaskNotifyGiveFromISR((TaskHandle_t) self->asyncTask, &woken);
+	if (woken) {
+		portYIELD_FROM_ISR();
 	}
+}
 
-    // Datasheet indicates the value is returned as a two's complement value, so 'stretch' the 24th bit to fit into 32 bits. 
-    if (NULL!=result) {
-	    for (j = 0; j < COUNT; ++j) {
-	    	if ( ( result[j] & 0x00800000 ) ) {
-	    		result[j] |= 0xFF000000;
-	    	} else {
-	    		result[j] &= 0x00FFFFFF; //required in lieu of re-setting the value to zero before shifting bits in.
-	    	}
-	    } 
+void HX711MULTI::acquisitionTask(void *arg) {
+	HX711MULTI *self = (HX711MULTI *) arg;
+	gpio_num_t watched = (gpio_num_t) self->readout.dout(self->get_count() - 1);
+
+	for (;;) {
+		// the timeout covers a missed edge; at 10 SPS a conversion is due every 100 ms
+		ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(120));
+
+		// the chips are not phase locked: give the slower ones a few ms to catch up
+		for (int tries = 0; tries < 5; ++tries) {
+			self->meter.begin();
+			gpio_intr_disable(watched);	// DOUT toggles with the data bits during the readout
+			bool taken = self->poll();
+			gpio_intr_enable(watched);
+			self->meter.end();
+			if (taken) {
+				break;
+			}
+			vTaskDelay(1);
+		}
+		ulTaskNotifyTake(pdTRUE, 0);	// drop the edges caused by our own readout
+	}
+}
 
-    }
+bool HX711MULTI::beginAsync(uint8_t priority, int8_t core) {
+	if (NULL != asyncTask) {
+		return true;
+	}
+	TaskHandle_t handle;
+	if (xTaskCreatePinnedToCore(acquisitionTask, "hx711", 3072, this, priority, &handle,
+			core < 0 ? tskNO_AFFINITY : core) != pdPASS) {
+		return false;
+	}
+	asyncTask = handle;
+	meter.place(handle, core, priority);
+	attachInterruptArg(readout.dout(get_count() - 1), readyISR, this, FALLING);
+	return true;
 }
 
-void HX711MULTI::setDebugEnable(bool debugEnable) {
-	debugEnabled = debugEnable;
+void HX711MULTI::endAsync() {
+	if (NULL == asyncTask) {
+		return;
+	}
+	detachInterrupt(readout.dout(get_count() - 1));
+	vTaskDelete((TaskHandle_t) asyncTask);
+	asyncTask = NULL;
 }
 
-void HX711MULTI::power_down() {
-	digitalWrite(PD_SCK, LOW);
-	digitalWrite(PD_SCK, HIGH);
+#else
+
+bool HX711MULTI::beginAsync(uint8_t, int8_t) {
+	return false;
 }
 
-void HX711MULTI::power_up() {
-	digitalWrite(PD_SCK, LOW);
+void HX711MULTI::endAsync() {
 }
+
+#endif
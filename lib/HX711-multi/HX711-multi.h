@@ -7,60 +7,70 @@
 #include "WProgram.h"
 #endif
 
-class HX711MULTI
+#include "HX711-pinio.h"
+#include "HX711-core.h"
+
+// the readout of HX711MULTI: pins and gain chosen at run time, pin access through an HX711PinIO backend
+class HX711PinIOReadout
 {
 	private:
 		byte PD_SCK;	// Power Down and Serial Clock Input Pin
 		byte COUNT;		// The number of channels to read
-		byte *DOUT;		// Serial Data Output Pin
-		byte GAIN;		// amplification factor
-
-		bool debugEnabled; //print debug messages?
+		byte DOUT[HX711_MAX_CHANNELS];	// Serial Data Output Pins, copied
 
-		long *OFFSETS;	// used for tare weight
-		float SCALE;	// used to return weight in grams, kg, ounces, whatever
+		HX711DefaultPinIO defaultIO;	// backend used when none is passed to begin()
+		HX711PinIO *io;		// pin access backend
 
 	public:
-		// define clock and data pin, channel, and gain factor
-		// channel selection is made by passing the appropriate gain: 128 or 64 for channel A, 32 for channel B
-		// count: the number of channels
-		// dout: an array of pin numbers, of length 'count', one entry per channel
-		HX711MULTI(int count, byte *dout, byte pd_sck, byte gain = 128);
+		static const byte CAPACITY = HX711_MAX_CHANNELS;
 
-		virtual ~HX711MULTI();
+		HX711PinIOReadout() : PD_SCK(0), COUNT(0), io(&defaultIO) {}
 
-		//returns the number of channels
-		byte get_count();
+		void begin(byte count, const byte *dout, byte pd_sck, HX711PinIO *pinIO);
 
-		// check if HX711 is ready
-		// from the datasheet: When output data is not ready for retrieval, digital output pin DOUT is high. Serial clock
-		// input PD_SCK should be low. When DOUT goes to low, it indicates data is ready for retrieval.
-		bool is_ready();
+		byte count() const { return COUNT; }
+		byte dout(byte channel) const { return DOUT[channel]; }
+		bool ready() { return io->readDataLines() == 0; }	// every DOUT line has to be low
+		void clockOut(long *result, byte pulses);
+		void writeClock(bool high) { io->writeClock(high); }
+};
 
-		// set the gain factor; takes effect only after a call to read()
-		// channel A can be set for a 128 or 64 gain; channel B has a fixed 32 gain
-		// depending on the parameter, the channel is also set to either A or B
-		void set_gain(byte gain = 128);
+class HX711MULTI : public HX711Core<HX711PinIOReadout>
+{
+	private:
+#if defined(ARDUINO_ARCH_ESP32)
+		void *asyncTask;	// TaskHandle_t of the acquisition task, NULL when not running
+		static void readyISR(void *arg);
+		static void acquisitionTask(void *arg);
+#endif
 
-		// waits for the chip to be ready and returns a reading
-		void read(long *result = NULL);
+	public:
+		// define clock and data pin, channel, and gain factor
+		// channel selection is made by passing the appropriate gain: 128 or 64 for channel A, 32 for channel B
+		// count: the number of channels
+		// dout: an array of pin numbers, of length 'count', one entry per channel; copied
+		// io: pin access backend; NULL selects the fastest one available on this platform
+		HX711MULTI(int count, const byte *dout, byte pd_sck, byte gain = 128, HX711PinIO *io = NULL);
 
-		// same as read, but does not offset the values according to the tare
-		void readRaw(long *result = NULL);
+		virtual ~HX711MULTI();
 
-		// set the OFFSET value for tare weight
-		// times: how many times to read the tare value
-		// returns true iff the offsets have been reset for the scale during this call.
-		// tolerance: the maximum deviation of samples, above which to reject the attempt to tare. (if set to 0, ignored)
-		bool tare(byte times = 10, uint16_t tolerance = 0);
+		// starts a task that calls poll() whenever DOUT signals a finished conversion (ESP32 only).
+		// on other platforms returns false; call poll() from the main loop instead.
+		bool beginAsync(uint8_t priority = 3, int8_t core = -1);
+		void endAsync();
 
-		// puts the chip into power down mode
-		void power_down();
+		// waits for the next tared conversion of the primary input: from its sample ring while the acquisition
+		// task runs, else read()
+		void read_next(long *result);
 
-		// wakes up the chip after power down mode
-		void power_up();
+		// keeps the calibration of every channel and input in non-volatile storage (NVS namespace 'name' on the ESP32).
+		// return false where there is no such storage or nothing valid was stored.
+		bool save_calibration(const char *name = "hx711");
+		bool load_calibration(const char *name = "hx711");
 
-		void setDebugEnable(bool debugEnable = true);
+		// turns the DOUT levels latched on each of the 24 clock edges into sign-extended readings
+		// lines[i]: bit j holds channel j's bit (23-i)
+		static void deinterleave(const uint32_t *lines, byte count, long *result);
 };
 
 #endif /* HX711_MULTI_h */
@@ -0,0 +1,174 @@
+#include <Arduino.h>
+#include <HX711-pinio.h>
+
+#if defined(ARDUINO_ARCH_ESP32)
+#include <driver/gpio.h>
+#include <soc/gpio_reg.h>
+#include <soc/spi_periph.h>
+#include <xtensa/core-macros.h>
+#endif
+
+void HX711DigitalPinIO::begin(byte pd_sck, const byte *dout, byte count) {
+	PD_SCK = pd_sck;
+	DOUT = dout;
+	COUNT = count;
+
+	pinMode(PD_SCK, OUTPUT);
+	for (int i = 0; i < COUNT; ++i) {
+		pinMode(DOUT[i], INPUT);
+	}
+}
+
+void HX711DigitalPinIO::writeClock(bool high) {
+	digitalWrite(PD_SCK, high ? HIGH : LOW);
+}
+
+uint32_t HX711DigitalPinIO::readDataLines() {
+	uint32_t lines = 0;
+	for (int j = 0; j < COUNT; ++j) {
+		if (digitalRead(DOUT[j]) == HIGH) {
+			lines |= 1UL << j;
+		}
+	}
+	return lines;
+}
+
+#if defined(ARDUINO_ARCH_ESP32)
+
+void HX711Esp32PinIO::begin(byte pd_sck, const byte *dout, byte count) {
+	COUNT = count > 32 ? 32 : count;
+	clockMask = 1UL << (pd_sck & 31);
+	clockBank1 = pd_sck >= 32;
+	needBank1 = false;
+
+	pinMode(pd_sck, OUTPUT);
+	for (int j = 0; j < COUNT; ++j) {
+		pinMode(dout[j], INPUT);
+		SHIFT[j] = dout[j] & 63;
+		if (dout[j] >= 32) {
+			needBank1 = true;
+		}
+	}
+
+	// 0.25us per half period; the HX711 needs 0.2us minimum and DOUT settles 0.1us after the rising edge
+	holdCycles = getCpuFrequencyMhz() / 4;
+}
+
+void HX711Esp32PinIO::writeClock(bool high) {
+	uint32_t reg;
+	if (clockBank1) {
+		reg = high ? GPIO_OUT1_W1TS_REG : GPIO_OUT1_W1TC_REG;
+	} else {
+		reg = high ? GPIO_OUT_W1TS_REG : GPIO_OUT_W1TC_REG;
+	}
+	REG_WRITE(reg, clockMask);
+
+	uint32_t start = XTHAL_GET_CCOUNT();
+	while (XTHAL_GET_CCOUNT() - start < holdCycles);
+}
+
+uint32_t HX711Esp32PinIO::readDataLines() {
+	uint64_t in = REG_READ(GPIO_IN_REG);
+	if (needBank1) {
+		in |= (uint64_t) REG_READ(GPIO_IN1_REG) << 32;
+	}
+
+	uint32_t lines = 0;
+	for (int j = 0; j < COUNT; ++j) {
+		lines |= (uint32_t) ((in >> SHIFT[j]) & 1) << j;
+	}
+	return lines;
+}
+
+void HX711SpiPinIO::begin(byte pd_sck, const byte *dout, byte count) {
+	gpio.begin(pd_sck, dout, count);
+	PD_SCK = pd_sck;
+	width = count == 2 ? 2 : 4;
+	mask = (1UL << count) - 1;
+	device = NULL;
+	if (count != 2 && count != 4) {
+		return;
+	}
+
+	// IO0..IO3 of the read are the DOUT lines of chips 0..3
+	spi_bus_config_t bus;
+	memset(&bus, 0, sizeof(bus));
+	bus.mosi_io_num = dout[0];
+	bus.miso_io_num = dout[1];
+	bus.quadwp_io_num = count == 4 ? dout[2] : -1;
+	bus.quadhd_io_num = count == 4 ? dout[3] : -1;
+	bus.sclk_io_num = pd_sck;
+	bus.max_transfer_sz = sizeof(rx);
+	bus.flags = SPICOMMON_BUSFLAG_MASTER | (count == 4 ? SPICOMMON_BUSFLAG_QUAD : SPICOMMON_BUSFLAG_DUAL);
+	// 16 bytes fit the FIFO: no DMA, whose buffers would have to be a multiple of 4 bytes long
+	if (spi_bus_initialize(host, &bus, SPI_DMA_DISABLED) != ESP_OK) {
+		return;
+	}
+
+	spi_device_interface_config_t config;
+	memset(&config, 0, sizeof(config));
+	config.mode = 1;	// PD_SCK idles low; sampled on the falling edge, DOUT settles 0.1us after the rising one
+	config.clock_speed_hz = clockHz;
+	config.spics_io_num = -1;
+	config.flags = SPI_DEVICE_HALFDUPLEX;
+	config.queue_size = 1;
+	config.post_cb = transferDone;
+	if (spi_bus_add_device(host, &config, &device) != ESP_OK) {
+		device = NULL;
+		spi_bus_free(host);
+		return;
+	}
+
+	// the bus set IO0..IO3 up as outputs too: keep only their inputs, the chips drive DOUT
+	for (int j = 0; j < count; ++j) {
+		pinMatrixOutDetach(dout[j], false, false);
+		gpio_set_direction((gpio_num_t) dout[j], GPIO_MODE_INPUT);
+	}
+}
+
+// SPI interrupt, after the FIFO was copied into rx: pulse i took bits i * width and up, MSB first, IO3
+// (or IO1) the highest
+void IRAM_ATTR HX711SpiPinIO::transferDone(spi_transaction_t *transaction) {
+	HX711SpiPinIO *self = (HX711SpiPinIO *) transaction->user;
+	const uint8_t *bytes = (const uint8_t *) self->rx;
+	for (int i = 0; i < 24; ++i) {
+		int bit = i * self->width;
+		self->lines[i] = (bytes[bit >> 3] >> (8 - self->width - (bit & 7))) & self->mask;
+	}
+}
+
+bool HX711SpiPinIO::clockOut(uint32_t *out, byte pulses) {
+	if (NULL == device || xTaskGetSchedulerState() != taskSCHEDULER_RUNNING) {
+		return false;
+	}
+
+	spi_transaction_t transaction;
+	memset(&transaction, 0, sizeof(transaction));
+	transaction.flags = width == 4 ? SPI_TRANS_MODE_QIO : SPI_TRANS_MODE_DIO;
+	transaction.rxlength = pulses * width;
+	transaction.rx_buffer = rx;
+	transaction.user = this;
+	lines = out;
+
+	// the task sleeps while the controller clocks; transferDone fills lines
+	spi_transaction_t *done;
+	return spi_device_queue_trans(device, &transaction, portMAX_DELAY) == ESP_OK
+		&& spi_device_get_trans_result(device, &done, portMAX_DELAY) == ESP_OK;
+}
+
+// PD_SCK from the GPIO output register while it is high (power down, or a readout clocked by hand), back
+// to the SPI clock once low; the GPIO register is low whenever the SPI has the pin, so neither hand-over
+// makes an edge
+void HX711SpiPinIO::writeClock(bool high) {
+	if (NULL == device) {
+		gpio.writeClock(high);
+	} else if (high) {
+		pinMatrixOutDetach(PD_SCK, false, false);
+		gpio.writeClock(true);
+	} else {
+		gpio.writeClock(false);
+		pinMatrixOutAttach(PD_SCK, spi_periph_signal[host].spiclk_out, false, false);
+	}
+}
+
+#endif
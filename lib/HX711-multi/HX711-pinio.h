@@ -0,0 +1,108 @@
+#ifndef HX711_PINIO_h
+#define HX711_PINIO_h
+
+#if ARDUINO >= 100
+#include "Arduino.h"
+#else
+#include "WProgram.h"
+#endif
+
+// Pin access used by HX711MULTI. A backend drives PD_SCK and latches all DOUT lines at once;
+// the bit assembly stays in HX711MULTI so every backend shares it.
+class HX711PinIO
+{
+	public:
+		virtual ~HX711PinIO() {}
+
+		// configure the pins; dout must stay valid for the lifetime of the backend
+		virtual void begin(byte pd_sck, const byte *dout, byte count) = 0;
+
+		virtual void writeClock(bool high) = 0;
+
+		// sample every DOUT line; bit j of the result holds the level of dout[j]
+		virtual uint32_t readDataLines() = 0;
+
+		// a backend that has a peripheral clock a whole readout, 'pulses' PD_SCK pulses, fills lines[i] with
+		// what readDataLines() would have returned after data pulse i and returns true. false: the caller
+		// clocks it out with writeClock()/readDataLines()
+		virtual bool clockOut(uint32_t *, byte) { return false; }
+};
+
+// portable backend: digitalWrite for the clock and one digitalRead per channel and edge
+class HX711DigitalPinIO : public HX711PinIO
+{
+	private:
+		byte PD_SCK;
+		byte COUNT;
+		const byte *DOUT;
+
+	public:
+		void begin(byte pd_sck, const byte *dout, byte count);
+		void writeClock(bool high);
+		uint32_t readDataLines();
+};
+
+#if defined(ARDUINO_ARCH_ESP32)
+#include <driver/spi_master.h>
+
+// fast path: the clock is driven through the W1TS/W1TC registers and every DOUT line is latched
+// with a single GPIO_IN_REG read (plus GPIO_IN1_REG when a DOUT sits on GPIO32-39)
+class HX711Esp32PinIO : public HX711PinIO
+{
+	private:
+		uint32_t clockMask;
+		bool clockBank1;
+		bool needBank1;
+		byte COUNT;
+		byte SHIFT[32];		// bit position of each DOUT inside its input register (bank 1 positions have bit 5 set)
+		uint32_t holdCycles;	// spin time after each edge, keeps PD_SCK high/low >= 0.2us
+
+	public:
+		void begin(byte pd_sck, const byte *dout, byte count);
+		void writeClock(bool high);
+		uint32_t readDataLines();
+};
+
+// The SPI controller clocks the readout: PD_SCK is its clock, and a quad (QIO) read samples four DOUT
+// lines on each falling edge, the chips' bits side by side in the FIFO. The pulse train is timed by the
+// peripheral, so no interrupt can stretch PD_SCK high into a power down, and the calling task sleeps
+// during the transfer; the transfer's completion callback, in the SPI interrupt, unpacks the nibbles
+// into lines. The DOUT pins only get the controller's inputs: the SPI never drives them. The ready check
+// and power down go through the GPIO registers, PD_SCK handed back to the SPI when it goes low.
+// 2 chips take a dual read, 4 a quad one; any other count, an SPI bus that cannot be set up, or a
+// readout before the scheduler runs (a global's constructor) falls back to HX711Esp32PinIO.
+class HX711SpiPinIO : public HX711PinIO
+{
+	private:
+		HX711Esp32PinIO gpio;	// ready check, power down, and the fallback
+		spi_host_device_t host;
+		uint32_t clockHz;
+		spi_device_handle_t device;	// NULL when falling back
+		byte PD_SCK;
+		byte width;				// DOUT lines sampled per pulse: 2 (dual read) or 4 (quad read)
+		uint32_t mask;			// DOUT lines in use
+		uint32_t *lines;		// of the readout under way
+		uint32_t rx[4];			// 27 pulses x 4 lines, one nibble per pulse
+
+		static void transferDone(spi_transaction_t *transaction);
+
+	public:
+		// host: SPI2_HOST (HSPI) or SPI3_HOST (VSPI), one the sketch does not use otherwise. clockHz: PD_SCK
+		// frequency; 1 MHz is 0.5 us high, within the HX711's 0.2 to 50 us
+		HX711SpiPinIO(spi_host_device_t host = SPI2_HOST, uint32_t clockHz = 1000000)
+			: host(host), clockHz(clockHz), device(NULL), PD_SCK(0), width(0), mask(0), lines(NULL) {}
+
+		void begin(byte pd_sck, const byte *dout, byte count);
+		void writeClock(bool high);
+		uint32_t readDataLines() { return gpio.readDataLines(); }
+		bool clockOut(uint32_t *lines, byte pulses);
+
+		bool usesPeripheral() const { return device != NULL; }
+};
+
+typedef HX711Esp32PinIO HX711DefaultPinIO;
+#else
+typedef HX711DigitalPinIO HX711DefaultPinIO;
+#endif
+
+#endif /* HX711_PINIO_h */
@@ -0,0 +1,202 @@
+/*
+  HX711-static.h - HX711MULTI with its pins fixed at compile time.
+
+    HX711Static<HX711Pins<18, 25, 26, 0, 14>, 128> scales;	// PD_SCK 18, four DOUT lines, channel A
+
+  Same tare, noise, calibration and sample ring as HX711MULTI (HX711-core.h), but the readout knows
+  everything at compile time: the 24 data pulses are unrolled by the template, each one latching the
+  input register once and shifting every channel's bit straight into its word, with the register
+  addresses, clock mask and DOUT bit positions as constants. Per-channel storage is std::array sized
+  by the pin count; nothing is allocated and nothing is called through a pointer. There is no
+  beginAsync() or NVS storage: a task calls poll() itself.
+
+  A pin set is a class of static functions:
+
+    static const byte COUNT               DOUT lines
+    static void begin()                   pin modes
+    static void clock(bool high)          drives PD_SCK, holding it long enough for the HX711
+    static bool ready()                   every DOUT line is low
+    static void shift(uint32_t *words)    latches every DOUT line once: words[j] = words[j] << 1 | DOUT j
+
+  HX711Pins is the ESP32 register one (GPIO_OUT_W1TS/W1TC, GPIO_IN_REG), digitalRead/digitalWrite
+  elsewhere; SimRegisterPins (lib/SimHal) is the host one.
+*/
+#ifndef HX711_STATIC_h
+#define HX711_STATIC_h
+
+#if ARDUINO >= 100
+#include "Arduino.h"
+#else
+#include "WProgram.h"
+#endif
+
+#include "HX711-core.h"
+
+#if defined(ARDUINO_ARCH_ESP32)
+#include <soc/gpio_reg.h>
+#include <xtensa/core-macros.h>
+#endif
+
+// the DOUT lines of a pin set, one recursion step per channel
+template <byte... DOUT>
+struct HX711DoutSet
+{
+	static const byte COUNT = 0;
+	static const uint64_t MASK = 0;			// bit of each line in the 64-bit input register pair
+	static const bool BANK1 = false;		// a line sits on GPIO32-39
+
+	static inline void begin() {}
+	static inline void shift(uint64_t, uint32_t *) {}
+	static inline bool anyHigh() { return false; }
+	static inline void shiftDigital(uint32_t *) {}
+};
+
+template <byte FIRST, byte... REST>
+struct HX711DoutSet<FIRST, REST...>
+{
+	typedef HX711DoutSet<REST...> Rest;
+	static const byte COUNT = 1 + Rest::COUNT;
+	static const uint64_t MASK = (1ULL << (FIRST & 63)) | Rest::MASK;
+	static const bool BANK1 = FIRST >= 32 || Rest::BANK1;
+
+	static inline void begin() {
+		pinMode(FIRST, INPUT);
+		Rest::begin();
+	}
+
+	// 'in' holds the input registers, bank 1 in the high word
+	static inline __attribute__((always_inline)) void shift(uint64_t in, uint32_t *words) {
+		words[0] = (words[0] << 1) | (uint32_t) ((in >> FIRST) & 1);
+		Rest::shift(in, words + 1);
+	}
+
+	static inline bool anyHigh() {
+		return digitalRead(FIRST) == HIGH || Rest::anyHigh();
+	}
+
+	static inline __attribute__((always_inline)) void shiftDigital(uint32_t *words) {
+		words[0] = (words[0] << 1) | (digitalRead(FIRST) == HIGH ? 1 : 0);
+		Rest::shiftDigital(words + 1);
+	}
+};
+
+template <byte PD_SCK, byte... DOUT>
+class HX711Pins
+{
+	private:
+		typedef HX711DoutSet<DOUT...> Dout;
+
+	public:
+		static const byte COUNT = Dout::COUNT;
+		static_assert(COUNT > 0, "at least one DOUT pin");
+
+#if defined(ARDUINO_ARCH_ESP32)
+		static uint32_t holdCycles;	// spin time after each edge, keeps PD_SCK high/low >= 0.2us
+
+		static void begin() {
+			pinMode(PD_SCK, OUTPUT);
+			Dout::begin();
+			// 0.25us per half period; the HX711 needs 0.2us minimum and DOUT settles 0.1us after the rising edge
+			holdCycles = getCpuFrequencyMhz() / 4;
+		}
+
+		static inline __attribute__((always_inline)) void clock(bool high) {
+			if (PD_SCK >= 32) {
+				REG_WRITE(high ? GPIO_OUT1_W1TS_REG : GPIO_OUT1_W1TC_REG, 1UL << (PD_SCK & 31));
+			} else {
+				REG_WRITE(high ? GPIO_OUT_W1TS_REG : GPIO_OUT_W1TC_REG, 1UL << (PD_SCK & 31));
+			}
+			uint32_t start = XTHAL_GET_CCOUNT();
+			while (XTHAL_GET_CCOUNT() - start < holdCycles);
+		}
+
+		static inline __attribute__((always_inline)) uint64_t levels() {
+			uint64_t in = REG_READ(GPIO_IN_REG);
+			if (Dout::BANK1) {
+				in |= (uint64_t) REG_READ(GPIO_IN1_REG) << 32;
+			}
+			return in;
+		}
+
+		static inline bool ready() { return (levels() & Dout::MASK) == 0; }
+		static inline __attribute__((always_inline)) void shift(uint32_t *words) { Dout::shift(levels(), words); }
+#else
+		static void begin() {
+			pinMode(PD_SCK, OUTPUT);
+			Dout::begin();
+		}
+
+		static inline void clock(bool high) { digitalWrite(PD_SCK, high ? HIGH : LOW); }
+		static inline bool ready() { return !Dout::anyHigh(); }
+		static inline __attribute__((always_inline)) void shift(uint32_t *words) { Dout::shiftDigital(words); }
+#endif
+};
+
+#if defined(ARDUINO_ARCH_ESP32)
+template <byte PD_SCK, byte... DOUT>
+uint32_t HX711Pins<PD_SCK, DOUT...>::holdCycles = 0;
+#endif
+
+// BITS clock pulses, each latching one bit of every channel: unrolled by the recursion
+template <class Pins, byte BITS>
+struct HX711ShiftIn
+{
+	static inline __attribute__((always_inline)) void run(uint32_t *words) {
+		Pins::clock(true);
+		Pins::shift(words);
+		Pins::clock(false);
+		HX711ShiftIn<Pins, BITS - 1>::run(words);
+	}
+};
+
+template <class Pins>
+struct HX711ShiftIn<Pins, 0>
+{
+	static inline void run(uint32_t *) {}
+};
+
+// the readout of HX711Static, see HX711-core.h
+template <class Pins>
+class HX711StaticReadout
+{
+	public:
+		static const byte CAPACITY = Pins::COUNT;
+
+		static constexpr byte count() { return Pins::COUNT; }
+		static inline bool ready() { return Pins::ready(); }
+		static inline void writeClock(bool high) { Pins::clock(high); }
+
+		static void clockOut(long *result, byte pulses) {
+			uint32_t words[CAPACITY] = {};
+
+			HX711ShiftIn<Pins, 24>::run(words);
+
+			// set the channel and the gain factor for the next reading using the clock pin
+			for (byte i = 24; i < pulses; ++i) {
+				Pins::clock(true);
+				Pins::clock(false);
+			}
+
+			if (NULL != result) {
+				for (byte j = 0; j < CAPACITY; ++j) {
+					// two's complement: 'stretch' the 24th bit to fit into 32 bits
+					result[j] = (long) ((int32_t) (words[j] << 8) >> 8);
+				}
+			}
+		}
+};
+
+template <class Pins, byte GAIN = 128>
+class HX711Static : public HX711Core<HX711StaticReadout<Pins> >
+{
+	public:
+		static_assert(GAIN == 128 || GAIN == 64 || GAIN == 32, "gain is 128 or 64 (channel A) or 32 (channel B)");
+
+		// configures the pins and reads once, so that the gain is in effect for the next read
+		HX711Static() {
+			Pins::begin();
+			this->set_gain(GAIN);
+		}
+};
+
+#endif /* HX711_STATIC_h */
@@ -0,0 +1,128 @@
+#include <Arduino.h>
+#include <ImpactDetector.h>
+#include <PlankBytes.h>
+
+size_t packPiezoHit(uint8_t *out, const PiezoHit &hit) {
+	put16(&out[0], hit.impact);
+	out[2] = hit.channel;
+	put16(&out[3], hit.time & 0xFFFF);
+	put16(&out[5], hit.time >> 16);
+	put16(&out[7], (uint16_t) hit.delay);
+	put16(&out[9], hit.peak);
+	put16(&out[11], hit.rise);
+	return HIT_PACKET_SIZE;
+}
+
+PiezoHit unpackPiezoHit(const uint8_t *in) {
+	PiezoHit hit;
+	hit.impact = get16(&in[0]);
+	hit.channel = in[2];
+	hit.time = get16(&in[3]) | ((uint32_t) get16(&in[5]) << 16);
+	hit.delay = (int16_t) get16(&in[7]);
+	hit.peak = get16(&in[9]);
+	hit.rise = get16(&in[11]);
+	return hit;
+}
+
+ImpactDetector::ImpactDetector() {
+	ImpactConfig defaults = IMPACT_DEFAULT_CONFIG;
+	config = defaults;
+	impact = 0;
+	impactStart = 0;
+	impactOpen = false;
+	reported = 0;
+	reset();
+}
+
+void ImpactDetector::reset() {
+	memset(channels, 0, sizeof(channels));
+	impactOpen = false;
+}
+
+void ImpactDetector::process(const PiezoBlock &block) {
+	uint32_t peakSamples = (uint64_t) config.peakWindowUs * block.rate / 1000000;
+	uint32_t refractorySamples = (uint64_t) config.refractoryUs * block.rate / 1000000;
+	// sample after sample rather than row after row, so that onsets come in time order
+	for (uint16_t i = 0; i < PIEZO_BLOCK_SAMPLES; i++) {
+		for (uint8_t c = 0; c < block.channels; c++) {
+			if (block.active & (1 << c)) {
+				sample(channels[c], c, block.mv[c][i], block, i, peakSamples, refractorySamples);
+			}
+		}
+	}
+}
+
+void ImpactDetector::sample(Channel &ch, uint8_t c, int16_t mv, const PiezoBlock &block, uint16_t i,
+		uint32_t peakSamples, uint32_t refractorySamples) {
+	int32_t x = (int32_t) mv << 8;
+	if (!ch.started) {
+		ch.baseline = x;
+		ch.started = true;
+	}
+	// written to compile to conditional moves: the noise makes these comparisons unpredictable
+	int32_t d = x - ch.baseline;
+	int32_t level = d < 0 ? -d : d;
+	int32_t decayed = ch.envelope - ((ch.envelope - level) >> config.releaseShift);
+	ch.envelope = level > ch.envelope ? level : decayed;
+	int32_t threshold = ch.floor * config.triggerRatio;
+	if (threshold < (int32_t) config.minLevel << 8) {
+		threshold = (int32_t) config.minLevel << 8;
+	}
+	switch (ch.state) {
+		case QUIET:
+			if (ch.envelope < threshold) {
+				ch.baseline += (x - ch.baseline) >> config.baselineShift;
+				ch.floor += (ch.envelope - ch.floor) >> config.floorShift;
+				break;
+			}
+			{
+				// the crossing, linearly between the previous sample and this one
+				int32_t period = 1000000000 / block.rate;
+				int32_t before = 0;
+				if (level >= threshold && level > ch.level) {
+					before = (int64_t) (level - threshold) * period / (level - ch.level);
+					before = before > period ? period : before;
+				}
+				int64_t onsetNs = (int64_t) block.sampleNs(c, i) - before;
+				ch.onset = block.timestamp + (int32_t) ((onsetNs >= 0 ? onsetNs + 500 : onsetNs - 500) / 1000);
+			}
+			if (!impactOpen || (int32_t) (ch.onset - impactStart) > config.impactWindowUs) {
+				++impact;
+				impactStart = ch.onset;
+				impactOpen = true;
+			}
+			ch.impact = impact;
+			ch.delay = (int16_t) (ch.onset - impactStart);
+			ch.state = PEAK;
+			ch.samples = 0;
+			ch.peak = level;
+			ch.peakTime = block.timestamp + (block.sampleNs(c, i) + 500) / 1000;
+			break;
+
+		case PEAK:
+			if (level > ch.peak) {
+				ch.peak = level;
+				ch.peakTime = block.timestamp + (block.sampleNs(c, i) + 500) / 1000;
+			}
+			if (++ch.samples >= peakSamples) {
+				PiezoHit hit;
+				hit.impact = ch.impact;
+				hit.channel = c;
+				hit.time = ch.onset;
+				hit.delay = ch.delay;
+				hit.peak = ch.peak >> 8;
+				hit.rise = (int32_t) (ch.peakTime - ch.onset) > 0 ? ch.peakTime - ch.onset : 0;
+				queue.push(hit);
+				++reported;
+				ch.state = REFRACTORY;
+			}
+			break;
+
+		case REFRACTORY:
+			if (++ch.samples >= refractorySamples && ch.envelope < threshold / 2) {
+				ch.state = QUIET;
+			}
+			break;
+	}
+	ch.level = level;
+}
@@ -0,0 +1,110 @@
+/*
+  ImpactDetector.h - knocks on the plank, found in the piezo blocks: one PiezoHit per channel and impact.
+
+  Per channel and per sample, in 24.8 fixed point mV:
+    level     = |mv - baseline|, the baseline (hum, ADC offset) following the signal while the channel is quiet
+    envelope  = the level when above it, else decaying towards it by 1/2^releaseShift per sample
+    floor     = the envelope averaged over about 2^floorShift samples while quiet: the adaptive noise floor
+  A quiet channel triggers when its envelope reaches max(minLevel, triggerRatio x floor). The onset is
+  interpolated between the two samples around the crossing and moved by the channel's conversion lag
+  (PiezoBlock::lagNs), so onsets compare across channels to a few microseconds. The highest level
+  within peakWindowUs gives the hit's amplitude and rise time, then the hit is queued. The channel
+  re-arms once refractoryUs have passed since the onset and the envelope is back under half the threshold.
+
+  Samples are taken in time order across channels. An onset less than impactWindowUs after the first
+  one of an impact joins it: its hit carries the impact number and the delay after that first onset,
+  the arrival time differences a receiver localizes the strike from.
+*/
+#ifndef IMPACT_DETECTOR_h
+#define IMPACT_DETECTOR_h
+
+#include <Arduino.h>
+#include "PiezoBlock.h"
+#include "SpscRing.h"
+
+#ifndef IMPACT_HIT_RING
+#define IMPACT_HIT_RING 16		// hits waiting for the consumer (power of two)
+#endif
+
+struct PiezoHit {
+	uint16_t impact;	// hits of one impact share it
+	uint8_t channel;
+	uint32_t time;		// micros() of the onset
+	int16_t delay;		// us after the first onset of the impact
+	uint16_t peak;		// mV above the baseline
+	uint16_t rise;		// us from the onset to the peak
+};
+
+// impact (u16) | channel (u8) | time (u32, us) | delay (i16, us) | peak (u16, mV) | rise (u16, us), little endian
+#define HIT_PACKET_SIZE 13
+
+size_t packPiezoHit(uint8_t *out, const PiezoHit &hit);
+PiezoHit unpackPiezoHit(const uint8_t *in);
+
+struct ImpactConfig {
+	int16_t minLevel;		// mV, lowest trigger threshold
+	uint8_t triggerRatio;	// threshold in noise floors
+	uint8_t releaseShift;	// envelope decay, 2^shift samples
+	uint8_t floorShift;		// noise floor time constant, 2^shift samples
+	uint8_t baselineShift;	// baseline time constant, 2^shift samples
+	uint16_t peakWindowUs;
+	uint32_t refractoryUs;
+	uint16_t impactWindowUs;
+};
+
+// a knock rings for 10-20 ms and crosses the plank in well under 5 ms; the hum is about 10 mV
+#define IMPACT_DEFAULT_CONFIG {30, 6, 4, 10, 9, 5000, 50000, 5000}
+
+class ImpactDetector : public PiezoBlockProcessor
+{
+	public:
+		ImpactDetector();
+
+		void setConfig(const ImpactConfig &c) { config = c; }
+		const ImpactConfig &getConfig() const { return config; }
+		// forgets baselines and noise floors, relearned from the next block
+		void reset();
+
+		void process(const PiezoBlock &block);
+
+		// consumer side: next hit in order of completion
+		bool readHit(PiezoHit &hit) { return queue.pop(hit); }
+		uint32_t hits() const { return reported; }
+		uint16_t impacts() const { return impact; }
+		uint32_t droppedHits() const { return queue.dropped(); }
+		uint32_t hitQueueHighWater() const { return queue.highWater(); }
+
+		int baseline(uint8_t channel) const { return channels[channel].baseline >> 8; }
+		int noiseFloor(uint8_t channel) const { return channels[channel].floor >> 8; }
+
+	private:
+		enum { QUIET, PEAK, REFRACTORY };
+
+		struct Channel {
+			int32_t baseline;	// 24.8 fixed point, like the three below
+			int32_t envelope;
+			int32_t floor;
+			int32_t level;		// of the previous sample
+			uint8_t state;
+			bool started;
+			uint32_t samples;	// since the onset
+			uint32_t onset;		// us
+			int32_t peak;
+			uint32_t peakTime;	// us
+			uint16_t impact;
+			int16_t delay;
+		};
+
+		void sample(Channel &ch, uint8_t c, int16_t mv, const PiezoBlock &block, uint16_t i,
+				uint32_t peakSamples, uint32_t refractorySamples);
+
+		ImpactConfig config;
+		Channel channels[PIEZO_MAX_CHANNELS];
+		SpscRing<PiezoHit, IMPACT_HIT_RING> queue;
+		uint16_t impact;
+		uint32_t impactStart;	// us, first onset of the current impact
+		bool impactOpen;
+		uint32_t reported;
+};
+
+#endif /* IMPACT_DETECTOR_h */
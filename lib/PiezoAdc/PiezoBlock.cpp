@@ -0,0 +1,92 @@
+#include <Arduino.h>
+#include <PiezoBlock.h>
+
+void PiezoPeakHold::process(const PiezoBlock &block) {
+	Peaks peaks;
+	memset(&peaks, 0, sizeof(peaks));
+	for (uint8_t c = 0; c < block.channels; c++) {
+		if (!(block.active & (1 << c))) {
+			continue;
+		}
+		int16_t top = block.mv[c][0];
+		for (uint16_t i = 0; i < PIEZO_BLOCK_SAMPLES; i++) {
+			if (block.mv[c][i] > top) {
+				top = block.mv[c][i];
+			}
+		}
+		peaks.mv[c] = top;
+	}
+	queue.push(peaks);
+}
+
+bool PiezoPeakHold::take(int16_t *peaks) {
+	Peaks block;
+	if (!queue.pop(block)) {
+		return false;
+	}
+	memcpy(peaks, block.mv, sizeof(block.mv));
+	while (queue.pop(block)) {
+		for (uint8_t c = 0; c < PIEZO_MAX_CHANNELS; c++) {
+			peaks[c] = block.mv[c] > peaks[c] ? block.mv[c] : peaks[c];
+		}
+	}
+	return true;
+}
+
+PiezoBlockAssembler::PiezoBlockAssembler() {
+	begin(0, 0, 1, 0);
+}
+
+void PiezoBlockAssembler::begin(uint8_t channels, uint8_t active, uint32_t rate, uint32_t startMicros) {
+	memset(&current, 0, sizeof(current));
+	current.channels = channels > PIEZO_MAX_CHANNELS ? PIEZO_MAX_CHANNELS : channels;
+	current.active = active & ((1 << current.channels) - 1);
+	current.rate = rate;
+	current.sequence = 0;
+	samples = 0;
+	start = startMicros;
+	extra = 0;
+	startBlock();
+}
+
+void PiezoBlockAssembler::startBlock() {
+	pending = 0;
+	for (uint8_t c = 0; c < PIEZO_MAX_CHANNELS; c++) {
+		fill[c] = 0;
+		if (current.active & (1 << c)) {
+			++pending;
+		}
+	}
+	current.timestamp = start + (uint32_t) (samples * 1000000 / current.rate);
+	complete = false;
+}
+
+bool PiezoBlockAssembler::add(uint8_t channel, int16_t mv) {
+	if (complete) {
+		samples += PIEZO_BLOCK_SAMPLES;
+		++current.sequence;
+		startBlock();
+	}
+	if (channel >= current.channels || !(current.active & (1 << channel))) {
+		return false;
+	}
+	if (fill[channel] == PIEZO_BLOCK_SAMPLES) {
+		++extra;
+		return false;
+	}
+	current.mv[channel][fill[channel]++] = mv;
+	if (fill[channel] == PIEZO_BLOCK_SAMPLES && --pending == 0) {
+		complete = true;
+	}
+	return complete;
+}
+
+bool PiezoBlockAssembler::addFrame(const int16_t *mv) {
+	bool done = false;
+	for (uint8_t c = 0; c < current.channels; c++) {
+		if (current.active & (1 << c)) {
+			done = add(c, mv[c]) || done;
+		}
+	}
+	return done;
+}
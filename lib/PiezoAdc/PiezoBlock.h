@@ -0,0 +1,100 @@
+/*
+  PiezoBlock.h - fixed-rate blocks of piezo samples and the processing stage they are handed to.
+
+  A block holds PIEZO_BLOCK_SAMPLES consecutive samples of every channel, in millivolts at the ADC
+  pin, one row per channel. Blocks are plain data: on the ESP32 PiezoSampler fills them from the ADC
+  DMA, on the host the simulation and the benchmarks fill them from synthesized or recorded waveforms
+  through the same PiezoBlockAssembler, so every PiezoBlockProcessor runs unchanged on both.
+*/
+#ifndef PIEZO_BLOCK_h
+#define PIEZO_BLOCK_h
+
+#include <Arduino.h>
+#include "SpscRing.h"
+
+#define PIEZO_MAX_CHANNELS 4
+
+#ifndef PIEZO_BLOCK_SAMPLES
+#define PIEZO_BLOCK_SAMPLES 128		// per channel: 16 ms at the default rate
+#endif
+
+struct PiezoBlock
+{
+	uint32_t sequence;		// blocks since the assembler started; a gap means blocks were dropped
+	uint32_t timestamp;		// micros() of the first sample of the block
+	uint32_t rate;			// samples per second of each channel
+	uint8_t channels;
+	uint8_t active;			// bit i set: channel i is sampled, the rows of the others stay at 0
+	// channels converted one after the other: how much later than 'timestamp' each row starts
+	uint32_t lagNs[PIEZO_MAX_CHANNELS];
+	int16_t mv[PIEZO_MAX_CHANNELS][PIEZO_BLOCK_SAMPLES];
+
+	// time of sample i of channel c, in ns after 'timestamp'
+	uint32_t sampleNs(uint8_t c, uint16_t i) const { return (uint32_t) ((uint64_t) i * 1000000000 / rate) + lagNs[c]; }
+};
+
+// a stage of the signal chain, given every block in order
+class PiezoBlockProcessor
+{
+	public:
+		virtual ~PiezoBlockProcessor() {}
+		virtual void process(const PiezoBlock &block) = 0;
+};
+
+// largest sample of every channel since the last take(), for outputs slower than the sample rate.
+// The peaks of every block are queued, so process() and take() may run in two different tasks; take()
+// has to come at least every 8 blocks (128 ms at the default rate) or the peaks of the blocks beyond are lost.
+class PiezoPeakHold : public PiezoBlockProcessor
+{
+	public:
+		void process(const PiezoBlock &block);
+
+		// copies the peaks (mV) and starts over; false if no block arrived since the previous call
+		bool take(int16_t *peaks);
+
+	private:
+		struct Peaks {
+			int16_t mv[PIEZO_MAX_CHANNELS];		// 0 for the channels that are not sampled
+		};
+		SpscRing<Peaks, 8> queue;
+};
+
+// cuts a stream of samples into blocks
+class PiezoBlockAssembler
+{
+	public:
+		PiezoBlockAssembler();
+
+		// active: bit mask of the channels that will be given samples; startMicros: time of the first one
+		void begin(uint8_t channels, uint8_t active, uint32_t rate, uint32_t startMicros);
+		// conversion time of a channel after the first one of each round, 0 by default
+		void setLag(uint8_t channel, uint32_t ns) { current.lagNs[channel] = ns; }
+
+		// one sample of one channel; returns true when it completes a block, block() then holds it
+		// until the next call. A sample for a channel whose row is already full is dropped and counted.
+		bool add(uint8_t channel, int16_t mv);
+		// one sample of every channel, e.g. from a recorded waveform; inactive channels are ignored
+		bool addFrame(const int16_t *mv);
+
+		const PiezoBlock &block() const { return current; }
+		uint32_t misaligned() const { return extra; }
+
+	private:
+		void startBlock();
+
+		PiezoBlock current;
+		uint16_t fill[PIEZO_MAX_CHANNELS];
+		uint8_t pending;		// active channels whose row is not full yet
+		bool complete;
+		uint64_t samples;		// per channel, before the block being filled
+		uint32_t start;
+		uint32_t extra;
+};
+
+// calibrated millivolts back to the 12-bit reading of an ideal ADC, 3.3 V full scale
+inline uint16_t piezoReading(int16_t mv) {
+	int32_t r = ((int32_t) mv * 4095 + 1650) / 3300;
+	return r < 0 ? 0 : (r > 4095 ? 4095 : r);
+}
+
+#endif /* PIEZO_BLOCK_h */
@@ -0,0 +1,237 @@
+/*
+  PiezoSampler.cpp - ADC DMA piezo acquisition, see PiezoSampler.h
+*/
+#include <Arduino.h>
+#include <PiezoSampler.h>
+
+#if defined(ARDUINO_ARCH_ESP32)
+#include <driver/adc.h>
+#include <esp_adc_cal.h>
+#endif
+
+int8_t piezoAdc1Channel(int pin) {
+	switch (pin) {
+		case 36: return 0;
+		case 37: return 1;
+		case 38: return 2;
+		case 39: return 3;
+		case 32: return 4;
+		case 33: return 5;
+		case 34: return 6;
+		case 35: return 7;
+	}
+	return -1;
+}
+
+PiezoSampler::PiezoSampler() : meter("piezo") {
+	active = 0;
+	consumer = NULL;
+	produced = 0;
+	lost = 0;
+	memset(channelOf, -1, sizeof(channelOf));
+#if defined(ARDUINO_ARCH_ESP32)
+	task = NULL;
+#endif
+}
+
+PiezoSampler::~PiezoSampler() {
+	end();
+}
+
+uint8_t PiezoSampler::mapPins(const int *pins, uint8_t count) {
+	uint8_t sampledChannels = 0;
+	memset(channelOf, -1, sizeof(channelOf));
+	for (uint8_t i = 0; i < count; i++) {
+		int8_t adc = piezoAdc1Channel(pins[i]);
+		if (adc >= 0) {
+			channelOf[adc] = i;
+			sampledChannels |= 1 << i;
+		}
+	}
+	return sampledChannels;
+}
+
+// the digital controller converts the pattern, in ADC1 channel order, at rate x patterns per second
+void PiezoSampler::setLags(uint32_t rate) {
+	uint8_t patterns = 0;
+	for (uint8_t adc = 0; adc < PIEZO_ADC1_CHANNELS; adc++) {
+		if (channelOf[adc] >= 0) {
+			++patterns;
+		}
+	}
+	uint8_t position = 0;
+	for (uint8_t adc = 0; adc < PIEZO_ADC1_CHANNELS; adc++) {
+		if (channelOf[adc] >= 0) {
+			assembler.setLag(channelOf[adc], (uint32_t) ((uint64_t) position++ * 1000000000 / ((uint64_t) rate * patterns)));
+		}
+	}
+}
+
+void PiezoSampler::onConversions(const uint16_t *words, size_t count) {
+	for (size_t i = 0; i < count; i++) {
+		int8_t channel = channelOf[words[i] >> 12];
+		if (channel < 0) {
+			continue;
+		}
+		if (assembler.add(channel, millivolts[words[i] & 0x0FFF])) {
+			if (ring.push(assembler.block())) {
+				produced = produced + 1;
+#if defined(ARDUINO_ARCH_ESP32)
+				if (NULL != consumer) {
+					xTaskNotifyGive((TaskHandle_t) consumer);
+				}
+#endif
+			}
+		}
+	}
+}
+
+bool PiezoSampler::readBlock(PiezoBlock &block) {
+	return ring.pop(block);
+}
+
+size_t PiezoSampler::drain(PiezoBlockProcessor *const *processors, uint8_t count) {
+	size_t n = 0;
+	while (ring.pop(drained)) {
+		for (uint8_t i = 0; i < count; i++) {
+			processors[i]->process(drained);
+		}
+		++n;
+	}
+	return n;
+}
+
+#if defined(ARDUINO_ARCH_ESP32)
+
+void PiezoSampler::calibrate() {
+	// the same characterization analogReadMilliVolts() uses: eFuse two-point or Vref, else 1100 mV
+	esp_adc_cal_characteristics_t chars;
+	esp_adc_cal_characterize(ADC_UNIT_1, ADC_ATTEN_DB_11, ADC_WIDTH_BIT_12, 1100, &chars);
+	for (uint32_t r = 0; r < 4096; r++) {
+		millivolts[r] = esp_adc_cal_raw_to_voltage(r, &chars);
+	}
+}
+
+void PiezoSampler::samplingTask(void *arg) {
+	PiezoSampler *self = (PiezoSampler *) arg;
+	uint16_t words[PIEZO_DMA_FRAME_BYTES / 2];
+
+	for (;;) {
+		uint32_t length = 0;
+		esp_err_t err = adc_digi_read_bytes((uint8_t *) words, sizeof(words), &length, ADC_MAX_DELAY);
+		if (err == ESP_ERR_INVALID_STATE) {
+			// the driver's pool overflowed and conversions were lost; what it returned is still valid
+			self->lost = self->lost + 1;
+		} else if (err != ESP_OK) {
+			continue;
+		}
+		self->meter.begin();
+		self->onConversions(words, length / 2);
+		self->meter.end();
+	}
+}
+
+bool PiezoSampler::begin(const int *pins, uint8_t count, uint32_t rate, uint8_t priority, int8_t core) {
+	if (running() || count == 0 || count > PIEZO_MAX_CHANNELS || rate == 0) {
+		return false;
+	}
+	uint8_t sampledChannels = mapPins(pins, count);
+	if (sampledChannels == 0) {
+		return false;
+	}
+	adc_digi_pattern_config_t pattern[PIEZO_MAX_CHANNELS];
+	uint8_t patterns = 0;
+	uint16_t mask = 0;
+	for (uint8_t adc = 0; adc < PIEZO_ADC1_CHANNELS; adc++) {
+		if (channelOf[adc] < 0) {
+			continue;
+		}
+		mask |= 1 << adc;
+		pattern[patterns].atten = ADC_ATTEN_DB_11;
+		pattern[patterns].channel = adc;
+		pattern[patterns].unit = 0;		// ADC1
+		pattern[patterns].bit_width = SOC_ADC_DIGI_MAX_BITWIDTH;
+		++patterns;
+	}
+	calibrate();
+
+	adc_digi_init_config_t init = {};
+	init.max_store_buf_size = PIEZO_DMA_FRAME_BYTES * 4;
+	init.conv_num_each_intr = PIEZO_DMA_FRAME_BYTES;
+	init.adc1_chan_mask = mask;
+	init.adc2_chan_mask = 0;
+	if (adc_digi_initialize(&init) != ESP_OK) {
+		return false;
+	}
+	adc_digi_configuration_t config = {};
+	config.conv_limit_en = 1;	// required on the ESP32
+	config.conv_limit_num = 250;
+	config.pattern_num = patterns;
+	config.adc_pattern = pattern;
+	config.sample_freq_hz = rate * patterns;	// the digital controller takes 20 kHz to 2 MHz in all
+	config.conv_mode = ADC_CONV_SINGLE_UNIT_1;
+	config.format = ADC_DIGI_OUTPUT_FORMAT_TYPE1;
+	if (adc_digi_controller_configure(&config) != ESP_OK) {
+		adc_digi_deinitialize();
+		return false;
+	}
+
+	active = sampledChannels;
+	assembler.begin(count, active, rate, micros());
+	setLags(rate);
+	TaskHandle_t handle;
+	if (xTaskCreatePinnedToCore(samplingTask, "piezo", 3072, this, priority, &handle,
+			core < 0 ? tskNO_AFFINITY : core) != pdPASS) {
+		adc_digi_deinitialize();
+		active = 0;
+		return false;
+	}
+	task = handle;
+	meter.place(handle, core, priority);
+	adc_digi_start();
+	return true;
+}
+
+void PiezoSampler::end() {
+	if (!running()) {
+		return;
+	}
+	adc_digi_stop();
+	if (NULL != task) {
+		vTaskDelete((TaskHandle_t) task);
+		task = NULL;
+	}
+	adc_digi_deinitialize();
+	active = 0;
+}
+
+#else
+
+// ideal ADC: 12 bits over 0-3.3 V
+void PiezoSampler::calibrate() {
+	for (uint32_t r = 0; r < 4096; r++) {
+		millivolts[r] = (r * 3300 + 2047) / 4095;
+	}
+}
+
+// no driver: the ESP32 pin numbering is kept so that the simulated board delivers the same words
+bool PiezoSampler::begin(const int *pins, uint8_t count, uint32_t rate, uint8_t, int8_t) {
+	if (running() || count == 0 || count > PIEZO_MAX_CHANNELS || rate == 0) {
+		return false;
+	}
+	uint8_t sampledChannels = mapPins(pins, count);
+	if (sampledChannels == 0) {
+		return false;
+	}
+	calibrate();
+	active = sampledChannels;
+	assembler.begin(count, active, rate, micros());
+	setLags(rate);
+	return true;
+}
+
+void PiezoSampler::end() {
+	active = 0;
+}
+
+#endif
@@ -0,0 +1,95 @@
+/*
+  PiezoSampler.h - continuous piezo acquisition through the ESP32 ADC DMA (digital controller of the
+  ADC, fed through I2S0).
+
+  The ADC converts the channels round-robin at rate x channels conversions per second without the CPU;
+  a task pinned to a core wakes up for every DMA frame, converts the readings to millivolts through
+  a table built from the eFuse calibration, and cuts them into PiezoBlocks queued for the consumer.
+  Only ADC1 pins (GPIO32-39) can be sampled this way: ADC2 has no DMA path on the ESP32. Other pins
+  are left out of the blocks (PiezoBlock::active) and stay readable with analogRead().
+
+  While the sampler runs ADC1 belongs to it: do not analogRead() the sampled pins.
+  On the host no driver is started; a simulated board delivers the conversions to onConversions().
+*/
+#ifndef PIEZO_SAMPLER_h
+#define PIEZO_SAMPLER_h
+
+#include <Arduino.h>
+#include "PiezoBlock.h"
+#include "SpscRing.h"
+#include "TaskMeter.h"
+
+#ifndef PIEZO_DEFAULT_RATE
+#define PIEZO_DEFAULT_RATE 8000		// samples per second and per channel
+#endif
+
+#ifndef PIEZO_RING_BLOCKS
+#define PIEZO_RING_BLOCKS 8			// blocks buffered between the task and the consumer (power of two)
+#endif
+
+#define PIEZO_DMA_FRAME_BYTES 512		// conversions handed over per DMA interrupt, 2 bytes each
+#define PIEZO_ADC1_CHANNELS 8
+
+// ADC1 channel of a GPIO, -1 if the pin is not on ADC1
+int8_t piezoAdc1Channel(int pin);
+
+class PiezoSampler
+{
+	public:
+		PiezoSampler();
+		~PiezoSampler();
+
+		// pins: the piezo GPIOs, in block channel order; rate: per channel. Starts the ADC and the task
+		// (ESP32); false if no pin is on ADC1 or the driver refused the configuration.
+		bool begin(const int *pins, uint8_t count, uint32_t rate = PIEZO_DEFAULT_RATE,
+				uint8_t priority = 5, int8_t core = -1);
+		void end();
+		bool running() const { return active != 0; }
+		// true if channel i is in the blocks, false if it has to be read with analogRead()
+		bool sampled(uint8_t i) const { return active & (1 << i); }
+
+		// consumer side: next block in order, false when none is waiting
+		bool readBlock(PiezoBlock &block);
+		// ESP32: the consumer task (TaskHandle_t) gets a task notification for every queued block,
+		// to wait on with ulTaskNotifyTake(); NULL to stop
+		void notifyOnBlock(void *consumerTask) { consumer = consumerTask; }
+		// hands every waiting block to each processor in turn; returns how many blocks
+		size_t drain(PiezoBlockProcessor *const *processors, uint8_t count);
+		size_t drain(PiezoBlockProcessor &processor) { PiezoBlockProcessor *p = &processor; return drain(&p, 1); }
+
+		uint32_t blocks() const { return produced; }
+		uint32_t droppedBlocks() const { return ring.dropped(); }
+		uint32_t queueHighWater() const { return ring.highWater(); }
+		// cost of the sampling task; a simulated board delivering frames may bracket them with it
+		TaskMeter &taskMeter() { return meter; }
+		// DMA frames the driver reported after losing conversions, and samples dropped out of channel order
+		uint32_t overruns() const { return lost; }
+		uint32_t misaligned() const { return assembler.misaligned(); }
+
+		// one DMA frame: ESP32 TYPE1 output words, ADC1 channel in bits 12-15 and the 12-bit reading
+		// below. Producer side; public so that a simulated board can deliver the frames.
+		void onConversions(const uint16_t *words, size_t count);
+
+	private:
+		// fills channelOf; returns the block channels that are on ADC1
+		uint8_t mapPins(const int *pins, uint8_t count);
+		void setLags(uint32_t rate);
+		void calibrate();
+
+		PiezoBlockAssembler assembler;
+		SpscRing<PiezoBlock, PIEZO_RING_BLOCKS> ring;
+		int8_t channelOf[16];		// channel field of a conversion -> block channel, -1: not sampled
+		uint16_t millivolts[4096];	// 12-bit reading -> mV at the pin
+		PiezoBlock drained;			// consumer copy for drain()
+		TaskMeter meter;
+		void *volatile consumer;
+		uint8_t active;
+		volatile uint32_t produced;
+		volatile uint32_t lost;
+#if defined(ARDUINO_ARCH_ESP32)
+		volatile void *task;
+		static void samplingTask(void *arg);
+#endif
+};
+
+#endif /* PIEZO_SAMPLER_h */
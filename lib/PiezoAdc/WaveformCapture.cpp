@@ -0,0 +1,151 @@
+#include <Arduino.h>
+#include <WaveformCapture.h>
+#include <PlankBytes.h>
+
+WaveformCapture::WaveformCapture() {
+	pre = CAPTURE_PRE_MAX;
+	post = CAPTURE_POST_MAX;
+	written = 0;
+	lastIndex = 0;
+	lastTime = 0;
+	rate = 0;
+	channels = 0;
+	active = 0;
+	state = IDLE;
+	requested = 0;
+	first = end = copied = 0;
+	startTime = 0;
+	capturedPre = 0;
+	sent = 0;
+	chunk = 0;
+	id = 0;
+	completed = 0;
+	refused = 0;
+}
+
+void WaveformCapture::setWindow(uint16_t preSamples, uint16_t postSamples) {
+	pre = preSamples > CAPTURE_PRE_MAX ? CAPTURE_PRE_MAX : preSamples;
+	post = postSamples > CAPTURE_POST_MAX ? CAPTURE_POST_MAX : (postSamples == 0 ? 1 : postSamples);
+}
+
+void WaveformCapture::process(const PiezoBlock &block) {
+	__atomic_store_n(&rate, block.rate, __ATOMIC_RELAXED);
+	channels = block.channels;
+	active = block.active;
+	lastIndex = written;
+	lastTime = block.timestamp;
+
+	uint32_t at = written & (CAPTURE_HISTORY - 1);
+	uint32_t first = CAPTURE_HISTORY - at < PIEZO_BLOCK_SAMPLES ? CAPTURE_HISTORY - at : PIEZO_BLOCK_SAMPLES;
+	for (uint8_t c = 0; c < channels; c++) {
+		if (!(active & (1 << c))) {
+			continue;
+		}
+		memcpy(&history[c][at], block.mv[c], first * sizeof(int16_t));
+		memcpy(&history[c][0], &block.mv[c][first], (PIEZO_BLOCK_SAMPLES - first) * sizeof(int16_t));
+	}
+	written += PIEZO_BLOCK_SAMPLES;
+
+	uint8_t now = __atomic_load_n(&state, __ATOMIC_ACQUIRE);
+	if (now == REQUESTED) {
+		start();
+	}
+	if (now == REQUESTED || now == FILLING) {
+		fill();
+	}
+}
+
+bool WaveformCapture::trigger(uint32_t timeUs) {
+	if (__atomic_load_n(&state, __ATOMIC_ACQUIRE) != IDLE || __atomic_load_n(&rate, __ATOMIC_RELAXED) == 0) {
+		++refused;
+		return false;
+	}
+	requested = timeUs;
+	__atomic_store_n(&state, (uint8_t) REQUESTED, __ATOMIC_RELEASE);
+	return true;
+}
+
+// places the requested window in the history
+void WaveformCapture::start() {
+	int64_t index = (int64_t) lastIndex + (int64_t) (int32_t) (requested - lastTime) * rate / 1000000;
+	int64_t oldest = written > CAPTURE_HISTORY ? written - CAPTURE_HISTORY : 0;
+	if (index < oldest) {
+		index = oldest;
+	}
+	int64_t from = index - pre < oldest ? oldest : index - pre;
+	first = from;
+	end = index + post;
+	copied = first;
+	capturedPre = index - from;
+	startTime = lastTime + (int32_t) (((int64_t) first - lastIndex) * 1000000 / rate);
+	state = FILLING;
+}
+
+// copies what the history holds of the window, moving on to sending once it is complete
+void WaveformCapture::fill() {
+	uint32_t upto = written < end ? written : end;
+	for (uint8_t c = 0; c < channels; c++) {
+		if (!(active & (1 << c))) {
+			continue;
+		}
+		for (uint32_t i = copied; i < upto; i++) {
+			snapshot[c][i - first] = history[c][i & (CAPTURE_HISTORY - 1)];
+		}
+	}
+	copied = upto > copied ? upto : copied;
+	if (copied == end) {
+		sent = 0;
+		chunk = 0;
+		__atomic_store_n(&state, (uint8_t) SENDING, __ATOMIC_RELEASE);
+	}
+}
+
+size_t WaveformCapture::nextChunk(uint8_t *out, size_t capacity) {
+	if (__atomic_load_n(&state, __ATOMIC_ACQUIRE) != SENDING || capacity < CAPTURE_CHUNK_HEADER_SIZE + CAPTURE_DESCRIPTOR_SIZE) {
+		return 0;
+	}
+	uint16_t count = end - first;
+	uint8_t rows[PIEZO_MAX_CHANNELS];
+	uint8_t rowCount = 0;
+	for (uint8_t c = 0; c < channels; c++) {
+		if (active & (1 << c)) {
+			rows[rowCount++] = c;
+		}
+	}
+	uint32_t total = (uint32_t) rowCount * count * 2;
+
+	out[0] = id;
+	put16(&out[1], chunk);
+	uint8_t *data = &out[CAPTURE_CHUNK_HEADER_SIZE];
+	size_t size;
+	if (chunk == 0) {
+		put32(&data[0], startTime);
+		put32(&data[4], rate);
+		data[8] = channels;
+		data[9] = active;
+		put16(&data[10], capturedPre);
+		put16(&data[12], count);
+		size = CAPTURE_DESCRIPTOR_SIZE;
+	} else {
+		// whole samples only, so that no sample straddles two chunks
+		size = (capacity - CAPTURE_CHUNK_HEADER_SIZE) & ~1u;
+		size = total - sent < size ? total - sent : size;
+		uint8_t row = (sent / 2) / count;
+		uint16_t i = (sent / 2) % count;
+		for (size_t k = 0; k < size; k += 2) {
+			put16(&data[k], (uint16_t) snapshot[rows[row]][i]);
+			if (++i == count) {
+				i = 0;
+				++row;
+			}
+		}
+		sent += size;
+	}
+	++chunk;
+	if (sent == total && chunk > 1) {
+		++completed;
+		++id;
+		__atomic_store_n(&state, (uint8_t) IDLE, __ATOMIC_RELEASE);
+	}
+	return CAPTURE_CHUNK_HEADER_SIZE + size;
+}
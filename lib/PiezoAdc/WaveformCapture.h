@@ -0,0 +1,100 @@
+/*
+  WaveformCapture.h - the piezo waveforms around a trigger, captured and sent in chunks.
+
+  Every block goes into a circular history of CAPTURE_HISTORY samples per channel. trigger() freezes
+  a snapshot of the window from 'pre' samples before the trigger to 'post' samples after it: with the
+  next block, the part already in the history is copied at once and the rest as the blocks arrive,
+  into a second buffer, so acquisition never stops. The snapshot then goes out through nextChunk() at
+  whatever pace the caller sends it; triggers meanwhile are counted as missed. Every buffer is a
+  member, sized at build time.
+
+  process() runs in the task that owns the blocks; trigger() and nextChunk() may run in another one:
+  the state hands the snapshot over from one side to the other, no locks.
+
+  Chunks:  capture (u8) | chunk index (u16) | data, little endian
+    chunk 0 data: time of the first sample (u32, us) | rate (u32, per channel) | channels (u8) |
+                  active mask (u8) | pre (u16) | samples per channel (u16)
+    next chunks:  the samples of every active channel in mV (int16), channel after channel, as
+                  many whole samples as the chunk holds. The capture ends with its last sample.
+*/
+#ifndef WAVEFORM_CAPTURE_h
+#define WAVEFORM_CAPTURE_h
+
+#include <Arduino.h>
+#include "PiezoBlock.h"
+
+#ifndef CAPTURE_PRE_MAX
+#define CAPTURE_PRE_MAX 256		// samples per channel: 32 ms at the default rate
+#endif
+
+#ifndef CAPTURE_POST_MAX
+#define CAPTURE_POST_MAX 768	// 96 ms, a knock rings for about 25 ms
+#endif
+
+#ifndef CAPTURE_HISTORY
+#define CAPTURE_HISTORY 1024	// power of two; covers 'pre' plus how late the trigger comes
+#endif
+
+#define CAPTURE_CHUNK_HEADER_SIZE 3
+#define CAPTURE_DESCRIPTOR_SIZE 14
+
+class WaveformCapture : public PiezoBlockProcessor
+{
+	static_assert((CAPTURE_HISTORY & (CAPTURE_HISTORY - 1)) == 0, "CAPTURE_HISTORY must be a power of two");
+	static_assert(CAPTURE_HISTORY >= CAPTURE_PRE_MAX + PIEZO_BLOCK_SAMPLES, "CAPTURE_HISTORY too short for CAPTURE_PRE_MAX");
+
+	public:
+		WaveformCapture();
+
+		// samples kept before and after the trigger (at least 1), clamped to the build-time maximums
+		void setWindow(uint16_t pre, uint16_t post);
+		uint16_t getPre() const { return pre; }
+		uint16_t getPost() const { return post; }
+
+		void process(const PiezoBlock &block);
+
+		// asks for a capture around a micros() time, which may lie in the past, started by the next
+		// process(); false while a capture is being taken or sent
+		bool trigger(uint32_t timeUs);
+		bool busy() const { return __atomic_load_n(&state, __ATOMIC_ACQUIRE) != IDLE; }
+
+		// next chunk of the capture ready to go, at most 'capacity' bytes; 0 when there is none
+		size_t nextChunk(uint8_t *out, size_t capacity);
+
+		uint16_t captures() const { return completed; }
+		uint16_t missed() const { return refused; }
+
+	private:
+		enum { IDLE, REQUESTED, FILLING, SENDING };
+
+		void start();
+		void fill();
+
+		int16_t history[PIEZO_MAX_CHANNELS][CAPTURE_HISTORY];
+		int16_t snapshot[PIEZO_MAX_CHANNELS][CAPTURE_PRE_MAX + CAPTURE_POST_MAX];
+		uint16_t pre;
+		uint16_t post;
+
+		// history: samples per channel since the first block, and the last block's place in it
+		uint32_t written;
+		uint32_t lastIndex;
+		uint32_t lastTime;
+		uint32_t rate;
+		uint8_t channels;
+		uint8_t active;
+
+		uint8_t state;		// IDLE and SENDING belong to the trigger()/nextChunk() side, the others to process()
+		uint32_t requested;	// us, time of the trigger
+		uint32_t first;		// history index of the first sample of the snapshot
+		uint32_t end;
+		uint32_t copied;	// history index up to which the snapshot is filled
+		uint32_t startTime;
+		uint16_t capturedPre;	// pre of this capture, shorter when the history did not reach back far enough
+		uint32_t sent;		// data bytes
+		uint16_t chunk;
+		uint8_t id;
+		uint16_t completed;
+		uint16_t refused;
+};
+
+#endif /* WAVEFORM_CAPTURE_h */
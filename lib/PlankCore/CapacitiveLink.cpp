@@ -0,0 +1,41 @@
+#include <Arduino.h>
+#include <CapacitiveLink.h>
+
+void printCapacitiveFrame(Print &out, const int *values, int count) {
+  out.print("<");
+  for (int i = 0; i < count; ++i) {
+    out.print(values[i]);
+    if (i < count - 1) {
+      out.print(",");
+    }
+  }
+  out.println(">");
+}
+
+bool CapacitiveFrameParser::feed(char c) {
+  bool complete = false;
+  if (c == '<') {
+    buffer = "";  // resynchronise: drops the line ending left over from the previous frame
+  }
+  buffer += c;
+
+  if (c == '>') {
+    if (buffer.startsWith("<")) {
+      String frame = buffer.substring(1, buffer.length() - 1);
+
+      int index = 0;
+      char* token = strtok(&frame[0], ",");
+      while (token != NULL && index < PLANK_CAPACITIVE_COUNT) {
+        data[index++] = atoi(token);
+        token = strtok(NULL, ",");
+      }
+      complete = (index == PLANK_CAPACITIVE_COUNT);
+    }
+    buffer = "";
+  }
+
+  if (buffer.length() > CAPACITIVE_FRAME_MAX_LENGTH) {
+    buffer = "";
+  }
+  return complete;
+}
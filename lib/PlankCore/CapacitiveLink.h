@@ -0,0 +1,29 @@
+/*
+  CapacitiveLink.h - the original ASCII capacitive frames, "<v0,v1,...,v15>" followed by a newline.
+  The firmwares now use the binary frames of PlankFrame.h; this is kept as the baseline for the benchmarks.
+*/
+#ifndef CAPACITIVE_LINK_h
+#define CAPACITIVE_LINK_h
+
+#include <Arduino.h>
+#include "SensorPackets.h"
+#define CAPACITIVE_FRAME_MAX_LENGTH 100	// longer input is discarded
+
+// writes one frame of 'count' values
+void printCapacitiveFrame(Print &out, const int *values, int count);
+
+class CapacitiveFrameParser
+{
+	private:
+		String buffer;
+		int data[PLANK_CAPACITIVE_COUNT];
+
+	public:
+		// feeds one received character; returns true when it completed a frame of
+		// PLANK_CAPACITIVE_COUNT values, which values() then holds
+		bool feed(char c);
+
+		const int *values() const { return data; }
+};
+
+#endif /* CAPACITIVE_LINK_h */
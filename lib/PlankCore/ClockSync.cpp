@@ -0,0 +1,99 @@
+#include <Arduino.h>
+#include <ClockSync.h>
+
+ClockSync::ClockSync() {
+	reset();
+}
+
+void ClockSync::reset() {
+	points = 0;
+	newest = 0;
+	burst = 0;
+	best.local = best.offset = 0;
+	bestRoundTrip = 0xFFFFFFFF;
+	anchor = anchorOffset = 0;
+	drift = 0;
+	lastRoundTrip = 0;
+	error = 0;
+	taken = 0;
+	refused = 0;
+	restarted = 0;
+}
+
+void ClockSync::add(uint32_t t1, uint32_t t2, uint32_t t3, uint32_t t4) {
+	int32_t roundTrip = (int32_t) ((t4 - t1) - (t3 - t2));
+	if (roundTrip < 0) {
+		++refused;
+		return;
+	}
+	++taken;
+	if ((uint32_t) roundTrip < bestRoundTrip) {
+		bestRoundTrip = roundTrip;
+		best.local = t1 + roundTrip / 2;
+		best.offset = t2 - best.local;
+	}
+	if (++burst < CLOCK_SYNC_BURST) {
+		return;
+	}
+
+	if (points > 0) {
+		error = (int32_t) (best.offset - offsetAt(best.local));
+		if (error > CLOCK_SYNC_MAX_ERROR_US || error < -CLOCK_SYNC_MAX_ERROR_US) {
+			points = 0;
+			++restarted;
+		}
+	}
+	newest = points == 0 ? 0 : (newest + 1) % CLOCK_SYNC_POINTS;
+	history[newest] = best;
+	if (points < CLOCK_SYNC_POINTS) {
+		++points;
+	}
+	lastRoundTrip = bestRoundTrip;
+	burst = 0;
+	bestRoundTrip = 0xFFFFFFFF;
+	fit();
+}
+
+// least-squares line of the offsets against local time, around the newest point
+void ClockSync::fit() {
+	const Point &last = history[newest];
+	anchor = last.local;
+	anchorOffset = last.offset;
+	drift = 0;
+	if (points < 2) {
+		return;
+	}
+	double sx = 0, sy = 0;
+	for (uint8_t i = 0; i < points; i++) {
+		sx += (int32_t) (history[i].local - last.local);
+		sy += (int32_t) (history[i].offset - last.offset);
+	}
+	double mx = sx / points;
+	double my = sy / points;
+	double sxx = 0, sxy = 0;
+	for (uint8_t i = 0; i < points; i++) {
+		double dx = (int32_t) (history[i].local - last.local) - mx;
+		double dy = (int32_t) (history[i].offset - last.offset) - my;
+		sxx += dx * dx;
+		sxy += dx * dy;
+	}
+	if (sxx <= 0) {
+		return;
+	}
+	double slope = sxy / sxx;
+	anchorOffset = last.offset + (int32_t) lround(my - slope * mx);
+	drift = (int32_t) lround(slope * 1e9);
+}
+
+uint32_t ClockSync::offsetAt(uint32_t local) const {
+	return anchorOffset + (int32_t) ((int64_t) (int32_t) (local - anchor) * drift / 1000000000);
+}
+
+uint32_t ClockSync::toRemote(uint32_t local) const {
+	return local + offsetAt(local);
+}
+
+uint32_t ClockSync::toLocal(uint32_t remote) const {
+	// the offset barely moves over the difference between the two clocks
+	return remote - offsetAt(remote - anchorOffset);
+}
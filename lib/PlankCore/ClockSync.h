@@ -0,0 +1,74 @@
+/*
+  ClockSync.h - the clock of the other end of the link, estimated from timestamp exchanges.
+
+  An exchange is four micros() readings: the request leaves here (t1), arrives there (t2), the reply
+  leaves there (t3) and arrives here (t4). Its round trip is (t4 - t1) - (t3 - t2), and the remote
+  clock read t2 about half of it after t1. Any exchange delayed on the way (a busy transmitter, a
+  late poll) comes out with a longer round trip, so of every CLOCK_SYNC_BURST exchanges only the
+  one with the shortest round trip is kept. The last CLOCK_SYNC_POINTS of these give the offset and,
+  by a least-squares line through them, the drift between the two crystals (tens of ppm, a
+  millisecond every ten seconds or so), so that conversions stay accurate between points.
+
+  A point further than CLOCK_SYNC_MAX_ERROR_US from the estimate means the remote end restarted: the
+  estimate starts over from it. Arithmetic wraps with micros(): any time within half an hour of the
+  last point converts.
+*/
+#ifndef CLOCK_SYNC_h
+#define CLOCK_SYNC_h
+
+#include <Arduino.h>
+
+#define CLOCK_SYNC_BURST 4
+#define CLOCK_SYNC_POINTS 8
+#define CLOCK_SYNC_MAX_ERROR_US 10000
+
+class ClockSync
+{
+	public:
+		ClockSync();
+		void reset();
+
+		// one exchange, all in micros(): t1 request sent and t4 reply received here, t2 request
+		// received and t3 reply sent at the remote end
+		void add(uint32_t t1, uint32_t t2, uint32_t t3, uint32_t t4);
+
+		// true once a burst has given the first point
+		bool synced() const { return points > 0; }
+
+		uint32_t toLocal(uint32_t remote) const;
+		uint32_t toRemote(uint32_t local) const;
+
+		int32_t driftPpb() const { return drift; }	// how much faster the remote clock runs
+		uint32_t roundTrip() const { return lastRoundTrip; }	// us, of the last point
+		// us, the last point against the estimate of the points before it: the accuracy of conversions
+		int32_t lastError() const { return error; }
+		uint32_t exchanges() const { return taken; }
+		uint32_t rejected() const { return refused; }	// negative round trips
+		uint32_t restarts() const { return restarted; }
+
+	private:
+		struct Point {
+			uint32_t local;		// us, here
+			uint32_t offset;	// remote - local
+		};
+
+		void fit();
+		uint32_t offsetAt(uint32_t local) const;
+
+		Point history[CLOCK_SYNC_POINTS];
+		uint8_t points;		// in history, up to CLOCK_SYNC_POINTS
+		uint8_t newest;
+		uint8_t burst;		// exchanges of the burst so far
+		Point best;
+		uint32_t bestRoundTrip;
+		uint32_t anchor;	// local time of the fitted offset
+		uint32_t anchorOffset;
+		int32_t drift;		// ppb
+		uint32_t lastRoundTrip;
+		int32_t error;
+		uint32_t taken;
+		uint32_t refused;
+		uint32_t restarted;
+};
+
+#endif /* CLOCK_SYNC_h */
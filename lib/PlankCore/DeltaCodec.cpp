@@ -0,0 +1,72 @@
+#include <Arduino.h>
+#include <DeltaCodec.h>
+
+static inline uint8_t bitWidth(uint32_t v) {
+	uint8_t width = 0;
+	while (v) {
+		++width;
+		v >>= 1;
+	}
+	return width;
+}
+
+size_t deltaEncode(uint8_t *out, const int32_t *values, const int32_t *previous, uint8_t count) {
+	size_t size = 0;
+	for (uint8_t first = 0; first < count; first += DELTA_BLOCK) {
+		uint8_t n = count - first < DELTA_BLOCK ? count - first : DELTA_BLOCK;
+		uint32_t z[DELTA_BLOCK];
+		uint32_t all = 0;
+		for (uint8_t i = 0; i < n; i++) {
+			uint32_t d = (uint32_t) values[first + i] - (previous ? (uint32_t) previous[first + i] : 0);
+			z[i] = zigzag((int32_t) d);
+			all |= z[i];
+		}
+		uint8_t width = bitWidth(all);
+		out[size++] = width;
+
+		// bits are shifted out of a 64-bit accumulator a byte at a time
+		uint64_t acc = 0;
+		uint8_t bits = 0;
+		for (uint8_t i = 0; i < n && width > 0; i++) {
+			acc |= (uint64_t) z[i] << bits;
+			bits += width;
+			while (bits >= 8) {
+				out[size++] = acc & 0xFF;
+				acc >>= 8;
+				bits -= 8;
+			}
+		}
+		if (bits > 0) {
+			out[size++] = acc & 0xFF;
+		}
+	}
+	return size;
+}
+
+size_t deltaDecode(const uint8_t *in, size_t length, int32_t *values, const int32_t *previous, uint8_t count) {
+	size_t at = 0;
+	for (uint8_t first = 0; first < count; first += DELTA_BLOCK) {
+		uint8_t n = count - first < DELTA_BLOCK ? count - first : DELTA_BLOCK;
+		if (at >= length) {
+			return 0;
+		}
+		uint8_t width = in[at++];
+		if (width > 32 || at + (n * width + 7) / 8 > length) {
+			return 0;
+		}
+		uint64_t acc = 0;
+		uint8_t bits = 0;
+		uint32_t mask = width == 32 ? 0xFFFFFFFFu : ((1u << width) - 1);
+		for (uint8_t i = 0; i < n; i++) {
+			while (bits < width) {
+				acc |= (uint64_t) in[at++] << bits;
+				bits += 8;
+			}
+			uint32_t z = (uint32_t) acc & mask;
+			acc >>= width;
+			bits -= width;
+			values[first + i] = (int32_t) ((uint32_t) unzigzag(z) + (previous ? (uint32_t) previous[first + i] : 0));
+		}
+	}
+	return at;
+}
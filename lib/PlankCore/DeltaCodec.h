@@ -0,0 +1,36 @@
+/*
+  DeltaCodec.h - lossless packing of one sample of several channels against the previous sample.
+
+  Each channel's difference to the previous sample (to zero for a key sample) is zig-zag mapped so that
+  small negative and positive differences both become small unsigned numbers. Channels are then taken
+  in blocks of DELTA_BLOCK: one byte gives the bit width of the largest value of the block (0 to 32),
+  followed by every value of the block in that many bits, least significant bit first. A block of
+  unchanged channels costs its width byte only.
+
+  Arithmetic wraps modulo 2^32, so any int32 input round-trips exactly.
+*/
+#ifndef DELTA_CODEC_h
+#define DELTA_CODEC_h
+
+#include <Arduino.h>
+
+#define DELTA_BLOCK 8
+#define DELTA_MAX_CHANNELS 16
+// worst case: every channel needs 32 bits
+#define DELTA_MAX_SIZE(channels) ((((channels) + DELTA_BLOCK - 1) / DELTA_BLOCK) + (channels) * 4)
+
+inline uint32_t zigzag(int32_t v) {
+	return ((uint32_t) v << 1) ^ (uint32_t) (v >> 31);
+}
+
+inline int32_t unzigzag(uint32_t v) {
+	return (int32_t) (v >> 1) ^ -(int32_t) (v & 1);
+}
+
+// previous: NULL for a key sample; returns the encoded size
+size_t deltaEncode(uint8_t *out, const int32_t *values, const int32_t *previous, uint8_t count);
+
+// returns the number of bytes taken from 'in', or 0 if 'length' is too short
+size_t deltaDecode(const uint8_t *in, size_t length, int32_t *values, const int32_t *previous, uint8_t count);
+
+#endif /* DELTA_CODEC_h */
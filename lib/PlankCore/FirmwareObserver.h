@@ -0,0 +1,62 @@
+/*
+  FirmwareObserver.h - what a host harness (src/native) sees of the firmware's processing classes,
+  CapacitiveNode (lib/PlankMega) and SensorHub (lib/PlankEsp32): the stages of their passes, each
+  bracketed by stageBegin()/stageEnd(), and the data some stages take in. The firmware gives them no
+  observer; the stages then cost a pointer test.
+*/
+#ifndef FIRMWARE_OBSERVER_h
+#define FIRMWARE_OBSERVER_h
+
+#include <Arduino.h>
+#include "PlankLink.h"
+
+enum PlankStage {
+	PLANK_STAGE_TOUCH,			// Mega: TouchTracker::update() of a scan
+	PLANK_STAGE_SEND,			// Mega: a frame encoded and handed to the link
+	PLANK_STAGE_LINK,			// Mega: ACKs and time requests in, retransmissions out
+	PLANK_STAGE_CAPACITIVE,		// ESP32: the frames from the Mega applied
+	PLANK_STAGE_STRAIN,			// ESP32: the newest strain sample taken
+	PLANK_STAGE_PIEZO,			// ESP32: the piezo levels taken
+	PLANK_STAGE_BLE,			// ESP32: notifications and the stream
+	PLANK_STAGE_RECORD,			// ESP32: the session log, flash included
+	PLANK_STAGE_COUNT
+};
+
+class FirmwareObserver
+{
+	public:
+		virtual ~FirmwareObserver() {}
+
+		virtual void stageBegin(uint8_t) {}
+		virtual void stageEnd(uint8_t) {}
+
+		// Mega: a scan taken by the tracker, stamped with its micros()
+		virtual void scanned(uint32_t, const int *) {}
+		// ESP32: a touch or capacitive frame from the Mega, applied to the capacitive values
+		virtual void frameApplied(const LinkFrame &) {}
+};
+
+class StageScope
+{
+	public:
+		StageScope(FirmwareObserver *observer, uint8_t stage) : observer(observer), stage(stage) {
+			if (NULL != observer) {
+				observer->stageBegin(stage);
+			}
+		}
+		~StageScope() {
+			if (NULL != observer) {
+				observer->stageEnd(stage);
+			}
+		}
+
+	private:
+		FirmwareObserver *observer;
+		uint8_t stage;
+};
+
+#define STAGE_JOIN(a, b) a##b
+#define STAGE_NAME(line) STAGE_JOIN(stageScope, line)
+#define STAGE_SCOPE(observer, stage) StageScope STAGE_NAME(__LINE__)(observer, stage)
+
+#endif /* FIRMWARE_OBSERVER_h */
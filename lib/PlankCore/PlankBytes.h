@@ -0,0 +1,29 @@
+/*
+  PlankBytes.h - little-endian 16 and 32-bit fields, the byte order of everything the plank puts on a
+  wire or in flash: BLE packets and the stream, piezo hits and captures, session log blocks, notification
+  logs and sensor captures.
+*/
+#ifndef PLANK_BYTES_h
+#define PLANK_BYTES_h
+
+#include <Arduino.h>
+
+inline void put16(uint8_t *out, uint16_t v) {
+	out[0] = v & 0xFF;
+	out[1] = v >> 8;
+}
+
+inline void put32(uint8_t *out, uint32_t v) {
+	put16(out, v & 0xFFFF);
+	put16(out + 2, v >> 16);
+}
+
+inline uint16_t get16(const uint8_t *in) {
+	return in[0] | (in[1] << 8);
+}
+
+inline uint32_t get32(const uint8_t *in) {
+	return get16(in) | ((uint32_t) get16(in + 2) << 16);
+}
+
+#endif /* PLANK_BYTES_h */
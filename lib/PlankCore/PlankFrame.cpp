@@ -0,0 +1,156 @@
+#include <Arduino.h>
+#include <PlankFrame.h>
+
+// CRC-16/CCITT, four bits at a time
+static const uint16_t crcNibble[16] = {
+	0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7,
+	0x8108, 0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF
+};
+
+uint16_t plankCrc16(const uint8_t *data, size_t length, uint16_t crc) {
+	while (length--) {
+		uint8_t b = *data++;
+		crc = (crc << 4) ^ crcNibble[(crc >> 12) ^ (b >> 4)];
+		crc = (crc << 4) ^ crcNibble[(crc >> 12) ^ (b & 0x0F)];
+	}
+	return crc;
+}
+
+size_t encodeFrame(uint8_t *out, uint8_t type, uint8_t sequence, const uint8_t *payload, uint8_t length) {
+	if (length > PLANK_FRAME_MAX_PAYLOAD) {
+		return 0;
+	}
+	out[0] = PLANK_FRAME_SYNC1;
+	out[1] = PLANK_FRAME_SYNC2;
+	out[2] = length;
+	out[3] = sequence;
+	out[4] = type;
+	if (payload != &out[PLANK_FRAME_HEADER_SIZE]) {
+		memcpy(&out[PLANK_FRAME_HEADER_SIZE], payload, length);
+	}
+	uint16_t crc = plankCrc16(&out[2], length + 3);
+	out[PLANK_FRAME_HEADER_SIZE + length] = crc & 0xFF;
+	out[PLANK_FRAME_HEADER_SIZE + length + 1] = crc >> 8;
+	return PLANK_FRAME_HEADER_SIZE + length + PLANK_FRAME_CRC_SIZE;
+}
+
+size_t encodeCapacitiveFrame(uint8_t *out, uint8_t sequence, uint32_t time, const int *values) {
+	uint8_t *payload = &out[PLANK_FRAME_HEADER_SIZE];
+	putFrameUint32(payload, time);
+	uint8_t *data = &payload[PLANK_FRAME_TIME_SIZE];
+	for (int i = 0; i < PLANK_CAPACITIVE_COUNT; ++i) {
+		long v = values[i];
+		int16_t s = v > 32767 ? 32767 : (v < -32768 ? -32768 : (int16_t) v);
+		data[i * 2] = s & 0xFF;
+		data[i * 2 + 1] = (s >> 8) & 0xFF;
+	}
+	// the payload is already in place, encodeFrame only adds the header and CRC around it
+	return encodeFrame(out, PLANK_FRAME_CAPACITIVE, sequence, payload, CAPACITIVE_PAYLOAD_SIZE);
+}
+
+size_t encodeTouchFrame(uint8_t *out, uint8_t sequence, uint32_t time, const TouchEvent *events, uint8_t count) {
+	uint8_t *payload = &out[PLANK_FRAME_HEADER_SIZE];
+	putFrameUint32(payload, time);
+	for (uint8_t i = 0; i < count; ++i) {
+		uint8_t *e = &payload[PLANK_FRAME_TIME_SIZE + i * TOUCH_EVENT_SIZE];
+		e[0] = (events[i].kind << 4) | (events[i].pad & 0x0F);
+		e[1] = events[i].strength & 0xFF;
+		e[2] = (events[i].strength >> 8) & 0xFF;
+	}
+	return encodeFrame(out, PLANK_FRAME_TOUCH, sequence, payload, TOUCH_PAYLOAD_SIZE(count));
+}
+
+FrameDecoder::FrameDecoder() {
+	state = SYNC1;
+	frameLength = 0;
+	taken = 0;
+	pendingHead = pendingTail = 0;
+	good = badCrc = badLength = 0;
+}
+
+bool FrameDecoder::feed(uint8_t c) {
+	if (pendingHead == pendingTail) {
+		return step(c);
+	}
+	// bytes from an earlier rescan go first
+	if (pendingTail == sizeof(pending)) {
+		memmove(pending, &pending[pendingHead], pendingTail - pendingHead);
+		pendingTail -= pendingHead;
+		pendingHead = 0;
+	}
+	pending[pendingTail++] = c;
+	while (pendingHead != pendingTail) {
+		if (step(pending[pendingHead++])) {
+			return true;
+		}
+	}
+	pendingHead = pendingTail = 0;
+	return false;
+}
+
+bool FrameDecoder::step(uint8_t c) {
+	switch (state) {
+		case SYNC1:
+			if (c == PLANK_FRAME_SYNC1) {
+				state = SYNC2;
+			}
+			return false;
+
+		case SYNC2:
+			if (c == PLANK_FRAME_SYNC2) {
+				state = LENGTH;
+			} else if (c != PLANK_FRAME_SYNC1) {
+				state = SYNC1;
+			}
+			return false;
+
+		case LENGTH:
+			if (c > PLANK_FRAME_MAX_PAYLOAD) {
+				++badLength;
+				// the length byte itself may start the next frame
+				state = (c == PLANK_FRAME_SYNC1) ? SYNC2 : SYNC1;
+				return false;
+			}
+			frameLength = c;
+			taken = 0;
+			state = BODY;
+			return false;
+
+		case BODY:
+			raw[taken++] = c;
+			if (taken < frameLength + 4) {
+				return false;
+			}
+			state = SYNC1;
+			{
+				uint16_t crc = plankCrc16(&frameLength, 1);
+				crc = plankCrc16(raw, frameLength + 2, crc);
+				uint16_t received = raw[frameLength + 2] | (raw[frameLength + 3] << 8);
+				if (crc == received) {
+					++good;
+					return true;
+				}
+			}
+			++badCrc;
+			rescan();
+			return false;
+	}
+	return false;
+}
+
+// queue what followed the sync of the failed frame, from its first possible sync byte, for decoding again
+void FrameDecoder::rescan() {
+	uint8_t from = 0;
+	while (from < taken && raw[from] != PLANK_FRAME_SYNC1) {
+		++from;
+	}
+	uint8_t count = taken - from;
+	uint8_t queued = pendingTail - pendingHead;
+	if (count == 0 || count + queued >= sizeof(pending)) {
+		return;
+	}
+	memmove(&pending[count], &pending[pendingHead], queued);
+	memcpy(pending, &raw[from], count);
+	pendingHead = 0;
+	pendingTail = count + queued;
+}
@@ -0,0 +1,131 @@
+/*
+  PlankFrame.h - binary frames on the UART between the ATmega2560 and the ESP32.
+
+    0xA5 0x5A | length | sequence | type | payload (length bytes) | CRC-16 (little endian)
+
+  The CRC (CCITT, polynomial 0x1021, initial value 0xFFFF) covers length through payload.
+  Multi-byte payload fields are little endian. Capacitive and touch frames start with the time of
+  their scan, in the Mega's micros(); the ESP32 converts it to its own clock (ClockSync.h).
+*/
+#ifndef PLANK_FRAME_h
+#define PLANK_FRAME_h
+
+#include <Arduino.h>
+#include "SensorPackets.h"
+#include "TouchTracker.h"
+
+#define PLANK_FRAME_SYNC1 0xA5
+#define PLANK_FRAME_SYNC2 0x5A
+#define PLANK_FRAME_HEADER_SIZE 5	// sync, sync, length, sequence, type
+#define PLANK_FRAME_CRC_SIZE 2
+#define PLANK_FRAME_MAX_PAYLOAD 52	// a touch frame of every pad
+#define PLANK_FRAME_MAX_SIZE (PLANK_FRAME_HEADER_SIZE + PLANK_FRAME_MAX_PAYLOAD + PLANK_FRAME_CRC_SIZE)
+
+// frame types; 0x80 and up are link control frames (PlankLink.h)
+#define PLANK_FRAME_CAPACITIVE 0x01	// time (u32) | PLANK_CAPACITIVE_COUNT x int16
+#define PLANK_FRAME_TOUCH 0x02		// time (u32) | 1 to PLANK_CAPACITIVE_COUNT touch events, see encodeTouchFrame
+#define PLANK_FRAME_LOG 0x03		// a PlankLog record, on the USB serial port (PlankLog.h)
+#define PLANK_FRAME_RESTART 0x40	// flag on the data type of a fresh sender's frame 0, see PlankLink.h
+#define PLANK_FRAME_ACK 0x80		// sequence = cumulative ACK, payload = 1 byte selective ACK mask
+#define PLANK_FRAME_TIME_REQUEST 0x81	// clock synchronization, see PlankLink.h
+#define PLANK_FRAME_TIME_REPLY 0x82
+
+#define PLANK_FRAME_TIME_SIZE 4
+#define CAPACITIVE_PAYLOAD_SIZE (PLANK_FRAME_TIME_SIZE + PLANK_CAPACITIVE_COUNT * 2)
+#define CAPACITIVE_FRAME_SIZE (PLANK_FRAME_HEADER_SIZE + CAPACITIVE_PAYLOAD_SIZE + PLANK_FRAME_CRC_SIZE)
+#define TOUCH_EVENT_SIZE 3
+#define TOUCH_PAYLOAD_SIZE(events) (PLANK_FRAME_TIME_SIZE + (events) * TOUCH_EVENT_SIZE)
+#define TOUCH_FRAME_SIZE(events) (PLANK_FRAME_HEADER_SIZE + TOUCH_PAYLOAD_SIZE(events) + PLANK_FRAME_CRC_SIZE)
+
+uint16_t plankCrc16(const uint8_t *data, size_t length, uint16_t crc = 0xFFFF);
+
+// writes a complete frame to 'out' (at least PLANK_FRAME_HEADER_SIZE + length + PLANK_FRAME_CRC_SIZE bytes)
+// and returns its size, or 0 if the payload is too long
+size_t encodeFrame(uint8_t *out, uint8_t type, uint8_t sequence, const uint8_t *payload, uint8_t length);
+
+// capacitive values, saturated to int16; time: micros() of the scan
+size_t encodeCapacitiveFrame(uint8_t *out, uint8_t sequence, uint32_t time, const int *values);
+
+inline int16_t frameInt16(const uint8_t *payload, int index) {
+	return (int16_t) (payload[index * 2] | (payload[index * 2 + 1] << 8));
+}
+
+inline uint32_t frameUint32(const uint8_t *payload) {
+	return payload[0] | ((uint32_t) payload[1] << 8) | ((uint32_t) payload[2] << 16) | ((uint32_t) payload[3] << 24);
+}
+
+inline void putFrameUint32(uint8_t *out, uint32_t value) {
+	out[0] = value & 0xFF;
+	out[1] = (value >> 8) & 0xFF;
+	out[2] = (value >> 16) & 0xFF;
+	out[3] = value >> 24;
+}
+
+// time of a capacitive or touch frame, in the sender's micros()
+inline uint32_t frameTime(const uint8_t *payload) {
+	return frameUint32(payload);
+}
+
+inline bool frameHasTime(uint8_t type) {
+	return type == PLANK_FRAME_CAPACITIVE || type == PLANK_FRAME_TOUCH;
+}
+
+inline int16_t frameCapacitive(const uint8_t *payload, int index) {
+	return frameInt16(&payload[PLANK_FRAME_TIME_SIZE], index);
+}
+
+// events, 3 bytes each: kind << 4 | pad, then the strength as int16
+size_t encodeTouchFrame(uint8_t *out, uint8_t sequence, uint32_t time, const TouchEvent *events, uint8_t count);
+
+// events in a touch frame of that payload length, 0 if it is not one
+inline uint8_t frameTouchEvents(uint8_t length) {
+	return length > PLANK_FRAME_TIME_SIZE && (length - PLANK_FRAME_TIME_SIZE) % TOUCH_EVENT_SIZE == 0
+		? (length - PLANK_FRAME_TIME_SIZE) / TOUCH_EVENT_SIZE : 0;
+}
+
+inline TouchEvent frameTouchEvent(const uint8_t *payload, int index) {
+	const uint8_t *e = &payload[PLANK_FRAME_TIME_SIZE + index * TOUCH_EVENT_SIZE];
+	TouchEvent event = {(uint8_t) (e[0] & 0x0F), (uint8_t) (e[0] >> 4), (int16_t) (e[1] | (e[2] << 8))};
+	return event;
+}
+
+// Byte-at-a-time decoder. It keeps one frame in a fixed buffer and never allocates; payload() points
+// into that buffer and stays valid until the next call to feed(). After a CRC or length error it
+// rescans the bytes it already took for another sync pattern, so a frame that starts inside a
+// corrupted one is not lost.
+class FrameDecoder
+{
+	public:
+		FrameDecoder();
+
+		// returns true when this byte completed a valid frame
+		bool feed(uint8_t c);
+
+		uint8_t type() const { return raw[1]; }
+		uint8_t sequence() const { return raw[0]; }
+		uint8_t length() const { return frameLength; }
+		const uint8_t *payload() const { return &raw[2]; }
+
+		uint32_t frames() const { return good; }
+		uint32_t crcErrors() const { return badCrc; }
+		uint32_t lengthErrors() const { return badLength; }
+
+	private:
+		enum State { SYNC1, SYNC2, LENGTH, BODY };
+
+		bool step(uint8_t c);
+		void rescan();
+
+		State state;
+		uint8_t frameLength;
+		uint8_t taken;		// bytes of raw[] filled for the current frame
+		uint8_t raw[PLANK_FRAME_MAX_PAYLOAD + 4];	// sequence, type, payload, CRC
+		uint8_t pending[PLANK_FRAME_MAX_SIZE * 2];	// bytes queued for rescanning after an error
+		uint8_t pendingHead;
+		uint8_t pendingTail;
+		uint32_t good;
+		uint32_t badCrc;
+		uint32_t badLength;
+};
+
+#endif /* PLANK_FRAME_h */
@@ -0,0 +1,372 @@
+#include <Arduino.h>
+#include <PlankLink.h>
+
+LinkSender::LinkSender(Print &out) : out(out) {
+	base = next = 0;
+	fresh = true;
+	memset(slots, 0, sizeof(slots));
+	memset(&counters, 0, sizeof(counters));
+}
+
+void LinkSender::transmit(Slot &slot) {
+	out.write(slot.frame, slot.size);
+	slot.sentAt = millis();
+}
+
+// flags the encoded frame and computes its CRC again; retransmissions keep the flag
+void LinkSender::markRestart(Slot &slot) {
+	slot.frame[4] |= PLANK_FRAME_RESTART;
+	uint16_t crc = plankCrc16(&slot.frame[2], slot.size - 4);
+	slot.frame[slot.size - 2] = crc & 0xFF;
+	slot.frame[slot.size - 1] = crc >> 8;
+}
+
+bool LinkSender::send(size_t size) {
+	if (!canSend()) {
+		++counters.refused;
+		return false;
+	}
+	if (size == 0 || size > PLANK_FRAME_MAX_SIZE) {
+		return false;
+	}
+	Slot &slot = slots[next % PLANK_LINK_WINDOW];
+	slot.size = size;
+	slot.acked = false;
+	slot.fastDone = false;
+	slot.retries = 0;
+	if (fresh) {
+		markRestart(slot);
+		fresh = false;
+	}
+	transmit(slot);
+	++next;
+	++counters.sent;
+	return true;
+}
+
+bool LinkSender::send(uint8_t type, const uint8_t *payload, uint8_t length) {
+	if (!canSend()) {
+		++counters.refused;
+		return false;
+	}
+	return send(encodeFrame(frameBuffer(), type, next, payload, length));
+}
+
+void LinkSender::feed(uint8_t c) {
+	if (decoder.feed(c)) {
+		if (decoder.type() == PLANK_FRAME_ACK && decoder.length() == 1) {
+			onAck(decoder.sequence(), decoder.payload()[0]);
+		} else if (decoder.type() == PLANK_FRAME_TIME_REQUEST && decoder.length() == PLANK_LINK_TIME_SIZE) {
+			replyTime(micros(), decoder.payload());
+		}
+	}
+	counters.crcErrors = decoder.crcErrors();
+}
+
+// written straight out, ahead of any retransmission: the time it waits here goes into the round trip
+void LinkSender::replyTime(uint32_t requested, const uint8_t *request) {
+	uint8_t payload[PLANK_LINK_TIME_SIZE];
+	memcpy(payload, request, 4);
+	putFrameUint32(&payload[4], requested);
+	putFrameUint32(&payload[8], micros());
+	uint8_t frame[PLANK_FRAME_HEADER_SIZE + PLANK_LINK_TIME_SIZE + PLANK_FRAME_CRC_SIZE];
+	out.write(frame, encodeFrame(frame, PLANK_FRAME_TIME_REPLY, 0, payload, PLANK_LINK_TIME_SIZE));
+	++counters.timeReplies;
+}
+
+void LinkSender::onAck(uint8_t cumulative, uint8_t mask) {
+	uint8_t inFlight = next - base;
+	if ((uint8_t) (cumulative - base) > inFlight) {
+		++counters.badAcks;
+		return;
+	}
+	while (base != cumulative) {
+		if (!slots[base % PLANK_LINK_WINDOW].acked) {
+			++counters.acked;
+		}
+		++base;
+	}
+	inFlight = next - base;
+
+	// selectively acknowledged frames, and the holes below the highest of them
+	uint8_t holes = 0;
+	for (uint8_t i = 0; i < 8; ++i) {
+		if (!(mask & (1 << i)) || i + 1 >= inFlight) {
+			continue;
+		}
+		Slot &slot = slots[(uint8_t) (cumulative + 1 + i) % PLANK_LINK_WINDOW];
+		if (!slot.acked) {
+			slot.acked = true;
+			++counters.acked;
+		}
+		holes = i + 1;
+	}
+	for (uint8_t i = 0; i < holes; ++i) {
+		Slot &slot = slots[(uint8_t) (cumulative + i) % PLANK_LINK_WINDOW];
+		if (!slot.acked && !slot.fastDone) {
+			slot.fastDone = true;
+			transmit(slot);
+			++counters.fastRetransmits;
+		}
+	}
+}
+
+void LinkSender::poll() {
+	unsigned long now = millis();
+	for (uint8_t s = base; s != next; ++s) {
+		Slot &slot = slots[s % PLANK_LINK_WINDOW];
+		if (slot.acked) {
+			continue;
+		}
+		unsigned long rto = (unsigned long) PLANK_LINK_RTO_MS << slot.retries;
+		if (rto > PLANK_LINK_RTO_MAX_MS) {
+			rto = PLANK_LINK_RTO_MAX_MS;
+		}
+		if (now - slot.sentAt >= rto) {
+			transmit(slot);
+			if (slot.retries < 8) {
+				++slot.retries;
+			}
+			++counters.retransmits;
+			return;
+		}
+	}
+}
+
+LinkReceiver::LinkReceiver(Print &ackOut) : ackOut(ackOut) {
+	memset(slots, 0, sizeof(slots));
+	memset(&counters, 0, sizeof(counters));
+	current = &slots[0];
+	synced = false;
+	restarted = false;
+	expected = 0;
+	awaiting = false;
+	requestTime = 0;
+	lastRequest = 0;
+}
+
+void LinkReceiver::poll() {
+	unsigned long now = millis();
+	if (awaiting) {
+		if (now - lastRequest < PLANK_LINK_SYNC_TIMEOUT_MS) {
+			return;
+		}
+		awaiting = false;
+		++counters.timeTimeouts;
+	}
+	if (now - lastRequest < PLANK_LINK_SYNC_MS) {
+		return;
+	}
+	uint8_t payload[PLANK_LINK_TIME_SIZE] = {0};
+	uint8_t frame[PLANK_FRAME_HEADER_SIZE + PLANK_LINK_TIME_SIZE + PLANK_FRAME_CRC_SIZE];
+	requestTime = micros();
+	putFrameUint32(payload, requestTime);
+	ackOut.write(frame, encodeFrame(frame, PLANK_FRAME_TIME_REQUEST, 0, payload, PLANK_LINK_TIME_SIZE));
+	lastRequest = now;
+	awaiting = true;
+	++counters.timeRequests;
+}
+
+void LinkReceiver::onTimeReply(uint32_t arrival) {
+	const uint8_t *reply = decoder.payload();
+	// a late reply to an abandoned request would pair with the wrong t1
+	if (!awaiting || decoder.length() != PLANK_LINK_TIME_SIZE || frameUint32(reply) != requestTime) {
+		return;
+	}
+	awaiting = false;
+	sync.add(requestTime, frameUint32(&reply[4]), frameUint32(&reply[8]), arrival);
+}
+
+void LinkReceiver::feed(uint8_t c) {
+	bool complete = decoder.feed(c);
+	counters.crcErrors = decoder.crcErrors();
+	counters.lengthErrors = decoder.lengthErrors();
+	if (!complete) {
+		return;
+	}
+	uint32_t arrival = micros();
+	if (decoder.type() == PLANK_FRAME_TIME_REPLY) {
+		onTimeReply(arrival);
+		return;
+	}
+	if (decoder.type() >= PLANK_FRAME_ACK) {
+		return;
+	}
+
+	uint8_t s = decoder.sequence();
+	// frame 0 of a fresh sender, unless it is the one this session started from, sent again because
+	// our ACK was lost: the sender cannot be past its window before that ACK
+	bool restart = (decoder.type() & PLANK_FRAME_RESTART) && s == 0
+			&& !(restarted && (uint8_t) expected <= PLANK_LINK_WINDOW);
+	if (!synced || restart) {
+		resync(s);
+		restarted = restart || (decoder.type() & PLANK_FRAME_RESTART);
+	}
+	uint8_t ahead = s - expected;
+	if (ahead < PLANK_LINK_WINDOW) {
+		Slot &slot = slots[s % PLANK_LINK_WINDOW];
+		if (slot.held && slot.sequence == s) {
+			++counters.duplicates;
+		} else {
+			uint8_t previous = s - 1;
+			const Slot &before = slots[previous % PLANK_LINK_WINDOW];
+			if (ahead > 0 && !(before.held && before.sequence == previous)) {
+				++counters.outOfOrder;
+			}
+			store(s, arrival);
+		}
+	} else if (ahead >= 256 - PLANK_LINK_WINDOW) {
+		// delivered already, our ACK was lost
+		++counters.duplicates;
+	} else if (ahead < 2 * PLANK_LINK_WINDOW) {
+		// the sender got ahead of frames we have not handed to the application yet
+		++counters.overruns;
+	} else {
+		resync(s);
+		restarted = false;
+		store(s, arrival);
+	}
+	sendAck();
+}
+
+// starts over from 'sequence', dropping what the sender's previous life left in the window
+void LinkReceiver::resync(uint8_t sequence) {
+	if (synced) {
+		for (uint8_t i = 0; i < PLANK_LINK_WINDOW; ++i) {
+			if (slots[i].held) {
+				slots[i].held = false;
+				++counters.lost;
+			}
+		}
+		++counters.resyncs;
+	}
+	expected = sequence;
+	synced = true;
+}
+
+void LinkReceiver::store(uint8_t sequence, uint32_t arrival) {
+	Slot &slot = slots[sequence % PLANK_LINK_WINDOW];
+	slot.held = true;
+	slot.sequence = sequence;
+	slot.type = decoder.type() & ~PLANK_FRAME_RESTART;
+	slot.length = decoder.length();
+	slot.arrival = arrival;
+	memcpy(slot.payload, decoder.payload(), decoder.length());
+}
+
+uint32_t LinkReceiver::time() const {
+	if (sync.synced() && frameHasTime(current->type) && current->length >= PLANK_FRAME_TIME_SIZE) {
+		return sync.toLocal(frameTime(current->payload));
+	}
+	return current->arrival;
+}
+
+bool LinkReceiver::read() {
+	Slot &slot = slots[expected % PLANK_LINK_WINDOW];
+	if (!slot.held || slot.sequence != expected) {
+		return false;
+	}
+	slot.held = false;
+	current = &slot;
+	++expected;
+	if (expected > PLANK_LINK_WINDOW) {
+		restarted = false;
+	}
+	++counters.delivered;
+	return true;
+}
+
+bool LinkReceiver::read(LinkFrame &frame) {
+	if (!read()) {
+		return false;
+	}
+	frame.type = current->type;
+	frame.sequence = current->sequence;
+	frame.length = current->length;
+	frame.time = time();
+	memcpy(frame.payload, current->payload, current->length);
+	return true;
+}
+
+void LinkReceiver::sendAck() {
+	// everything before 'cumulative' was received, whether or not the application has read it yet
+	uint8_t cumulative = expected;
+	for (uint8_t i = 0; i < PLANK_LINK_WINDOW; ++i) {
+		const Slot &slot = slots[cumulative % PLANK_LINK_WINDOW];
+		if (!slot.held || slot.sequence != cumulative) {
+			break;
+		}
+		++cumulative;
+	}
+	uint8_t mask = 0;
+	for (uint8_t i = 0; i < 8 && (uint8_t) (cumulative + 1 + i - expected) < PLANK_LINK_WINDOW; ++i) {
+		uint8_t s = cumulative + 1 + i;
+		const Slot &slot = slots[s % PLANK_LINK_WINDOW];
+		if (slot.held && slot.sequence == s) {
+			mask |= 1 << i;
+		}
+	}
+	uint8_t frame[PLANK_FRAME_HEADER_SIZE + 1 + PLANK_FRAME_CRC_SIZE];
+	ackOut.write(frame, encodeFrame(frame, PLANK_FRAME_ACK, cumulative, &mask, 1));
+	++counters.acksSent;
+}
+
+void printLinkStats(Print &out, const LinkSenderStats &stats) {
+	out.print("link sent ");
+	out.print(stats.sent);
+	out.print(", acked ");
+	out.print(stats.acked);
+	out.print(", retransmits ");
+	out.print(stats.retransmits);
+	out.print(" + ");
+	out.print(stats.fastRetransmits);
+	out.print(" fast, refused ");
+	out.print(stats.refused);
+	out.print(", bad ACKs ");
+	out.print(stats.badAcks);
+	out.print(", time replies ");
+	out.print(stats.timeReplies);
+	out.print(", CRC errors ");
+	out.println(stats.crcErrors);
+}
+
+void printLinkStats(Print &out, const LinkReceiverStats &stats) {
+	out.print("link delivered ");
+	out.print(stats.delivered);
+	out.print(", out of order ");
+	out.print(stats.outOfOrder);
+	out.print(", duplicates ");
+	out.print(stats.duplicates);
+	out.print(", overruns ");
+	out.print(stats.overruns);
+	out.print(", resyncs ");
+	out.print(stats.resyncs);
+	out.print(", lost ");
+	out.print(stats.lost);
+	out.print(", CRC errors ");
+	out.print(stats.crcErrors);
+	out.print(", length errors ");
+	out.print(stats.lengthErrors);
+	out.print(", time requests ");
+	out.print(stats.timeRequests);
+	out.print(" (");
+	out.print(stats.timeTimeouts);
+	out.println(" unanswered)");
+}
+
+void printClockStats(Print &out, const ClockSync &clock) {
+	out.print("clock ");
+	out.print(clock.synced() ? "synchronized" : "not synchronized");
+	out.print(", exchanges ");
+	out.print(clock.exchanges());
+	out.print(", round trip ");
+	out.print(clock.roundTrip());
+	out.print(" us, last error ");
+	out.print(clock.lastError());
+	out.print(" us, drift ");
+	out.print(clock.driftPpb() / 1000.0f);
+	out.print(" ppm, restarts ");
+	out.print(clock.restarts());
+	out.print(", rejected ");
+	out.println(clock.rejected());
+}
@@ -0,0 +1,184 @@
+/*
+  PlankLink.h - sliding-window link layer over PlankFrame frames, ATmega2560 -> ESP32.
+
+  The sender keeps up to PLANK_LINK_WINDOW frames in flight. The receiver answers every data frame
+  with an ACK frame whose sequence is the cumulative ACK (every frame before it was received) and whose
+  payload is a bit mask of the frames after it that arrived out of order (bit i = cumulative + 1 + i).
+  Frames are retransmitted one by one: immediately when a later frame is selectively acknowledged,
+  otherwise when their timeout expires, with exponential backoff. Nothing is given up: when the
+  window is full the sender refuses new frames and the caller decides what to drop.
+
+  The receiver hands frames to the application in sequence order.
+
+  A fresh sender numbers its frames from 0 and sets PLANK_FRAME_RESTART in the type of its frame 0,
+  retransmissions included, so that a receiver still waiting for the sequences of the sender's
+  previous life starts over from it instead of taking the new frames for duplicates or overruns.
+  A flagged frame 0 the receiver's session started from is only a retransmission while the receiver
+  has not got past the window; a restart within that window costs the frames it overlaps.
+
+  The receiver also keeps track of the sender's clock (ClockSync.h). Every PLANK_LINK_SYNC_MS it sends
+  a TIME_REQUEST holding its micros(); the sender answers at once with a TIME_REPLY holding that time,
+  its own micros() when the request arrived and when the reply left. Both carry PLANK_LINK_TIME_SIZE
+  bytes so that they take as long on the wire, which is what the round-trip halving assumes. Timed
+  frames (capacitive and touch) are then stamped in the receiver's clock.
+*/
+#ifndef PLANK_LINK_h
+#define PLANK_LINK_h
+
+#include <Arduino.h>
+#include "PlankFrame.h"
+#include "ClockSync.h"
+
+#define PLANK_LINK_WINDOW 8			// frames in flight, power of two, at most 8 (one ACK mask byte)
+#define PLANK_LINK_RTO_MS 50		// first retransmission timeout
+#define PLANK_LINK_RTO_MAX_MS 1000	// backoff ceiling
+#define PLANK_LINK_SYNC_MS 250		// between time requests: a clock point every CLOCK_SYNC_BURST of them
+#define PLANK_LINK_SYNC_TIMEOUT_MS 50	// a reply later than this is not waited for
+#define PLANK_LINK_TIME_SIZE 12		// payload of TIME_REQUEST (t1, padding) and TIME_REPLY (t1, t2, t3)
+
+struct LinkSenderStats {
+	uint32_t sent;				// new frames
+	uint32_t acked;
+	uint32_t retransmits;		// after a timeout
+	uint32_t fastRetransmits;	// after a selective ACK showed a hole
+	uint32_t refused;			// send() called with a full window
+	uint32_t badAcks;			// ACKs outside the window
+	uint32_t timeReplies;
+	uint32_t crcErrors;			// on the ACK line
+};
+
+struct LinkReceiverStats {
+	uint32_t delivered;
+	uint32_t outOfOrder;		// buffered until the frames before them arrived
+	uint32_t duplicates;		// already received, ACKed again
+	uint32_t overruns;			// beyond the window, dropped unacknowledged
+	uint32_t resyncs;			// the sender restarted: flagged frame 0, or the sequence jumped
+	uint32_t lost;				// buffered frames discarded by a resync
+	uint32_t crcErrors;
+	uint32_t lengthErrors;
+	uint32_t acksSent;
+	uint32_t timeRequests;
+	uint32_t timeTimeouts;		// requests left unanswered
+};
+
+class LinkSender
+{
+	public:
+		LinkSender(Print &out);
+
+		bool canSend() const { return (uint8_t) (next - base) < PLANK_LINK_WINDOW; }
+
+		// in-place sending: encode a frame numbered sequence() into frameBuffer(), then send(size)
+		uint8_t *frameBuffer() { return slots[next % PLANK_LINK_WINDOW].frame; }
+		uint8_t sequence() const { return next; }
+		bool send(size_t size);
+
+		bool send(uint8_t type, const uint8_t *payload, uint8_t length);
+
+		// bytes from the receiver's direction of the UART; time requests are answered from here
+		void feed(uint8_t c);
+
+		// retransmits the oldest timed out frame, if any; call from loop(). One frame per call keeps a
+		// burst of retransmissions from blocking on a full transmit buffer.
+		void poll();
+
+		uint8_t inFlight() const { return next - base; }
+		const LinkSenderStats &stats() const { return counters; }
+
+	private:
+		struct Slot {
+			uint8_t frame[PLANK_FRAME_MAX_SIZE];
+			uint8_t size;
+			bool acked;			// selectively
+			bool fastDone;		// fast retransmit happens once per frame
+			uint8_t retries;
+			unsigned long sentAt;
+		};
+
+		void transmit(Slot &slot);
+		void markRestart(Slot &slot);
+		void onAck(uint8_t cumulative, uint8_t mask);
+		void replyTime(uint32_t requested, const uint8_t *request);
+
+		Print &out;
+		FrameDecoder decoder;
+		Slot slots[PLANK_LINK_WINDOW];
+		uint8_t base;	// oldest unacknowledged
+		uint8_t next;	// next sequence to send
+		bool fresh;		// nothing sent yet: frame 0 carries PLANK_FRAME_RESTART
+		LinkSenderStats counters;
+};
+
+// a delivered frame copied out of the receiver, e.g. to hand it over to another task
+struct LinkFrame
+{
+	uint8_t type;
+	uint8_t sequence;
+	uint8_t length;
+	uint32_t time;	// receiver's micros(), see LinkReceiver::time()
+	uint8_t payload[PLANK_FRAME_MAX_PAYLOAD];
+};
+
+class LinkReceiver
+{
+	public:
+		LinkReceiver(Print &ackOut);
+
+		// bytes from the sender's direction of the UART; ACKs are written to ackOut as frames complete
+		void feed(uint8_t c);
+
+		// sends a time request when one is due; call at least every PLANK_LINK_SYNC_MS
+		void poll();
+		// a time request is out: feed() the replies as soon as they arrive, their delay is an error
+		bool awaitingTime() const { return awaiting; }
+		const ClockSync &clock() const { return sync; }
+
+		// pops the next in-order frame; the accessors below then describe it until the next feed()
+		bool read();
+		// pops the next in-order frame into 'frame'
+		bool read(LinkFrame &frame);
+
+		uint8_t type() const { return current->type; }
+		uint8_t sequence() const { return current->sequence; }
+		uint8_t length() const { return current->length; }
+		const uint8_t *payload() const { return current->payload; }
+		// when the frame was taken, in our micros(): the scan time it carries once the clocks are
+		// synchronized, its arrival otherwise
+		uint32_t time() const;
+
+		const LinkReceiverStats &stats() const { return counters; }
+
+	private:
+		struct Slot {
+			bool held;
+			uint8_t sequence;
+			uint8_t type;
+			uint8_t length;
+			uint32_t arrival;	// micros()
+			uint8_t payload[PLANK_FRAME_MAX_PAYLOAD];
+		};
+
+		void store(uint8_t sequence, uint32_t arrival);
+		void resync(uint8_t sequence);
+		void sendAck();
+		void onTimeReply(uint32_t arrival);
+
+		Print &ackOut;
+		FrameDecoder decoder;
+		Slot slots[PLANK_LINK_WINDOW];
+		const Slot *current;
+		bool synced;
+		bool restarted;		// synchronized on a flagged frame 0, which may still come again
+		uint8_t expected;	// next sequence to deliver
+		LinkReceiverStats counters;
+		ClockSync sync;
+		bool awaiting;
+		uint32_t requestTime;	// micros() of the request out, t1
+		unsigned long lastRequest;	// millis()
+};
+
+void printLinkStats(Print &out, const LinkSenderStats &stats);
+void printLinkStats(Print &out, const LinkReceiverStats &stats);
+void printClockStats(Print &out, const ClockSync &clock);
+
+#endif /* PLANK_LINK_h */
@@ -0,0 +1,144 @@
+#include <Arduino.h>
+#include <PlankLog.h>
+
+#if defined(ARDUINO_ARCH_ESP32)
+static portMUX_TYPE logLock = portMUX_INITIALIZER_UNLOCKED;
+
+static inline uint8_t lock() {
+	portENTER_CRITICAL(&logLock);
+	return 0;
+}
+
+static inline void unlock(uint8_t) {
+	portEXIT_CRITICAL(&logLock);
+}
+#elif defined(__AVR__)
+static inline uint8_t lock() {
+	uint8_t sreg = SREG;
+	cli();
+	return sreg;
+}
+
+static inline void unlock(uint8_t sreg) {
+	SREG = sreg;
+}
+#else
+// the simulation runs every task on one thread
+static inline uint8_t lock() {
+	return 0;
+}
+
+static inline void unlock(uint8_t) {}
+#endif
+
+PlankLog plankLog;
+
+PlankLog::PlankLog() {
+	head = 0;
+	tail = 0;
+	sequence = 0;
+	lastTime = 0;
+	stored = 0;
+	lost = 0;
+	peak = 0;
+	lineLength = 0;
+	textLost = 0;
+}
+
+#define PLANK_LOG_TEXT_ENTRY 0x80	// in the length byte of an entry: text rather than a record
+
+// ring layout: record length (u8), then the record; or PLANK_LOG_TEXT_ENTRY | text length, then the text
+void PlankLog::append(uint8_t format, const uint8_t *args, uint8_t length) {
+	uint8_t header[3 + PLANK_LOG_VARINT_MAX];
+	uint8_t state = lock();
+	uint32_t now = micros();
+	header[1] = sequence++;
+	header[2] = format;
+	uint8_t headerLength = 3 + plankLogVarint(&header[3], now - lastTime);
+	header[0] = headerLength - 1 + length;
+	uint16_t used = head - tail;
+	if (used + headerLength + length > PLANK_LOG_BUFFER) {
+		++lost;
+		unlock(state);
+		return;
+	}
+	put(header, headerLength);
+	put(args, length);
+	lastTime = now;
+	++stored;
+	used += headerLength + length;
+	if (used > peak) {
+		peak = used;
+	}
+	unlock(state);
+}
+
+size_t PlankLog::write(uint8_t c) {
+	line[lineLength++] = c;
+	if (c == '\n' || lineLength == PLANK_LOG_TEXT_LINE) {
+		appendText();
+	}
+	return 1;
+}
+
+void PlankLog::appendText() {
+	uint8_t length = PLANK_LOG_TEXT_ENTRY | lineLength;
+	uint8_t state = lock();
+	uint16_t used = head - tail;
+	if (used + 1 + lineLength > PLANK_LOG_BUFFER) {
+		++textLost;
+	} else {
+		put(&length, 1);
+		put(line, lineLength);
+		used += 1 + lineLength;
+		if (used > peak) {
+			peak = used;
+		}
+	}
+	unlock(state);
+	lineLength = 0;
+}
+
+void PlankLog::put(const uint8_t *data, uint8_t length) {
+	uint16_t at = head & (PLANK_LOG_BUFFER - 1);
+	uint16_t first = PLANK_LOG_BUFFER - at < length ? PLANK_LOG_BUFFER - at : length;
+	memcpy(&buffer[at], data, first);
+	memcpy(buffer, data + first, length - first);
+	head += length;
+}
+
+size_t PlankLog::drain(Print &out, size_t budget) {
+	size_t written = 0;
+	for (;;) {
+		uint8_t record[PLANK_LOG_MAX_RECORD > PLANK_LOG_TEXT_LINE ? PLANK_LOG_MAX_RECORD : PLANK_LOG_TEXT_LINE];
+		uint8_t state = lock();
+		if (head == tail) {
+			unlock(state);
+			break;
+		}
+		uint8_t length = buffer[tail & (PLANK_LOG_BUFFER - 1)];
+		bool text = length & PLANK_LOG_TEXT_ENTRY;
+		length &= ~PLANK_LOG_TEXT_ENTRY;
+		// the sequence byte goes into the frame header
+		size_t frameSize = text ? length : PLANK_FRAME_HEADER_SIZE + length - 1 + PLANK_FRAME_CRC_SIZE;
+		if (written + frameSize > budget) {
+			unlock(state);
+			break;
+		}
+		uint16_t at = (uint16_t) (tail + 1) & (PLANK_LOG_BUFFER - 1);
+		uint16_t first = PLANK_LOG_BUFFER - at < length ? PLANK_LOG_BUFFER - at : length;
+		memcpy(record, &buffer[at], first);
+		memcpy(&record[first], buffer, length - first);
+		tail += 1 + length;
+		unlock(state);
+
+		if (text) {
+			out.write(record, length);
+		} else {
+			uint8_t frame[PLANK_FRAME_MAX_SIZE];
+			out.write(frame, encodeFrame(frame, PLANK_FRAME_LOG, record[0], &record[1], length - 1));
+		}
+		written += frameSize;
+	}
+	return written;
+}
@@ -0,0 +1,191 @@
+/*
+  PlankLog.h - debug output as compact binary records, drained to the serial port when there is time.
+
+  PLOG_ERROR / PLOG_WARN / PLOG_INFO / PLOG_DEBUG / PLOG_TRACE(format, args...) take a format of
+  PlankLogFormats.h and up to PLANK_LOG_MAX_ARGS integer or float arguments. Above PLANK_LOG_LEVEL a
+  call compiles to nothing and its arguments are not evaluated; they are still type-checked, and the
+  argument count is checked against the format at compile time. Otherwise the call appends a record
+  to a ring buffer and returns. No text is formatted on the target:
+
+    sequence (u8) | format (u8) | us since the previous record | arguments
+
+  The time and the arguments are varints, 7 bits a byte; the arguments zig-zag mapped (DeltaCodec.h),
+  float ones as their bits. drain(), run from a low-priority task or the end of loop(), writes the
+  records as PLANK_FRAME_LOG frames (PlankFrame.h) whose sequence is the record's. test/PlankLog.py
+  finds the frames in the serial output, expands them with the format strings and passes the plain
+  text around them through.
+  A record that does not fit in the ring is dropped: its sequence number goes missing.
+
+  PlankLog is also a Print, for the text a firmware prints on demand (the answer to a serial
+  command): it goes into the ring a line at a time, at most PLANK_LOG_TEXT_LINE bytes, in order with
+  the records, and drain() writes it as is. Only the drain then writes the serial port, so no text
+  ends up inside a frame. Text comes from one task only; a line that does not fit is dropped.
+
+  The ring is locked with interrupts off (a spinlock on the ESP32) while a record is copied in or
+  out. On the ESP32, log from tasks only, not from interrupt handlers.
+*/
+#ifndef PLANK_LOG_h
+#define PLANK_LOG_h
+
+#include <Arduino.h>
+#include "DeltaCodec.h"
+#include "PlankFrame.h"
+#include "PlankLogFormats.h"
+
+#define PLANK_LOG_ERROR 1
+#define PLANK_LOG_WARN 2
+#define PLANK_LOG_INFO 3
+#define PLANK_LOG_DEBUG 4	// every sample
+#define PLANK_LOG_TRACE 5	// every packet
+
+#ifndef PLANK_LOG_LEVEL
+#define PLANK_LOG_LEVEL PLANK_LOG_INFO
+#endif
+
+#ifndef PLANK_LOG_BUFFER
+#if defined(__AVR__)
+#define PLANK_LOG_BUFFER 128
+#else
+#define PLANK_LOG_BUFFER 2048	// bytes, power of two
+#endif
+#endif
+
+#ifndef PLANK_LOG_TEXT_LINE
+#if defined(__AVR__)
+#define PLANK_LOG_TEXT_LINE 32
+#else
+#define PLANK_LOG_TEXT_LINE 80	// bytes, at most 127
+#endif
+#endif
+
+#define PLANK_LOG_MAX_ARGS 8
+#define PLANK_LOG_VARINT_MAX 5
+// length, sequence and format bytes, time, arguments; the frame payload is all but the first two
+#define PLANK_LOG_MAX_RECORD (3 + PLANK_LOG_VARINT_MAX * (1 + PLANK_LOG_MAX_ARGS))
+
+#define PLOG_AT(level, format, ...) \
+	do { \
+		if ((level) <= PLANK_LOG_LEVEL) { \
+			plankLog.write<format>(__VA_ARGS__); \
+		} \
+	} while (0)
+
+#define PLOG_ERROR(format, ...) PLOG_AT(PLANK_LOG_ERROR, format, ##__VA_ARGS__)
+#define PLOG_WARN(format, ...) PLOG_AT(PLANK_LOG_WARN, format, ##__VA_ARGS__)
+#define PLOG_INFO(format, ...) PLOG_AT(PLANK_LOG_INFO, format, ##__VA_ARGS__)
+#define PLOG_DEBUG(format, ...) PLOG_AT(PLANK_LOG_DEBUG, format, ##__VA_ARGS__)
+#define PLOG_TRACE(format, ...) PLOG_AT(PLANK_LOG_TRACE, format, ##__VA_ARGS__)
+
+enum PlankLogFormat {
+#define PLANK_LOG_FORMAT_ID(id, format) id,
+	PLANK_LOG_FORMATS(PLANK_LOG_FORMAT_ID)
+#undef PLANK_LOG_FORMAT_ID
+	PLANK_LOG_FORMAT_COUNT
+};
+
+// only ever read by the compiler, see plankLogArity()
+constexpr const char *PLANK_LOG_FORMAT_STRINGS[] = {
+#define PLANK_LOG_FORMAT_STRING(id, format) format,
+	PLANK_LOG_FORMATS(PLANK_LOG_FORMAT_STRING)
+#undef PLANK_LOG_FORMAT_STRING
+};
+
+// conversions in a format, "%%" aside
+constexpr uint8_t plankLogConversions(const char *f) {
+	return *f == 0 ? 0
+		: (f[0] == '%' && f[1] == '%') ? plankLogConversions(f + 2)
+		: (f[0] == '%') + plankLogConversions(f + 1);
+}
+
+constexpr uint8_t plankLogArity(PlankLogFormat format) {
+	return plankLogConversions(PLANK_LOG_FORMAT_STRINGS[format]);
+}
+
+inline uint8_t plankLogVarint(uint8_t *out, uint32_t v) {
+	uint8_t n = 0;
+	while (v >= 0x80) {
+		out[n++] = (v & 0x7F) | 0x80;
+		v >>= 7;
+	}
+	out[n++] = v;
+	return n;
+}
+
+template <typename T>
+inline uint32_t plankLogValue(T v) {
+	return zigzag((int32_t) v);
+}
+
+inline uint32_t plankLogValue(float v) {
+	uint32_t bits;
+	memcpy(&bits, &v, sizeof(bits));
+	return bits;
+}
+
+inline uint32_t plankLogValue(double v) {
+	return plankLogValue((float) v);
+}
+
+inline uint8_t plankLogEncode(uint8_t *) {
+	return 0;
+}
+
+template <typename T, typename... R>
+inline uint8_t plankLogEncode(uint8_t *out, T first, R... rest) {
+	uint8_t n = plankLogVarint(out, plankLogValue(first));
+	return n + plankLogEncode(out + n, rest...);
+}
+
+class PlankLog : public Print
+{
+	static_assert((PLANK_LOG_BUFFER & (PLANK_LOG_BUFFER - 1)) == 0, "PLANK_LOG_BUFFER must be a power of two");
+	static_assert(PLANK_LOG_FORMAT_COUNT <= 256, "PlankLog format ids are one byte");
+	static_assert(PLANK_LOG_TEXT_LINE < 128 && PLANK_LOG_MAX_RECORD < 128, "PlankLog entry lengths are 7 bits");
+
+	public:
+		PlankLog();
+
+		template <PlankLogFormat F, typename... A>
+		void write(A... args) {
+			static_assert(sizeof...(A) <= PLANK_LOG_MAX_ARGS, "PlankLog: too many arguments");
+			static_assert(plankLogArity(F) == sizeof...(A), "PlankLog: the argument count does not match the format");
+			uint8_t encoded[PLANK_LOG_VARINT_MAX * sizeof...(A) + 1];
+			append(F, encoded, plankLogEncode(encoded, args...));
+		}
+
+		// text, stored when a line is complete or PLANK_LOG_TEXT_LINE bytes long
+		size_t write(uint8_t c);
+		using Print::write;
+
+		// writes whole records as frames, and text lines, as long as they fit in 'budget' bytes (the
+		// room in the UART driver, so that it does not block); returns the bytes written
+		size_t drain(Print &out, size_t budget);
+
+		uint32_t records() const { return stored; }
+		uint32_t dropped() const { return lost; }
+		uint32_t droppedText() const { return textLost; }	// lines
+		uint32_t highWater() const { return peak; }	// bytes
+		uint32_t capacity() const { return PLANK_LOG_BUFFER; }
+
+	private:
+		void append(uint8_t format, const uint8_t *args, uint8_t length);
+		void appendText();
+		void put(const uint8_t *data, uint8_t length);
+
+		uint8_t buffer[PLANK_LOG_BUFFER];
+		uint16_t head;		// free-running byte indices
+		uint16_t tail;
+		uint8_t sequence;
+		uint32_t lastTime;	// us, of the last stored record
+		uint32_t stored;
+		uint32_t lost;
+		uint16_t peak;
+		uint8_t line[PLANK_LOG_TEXT_LINE];	// text not stored yet
+		uint8_t lineLength;
+		uint32_t textLost;
+};
+
+// the log of the firmware; the simulation gives each of its MCUs one of its own
+extern PlankLog plankLog;
+
+#endif /* PLANK_LOG_h */
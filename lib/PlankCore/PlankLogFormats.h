@@ -0,0 +1,32 @@
+/*
+  PlankLogFormats.h - the format strings of the PlankLog records, and the only place they live.
+
+  A record carries the index of its format in this list. The firmware only reads the strings at
+  compile time, to check the argument counts, so none of them takes flash; test/PlankLog.py reads
+  them from this file to expand the records. Add formats at the end: the tool has to read the
+  list the running firmware was built with.
+  Conversions: %d %u %x %c, optionally with l, and %f for float arguments.
+*/
+#ifndef PLANK_LOG_FORMATS_h
+#define PLANK_LOG_FORMATS_h
+
+#define PLANK_LOG_FORMATS(X) \
+	X(LOG_TOUCH_DOWN, "Touch down - Sensor %d: %d") \
+	X(LOG_TOUCH_UP, "Touch up - Sensor %d: %d") \
+	X(LOG_TOUCH_STRENGTH, "Touch strength - Sensor %d: %d") \
+	X(LOG_CAPACITIVE, "Capacitive sensor %d: %d") \
+	X(LOG_STRAIN, "Gauge %d - Raw: %ld, Scaled: %ld") \
+	X(LOG_PIEZO, "Piezo %d - Raw: %d, Mapped: %u") \
+	X(LOG_HIT, "Hit - Piezo %u, impact %u at %lu us (+%d us), peak %u mV, rise %u us") \
+	X(LOG_BLE_PACKET, "%c BLE packet: %u bytes") \
+	X(LOG_STREAM_CONFIG, "Stream frames of %u bytes, packed %d") \
+	X(LOG_CAPTURE_WINDOW, "Capture window: %u + %u samples") \
+	X(LOG_SEND_EVENT, "Sending touch event %d: A%d %d") \
+	X(LOG_SEND_DATA, "Sending data A%d: %d") \
+	X(LOG_SESSION_START, "Recording session %u") \
+	X(LOG_SESSION_END, "Session %u recorded, %lu samples in all") \
+	X(LOG_SESSION_DOWNLOAD, "Sending session %u from block %lu, found %d") \
+	X(LOG_LINK_SENDER, "link sent %lu, acked %lu, retransmits %lu + %lu fast, refused %lu, bad ACKs %lu, time replies %lu, CRC errors %lu") \
+	X(LOG_SCAN_RATE, "Capacitive scans/s: %f")
+
+#endif /* PLANK_LOG_FORMATS_h */
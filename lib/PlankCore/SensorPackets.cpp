@@ -0,0 +1,63 @@
+#include <Arduino.h>
+#include <SensorPackets.h>
+
+static void putTime(uint8_t *out, uint32_t time) {
+  out[0] = time & 0xFF;
+  out[1] = (time >> 8) & 0xFF;
+  out[2] = (time >> 16) & 0xFF;
+  out[3] = time >> 24;
+}
+
+size_t packCapacitive(uint8_t *out, const int *values, uint32_t time) {
+  const uint8_t CAPACITIVE_START = 0x3C;
+  const uint8_t CAPACITIVE_END = 0x3E;
+
+  out[0] = CAPACITIVE_START;
+  for (int i = 0; i < PLANK_CAPACITIVE_COUNT; i++) {
+    out[i*2 + 1] = values[i] & 0xFF;
+    out[i*2 + 2] = (values[i] >> 8) & 0xFF;
+  }
+  putTime(&out[PLANK_CAPACITIVE_COUNT * 2 + 1], time);
+  out[CAPACITIVE_PACKET_SIZE - 1] = CAPACITIVE_END;
+  return CAPACITIVE_PACKET_SIZE;
+}
+
+size_t packStrain(uint8_t *out, const long *values, uint32_t time) {
+  const uint8_t STRAIN_START = 0x28;
+  const uint8_t STRAIN_END = 0x29;
+
+  out[0] = STRAIN_START;
+  for (int i = 0; i < PLANK_STRAIN_COUNT; i++) {
+    out[i + 1] = strainToByte(values[i]);
+  }
+  putTime(&out[PLANK_STRAIN_COUNT + 1], time);
+  out[STRAIN_PACKET_SIZE - 1] = STRAIN_END;
+  return STRAIN_PACKET_SIZE;
+}
+
+size_t packPiezo(uint8_t *out, const uint16_t *values, uint32_t time) {
+  out[0] = 0x2D;
+  out[1] = 0x3E;
+  for (int i = 0; i < PLANK_PIEZO_COUNT; i++) {
+    out[2 + i * 2] = (values[i] >> 8) & 0xFF;
+    out[3 + i * 2] = values[i] & 0xFF;
+  }
+  putTime(&out[2 + PLANK_PIEZO_COUNT * 2], time);
+  out[PIEZO_PACKET_SIZE - 2] = 0x3C;
+  out[PIEZO_PACKET_SIZE - 1] = 0x2D;
+  return PIEZO_PACKET_SIZE;
+}
+
+uint8_t strainToByte(long units) {
+  if (units <= 0) {
+    return 0;
+  }
+  if (units >= STRAIN_PACKET_FULL_SCALE) {
+    return 255;
+  }
+  return static_cast<uint8_t>(units * 255 / STRAIN_PACKET_FULL_SCALE);
+}
+
+uint16_t mapPiezo(int reading) {
+  return map(reading, 0, 4095, 0, 65535);
+}
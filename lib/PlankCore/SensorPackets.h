@@ -0,0 +1,41 @@
+/*
+  SensorPackets.h - sensor counts and the legacy BLE characteristic payloads shared by the
+  firmwares, the native simulation and the benchmarks.
+
+  Every packet carries the time of its sample before the closing marker: the ESP32's micros(), little
+  endian, the clock the capacitive frames are converted to (ClockSync.h) and the stream and hits use.
+*/
+#ifndef SENSOR_PACKETS_h
+#define SENSOR_PACKETS_h
+
+#include <Arduino.h>
+
+#define PLANK_CAPACITIVE_COUNT 16
+#define PLANK_STRAIN_COUNT 4
+#define PLANK_PIEZO_COUNT 4
+
+#define PACKET_TIME_SIZE 4
+// '<' + 16 x int16 little endian + time + '>'
+#define CAPACITIVE_PACKET_SIZE (PLANK_CAPACITIVE_COUNT * 2 + PACKET_TIME_SIZE + 2)
+// '(' + 4 x uint8 + time + ')'
+#define STRAIN_PACKET_SIZE (PLANK_STRAIN_COUNT + PACKET_TIME_SIZE + 2)
+// calibrated strain units covered by the one byte of the strain packet
+#define STRAIN_PACKET_FULL_SCALE 2500
+// the original (raw / 842) scaling, used for cells that have no stored calibration
+#define STRAIN_DEFAULT_UNITS_PER_COUNT (1.0f / 842)
+// '-' '>' + 4 x uint16 big endian + time + '<' '-'
+#define PIEZO_PACKET_SIZE (PLANK_PIEZO_COUNT * 2 + PACKET_TIME_SIZE + 4)
+
+// time: micros() of the sample
+size_t packCapacitive(uint8_t *out, const int *values, uint32_t time);
+// values: calibrated strain units, narrowed to the packet's byte here
+size_t packStrain(uint8_t *out, const long *values, uint32_t time);
+size_t packPiezo(uint8_t *out, const uint16_t *values, uint32_t time);
+
+// calibrated units to the byte of the strain packet: 0..STRAIN_PACKET_FULL_SCALE onto 0..255, clamped
+uint8_t strainToByte(long units);
+
+// 12-bit ESP32 ADC reading stretched to 16 bits
+uint16_t mapPiezo(int reading);
+
+#endif /* SENSOR_PACKETS_h */
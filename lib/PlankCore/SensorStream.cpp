@@ -0,0 +1,190 @@
+#include <Arduino.h>
+#include <SensorStream.h>
+#include <PlankBytes.h>
+
+uint8_t streamChannels(uint8_t type) {
+	switch (STREAM_RECORD_TYPE(type)) {
+		case STREAM_RECORD_CAPACITIVE:
+			return PLANK_CAPACITIVE_COUNT;
+		case STREAM_RECORD_STRAIN:
+			return PLANK_STRAIN_COUNT;
+		case STREAM_RECORD_PIEZO:
+			return PLANK_PIEZO_COUNT;
+	}
+	return 0;
+}
+
+uint8_t packStreamRecord(uint8_t *out, uint8_t type, const int32_t *values) {
+	switch (STREAM_RECORD_TYPE(type)) {
+		case STREAM_RECORD_CAPACITIVE:
+			for (int i = 0; i < PLANK_CAPACITIVE_COUNT; i++) {
+				int32_t v = values[i];
+				put16(&out[i * 2], (uint16_t) (v > 32767 ? 32767 : (v < -32768 ? -32768 : v)));
+			}
+			return PLANK_CAPACITIVE_COUNT * 2;
+		case STREAM_RECORD_STRAIN:
+			for (int i = 0; i < PLANK_STRAIN_COUNT; i++) {
+				put32(&out[i * 4], (uint32_t) values[i]);
+			}
+			return PLANK_STRAIN_COUNT * 4;
+		case STREAM_RECORD_PIEZO:
+			for (int i = 0; i < PLANK_PIEZO_COUNT; i++) {
+				put16(&out[i * 2], (uint16_t) values[i]);
+			}
+			return PLANK_PIEZO_COUNT * 2;
+	}
+	return 0;
+}
+
+SensorStreamWriter::SensorStreamWriter() {
+	capacity = STREAM_FRAME_MIN;
+	size = STREAM_HEADER_SIZE;
+	wanted = STREAM_MASK_ALL;
+	packed = false;
+	mask = 0;
+	records = 0;
+	sequence = 0;
+	start = 0;
+	tooLarge = 0;
+}
+
+void SensorStreamWriter::setCapacity(size_t bytes) {
+	capacity = bytes < STREAM_FRAME_MIN ? STREAM_FRAME_MIN : (bytes > STREAM_FRAME_MAX ? STREAM_FRAME_MAX : bytes);
+}
+
+bool SensorStreamWriter::add(uint8_t type, uint32_t timeUs, const uint8_t *payload, uint8_t length) {
+	if (records == 0) {
+		size = STREAM_HEADER_SIZE;
+		mask = 0;
+		start = timeUs;
+	}
+	int32_t ticks = (int32_t) (timeUs - start) / STREAM_TICK_US;
+	if (records == 255 || ticks > 32767 || ticks < -32768 || size + STREAM_RECORD_HEADER_SIZE + length > capacity) {
+		if (records == 0) {
+			// too large for an empty frame: dropped rather than refused forever
+			++tooLarge;
+			return true;
+		}
+		return false;
+	}
+	uint8_t *r = &frame[size];
+	r[0] = type;
+	r[1] = length;
+	put16(&r[2], (uint16_t) ticks);
+	memcpy(&r[STREAM_RECORD_HEADER_SIZE], payload, length);
+	size += STREAM_RECORD_HEADER_SIZE + length;
+	mask |= STREAM_MASK(type);
+	++records;
+	return true;
+}
+
+bool SensorStreamWriter::addValues(uint8_t type, uint32_t timeUs, const int32_t *values) {
+	uint8_t channels = streamChannels(type);
+	if (channels == 0) {
+		return true;
+	}
+	uint8_t payload[STREAM_RECORD_MAX];
+	uint8_t length;
+	int32_t *last = previous[type - 1];
+	if (packed) {
+		// a record that opens the frame, or the first of its type in it, is packed against zero
+		bool key = records == 0 || !(mask & STREAM_MASK(type));
+		length = deltaEncode(payload, values, key ? NULL : last, channels);
+		type |= STREAM_RECORD_PACKED;
+	} else {
+		length = packStreamRecord(payload, type, values);
+	}
+	if (!add(type, timeUs, payload, length)) {
+		return false;
+	}
+	memcpy(last, values, channels * sizeof(int32_t));
+	return true;
+}
+
+size_t SensorStreamWriter::finish() {
+	put16(&frame[0], sequence);
+	frame[2] = mask;
+	frame[3] = records;
+	put32(&frame[4], start);
+	++sequence;
+	records = 0;
+	return size;
+}
+
+bool SensorStreamReader::begin(const uint8_t *data, size_t length) {
+	frame = data;
+	size = length;
+	offset = 0;
+	following = STREAM_HEADER_SIZE;
+	seen = 0;
+	if (length < STREAM_HEADER_SIZE) {
+		return false;
+	}
+	// every record header and length must land exactly on the end of the frame
+	size_t at = STREAM_HEADER_SIZE;
+	for (uint8_t i = 0; i < count(); i++) {
+		if (at + STREAM_RECORD_HEADER_SIZE > length) {
+			return false;
+		}
+		at += STREAM_RECORD_HEADER_SIZE + data[at + 1];
+	}
+	return at == length;
+}
+
+uint32_t SensorStreamReader::time() const {
+	return frame[4] | (frame[5] << 8) | ((uint32_t) frame[6] << 16) | ((uint32_t) frame[7] << 24);
+}
+
+bool SensorStreamReader::next() {
+	if (following + STREAM_RECORD_HEADER_SIZE > size) {
+		return false;
+	}
+	offset = following;
+	following += STREAM_RECORD_HEADER_SIZE + frame[offset + 1];
+	return following <= size;
+}
+
+uint8_t SensorStreamReader::values(int32_t *out) {
+	uint8_t channels = streamChannels(baseType());
+	if (channels == 0) {
+		return 0;
+	}
+	const uint8_t *in = payload();
+	int32_t *last = previous[baseType() - 1];
+	if (type() & STREAM_RECORD_PACKED) {
+		bool key = !(seen & STREAM_MASK(baseType()));
+		if (deltaDecode(in, length(), out, key ? NULL : last, channels) != length()) {
+			return 0;
+		}
+	} else {
+		switch (baseType()) {
+			case STREAM_RECORD_CAPACITIVE:
+				if (length() != channels * 2) {
+					return 0;
+				}
+				for (uint8_t i = 0; i < channels; i++) {
+					out[i] = (int16_t) get16(&in[i * 2]);
+				}
+				break;
+			case STREAM_RECORD_STRAIN:
+				if (length() != channels * 4) {
+					return 0;
+				}
+				for (uint8_t i = 0; i < channels; i++) {
+					out[i] = (int32_t) get32(&in[i * 4]);
+				}
+				break;
+			case STREAM_RECORD_PIEZO:
+				if (length() != channels * 2) {
+					return 0;
+				}
+				for (uint8_t i = 0; i < channels; i++) {
+					out[i] = get16(&in[i * 2]);
+				}
+				break;
+		}
+	}
+	seen |= STREAM_MASK(baseType());
+	memcpy(last, out, channels * sizeof(int32_t));
+	return channels;
+}
@@ -0,0 +1,134 @@
+/*
+  SensorStream.h - batched BLE notifications: many timestamped samples of every sensor in one frame.
+
+    sequence (u16) | sensor mask (u8) | record count (u8) | time of the frame (u32, us)
+    then per record: type (u8) | length (u8) | time offset (i16, STREAM_TICK_US units) | payload
+
+  The mask has bit (type - 1) set for every record type present. A receiver skips record types it
+  does not know by their length. Multi-byte fields are little endian. A frame holds as many records
+  as fit the capacity the receiver announced (its ATT MTU - 3), so one notification replaces several
+  legacy ones. The offset is signed: a capacitive sample is stamped with the time of its scan on the
+  Mega, which can come before the first record of the frame.
+
+  Packed records (type | STREAM_RECORD_PACKED) carry the same channels through DeltaCodec.h: the first
+  record of a type in a frame is packed against zero, the next ones against the record before them,
+  so every frame still decodes on its own.
+*/
+#ifndef SENSOR_STREAM_h
+#define SENSOR_STREAM_h
+
+#include <Arduino.h>
+#include "SensorPackets.h"
+#include "DeltaCodec.h"
+
+#define STREAM_HEADER_SIZE 8
+#define STREAM_RECORD_HEADER_SIZE 4
+#define STREAM_FRAME_MIN 20		// default ATT MTU of 23
+#define STREAM_FRAME_MAX 244	// ATT MTU of 247, one LE data length extended packet
+#define STREAM_TICK_US 10
+
+#define STREAM_RECORD_CAPACITIVE 1	// PLANK_CAPACITIVE_COUNT x int16
+#define STREAM_RECORD_STRAIN 2		// PLANK_STRAIN_COUNT x int32, calibrated units
+#define STREAM_RECORD_PIEZO 3		// PLANK_PIEZO_COUNT x uint16, raw 12-bit ADC readings
+#define STREAM_RECORD_TYPES 3
+#define STREAM_RECORD_PACKED 0x80
+#define STREAM_RECORD_TYPE(type) ((type) & 0x7F)
+#define STREAM_MASK(type) (1 << (STREAM_RECORD_TYPE(type) - 1))
+#define STREAM_MASK_ALL 0xFF
+#define STREAM_RECORD_MAX DELTA_MAX_SIZE(DELTA_MAX_CHANNELS)
+
+// channels of a record type, 0 for types this build does not know
+uint8_t streamChannels(uint8_t type);
+
+// unpacked payload of a record type, in the widths listed above; returns its length
+uint8_t packStreamRecord(uint8_t *out, uint8_t type, const int32_t *values);
+
+class SensorStreamWriter
+{
+	public:
+		SensorStreamWriter();
+
+		// frame size, clamped to STREAM_FRAME_MIN..STREAM_FRAME_MAX; applies from the next frame
+		void setCapacity(size_t bytes);
+		size_t getCapacity() const { return capacity; }
+		// record types the receiver asked for
+		void setMask(uint8_t m) { wanted = m; }
+		bool accepts(uint8_t type) const { return wanted & STREAM_MASK(type); }
+		// sensor records packed with DeltaCodec from the next frame on
+		void setPacked(bool p) { packed = p; }
+		bool isPacked() const { return packed; }
+
+		// appends a record; false when it does not fit the frame being built or lies more than
+		// 327 ms either side of its start, then finish() the frame and add it again
+		bool add(uint8_t type, uint32_t timeUs, const uint8_t *payload, uint8_t length);
+
+		// one sample of a sensor record type, packed or not as set; same contract as add()
+		bool addValues(uint8_t type, uint32_t timeUs, const int32_t *values);
+		template <typename T>
+		bool addSample(uint8_t type, uint32_t timeUs, const T *values) {
+			int32_t v[DELTA_MAX_CHANNELS];
+			for (uint8_t i = 0; i < streamChannels(type); i++) {
+				v[i] = (int32_t) values[i];
+			}
+			return addValues(type, timeUs, v);
+		}
+
+		bool empty() const { return records == 0; }
+		// records larger than the frame capacity, never sent
+		uint32_t dropped() const { return tooLarge; }
+		// time since the first record of the frame being built
+		uint32_t age(uint32_t nowUs) const { return empty() ? 0 : nowUs - start; }
+
+		// closes the frame and returns its size; data() then holds it until the next add()
+		size_t finish();
+		const uint8_t *data() const { return frame; }
+
+	private:
+		uint8_t frame[STREAM_FRAME_MAX];
+		size_t capacity;
+		size_t size;
+		uint8_t wanted;
+		bool packed;
+		uint8_t mask;
+		uint8_t records;
+		uint16_t sequence;
+		uint32_t start;
+		uint32_t tooLarge;
+		int32_t previous[STREAM_RECORD_TYPES][DELTA_MAX_CHANNELS];
+};
+
+// walks the records of one frame in place
+class SensorStreamReader
+{
+	public:
+		// checks the header and that the records exactly fill the frame
+		bool begin(const uint8_t *frame, size_t size);
+
+		uint16_t sequence() const { return frame[0] | (frame[1] << 8); }
+		uint8_t mask() const { return frame[2]; }
+		uint8_t count() const { return frame[3]; }
+		uint32_t time() const;
+
+		// moves to the next record; the accessors below then describe it
+		bool next();
+		uint8_t type() const { return frame[offset]; }
+		uint8_t baseType() const { return STREAM_RECORD_TYPE(frame[offset]); }
+		uint8_t length() const { return frame[offset + 1]; }
+		uint32_t timeUs() const { return time() + (int32_t) (int16_t) (frame[offset + 2] | (frame[offset + 3] << 8)) * STREAM_TICK_US; }
+		const uint8_t *payload() const { return &frame[offset + STREAM_RECORD_HEADER_SIZE]; }
+
+		// channel values of the record, packed or not; returns how many, 0 for an unknown type or a
+		// corrupt record. Packed records depend on the one before them: call it on every record of the
+		// types you decode.
+		uint8_t values(int32_t *out);
+
+	private:
+		const uint8_t *frame;
+		size_t size;
+		size_t offset;
+		size_t following;
+		uint8_t seen;		// record types met in this frame
+		int32_t previous[STREAM_RECORD_TYPES][DELTA_MAX_CHANNELS];
+};
+
+#endif /* SENSOR_STREAM_h */
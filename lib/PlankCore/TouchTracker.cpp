@@ -0,0 +1,73 @@
+#include <Arduino.h>
+#include <TouchTracker.h>
+
+static const TouchConfig defaultConfig = TOUCH_DEFAULT_CONFIG;
+
+TouchTracker::TouchTracker(uint8_t padCount) {
+	config = defaultConfig;
+	count = padCount > PLANK_CAPACITIVE_COUNT ? PLANK_CAPACITIVE_COUNT : padCount;
+	memset(pads, 0, sizeof(pads));
+}
+
+void TouchTracker::reset(const int *raw) {
+	memset(pads, 0, sizeof(pads));
+	for (uint8_t i = 0; i < count; i++) {
+		pads[i].baseline = (int32_t) raw[i] << 8;
+	}
+}
+
+uint8_t TouchTracker::update(const int *raw, TouchEvent *events) {
+	uint8_t n = 0;
+	for (uint8_t i = 0; i < count; i++) {
+		Pad &p = pads[i];
+		int32_t delta = raw[i] - (p.baseline >> 8);
+		int16_t s = delta > 32767 ? 32767 : (delta < -32768 ? -32768 : (int16_t) delta);
+		p.strength = s;
+
+		if (!p.down && s < config.releaseThreshold) {
+			p.baseline += (((int32_t) raw[i] << 8) - p.baseline) >> config.baselineShift;
+			p.frozen = 0;
+		} else if (config.stuckScans != 0 && ++p.frozen >= config.stuckScans) {
+			p.baseline = (int32_t) raw[i] << 8;
+			p.strength = 0;
+			p.frozen = 0;
+			p.count = 0;
+			if (p.down) {
+				p.down = false;
+				p.reported = 0;
+				events[n++] = {i, TOUCH_EVENT_UP, 0};
+			}
+			continue;
+		}
+
+		bool other = p.down ? s < config.releaseThreshold : s >= config.touchThreshold;
+		if (!other) {
+			p.count = 0;
+			if (p.down && abs(s - p.reported) >= config.strengthStep) {
+				p.reported = s;
+				events[n++] = {i, TOUCH_EVENT_STRENGTH, s};
+			}
+			continue;
+		}
+		if (++p.count < config.debounce) {
+			continue;
+		}
+		p.count = 0;
+		p.down = !p.down;
+		p.reported = p.down ? s : 0;
+		events[n++] = {i, p.down ? (uint8_t) TOUCH_EVENT_DOWN : (uint8_t) TOUCH_EVENT_UP, s};
+	}
+	return n;
+}
+
+void TouchTracker::strengths(int *out) const {
+	for (uint8_t i = 0; i < count; i++) {
+		out[i] = pads[i].strength;
+	}
+}
+
+void TouchTracker::levels(int *out) const {
+	for (uint8_t i = 0; i < count; i++) {
+		out[i] = pads[i].down ? pads[i].reported : 0;
+	}
+}
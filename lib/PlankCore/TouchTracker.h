@@ -0,0 +1,82 @@
+/*
+  TouchTracker.h - touch detection on the capacitive pads of the ATmega2560.
+
+  Each pad keeps a baseline, the reading it gives untouched, as a slow IIR in 24.8 fixed point:
+  baseline += (raw - baseline) >> baselineShift per scan. The filter freezes while the pad is touched
+  or its reading sits above the release threshold, so a finger is never learned into the baseline
+  while humidity and temperature drift still are. A baseline frozen for stuckScans scans in a row is
+  taken for a lasting change around the pad (something left on it, a cable moved) rather than a
+  finger: it jumps to the reading, and a touched pad is released with strength 0.
+
+  strength = raw - baseline. A pad goes down after 'debounce' consecutive scans at or above the touch
+  threshold and up after as many scans below the release threshold; the gap between the two thresholds
+  is the hysteresis. While down, a strength that moved by strengthStep since the last report is
+  reported again.
+*/
+#ifndef TOUCH_TRACKER_h
+#define TOUCH_TRACKER_h
+
+#include <Arduino.h>
+#include "SensorPackets.h"
+
+#define TOUCH_EVENT_DOWN 1
+#define TOUCH_EVENT_UP 2
+#define TOUCH_EVENT_STRENGTH 3
+
+struct TouchEvent {
+	uint8_t pad;
+	uint8_t kind;		// TOUCH_EVENT_*
+	int16_t strength;	// above the baseline, at the scan that raised the event
+};
+
+struct TouchConfig {
+	int16_t touchThreshold;
+	int16_t releaseThreshold;
+	uint8_t debounce;		// consecutive scans
+	uint8_t baselineShift;	// IIR time constant, 2^shift scans
+	int16_t strengthStep;
+	uint16_t stuckScans;	// frozen baseline before it is taken over from the reading, 0: never
+};
+
+// a 12 pF finger on a 20 pF pad moves an ADCTouch reading by about 100 counts; at the Mega's 18 or so
+// scans/s a pad stuck down is released after about 5 minutes, longer than a plank is held
+#define TOUCH_DEFAULT_CONFIG {30, 15, 2, 8, 8, 5400}
+
+class TouchTracker
+{
+	public:
+		TouchTracker(uint8_t count = PLANK_CAPACITIVE_COUNT);
+
+		void setConfig(const TouchConfig &c) { config = c; }
+		const TouchConfig &getConfig() const { return config; }
+
+		// baselines from a scan taken with the plank untouched; every pad starts released
+		void reset(const int *raw);
+
+		// one scan of 'count' raw readings; writes at most one event per pad and returns how many
+		uint8_t update(const int *raw, TouchEvent *events);
+
+		int baseline(uint8_t pad) const { return pads[pad].baseline >> 8; }
+		bool touched(uint8_t pad) const { return pads[pad].down; }
+
+		// raw - baseline of the last scan, for every pad
+		void strengths(int *out) const;
+		// the state the events describe: the last reported strength of touched pads, 0 elsewhere
+		void levels(int *out) const;
+
+	private:
+		struct Pad {
+			int32_t baseline;	// 24.8 fixed point
+			int16_t strength;
+			int16_t reported;
+			uint8_t count;		// consecutive scans pointing at the other state
+			uint16_t frozen;	// consecutive scans without a baseline update
+			bool down;
+		};
+
+		TouchConfig config;
+		Pad pads[PLANK_CAPACITIVE_COUNT];
+		uint8_t count;
+};
+
+#endif /* TOUCH_TRACKER_h */
@@ -0,0 +1,409 @@
+#include "SensorHub.h"
+
+SensorHub::SensorHub(HX711MULTI &scales, Stream &link, FlashStore &logPartition, const int *piezoPins, PlankLog &log)
+	: scales(scales), linkUart(link), piezoPins(piezoPins), plankLog(log), observer(NULL), calibrator(NULL), hitMode(true),
+	  capacitiveLink(link),
+	  probes{CycleProbe("readCapacitiveSensors"), CycleProbe("readStrainGauges"), CycleProbe("readPiezo"),
+	         CycleProbe("updateBLEData"), CycleProbe("BLE.poll")},
+	  capacitiveData(), capacitiveTime(0), strainGaugeData(), strainTime(0), piezoData(), piezoReadings(), piezoTime(0),
+	  sensorService("4fafc201-1fb5-459e-8fcc-c5c9c331914b"),
+	  capacitiveChar("beb5483e-36e1-4688-b7f5-ea07361b26a8", BLERead | BLENotify, CAPACITIVE_PACKET_SIZE),
+	  strainChar("cc54f4ce-1037-4b73-9e5a-cdcd53e85145", BLERead | BLENotify, STRAIN_PACKET_SIZE),
+	  piezoChar("beb5483e-36e1-4688-b7f5-ea07361b26a9", BLERead | BLENotify, PIEZO_PACKET_SIZE),
+	  streamChar("beb5483e-36e1-4688-b7f5-ea07361b26aa", BLERead | BLENotify, STREAM_FRAME_MAX),
+	  streamConfigChar("beb5483e-36e1-4688-b7f5-ea07361b26ab", BLEWrite, 4),
+	  hitChar("beb5483e-36e1-4688-b7f5-ea07361b26ac", BLERead | BLENotify, HIT_PACKET_SIZE),
+	  captureChar("beb5483e-36e1-4688-b7f5-ea07361b26ad", BLERead | BLEWrite | BLENotify, STREAM_FRAME_MAX),
+	  recordingChar("beb5483e-36e1-4688-b7f5-ea07361b26ae", BLERead | BLEWrite | BLENotify, STREAM_FRAME_MAX),
+	  diagnosticsChar("beb5483e-36e1-4688-b7f5-ea07361b26af", BLERead | BLEWrite | BLENotify, STREAM_FRAME_MAX),
+	  streamConfigured(false), sessionLog(logPartition), download(sessionLog),
+	  lastStrainTime(0), lastPiezoTime(0), lastChunkTime(0), capturedImpact(0) {
+}
+
+void SensorHub::addService() {
+	BLE.setAdvertisedService(sensorService);
+	sensorService.addCharacteristic(capacitiveChar);
+	sensorService.addCharacteristic(strainChar);
+	sensorService.addCharacteristic(piezoChar);
+	sensorService.addCharacteristic(streamChar);
+	sensorService.addCharacteristic(streamConfigChar);
+	sensorService.addCharacteristic(hitChar);
+	sensorService.addCharacteristic(captureChar);
+	sensorService.addCharacteristic(recordingChar);
+	sensorService.addCharacteristic(diagnosticsChar);
+	BLE.addService(sensorService);
+
+	// Set the UUID of the service to be advertised
+	BLE.setAdvertisedServiceUuid(sensorService.uuid());
+}
+
+void SensorHub::resetProbes() {
+	for (int i = 0; i < PROBE_COUNT; i++) {
+		probes[i].reset();
+	}
+}
+
+// Bytes from the Mega into the link, which ACKs them at once, and in-order frames on to the publish
+// task. When the queue is full the frames wait in the link: its window holds the Mega back.
+void SensorHub::linkPass() {
+	while (linkUart.available()) {
+		capacitiveLink.feed(linkUart.read());
+	}
+	capacitiveLink.poll();
+	LinkFrame frame;
+	while (linkFrames.size() < linkFrames.capacity() && capacitiveLink.read(frame)) {
+		linkFrames.push(frame);
+	}
+}
+
+// Applies the frames received from the Mega: full states and touch events (levels above the baseline,
+// 0 when released). Returns true if a frame arrived, i.e. a notification is due.
+bool SensorHub::readCapacitiveSensors() {
+	PROBE_SCOPE(probes[PROBE_CAPACITIVE]);
+	STAGE_SCOPE(observer, PLANK_STAGE_CAPACITIVE);
+	bool received = false;
+	LinkFrame frame;
+
+	while (linkFrames.pop(frame)) {
+		uint8_t events = frame.type == PLANK_FRAME_TOUCH ? frameTouchEvents(frame.length) : 0;
+		if (events > 0) {
+			for (int i = 0; i < events; i++) {
+				TouchEvent event = frameTouchEvent(frame.payload, i);
+				if (event.pad < PLANK_CAPACITIVE_COUNT) {
+					capacitiveData[event.pad] = event.kind == TOUCH_EVENT_UP ? 0 : event.strength;
+				}
+				if (event.kind == TOUCH_EVENT_DOWN) {
+					PLOG_INFO(LOG_TOUCH_DOWN, event.pad, event.strength);
+				} else if (event.kind == TOUCH_EVENT_UP) {
+					PLOG_INFO(LOG_TOUCH_UP, event.pad, event.strength);
+				} else {
+					PLOG_DEBUG(LOG_TOUCH_STRENGTH, event.pad, event.strength);
+				}
+			}
+		} else if (frame.type == PLANK_FRAME_CAPACITIVE && frame.length == CAPACITIVE_PAYLOAD_SIZE) {
+			for (int i = 0; i < PLANK_CAPACITIVE_COUNT; i++) {
+				capacitiveData[i] = frameCapacitive(frame.payload, i);
+				PLOG_DEBUG(LOG_CAPACITIVE, i, capacitiveData[i]);
+			}
+		} else {
+			continue;
+		}
+		capacitiveTime = frame.time;
+		received = true;
+		if (NULL != observer) {
+			observer->frameApplied(frame);
+		}
+	}
+	return received;
+}
+
+// Takes the newest strain sample, calibrated. Returns false if no conversion came in since the last
+// call: the previous values stand and no notification is due.
+bool SensorHub::readStrainGauges() {
+	PROBE_SCOPE(probes[PROBE_STRAIN]);
+	STAGE_SCOPE(observer, PLANK_STAGE_STRAIN);
+	long results[PLANK_STRAIN_COUNT];
+	unsigned long timestamp;
+	if (!scales.readLatest(results, &timestamp)) {
+		return false;
+	}
+	if (NULL != calibrator) {
+		calibrator->feed(results);
+	}
+
+	memcpy(strainGaugeData, results, sizeof(strainGaugeData));
+	strainTime = timestamp;
+	scales.apply_calibration(strainGaugeData);
+
+	for (int i = 0; i < PLANK_STRAIN_COUNT; i++) {
+		PLOG_DEBUG(LOG_STRAIN, i, results[i], strainGaugeData[i]);
+	}
+	return true;
+}
+
+// Processing stage of the piezo blocks, run by the process task; the ring holds about 128 ms
+void SensorHub::processPiezoBlocks() {
+	PiezoBlockProcessor *const processors[] = {&piezoPeaks, &impacts, &capture};
+	piezoSampler.drain(processors, 3);
+}
+
+void SensorHub::sendHits() {
+	STAGE_SCOPE(observer, PLANK_STAGE_BLE);
+	PiezoHit hit;
+	while (impacts.readHit(hit)) {
+		uint8_t packet[HIT_PACKET_SIZE];
+		hitChar.writeValue(packet, packPiezoHit(packet, hit));
+
+		// the window starts from the first onset of the impact, whichever piezo reports first
+		if (hit.impact != capturedImpact && captureChar.subscribed()) {
+			capture.trigger(hit.time - hit.delay);
+			capturedImpact = hit.impact;
+		}
+		PLOG_INFO(LOG_HIT, hit.channel, hit.impact, hit.time, hit.delay, hit.peak, hit.rise);
+	}
+}
+
+// DMA-sampled piezos report their peak since the previous call (a knock rings for a few ms only),
+// the others one analogRead()
+void SensorHub::readPiezo() {
+	PROBE_SCOPE(probes[PROBE_PIEZO]);
+	STAGE_SCOPE(observer, PLANK_STAGE_PIEZO);
+	int16_t peaks[PIEZO_MAX_CHANNELS];
+	bool fresh = piezoPeaks.take(peaks);
+	piezoTime = micros();
+	for (int i = 0; i < PLANK_PIEZO_COUNT; i++) {
+		int reading;
+		if (piezoSampler.sampled(i)) {
+			if (!fresh) {
+				continue;  // no block finished since the last call, keep the previous value
+			}
+			reading = piezoReading(peaks[i]);
+		} else {
+			reading = analogRead(piezoPins[i]);
+		}
+		piezoReadings[i] = reading;
+		piezoData[i] = mapPiezo(reading);
+		PLOG_DEBUG(LOG_PIEZO, i, reading, piezoData[i]);
+	}
+}
+
+void SensorHub::flushStream() {
+	if (stream.empty()) {
+		return;
+	}
+	size_t size = stream.finish();
+	streamChar.writeValue(stream.data(), size);
+}
+
+// Appends a sample taken at 'time' to the stream frame, sending the frame first if the sample does not fit
+template <typename T>
+void SensorHub::streamSample(uint8_t type, uint32_t time, const T *values) {
+	if (!streamConfigured || !streamChar.subscribed() || !stream.accepts(type)) {
+		return;
+	}
+	if (!stream.addSample(type, time, values)) {
+		flushStream();
+		stream.addSample(type, time, values);
+	}
+}
+
+void SensorHub::handleStreamConfig() {
+	if (!streamConfigChar.written() || streamConfigChar.valueLength() < 3) {
+		return;
+	}
+	const uint8_t *config = streamConfigChar.value();
+	flushStream();
+	stream.setMask(config[0]);
+	stream.setCapacity(config[1] | (config[2] << 8));
+	stream.setPacked(streamConfigChar.valueLength() >= 4 && (config[3] & 1));
+	streamConfigured = true;
+	PLOG_INFO(LOG_STREAM_CONFIG, stream.getCapacity(), stream.isPacked());
+}
+
+// One chunk of a finished capture every CAPTURE_CHUNK_INTERVAL_MS, as large as the receiver takes
+void SensorHub::sendCaptureChunk() {
+	if (millis() - lastChunkTime < CAPTURE_CHUNK_INTERVAL_MS) {
+		return;
+	}
+	STAGE_SCOPE(observer, PLANK_STAGE_BLE);
+	uint8_t chunk[STREAM_FRAME_MAX];
+	size_t size = capture.nextChunk(chunk, chunkCapacity());
+	if (size > 0) {
+		captureChar.writeValue(chunk, size);
+		lastChunkTime = millis();
+	}
+}
+
+void SensorHub::handleCaptureConfig() {
+	if (!captureChar.written() || captureChar.valueLength() < 4) {
+		return;
+	}
+	const uint8_t *config = captureChar.value();
+	capture.setWindow(config[0] | (config[1] << 8), config[2] | (config[3] << 8));
+	PLOG_INFO(LOG_CAPTURE_WINDOW, capture.getPre(), capture.getPost());
+}
+
+// Recording starts when the central goes away and ends when one connects: each absence is a session
+void SensorHub::updateRecording() {
+	if (!sessionLog.mounted()) {
+		return;
+	}
+	STAGE_SCOPE(observer, PLANK_STAGE_RECORD);
+	bool connected = BLE.connected();
+	if (!connected && !sessionLog.recording()) {
+		sessionLog.startSession();
+		PLOG_INFO(LOG_SESSION_START, sessionLog.sessionId());
+	} else if (connected && sessionLog.recording()) {
+		sessionLog.endSession();
+		PLOG_INFO(LOG_SESSION_END, sessionLog.sessionId(), sessionLog.samples());
+	}
+	if (!connected) {
+		download.stop();
+	}
+	if (sessionLog.age(micros()) >= RECORD_FLUSH_US) {
+		sessionLog.flush();
+	}
+}
+
+void SensorHub::handleRecordingCommand() {
+	if (!recordingChar.written() || recordingChar.valueLength() < 1) {
+		return;
+	}
+	const uint8_t *command = recordingChar.value();
+	int length = recordingChar.valueLength();
+	uint8_t chunk[STREAM_FRAME_MAX];
+	switch (command[0]) {
+		case 'L':
+			recordingChar.writeValue(chunk, sessionLog.listSessions(chunk, chunkCapacity(), length >= 2 ? command[1] : 0));
+			break;
+		case 'R':
+			if (length >= 3) {
+				uint16_t id = command[1] | (command[2] << 8);
+				uint32_t from = length >= 7 ? command[3] | (command[4] << 8) | ((uint32_t) command[5] << 16) | ((uint32_t) command[6] << 24) : 0;
+				bool found = download.start(id, from);
+				PLOG_INFO(LOG_SESSION_DOWNLOAD, id, from, found);
+			}
+			break;
+		case 'S':
+			download.stop();
+			break;
+		case 'E':
+			download.stop();
+			sessionLog.erase();
+			break;
+	}
+}
+
+void SensorHub::handleDiagnosticsCommand() {
+	if (!diagnosticsChar.written() || diagnosticsChar.valueLength() < 1) {
+		return;
+	}
+	uint8_t packet[STREAM_FRAME_MAX];
+	size_t capacity = chunkCapacity();
+	switch (diagnosticsChar.value()[0]) {
+		case 'D':
+			for (int i = 0; i < PROBE_COUNT; i++) {
+				if (PROBE_PACKET_SIZE(strlen(probes[i].name())) <= capacity) {
+					diagnosticsChar.writeValue(packet, packCycleProbe(packet, i, probes[i]));
+				}
+			}
+			break;
+		case 'Z':
+			resetProbes();
+			break;
+	}
+}
+
+// A session being downloaded goes out in back-to-back notifications, as large as the receiver takes
+void SensorHub::sendRecordingChunks() {
+	if (!download.active()) {
+		return;
+	}
+	STAGE_SCOPE(observer, PLANK_STAGE_BLE);
+	uint8_t chunk[STREAM_FRAME_MAX];
+	for (int i = 0; i < RECORDING_NOTIFY_BURST && download.active(); i++) {
+		size_t size = download.nextChunk(chunk, chunkCapacity());
+		if (size == 0 || !recordingChar.writeValue(chunk, size)) {
+			break;
+		}
+	}
+}
+
+// the sample goes to the session log while one is recorded
+template <typename T>
+bool SensorHub::record(uint8_t type, uint32_t time, const T *values) {
+	STAGE_SCOPE(observer, PLANK_STAGE_RECORD);
+	return sessionLog.addSample(type, time, values);
+}
+
+// While a session is recorded the samples go to flash and the characteristics are left alone
+void SensorHub::updateBLEData(char sensorType) {
+	PROBE_SCOPE(probes[PROBE_BLE_DATA]);
+	STAGE_SCOPE(observer, PLANK_STAGE_BLE);
+	switch (sensorType) {
+		case 'C':  // Capacitive sensors only
+			if (record(STREAM_RECORD_CAPACITIVE, capacitiveTime, capacitiveData)) {
+				break;
+			}
+			{
+				uint8_t capacitiveDataBytes[CAPACITIVE_PACKET_SIZE];
+				packCapacitive(capacitiveDataBytes, capacitiveData, capacitiveTime);
+				capacitiveChar.writeValue(capacitiveDataBytes, sizeof(capacitiveDataBytes));
+				streamSample(STREAM_RECORD_CAPACITIVE, capacitiveTime, capacitiveData);
+				PLOG_TRACE(LOG_BLE_PACKET, 'C', sizeof(capacitiveDataBytes));
+			}
+			break;
+
+		case 'S':  // Strain Gauges only
+			if (record(STREAM_RECORD_STRAIN, strainTime, strainGaugeData)) {
+				break;
+			}
+			{
+				uint8_t strainGaugeDataBytes[STRAIN_PACKET_SIZE];
+				packStrain(strainGaugeDataBytes, strainGaugeData, strainTime);
+				strainChar.writeValue(strainGaugeDataBytes, sizeof(strainGaugeDataBytes));
+				streamSample(STREAM_RECORD_STRAIN, strainTime, strainGaugeData);
+				PLOG_TRACE(LOG_BLE_PACKET, 'S', sizeof(strainGaugeDataBytes));
+			}
+			break;
+
+		case 'P':  // Piezo sensors
+			if (record(STREAM_RECORD_PIEZO, piezoTime, piezoReadings)) {
+				break;
+			}
+			{
+				uint8_t piezoPacket[PIEZO_PACKET_SIZE];
+				packPiezo(piezoPacket, piezoData, piezoTime);
+				piezoChar.writeValue(piezoPacket, sizeof(piezoPacket));
+				streamSample(STREAM_RECORD_PIEZO, piezoTime, piezoReadings);
+				PLOG_TRACE(LOG_BLE_PACKET, 'P', sizeof(piezoPacket));
+			}
+			break;
+	}
+}
+
+// Everything but acquisition and piezo processing: sensor values to the characteristics, the stream,
+// the session log, BLE
+void SensorHub::publish() {
+	unsigned long currentTime = millis();
+	updateRecording();
+
+	// Capacitive data is sent as soon as the Mega reports a change (or its periodic full state)
+	if (readCapacitiveSensors()) {
+		updateBLEData('C');
+	}
+
+	// Read and send strain gauge data (every HUB_STRAIN_MS), once a new conversion is in: until then the
+	// following passes try again
+	if (currentTime - lastStrainTime >= HUB_STRAIN_MS && readStrainGauges()) {
+		updateBLEData('S');
+		lastStrainTime = currentTime;
+	}
+
+	if (hitMode) {
+		sendHits();
+	} else if (currentTime - lastPiezoTime >= HUB_PIEZO_MS) {
+		// Read and send piezo data (every HUB_PIEZO_MS)
+		readPiezo();
+		updateBLEData('P');
+		lastPiezoTime = currentTime;
+	}
+
+	sendCaptureChunk();
+	handleCaptureConfig();
+
+	handleStreamConfig();
+	if (stream.age(micros()) >= STREAM_MAX_LATENCY_US) {
+		STAGE_SCOPE(observer, PLANK_STAGE_BLE);
+		flushStream();
+	}
+
+	handleRecordingCommand();
+	sendRecordingChunks();
+
+	handleDiagnosticsCommand();
+	{
+		PROBE_SCOPE(probes[PROBE_BLE_POLL]);
+		BLE.poll();
+	}
+}
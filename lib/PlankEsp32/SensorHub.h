@@ -0,0 +1,166 @@
+/*
+  SensorHub.h - what the ESP32 does with the sensor data once it is acquired: the frames from the
+  Mega, the strain samples and the piezo blocks, onto the BLE characteristics and the stream, or into
+  the session log while no central is connected. The firmware (src/dfrobot_firebeetle2_esp32e) runs it
+  from its tasks, the simulation (src/native) from its host scheduler:
+
+    linkPass()            link task      UART bytes from the Mega -> ACKs, in-order frames queued
+    processPiezoBlocks()  process task   piezo blocks -> peaks, hits, captures
+    publish()             publish task   characteristics, stream, session log, BLE.poll()
+
+  Acquisition stays with its owners: the HX711MULTI task, and the PiezoSampler task (sampler()).
+
+  In hit mode every knock is one PiezoHit notification on the hit characteristic and starts a
+  waveform capture while someone listens; otherwise the peak level of every piezo goes out every
+  HUB_PIEZO_MS. The strain sample goes out every HUB_STRAIN_MS.
+*/
+#ifndef SENSOR_HUB_h
+#define SENSOR_HUB_h
+
+#include <Arduino.h>
+#include <ArduinoBLE.h>
+#include <HX711-multi.h>
+#include <SensorPackets.h>
+#include <PlankLink.h>
+#include <SensorStream.h>
+#include <PiezoSampler.h>
+#include <ImpactDetector.h>
+#include <WaveformCapture.h>
+#include <SpscRing.h>
+#include <CycleProbe.h>
+#include <PlankLog.h>
+#include <SessionLog.h>
+#include <FirmwareObserver.h>
+
+#define LINK_FRAME_QUEUE 8				// frames, as many as the link window
+#define HUB_STRAIN_MS 100				// between two strain samples sent
+#define HUB_PIEZO_MS 20					// level mode: between two piezo levels sent
+#define STREAM_MAX_LATENCY_US 100000	// a stream frame that is not full goes out after 100 ms
+#define CAPTURE_CHUNK_INTERVAL_MS 5		// pace of the waveform capture chunks, beside the live notifications
+#define RECORD_FLUSH_US 30000000		// a recorded block not full goes to flash after 30 s: what a reset loses
+#define RECORDING_NOTIFY_BURST 8		// download chunks per publish pass, as many as the BLE stack queues
+
+class SensorHub
+{
+	public:
+		// Cycle costs of the publish task's stages, including what preempts them on core 0: BLE controller
+		// interrupts, flash cache misses. 'D' on the diagnostics characteristic notifies them.
+		enum { PROBE_CAPACITIVE, PROBE_STRAIN, PROBE_PIEZO, PROBE_BLE_DATA, PROBE_BLE_POLL, PROBE_COUNT };
+
+		// scales: their acquisition task feeds readLatest(); link: the UART from the Mega; logPartition: the
+		// flash of the session log; piezoPins: PLANK_PIEZO_COUNT pins in block channel order, the ones the
+		// sampler does not take are read with analogRead(); log: where the PLOG_* of the member functions go
+		SensorHub(HX711MULTI &scales, Stream &link, FlashStore &logPartition, const int *piezoPins,
+				PlankLog &log = ::plankLog);
+
+		void setPiezoHitMode(bool hits) { hitMode = hits; }
+		void setObserver(FirmwareObserver *o) { observer = o; }
+		// gets the tared strain samples the publish pass takes, for the points of a calibration
+		void setCalibrator(HX711Calibrator *c) { calibrator = c; }
+
+		// the service and its characteristics, advertised; after BLE.begin()
+		void addService();
+		// mounts the session log once logPartition is open; false leaves recording off
+		bool beginRecording() { return sessionLog.begin(); }
+
+		void linkPass();
+		void processPiezoBlocks();
+		void publish();
+
+		PiezoSampler &sampler() { return piezoSampler; }
+		LinkReceiver &link() { return capacitiveLink; }
+		const SpscRing<LinkFrame, LINK_FRAME_QUEUE> &frameQueue() const { return linkFrames; }
+		const ImpactDetector &impactDetector() const { return impacts; }
+		const WaveformCapture &waveformCapture() const { return capture; }
+		const SensorStreamWriter &sensorStream() const { return stream; }
+		const SessionLog &sessions() const { return sessionLog; }
+		CycleProbe &probe(uint8_t i) { return probes[i]; }
+		void resetProbes();
+
+		BLECharacteristic &capacitiveCharacteristic() { return capacitiveChar; }
+		BLECharacteristic &strainCharacteristic() { return strainChar; }
+		BLECharacteristic &piezoCharacteristic() { return piezoChar; }
+		BLECharacteristic &streamCharacteristic() { return streamChar; }
+		BLECharacteristic &streamConfigCharacteristic() { return streamConfigChar; }
+		BLECharacteristic &hitCharacteristic() { return hitChar; }
+		BLECharacteristic &captureCharacteristic() { return captureChar; }
+		BLECharacteristic &recordingCharacteristic() { return recordingChar; }
+		BLECharacteristic &diagnosticsCharacteristic() { return diagnosticsChar; }
+
+	private:
+		bool readCapacitiveSensors();
+		bool readStrainGauges();
+		void readPiezo();
+		void sendHits();
+		void flushStream();
+		template <typename T> void streamSample(uint8_t type, uint32_t time, const T *values);
+		void handleStreamConfig();
+		void sendCaptureChunk();
+		void handleCaptureConfig();
+		void updateRecording();
+		void handleRecordingCommand();
+		void handleDiagnosticsCommand();
+		void sendRecordingChunks();
+		void updateBLEData(char sensorType);
+		template <typename T> bool record(uint8_t type, uint32_t time, const T *values);
+		size_t chunkCapacity() const { return streamConfigured ? stream.getCapacity() : STREAM_FRAME_MIN; }
+
+		HX711MULTI &scales;
+		Stream &linkUart;
+		const int *piezoPins;
+		PlankLog &plankLog;		// PLOG_* in the member functions write here
+		FirmwareObserver *observer;
+		HX711Calibrator *calibrator;
+		bool hitMode;
+
+		LinkReceiver capacitiveLink;	// frames from the ATmega2560, ACKed as they arrive
+		SpscRing<LinkFrame, LINK_FRAME_QUEUE> linkFrames;	// in-order frames, link task -> publish task
+		CycleProbe probes[PROBE_COUNT];
+
+		// Sample times, all in this board's micros(): the capacitive scans are converted from the Mega's clock
+		int capacitiveData[PLANK_CAPACITIVE_COUNT];
+		uint32_t capacitiveTime;
+		long strainGaugeData[PLANK_STRAIN_COUNT];	// calibrated units, narrowed by the packers
+		uint32_t strainTime;
+		uint16_t piezoData[PLANK_PIEZO_COUNT];
+		uint16_t piezoReadings[PLANK_PIEZO_COUNT];	// raw, for the stream
+		uint32_t piezoTime;
+		PiezoSampler piezoSampler;	// ADC1 piezos at PIEZO_DEFAULT_RATE through the ADC DMA
+		PiezoPeakHold piezoPeaks;	// highest sample of each piezo between two readPiezo()
+		ImpactDetector impacts;		// knocks, timestamped per piezo
+		WaveformCapture capture;	// waveforms around the first knock of an impact, while someone listens
+
+		BLEService sensorService;
+		BLECharacteristic capacitiveChar;
+		BLECharacteristic strainChar;
+		BLECharacteristic piezoChar;
+		// Batched frames of every sensor (SensorStream.h). The receiver starts the stream by writing its
+		// configuration: sensor mask (u8), the frame size it can take (u16, its negotiated ATT MTU - 3) and
+		// optionally a flags byte, bit 0 asking for DeltaCodec-packed records.
+		BLECharacteristic streamChar;
+		BLECharacteristic streamConfigChar;
+		// One PiezoHit per notification (ImpactDetector.h); hits of one knock share their impact number
+		BLECharacteristic hitChar;
+		// Piezo waveforms around impacts, in chunks (WaveformCapture.h); writing pre (u16) and post (u16),
+		// in samples, sets the window
+		BLECharacteristic captureChar;
+		// Sessions recorded while no central was connected (SessionLog.h). Writing 'L' [first session (u8)]
+		// notifies the list of the sessions, 'R' session (u16) [from block (u32)] sends one at full speed,
+		// 'S' stops sending, 'E' erases the log.
+		BLECharacteristic recordingChar;
+		// Writing 'D' notifies every cycle probe, one per notification (packCycleProbe() in CycleProbe.h, up
+		// to 72 bytes: the receiver's frame size has to take them); 'Z' starts them over
+		BLECharacteristic diagnosticsChar;
+
+		SensorStreamWriter stream;
+		bool streamConfigured;
+		SessionLog sessionLog;
+		SessionDownload download;
+
+		unsigned long lastStrainTime;	// millis() of the publish passes
+		unsigned long lastPiezoTime;
+		unsigned long lastChunkTime;
+		uint16_t capturedImpact;
+};
+
+#endif /* SENSOR_HUB_h */
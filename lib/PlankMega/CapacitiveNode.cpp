@@ -0,0 +1,77 @@
+#include "CapacitiveNode.h"
+
+CapacitiveNode::CapacitiveNode(Stream &uart, PlankLog &log)
+	: uart(uart), plankLog(log), sender(uart), observer(NULL), eventMode(true), scanTime(0), lastSendTime(0) {
+}
+
+bool CapacitiveNode::begin(const int *pins) {
+	return scans.begin(pins, PLANK_CAPACITIVE_COUNT, CAPACITIVE_SAMPLES);
+}
+
+bool CapacitiveNode::takeBaseline() {
+	if (!scans.read(raw, &scanTime)) {
+		return false;
+	}
+	touches.reset(raw);
+	return true;
+}
+
+// ACKs, and immediate answers to the ESP32's time requests; then retransmissions
+void CapacitiveNode::serviceLink() {
+	STAGE_SCOPE(observer, PLANK_STAGE_LINK);
+	while (uart.available()) {
+		sender.feed(uart.read());
+	}
+	sender.poll();
+}
+
+// Traces as PlankLog records (test/PlankLog.py turns them back into text), compiled only with
+// PLANK_LOG_LEVEL >= PLANK_LOG_DEBUG
+void CapacitiveNode::sendEvents(uint8_t count) {
+	for (uint8_t i = 0; i < count; ++i) {
+		PLOG_DEBUG(LOG_SEND_EVENT, events[i].kind, events[i].pad, events[i].strength);
+	}
+	STAGE_SCOPE(observer, PLANK_STAGE_SEND);
+	sender.send(encodeTouchFrame(sender.frameBuffer(), sender.sequence(), scanTime, events, count));
+}
+
+void CapacitiveNode::sendData() {
+	for (int i = 0; i < PLANK_CAPACITIVE_COUNT; ++i) {
+		PLOG_DEBUG(LOG_SEND_DATA, i, values[i]);
+	}
+	STAGE_SCOPE(observer, PLANK_STAGE_SEND);
+	sender.send(encodeCapacitiveFrame(sender.frameBuffer(), sender.sequence(), scanTime, values));
+}
+
+void CapacitiveNode::loop() {
+	unsigned long currentTime = millis();
+
+	serviceLink();
+
+	// every completed scan goes through the tracker; none is taken while the window is full
+	if (!sender.canSend() || !scans.read(raw, &scanTime)) {
+		return;
+	}
+	if (NULL != observer) {
+		observer->scanned(scanTime, raw);
+	}
+	uint8_t count;
+	{
+		STAGE_SCOPE(observer, PLANK_STAGE_TOUCH);
+		count = touches.update(raw, events);
+	}
+	if (eventMode) {
+		if (count > 0) {
+			sendEvents(count);
+			lastSendTime = currentTime;
+		} else if (currentTime - lastSendTime >= CAPACITIVE_KEEPALIVE_MS) {
+			touches.levels(values);
+			sendData();
+			lastSendTime = currentTime;
+		}
+	} else if (currentTime - lastSendTime >= CAPACITIVE_SEND_MS) {
+		touches.strengths(values);
+		sendData();
+		lastSendTime = currentTime;
+	}
+}
@@ -0,0 +1,80 @@
+/*
+  CapacitiveNode.h - what the ATmega2560 does: capacitive scans from the ADC interrupt, through the
+  TouchTracker, as frames on the link to the ESP32. The firmware (src/megaatmega2560) and the
+  simulation (src/native) both run it, from loop() and from the host scheduler.
+
+  In event mode only presses, releases and strength changes are sent, from the scan that found them,
+  and the full state every CAPACITIVE_KEEPALIVE_MS; otherwise all the strengths every
+  CAPACITIVE_SEND_MS. No scan is taken while the link window is full.
+*/
+#ifndef CAPACITIVE_NODE_h
+#define CAPACITIVE_NODE_h
+
+#include <Arduino.h>
+#include <ADCTouchScanner.h>
+#include <FirmwareObserver.h>
+#include <PlankLink.h>
+#include <PlankLog.h>
+#include <TouchTracker.h>
+
+#define CAPACITIVE_SEND_MS 100			// stream mode: between two full states
+#define CAPACITIVE_KEEPALIVE_MS 2000	// event mode: a full state at least this often
+
+// ADCTouch samples averaged per pad and scan: scan rate against noise. A sample is two conversions of
+// 104 us (ADC clock 125 kHz), so a scan of the 16 pads takes 16 x CAPACITIVE_SAMPLES x 208 us:
+//     samples   scan      scans/s   noise, relative to one sample
+//       100     333 ms       3         0.10   ADCTouch.read()'s default, 3x over the 100 ms send interval
+//        32     107 ms       9         0.18
+//        16      53 ms      18         0.25   (17.5 scans/s measured in the simulation)
+// The averaged noise is the noise of one sample over sqrt(samples): 16 samples are 2.5 times noisier
+// than 100. TOUCH_DEFAULT_CONFIG (TouchTracker.h) takes it to stay well below its 15-count release
+// threshold, which so far only the simulation confirms; its pad model has no realistic sample noise.
+// The Mega prints every pad's rest noise at this setting at startup: check it on the board, and
+// raise CAPACITIVE_SAMPLES (build_flags) or the thresholds if it comes near the release threshold.
+#ifndef CAPACITIVE_SAMPLES
+#define CAPACITIVE_SAMPLES 16
+#endif
+
+class CapacitiveNode
+{
+	public:
+		// uart: the line to the ESP32; log: where the PLOG_* of the member functions go
+		CapacitiveNode(Stream &uart, PlankLog &log = ::plankLog);
+
+		void setEventMode(bool events) { eventMode = events; }
+		void setObserver(FirmwareObserver *o) { observer = o; }
+
+		// starts the scanner on PLANK_CAPACITIVE_COUNT pins; from here on the ADC belongs to it
+		bool begin(const int *pins);
+		// resets the baselines from the first scan completed with the plank at rest; false until there is one
+		bool takeBaseline();
+
+		// one pass of loop(): the link, then the newest scan if the link takes a frame
+		void loop();
+
+		ADCTouchScanner &scanner() { return scans; }
+		const TouchTracker &tracker() const { return touches; }
+		const LinkSender &link() const { return sender; }
+		const int *lastScan() const { return raw; }
+
+	private:
+		void serviceLink();
+		void sendEvents(uint8_t count);
+		void sendData();
+
+		Stream &uart;
+		PlankLog &plankLog;		// PLOG_* in the member functions write here
+		LinkSender sender;
+		ADCTouchScanner scans;
+		TouchTracker touches;
+		FirmwareObserver *observer;
+		bool eventMode;
+
+		int raw[PLANK_CAPACITIVE_COUNT];		// the last scan
+		unsigned long scanTime;					// micros() halfway through it, converted by the ESP32
+		int values[PLANK_CAPACITIVE_COUNT];		// sent to the ESP32, above each pad's baseline
+		TouchEvent events[PLANK_CAPACITIVE_COUNT];
+		unsigned long lastSendTime;				// millis()
+};
+
+#endif /* CAPACITIVE_NODE_h */
@@ -0,0 +1,150 @@
+#include <Arduino.h>
+#include <NotificationLog.h>
+#include <PlankBytes.h>
+#include <stdlib.h>
+
+static bool validHeader(const uint8_t *header) {
+	return memcmp(header, NOTIFICATION_LOG_MAGIC, 4) == 0 && header[4] == NOTIFICATION_LOG_VERSION;
+}
+
+int parseNotification(const uint8_t *in, size_t available, Notification &n) {
+	if (available < NOTIFICATION_RECORD_HEADER_SIZE) {
+		return 0;
+	}
+	n.time = in[0] | (in[1] << 8) | ((uint32_t) in[2] << 16) | ((uint32_t) in[3] << 24);
+	n.channel = in[4];
+	n.length = in[6] | (in[7] << 8);
+	n.value = &in[NOTIFICATION_RECORD_HEADER_SIZE];
+	if (n.length > NOTIFICATION_MAX_VALUE) {
+		return -1;
+	}
+	size_t size = NOTIFICATION_RECORD_HEADER_SIZE + n.length;
+	return available < size ? 0 : (int) size;
+}
+
+NotificationLogReader::NotificationLogReader() {
+	file = NULL;
+	buffer = NULL;
+	start = 0;
+	end = 0;
+	bad = false;
+}
+
+NotificationLogReader::~NotificationLogReader() {
+	close();
+}
+
+bool NotificationLogReader::open(const char *path) {
+	close();
+	file = strcmp(path, "-") == 0 ? stdin : fopen(path, "rb");
+	buffer = (uint8_t *) malloc(NOTIFICATION_LOG_BUFFER);
+	if (file == NULL || buffer == NULL || !fill(NOTIFICATION_LOG_HEADER_SIZE) || !validHeader(buffer)) {
+		close();
+		return false;
+	}
+	start = NOTIFICATION_LOG_HEADER_SIZE;
+	return true;
+}
+
+void NotificationLogReader::close() {
+	if (file != NULL && file != stdin) {
+		fclose(file);
+	}
+	file = NULL;
+	free(buffer);
+	buffer = NULL;
+	start = 0;
+	end = 0;
+	bad = false;
+}
+
+// at least 'wanted' bytes from start on in the buffer, moving what is left of it to the front first
+bool NotificationLogReader::fill(size_t wanted) {
+	if (start > 0) {
+		memmove(buffer, &buffer[start], end - start);
+		end -= start;
+		start = 0;
+	}
+	while (end < wanted) {
+		size_t n = fread(&buffer[end], 1, NOTIFICATION_LOG_BUFFER - end, file);
+		if (n == 0) {
+			return false;
+		}
+		end += n;
+	}
+	return true;
+}
+
+bool NotificationLogReader::next(Notification &n) {
+	if (file == NULL) {
+		return false;
+	}
+	int size = parseNotification(&buffer[start], end - start, n);
+	if (size == 0) {
+		size_t wanted = end - start >= NOTIFICATION_RECORD_HEADER_SIZE ? NOTIFICATION_RECORD_HEADER_SIZE + n.length : NOTIFICATION_RECORD_HEADER_SIZE;
+		if (!fill(wanted)) {
+			bad = end > start;
+			return false;
+		}
+		size = parseNotification(&buffer[start], end - start, n);
+	}
+	if (size <= 0) {
+		bad = true;
+		return false;
+	}
+	start += size;
+	return true;
+}
+
+MemoryNotificationSource::MemoryNotificationSource(const uint8_t *log, size_t size) : log(log), size(size) {
+	offset = NOTIFICATION_LOG_HEADER_SIZE;
+	ok = size >= NOTIFICATION_LOG_HEADER_SIZE && validHeader(log);
+}
+
+bool MemoryNotificationSource::next(Notification &n) {
+	if (!ok) {
+		return false;
+	}
+	int record = parseNotification(&log[offset], size - offset, n);
+	if (record <= 0) {
+		return false;
+	}
+	offset += record;
+	return true;
+}
+
+bool NotificationLogWriter::open(const char *path) {
+	close();
+	file = fopen(path, "wb");
+	if (file == NULL) {
+		return false;
+	}
+	uint8_t header[NOTIFICATION_LOG_HEADER_SIZE] = {0};
+	memcpy(header, NOTIFICATION_LOG_MAGIC, 4);
+	header[4] = NOTIFICATION_LOG_VERSION;
+	records = 0;
+	return fwrite(header, 1, sizeof(header), file) == sizeof(header);
+}
+
+void NotificationLogWriter::close() {
+	if (file != NULL) {
+		fclose(file);
+		file = NULL;
+	}
+}
+
+bool NotificationLogWriter::write(uint32_t time, uint8_t channel, const uint8_t *value, uint16_t length) {
+	if (file == NULL || length > NOTIFICATION_MAX_VALUE) {
+		return false;
+	}
+	uint8_t header[NOTIFICATION_RECORD_HEADER_SIZE];
+	put32(&header[0], time);
+	header[4] = channel;
+	header[5] = 0;
+	put16(&header[6], length);
+	if (fwrite(header, 1, sizeof(header), file) != sizeof(header) || fwrite(value, 1, length, file) != length) {
+		return false;
+	}
+	++records;
+	return true;
+}
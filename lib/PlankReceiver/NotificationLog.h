@@ -0,0 +1,119 @@
+/*
+  NotificationLog.h - BLE notifications as they reached a receiver, recorded to a byte log and read
+  back, so that decoding can be replayed and measured offline.
+
+    file header: "PKNL" | version (u8) | 3 bytes reserved
+    record:      receive time (u32, us) | channel (u8) | reserved (u8) | length (u16) | value
+
+  Little endian. The channel tells which characteristic notified, one of the PLANK_CHANNEL_*
+  letters. test/BluetoothPlank.py --log writes one from a live plank, the simulation from its
+  characteristics.
+
+  A NotificationSource hands out the notifications one by one, pointing into its own buffer: the value
+  stays valid until the next call, nothing is copied. NotificationLogReader reads a file (or stdin)
+  in large chunks; MemoryNotificationSource walks a log already in memory, for benchmarks.
+*/
+#ifndef NOTIFICATION_LOG_h
+#define NOTIFICATION_LOG_h
+
+#include <Arduino.h>
+#include <stdio.h>
+
+#define NOTIFICATION_LOG_MAGIC "PKNL"
+#define NOTIFICATION_LOG_VERSION 1
+#define NOTIFICATION_LOG_HEADER_SIZE 8
+#define NOTIFICATION_RECORD_HEADER_SIZE 8
+#define NOTIFICATION_MAX_VALUE 512		// the largest attribute value ATT allows
+#ifndef NOTIFICATION_LOG_BUFFER
+#define NOTIFICATION_LOG_BUFFER 65536
+#endif
+
+// characteristics of the plank service
+#define PLANK_CHANNEL_CAPACITIVE 'C'
+#define PLANK_CHANNEL_STRAIN 'S'
+#define PLANK_CHANNEL_PIEZO 'P'
+#define PLANK_CHANNEL_STREAM 'F'
+#define PLANK_CHANNEL_HIT 'H'
+#define PLANK_CHANNEL_CAPTURE 'W'
+#define PLANK_CHANNEL_RECORDING 'R'
+
+struct Notification {
+	uint32_t time;		// us, when the receiver got it
+	uint8_t channel;
+	uint16_t length;
+	const uint8_t *value;
+};
+
+class NotificationSource
+{
+	public:
+		virtual ~NotificationSource() {}
+
+		// false at the end of the log, or on a record that cannot be one
+		virtual bool next(Notification &n) = 0;
+};
+
+class NotificationLogReader : public NotificationSource
+{
+	public:
+		NotificationLogReader();
+		~NotificationLogReader();
+
+		// "-" reads stdin; false if the file cannot be opened or is not a notification log
+		bool open(const char *path);
+		void close();
+
+		bool next(Notification &n);
+
+		bool corrupt() const { return bad; }	// the log ended on a record that cannot be one
+
+	private:
+		bool fill(size_t wanted);
+
+		FILE *file;
+		uint8_t *buffer;
+		size_t start;		// of the next record in buffer
+		size_t end;			// of the bytes read
+		bool bad;
+};
+
+class MemoryNotificationSource : public NotificationSource
+{
+	public:
+		// a whole log, file header included; it must outlive the source
+		MemoryNotificationSource(const uint8_t *log, size_t size);
+
+		bool next(Notification &n);
+		bool valid() const { return ok; }	// the header is a notification log's
+		void rewind() { offset = NOTIFICATION_LOG_HEADER_SIZE; }
+
+	private:
+		const uint8_t *log;
+		size_t size;
+		size_t offset;
+		bool ok;
+};
+
+class NotificationLogWriter
+{
+	public:
+		NotificationLogWriter() : file(NULL), records(0) {}
+		~NotificationLogWriter() { close(); }
+
+		bool open(const char *path);
+		void close();
+		bool isOpen() const { return file != NULL; }
+
+		bool write(uint32_t time, uint8_t channel, const uint8_t *value, uint16_t length);
+		uint32_t written() const { return records; }
+
+	private:
+		FILE *file;
+		uint32_t records;
+};
+
+// the record header and value at 'in', if the size 'available' holds them: the length of the whole
+// record, 0 if it is cut short, -1 if it cannot be a record
+int parseNotification(const uint8_t *in, size_t available, Notification &n);
+
+#endif /* NOTIFICATION_LOG_h */
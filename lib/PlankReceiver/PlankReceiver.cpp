@@ -0,0 +1,159 @@
+#include <Arduino.h>
+#include <PlankReceiver.h>
+#include <PlankBytes.h>
+
+PlankDecoder::PlankDecoder() {
+	reset();
+}
+
+void PlankDecoder::reset() {
+	memset(&counters, 0, sizeof(counters));
+	streamStarted = false;
+	streamNext = 0;
+	captureStarted = false;
+	capture = 0;
+	captureNext = 0;
+	sessionStarted = false;
+	session = 0;
+	sessionNext = 0;
+}
+
+bool PlankDecoder::decode(const Notification &n, PlankHandler &handler) {
+	++counters.notifications;
+	counters.bytes += n.length;
+	const uint8_t *v = n.value;
+	bool ok = false;
+	switch (n.channel) {
+		case PLANK_CHANNEL_CAPACITIVE:
+			ok = n.length == CAPACITIVE_PACKET_SIZE && v[0] == '<' && v[CAPACITIVE_PACKET_SIZE - 1] == '>';
+			if (ok) {
+				CapacitivePacket packet = {PacketSpan<int16_t>(&v[1], PLANK_CAPACITIVE_COUNT), get32(&v[1 + PLANK_CAPACITIVE_COUNT * 2])};
+				handler.onCapacitive(n, packet);
+			}
+			break;
+		case PLANK_CHANNEL_STRAIN:
+			ok = n.length == STRAIN_PACKET_SIZE && v[0] == '(' && v[STRAIN_PACKET_SIZE - 1] == ')';
+			if (ok) {
+				StrainPacket packet = {PacketSpan<uint8_t>(&v[1], PLANK_STRAIN_COUNT), get32(&v[1 + PLANK_STRAIN_COUNT])};
+				handler.onStrain(n, packet);
+			}
+			break;
+		case PLANK_CHANNEL_PIEZO:
+			ok = n.length == PIEZO_PACKET_SIZE && v[0] == '-' && v[1] == '>' && v[PIEZO_PACKET_SIZE - 2] == '<' && v[PIEZO_PACKET_SIZE - 1] == '-';
+			if (ok) {
+				PiezoPacket packet = {PacketSpan<uint16_t, true>(&v[2], PLANK_PIEZO_COUNT), get32(&v[2 + PLANK_PIEZO_COUNT * 2])};
+				handler.onPiezo(n, packet);
+			}
+			break;
+		case PLANK_CHANNEL_STREAM:
+			ok = decodeStream(n, handler);
+			break;
+		case PLANK_CHANNEL_HIT:
+			ok = n.length == HIT_PACKET_SIZE;
+			if (ok) {
+				handler.onHit(n, unpackPiezoHit(v));
+			}
+			break;
+		case PLANK_CHANNEL_CAPTURE:
+			ok = decodeCapture(n, handler);
+			break;
+		case PLANK_CHANNEL_RECORDING:
+			ok = decodeSession(n, handler);
+			break;
+		default:
+			++counters.unknown;
+			return false;
+	}
+	if (ok) {
+		++counters.decoded;
+	} else {
+		++counters.badPackets;
+	}
+	return ok;
+}
+
+uint32_t PlankDecoder::run(NotificationSource &source, PlankHandler &handler) {
+	uint32_t count = 0;
+	Notification n;
+	while (source.next(n)) {
+		decode(n, handler);
+		++count;
+	}
+	return count;
+}
+
+bool PlankDecoder::decodeStream(const Notification &n, PlankHandler &handler) {
+	if (!reader.begin(n.value, n.length)) {
+		return false;
+	}
+	if (streamStarted && reader.sequence() != streamNext) {
+		counters.streamLost += (uint16_t) (reader.sequence() - streamNext);
+	}
+	streamStarted = true;
+	streamNext = reader.sequence() + 1;
+	++counters.streamFrames;
+	handler.onStreamFrame(n, reader);
+	return true;
+}
+
+bool PlankDecoder::decodeCapture(const Notification &n, PlankHandler &handler) {
+	if (n.length < CAPTURE_CHUNK_HEADER_SIZE) {
+		return false;
+	}
+	const uint8_t *v = n.value;
+	CaptureChunk chunk = CaptureChunk();
+	chunk.capture = v[0];
+	chunk.index = get16(&v[1]);
+	const uint8_t *body = &v[CAPTURE_CHUNK_HEADER_SIZE];
+	size_t size = n.length - CAPTURE_CHUNK_HEADER_SIZE;
+	if (chunk.index == 0) {
+		if (size < CAPTURE_DESCRIPTOR_SIZE) {
+			return false;
+		}
+		chunk.time = get32(&body[0]);
+		chunk.rate = get32(&body[4]);
+		chunk.channels = body[8];
+		chunk.active = body[9];
+		chunk.pre = get16(&body[10]);
+		chunk.samples = get16(&body[12]);
+	} else {
+		if (size % 2 != 0) {
+			return false;
+		}
+		if (!captureStarted || chunk.capture != capture || chunk.index != captureNext) {
+			++counters.captureChunksLost;
+		}
+		chunk.data = PacketSpan<int16_t>(body, size / 2);
+	}
+	captureStarted = true;
+	capture = chunk.capture;
+	captureNext = chunk.index + 1;
+	handler.onCaptureChunk(n, chunk);
+	return true;
+}
+
+// the 'D' chunks of a session download; the list and end chunks are left to the caller
+bool PlankDecoder::decodeSession(const Notification &n, PlankHandler &handler) {
+	const uint8_t *v = n.value;
+	if (n.length < 1 || v[0] != 'D') {
+		return n.length >= 1 && (v[0] == 'L' || v[0] == 'F');
+	}
+	if (n.length < SESSION_CHUNK_HEADER_SIZE) {
+		return false;
+	}
+	SessionChunk chunk;
+	chunk.session = get16(&v[1]);
+	chunk.block = get32(&v[3]);
+	chunk.offset = get16(&v[7]);
+	chunk.data = PacketSpan<uint8_t>(&v[SESSION_CHUNK_HEADER_SIZE], n.length - SESSION_CHUNK_HEADER_SIZE);
+	if (chunk.offset == 0) {
+		if (sessionStarted && chunk.session == session && chunk.block != sessionNext) {
+			counters.sessionBlocksLost += chunk.block - sessionNext;
+		}
+		sessionStarted = true;
+		session = chunk.session;
+		sessionNext = chunk.block + 1;
+	}
+	handler.onSessionChunk(n, chunk);
+	return true;
+}
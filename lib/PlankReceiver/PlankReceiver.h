@@ -0,0 +1,143 @@
+/*
+  PlankReceiver.h - host side decoding of the plank's notifications, in place.
+
+  PlankDecoder checks each notification of a NotificationSource (NotificationLog.h): the markers and
+  size of the sensor packets (SensorPackets.h), the header and records of the stream frames
+  (SensorStream.h) and the order of the stream frames, capture chunks and session blocks. It hands
+  what it finds to a PlankHandler as views over the notification's own bytes: a PacketSpan reads its
+  values out of the packet on access, in the byte order of the packet, and nothing is copied. The
+  views live as long as the notification, until the source's next().
+
+  Stream frames reach the handler as a SensorStreamReader over the frame: it walks the records in
+  place and unpacks the DeltaCodec-packed ones on request.
+*/
+#ifndef PLANK_RECEIVER_h
+#define PLANK_RECEIVER_h
+
+#include <Arduino.h>
+#include <SensorPackets.h>
+#include <SensorStream.h>
+#include <ImpactDetector.h>
+#include <WaveformCapture.h>
+#include <SessionLog.h>
+#include "NotificationLog.h"
+
+// 'count' values of T packed at 'data', little endian unless BigEndian
+template <typename T, bool BigEndian = false>
+class PacketSpan
+{
+	public:
+		PacketSpan() : bytes(NULL), count(0) {}
+		PacketSpan(const uint8_t *data, size_t count) : bytes(data), count(count) {}
+
+		size_t size() const { return count; }
+		const uint8_t *data() const { return bytes; }
+
+		T operator[](size_t i) const {
+			const uint8_t *p = &bytes[i * sizeof(T)];
+			uint32_t v = 0;
+			for (size_t b = 0; b < sizeof(T); b++) {
+				v |= (uint32_t) p[BigEndian ? sizeof(T) - 1 - b : b] << (8 * b);
+			}
+			return (T) v;
+		}
+
+	private:
+		const uint8_t *bytes;
+		size_t count;
+};
+
+struct CapacitivePacket {
+	PacketSpan<int16_t> values;		// levels above the baseline, PLANK_CAPACITIVE_COUNT
+	uint32_t time;					// us, ESP32 clock
+};
+
+struct StrainPacket {
+	PacketSpan<uint8_t> values;		// 0..STRAIN_PACKET_FULL_SCALE onto 0..255
+	uint32_t time;
+};
+
+struct PiezoPacket {
+	PacketSpan<uint16_t, true> values;	// mapPiezo() levels
+	uint32_t time;
+};
+
+struct CaptureChunk {
+	uint8_t capture;
+	uint16_t index;
+	// chunk 0 describes the capture, the next ones carry samples
+	uint32_t time;
+	uint32_t rate;
+	uint8_t channels;
+	uint8_t active;
+	uint16_t pre;
+	uint16_t samples;
+	PacketSpan<int16_t> data;		// mV, channel after channel across the chunks
+};
+
+struct SessionChunk {
+	uint16_t session;
+	uint32_t block;		// sequence
+	uint16_t offset;	// in the block
+	PacketSpan<uint8_t> data;
+};
+
+// what the decoder found; override the ones of interest
+class PlankHandler
+{
+	public:
+		virtual ~PlankHandler() {}
+
+		virtual void onCapacitive(const Notification &, const CapacitivePacket &) {}
+		virtual void onStrain(const Notification &, const StrainPacket &) {}
+		virtual void onPiezo(const Notification &, const PiezoPacket &) {}
+		// a checked frame, its records not walked yet
+		virtual void onStreamFrame(const Notification &, SensorStreamReader &) {}
+		virtual void onHit(const Notification &, const PiezoHit &) {}
+		virtual void onCaptureChunk(const Notification &, const CaptureChunk &) {}
+		virtual void onSessionChunk(const Notification &, const SessionChunk &) {}
+};
+
+struct PlankReceiverStats {
+	uint32_t notifications;
+	uint64_t bytes;
+	uint32_t decoded;
+	uint32_t badPackets;		// wrong size or markers, corrupt frames
+	uint32_t unknown;			// channels or chunk kinds this build does not decode
+	uint32_t streamFrames;
+	uint32_t streamLost;		// frames missing from the sequence
+	uint32_t captureChunksLost;
+	uint32_t sessionBlocksLost;
+};
+
+class PlankDecoder
+{
+	public:
+		PlankDecoder();
+		void reset();
+
+		// false when the notification is not a valid one of its channel
+		bool decode(const Notification &n, PlankHandler &handler);
+		// every notification of the source; returns how many
+		uint32_t run(NotificationSource &source, PlankHandler &handler);
+
+		const PlankReceiverStats &stats() const { return counters; }
+
+	private:
+		bool decodeStream(const Notification &n, PlankHandler &handler);
+		bool decodeCapture(const Notification &n, PlankHandler &handler);
+		bool decodeSession(const Notification &n, PlankHandler &handler);
+
+		PlankReceiverStats counters;
+		SensorStreamReader reader;
+		bool streamStarted;
+		uint16_t streamNext;
+		bool captureStarted;
+		uint8_t capture;
+		uint16_t captureNext;
+		bool sessionStarted;
+		uint16_t session;
+		uint32_t sessionNext;	// block
+};
+
+#endif /* PLANK_RECEIVER_h */
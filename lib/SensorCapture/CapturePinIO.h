@@ -0,0 +1,125 @@
+/*
+  CapturePinIO.h - HX711 pin backends that record the conversions HX711MULTI clocks out, and play
+  them back to it.
+
+  HX711CapturePinIO sits in front of the real backend and records a CAPTURE_HX711 record on the 24th
+  data bit of every conversion, tare readings included, so that a replay takes the same path through
+  read()/tare()/poll() as the firmware did. HX711ReplayPinIO is the chips of such a replay: ready
+  whenever its supply has a conversion for it, then shifting it out edge by edge.
+*/
+#ifndef CAPTURE_PINIO_h
+#define CAPTURE_PINIO_h
+
+#include <Arduino.h>
+#include <HX711-multi.h>
+#include <functional>
+#include "SensorCapture.h"
+
+class HX711CapturePinIO : public HX711PinIO
+{
+	private:
+		HX711PinIO &pins;
+		SensorCaptureWriter &out;
+		byte COUNT;
+		bool clock;
+		uint8_t bits;		// data bits latched of the conversion being clocked out
+		uint32_t lines[24];
+
+	public:
+		HX711CapturePinIO(HX711PinIO &pins, SensorCaptureWriter &out) : pins(pins), out(out), COUNT(0), clock(false), bits(0) {}
+
+		void begin(byte pd_sck, const byte *dout, byte count) {
+			COUNT = count > HX711_MAX_CHANNELS ? HX711_MAX_CHANNELS : count;
+			pins.begin(pd_sck, dout, count);
+		}
+
+		void writeClock(bool high) {
+			clock = high;
+			pins.writeClock(high);
+		}
+
+		uint32_t readDataLines() {
+			uint32_t levels = pins.readDataLines();
+			if (!clock) {
+				bits = 0;	// a ready check: the next edges start a conversion
+			} else if (bits < 24) {
+				lines[bits++] = levels;
+				if (bits == 24) {
+					record(lines);
+				}
+			}
+			return levels;
+		}
+
+		// a backend that clocks whole readouts itself is recorded per readout
+		bool clockOut(uint32_t *levels, byte pulses) {
+			if (!pins.clockOut(levels, pulses)) {
+				return false;
+			}
+			record(levels);
+			return true;
+		}
+
+	private:
+		void record(const uint32_t *levels) {
+			long words[HX711_MAX_CHANNELS];
+			uint8_t payload[HX711_MAX_CHANNELS * 4];
+			HX711MULTI::deinterleave(levels, COUNT, words);
+			for (int j = 0; j < COUNT; ++j) {
+				uint32_t w = (uint32_t) words[j];
+				payload[4 * j] = w & 0xFF;
+				payload[4 * j + 1] = (w >> 8) & 0xFF;
+				payload[4 * j + 2] = (w >> 16) & 0xFF;
+				payload[4 * j + 3] = w >> 24;
+			}
+			out.write(micros(), CAPTURE_HX711, 0, payload, COUNT * 4);
+		}
+};
+
+class HX711ReplayPinIO : public HX711PinIO
+{
+	public:
+		// fills one word per chip with the next conversion; false once there is none
+		typedef std::function<bool(long *words)> Supply;
+
+	private:
+		Supply supply;
+		byte COUNT;
+		bool clock;
+		bool loaded;		// a conversion waits to be clocked out
+		uint8_t edges;		// rising edges since it was loaded
+		long words[HX711_MAX_CHANNELS];
+
+	public:
+		HX711ReplayPinIO(Supply supply) : supply(supply), COUNT(0), clock(false), loaded(false), edges(0) {}
+
+		void begin(byte, const byte *, byte count) {
+			COUNT = count > HX711_MAX_CHANNELS ? HX711_MAX_CHANNELS : count;
+		}
+
+		void writeClock(bool high) {
+			if (high && !clock) {
+				++edges;
+			}
+			clock = high;
+		}
+
+		uint32_t readDataLines() {
+			if (!clock) {
+				if (!loaded || edges >= 24) {
+					loaded = supply(words);
+					edges = 0;
+				}
+				return loaded ? 0 : (1UL << COUNT) - 1;
+			}
+			uint32_t levels = 0;
+			if (loaded && edges >= 1 && edges <= 24) {
+				for (int j = 0; j < COUNT; ++j) {
+					levels |= (uint32_t) ((words[j] >> (24 - edges)) & 1) << j;
+				}
+			}
+			return levels;
+		}
+};
+
+#endif /* CAPTURE_PINIO_h */
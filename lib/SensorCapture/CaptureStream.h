@@ -0,0 +1,55 @@
+/*
+  CaptureStream.h - a serial port that records the bytes read from it as CAPTURE_UART records, one
+  per reading pass: a pass reads while available() says there is more, and the available() that
+  says there is none closes its record. Writes go straight through.
+*/
+#ifndef CAPTURE_STREAM_h
+#define CAPTURE_STREAM_h
+
+#include <Arduino.h>
+#include "SensorCapture.h"
+
+class CaptureStream : public Stream
+{
+	private:
+		Stream &port;
+		SensorCaptureWriter &out;
+		uint8_t bytes[256];
+		uint16_t count;
+
+		void record() {
+			if (count > 0) {
+				out.write(micros(), CAPTURE_UART, 0, bytes, count);
+				count = 0;
+			}
+		}
+
+	public:
+		CaptureStream(Stream &port, SensorCaptureWriter &out) : port(port), out(out), count(0) {}
+
+		int available() {
+			int n = port.available();
+			if (n == 0) {
+				record();
+			}
+			return n;
+		}
+
+		int read() {
+			int c = port.read();
+			if (c >= 0) {
+				bytes[count++] = c;
+				if (count == sizeof(bytes)) {
+					record();
+				}
+			}
+			return c;
+		}
+
+		int peek() { return port.peek(); }
+
+		using Print::write;
+		size_t write(uint8_t c) { return port.write(c); }
+};
+
+#endif /* CAPTURE_STREAM_h */
@@ -0,0 +1,137 @@
+#include <Arduino.h>
+#include <SensorCapture.h>
+#include <PlankBytes.h>
+#include <stdlib.h>
+
+int parseCaptureRecord(const uint8_t *in, size_t available, CaptureRecord &record) {
+	if (available < CAPTURE_RECORD_HEADER_SIZE) {
+		return 0;
+	}
+	record.time = in[0] | (in[1] << 8) | ((uint32_t) in[2] << 16) | ((uint32_t) in[3] << 24);
+	record.source = in[4];
+	record.flags = in[5];
+	record.length = in[6] | (in[7] << 8);
+	record.payload = &in[CAPTURE_RECORD_HEADER_SIZE];
+	if (record.length > CAPTURE_MAX_PAYLOAD) {
+		return -1;
+	}
+	size_t size = CAPTURE_RECORD_HEADER_SIZE + record.length;
+	return available < size ? 0 : (int) size;
+}
+
+SensorCaptureReader::SensorCaptureReader() {
+	file = NULL;
+	buffer = NULL;
+	start = 0;
+	end = 0;
+	bad = false;
+}
+
+SensorCaptureReader::~SensorCaptureReader() {
+	close();
+}
+
+bool SensorCaptureReader::open(const char *path) {
+	close();
+	file = strcmp(path, "-") == 0 ? stdin : fopen(path, "rb");
+	buffer = (uint8_t *) malloc(SENSOR_CAPTURE_BUFFER);
+	if (file == NULL || buffer == NULL || !fill(SENSOR_CAPTURE_HEADER_SIZE)
+			|| memcmp(buffer, SENSOR_CAPTURE_MAGIC, 4) != 0 || buffer[4] != SENSOR_CAPTURE_VERSION) {
+		close();
+		return false;
+	}
+	start = SENSOR_CAPTURE_HEADER_SIZE;
+	return true;
+}
+
+void SensorCaptureReader::close() {
+	if (file != NULL && file != stdin) {
+		fclose(file);
+	}
+	file = NULL;
+	free(buffer);
+	buffer = NULL;
+	start = 0;
+	end = 0;
+	bad = false;
+}
+
+// at least 'wanted' bytes from start on in the buffer, moving what is left of it to the front first
+bool SensorCaptureReader::fill(size_t wanted) {
+	if (start > 0) {
+		memmove(buffer, &buffer[start], end - start);
+		end -= start;
+		start = 0;
+	}
+	while (end < wanted) {
+		size_t n = fread(&buffer[end], 1, SENSOR_CAPTURE_BUFFER - end, file);
+		if (n == 0) {
+			return false;
+		}
+		end += n;
+	}
+	return true;
+}
+
+bool SensorCaptureReader::next(CaptureRecord &record, uint8_t source) {
+	if (file == NULL) {
+		return false;
+	}
+	for (;;) {
+		int size = parseCaptureRecord(&buffer[start], end - start, record);
+		if (size == 0) {
+			size_t wanted = end - start >= CAPTURE_RECORD_HEADER_SIZE ? CAPTURE_RECORD_HEADER_SIZE + record.length : CAPTURE_RECORD_HEADER_SIZE;
+			if (!fill(wanted)) {
+				bad = end > start;
+				return false;
+			}
+			size = parseCaptureRecord(&buffer[start], end - start, record);
+		}
+		if (size <= 0) {
+			bad = true;
+			return false;
+		}
+		start += size;
+		if (source == 0 || record.source == source) {
+			return true;
+		}
+	}
+}
+
+bool SensorCaptureWriter::open(const char *path) {
+	close();
+	file = fopen(path, "wb");
+	if (file == NULL) {
+		return false;
+	}
+	uint8_t header[SENSOR_CAPTURE_HEADER_SIZE] = {0};
+	memcpy(header, SENSOR_CAPTURE_MAGIC, 4);
+	header[4] = SENSOR_CAPTURE_VERSION;
+	records = 0;
+	bytes = sizeof(header);
+	return fwrite(header, 1, sizeof(header), file) == sizeof(header);
+}
+
+void SensorCaptureWriter::close() {
+	if (file != NULL) {
+		fclose(file);
+		file = NULL;
+	}
+}
+
+bool SensorCaptureWriter::write(uint32_t time, uint8_t source, uint8_t flags, const uint8_t *payload, uint16_t length) {
+	if (file == NULL || length > CAPTURE_MAX_PAYLOAD) {
+		return false;
+	}
+	uint8_t header[CAPTURE_RECORD_HEADER_SIZE];
+	put32(&header[0], time);
+	header[4] = source;
+	header[5] = flags;
+	put16(&header[6], length);
+	if (fwrite(header, 1, sizeof(header), file) != sizeof(header) || fwrite(payload, 1, length, file) != length) {
+		return false;
+	}
+	++records;
+	bytes += sizeof(header) + length;
+	return true;
+}
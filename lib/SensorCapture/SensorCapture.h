@@ -0,0 +1,111 @@
+/*
+  SensorCapture.h - the plank's raw sensor data, as the firmware read it, recorded to a byte log so
+  that a session can be fed through the processing stages again (src/replay).
+
+    file header: "PKSC" | version (u8) | 3 bytes reserved
+    record:      time (u32, us) | source (u8) | flags (u8) | length (u16) | payload
+
+  Little endian. The time is micros() of the MCU that read the data: the Mega's for the touch scans,
+  the ESP32's for everything else. Each source is recorded in order on its own clock; records of
+  different sources may come in any order.
+
+    'T' ADCTouch scan       PLANK_CAPACITIVE_COUNT x u16, ADCTouchScanner::read(); CAPTURE_FLAG_START
+                            on the scan the tracker was reset with
+    'X' HX711 conversion    one sign-extended i32 word per chip, as clocked out (tare readings included)
+    'D' piezo DMA frame     the ESP32 TYPE1 output words of one frame; CAPTURE_FLAG_START:
+                            rate (u32) | count (u8) | pins (u8 x count), when the sampler began
+    'U' UART bytes          what the ESP32 read from the Mega in one pass of the link task
+
+  A replay writes what the stages made of it in the same format, under the lower case sources
+  (CAPTURE_OUT_*), so that two runs compare record by record.
+*/
+#ifndef SENSOR_CAPTURE_h
+#define SENSOR_CAPTURE_h
+
+#include <Arduino.h>
+#include <stdio.h>
+
+#define SENSOR_CAPTURE_MAGIC "PKSC"
+#define SENSOR_CAPTURE_VERSION 1
+#define SENSOR_CAPTURE_HEADER_SIZE 8
+#define CAPTURE_RECORD_HEADER_SIZE 8
+#define CAPTURE_MAX_PAYLOAD 2048		// a DMA frame is 512 bytes
+#ifndef SENSOR_CAPTURE_BUFFER
+#define SENSOR_CAPTURE_BUFFER 65536
+#endif
+
+// inputs, read by the firmware
+#define CAPTURE_TOUCH_SCAN 'T'
+#define CAPTURE_HX711 'X'
+#define CAPTURE_PIEZO_DMA 'D'
+#define CAPTURE_UART 'U'
+
+// outputs, made by the processing stages
+#define CAPTURE_OUT_TOUCH 't'		// TouchEvents: pad (u8) | kind (u8) | strength (i16), for each
+#define CAPTURE_OUT_STRAIN 'x'		// HX711Sample: timestamp (u32) | calibrated value (i32) per chip
+#define CAPTURE_OUT_HIT 'h'			// packPiezoHit()
+#define CAPTURE_OUT_CAPTURE 'w'		// WaveformCapture::nextChunk()
+#define CAPTURE_OUT_FRAME 'f'		// LinkFrame: type (u8) | sequence (u8) | time (u32) | payload
+#define CAPTURE_OUT_LINK_TX 'u'		// what the ESP32 sent back to the Mega
+
+#define CAPTURE_FLAG_START 0x01
+
+struct CaptureRecord {
+	uint32_t time;
+	uint8_t source;
+	uint8_t flags;
+	uint16_t length;
+	const uint8_t *payload;
+};
+
+class SensorCaptureReader
+{
+	public:
+		SensorCaptureReader();
+		~SensorCaptureReader();
+
+		// "-" reads stdin; false if the file cannot be opened or is not a sensor capture
+		bool open(const char *path);
+		void close();
+
+		// the next record of 'source', or of any source if 0; the payload stays valid until the next
+		// call. false at the end of the capture, or on a record that cannot be one
+		bool next(CaptureRecord &record, uint8_t source = 0);
+
+		bool corrupt() const { return bad; }	// the capture ended on a record that cannot be one
+
+	private:
+		bool fill(size_t wanted);
+
+		FILE *file;
+		uint8_t *buffer;
+		size_t start;		// of the next record in buffer
+		size_t end;			// of the bytes read
+		bool bad;
+};
+
+class SensorCaptureWriter
+{
+	public:
+		SensorCaptureWriter() : file(NULL), records(0), bytes(0) {}
+		~SensorCaptureWriter() { close(); }
+
+		bool open(const char *path);
+		void close();
+		bool isOpen() const { return file != NULL; }
+
+		bool write(uint32_t time, uint8_t source, uint8_t flags, const uint8_t *payload, uint16_t length);
+		uint32_t written() const { return records; }
+		uint64_t size() const { return bytes; }
+
+	private:
+		FILE *file;
+		uint32_t records;
+		uint64_t bytes;
+};
+
+// the record header and payload at 'in', if the size 'available' holds them: the length of the whole
+// record, 0 if it is cut short, -1 if it cannot be a record
+int parseCaptureRecord(const uint8_t *in, size_t available, CaptureRecord &record);
+
+#endif /* SENSOR_CAPTURE_h */
@@ -0,0 +1,135 @@
+#include <Arduino.h>
+#include <FlashStore.h>
+#include <stdlib.h>
+
+#if defined(ARDUINO_ARCH_ESP32)
+bool PartitionStore::begin(uint8_t subtype, const char *label) {
+	partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, (esp_partition_subtype_t) subtype, label);
+	return partition != NULL;
+}
+
+uint32_t PartitionStore::size() const {
+	return partition != NULL ? partition->size & ~(uint32_t) (FLASH_SECTOR_SIZE - 1) : 0;
+}
+
+// the flash cache is off while these run: both cores stall unless they run from IRAM
+bool PartitionStore::erase(uint32_t address) {
+	return partition != NULL && esp_partition_erase_range(partition, address, FLASH_SECTOR_SIZE) == ESP_OK;
+}
+
+bool PartitionStore::program(uint32_t address, const uint8_t *data, size_t length) {
+	return partition != NULL && esp_partition_write(partition, address, data, length) == ESP_OK;
+}
+
+bool PartitionStore::read(uint32_t address, uint8_t *data, size_t length) {
+	return partition != NULL && esp_partition_read(partition, address, data, length) == ESP_OK;
+}
+#endif
+
+#define FILE_STORE_CHUNK 256
+
+FileStore::FileStore() {
+	file = NULL;
+	bytes = 0;
+	sectorErases = NULL;
+	erased = 0;
+	written = 0;
+	badPrograms = 0;
+}
+
+FileStore::~FileStore() {
+	close();
+}
+
+bool FileStore::open(const char *path, uint32_t size) {
+	close();
+	bytes = size & ~(uint32_t) (FLASH_SECTOR_SIZE - 1);
+	if (bytes == 0) {
+		return false;
+	}
+	file = path != NULL ? fopen(path, "r+b") : tmpfile();
+	if (file == NULL && path != NULL) {
+		file = fopen(path, "w+b");
+	}
+	if (file == NULL) {
+		return false;
+	}
+	fseek(file, 0, SEEK_END);
+	long existing = ftell(file);
+	uint8_t blank[FILE_STORE_CHUNK];
+	memset(blank, 0xFF, sizeof(blank));
+	for (long at = existing < 0 ? 0 : existing; at < (long) bytes; at += FILE_STORE_CHUNK) {
+		fwrite(blank, 1, (long) bytes - at < FILE_STORE_CHUNK ? (long) bytes - at : FILE_STORE_CHUNK, file);
+	}
+	fflush(file);
+	sectorErases = (uint32_t *) calloc(bytes / FLASH_SECTOR_SIZE, sizeof(uint32_t));
+	erased = 0;
+	written = 0;
+	badPrograms = 0;
+	return sectorErases != NULL;
+}
+
+void FileStore::close() {
+	if (file != NULL) {
+		fclose(file);
+		file = NULL;
+	}
+	free(sectorErases);
+	sectorErases = NULL;
+}
+
+bool FileStore::erase(uint32_t address) {
+	if (file == NULL || address % FLASH_SECTOR_SIZE != 0 || address >= bytes) {
+		return false;
+	}
+	uint8_t blank[FILE_STORE_CHUNK];
+	memset(blank, 0xFF, sizeof(blank));
+	fseek(file, address, SEEK_SET);
+	for (uint32_t done = 0; done < FLASH_SECTOR_SIZE; done += FILE_STORE_CHUNK) {
+		fwrite(blank, 1, FILE_STORE_CHUNK, file);
+	}
+	++sectorErases[address / FLASH_SECTOR_SIZE];
+	++erased;
+	return true;
+}
+
+// what NOR flash does: the new contents are ANDed into the old ones
+bool FileStore::program(uint32_t address, const uint8_t *data, size_t length) {
+	if (file == NULL || address + length > bytes) {
+		return false;
+	}
+	for (size_t done = 0; done < length; done += FILE_STORE_CHUNK) {
+		size_t n = length - done < FILE_STORE_CHUNK ? length - done : FILE_STORE_CHUNK;
+		uint8_t cells[FILE_STORE_CHUNK];
+		fseek(file, address + done, SEEK_SET);
+		if (fread(cells, 1, n, file) != n) {
+			return false;
+		}
+		bool violation = false;
+		for (size_t i = 0; i < n; i++) {
+			violation |= (data[done + i] & ~cells[i]) != 0;
+			cells[i] &= data[done + i];
+		}
+		badPrograms += violation ? 1 : 0;
+		fseek(file, address + done, SEEK_SET);
+		fwrite(cells, 1, n, file);
+	}
+	written += length;
+	return true;
+}
+
+bool FileStore::read(uint32_t address, uint8_t *data, size_t length) {
+	if (file == NULL || address + length > bytes) {
+		return false;
+	}
+	fseek(file, address, SEEK_SET);
+	return fread(data, 1, length, file) == length;
+}
+
+uint32_t FileStore::mostErases() const {
+	uint32_t most = 0;
+	for (uint32_t i = 0; sectorErases != NULL && i < bytes / FLASH_SECTOR_SIZE; i++) {
+		most = sectorErases[i] > most ? sectorErases[i] : most;
+	}
+	return most;
+}
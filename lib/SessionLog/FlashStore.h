@@ -0,0 +1,84 @@
+/*
+  FlashStore.h - the NOR flash a SessionLog lives in: sectors erased to 0xFF, programming only clears
+  bits.
+
+  PartitionStore is a raw data partition of the ESP32's SPI flash (partitions.csv). FileStore keeps
+  the same contents in a host file for the simulation and the benchmarks, and checks the flash rules
+  on the way: a program() that would have to set a cleared bit is counted, and every erase is
+  counted per sector to show the wear.
+*/
+#ifndef FLASH_STORE_h
+#define FLASH_STORE_h
+
+#include <Arduino.h>
+#include <stdio.h>
+
+#define FLASH_SECTOR_SIZE 4096
+
+class FlashStore
+{
+	public:
+		virtual ~FlashStore() {}
+
+		// bytes, a whole number of sectors; 0 when the store is not open
+		virtual uint32_t size() const = 0;
+		// the sector at a FLASH_SECTOR_SIZE aligned address back to 0xFF
+		virtual bool erase(uint32_t address) = 0;
+		virtual bool program(uint32_t address, const uint8_t *data, size_t length) = 0;
+		virtual bool read(uint32_t address, uint8_t *data, size_t length) = 0;
+};
+
+#if defined(ARDUINO_ARCH_ESP32)
+#include <esp_partition.h>
+
+#define PLANK_LOG_PARTITION_SUBTYPE 0x40	// data partition "plank" in partitions.csv
+
+class PartitionStore : public FlashStore
+{
+	public:
+		PartitionStore() : partition(NULL) {}
+
+		// the first data partition of that subtype and label
+		bool begin(uint8_t subtype = PLANK_LOG_PARTITION_SUBTYPE, const char *label = "plank");
+
+		uint32_t size() const;
+		bool erase(uint32_t address);
+		bool program(uint32_t address, const uint8_t *data, size_t length);
+		bool read(uint32_t address, uint8_t *data, size_t length);
+
+	private:
+		const esp_partition_t *partition;
+};
+#endif
+
+class FileStore : public FlashStore
+{
+	public:
+		FileStore();
+		~FileStore();
+
+		// size rounded down to whole sectors; a new or shorter file is extended as erased flash.
+		// NULL: an anonymous temporary file.
+		bool open(const char *path, uint32_t bytes);
+		void close();
+
+		uint32_t size() const { return file != NULL ? bytes : 0; }
+		bool erase(uint32_t address);
+		bool program(uint32_t address, const uint8_t *data, size_t length);
+		bool read(uint32_t address, uint8_t *data, size_t length);
+
+		uint32_t erases() const { return erased; }
+		uint32_t mostErases() const;		// of any one sector
+		uint64_t programmed() const { return written; }	// bytes
+		uint32_t violations() const { return badPrograms; }	// programs over bits not erased
+
+	private:
+		FILE *file;
+		uint32_t bytes;
+		uint32_t *sectorErases;
+		uint32_t erased;
+		uint64_t written;
+		uint32_t badPrograms;
+};
+
+#endif /* FLASH_STORE_h */
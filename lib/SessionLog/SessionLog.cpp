@@ -0,0 +1,321 @@
+#include <Arduino.h>
+#include <SessionLog.h>
+#include <PlankFrame.h>
+#include <PlankBytes.h>
+
+#define BLOCKS_PER_SECTOR (FLASH_SECTOR_SIZE / SESSION_LOG_BLOCK)
+#define SESSION_LOG_MAX_PAYLOAD (SESSION_LOG_BLOCK - SESSION_LOG_HEADER_SIZE)
+
+SessionLog::SessionLog(FlashStore &store) : store(store) {
+	frames.setCapacity(STREAM_FRAME_MAX);
+	frames.setMask(STREAM_MASK_ALL);
+	frames.setPacked(true);
+	used = SESSION_LOG_HEADER_SIZE;
+	blockTime = 0;
+	blockCount = 0;
+	next = 0;
+	count = 0;
+	active = false;
+	current = 0;
+	nextId = 1;
+	recorded = 0;
+	written = 0;
+	erasedSectors = 0;
+	payload = 0;
+	failed = 0;
+	corrupt = 0;
+}
+
+// the header of block 'sequence' if it is that block's
+bool SessionLog::readHeader(uint32_t sequence, uint8_t *header) {
+	uint32_t address = (sequence % blockCount) * SESSION_LOG_BLOCK;
+	return store.read(address, header, SESSION_LOG_HEADER_SIZE)
+		&& get16(&header[0]) == SESSION_LOG_MAGIC
+		&& get32(&header[4]) == sequence
+		&& get16(&header[12]) <= SESSION_LOG_MAX_PAYLOAD;
+}
+
+bool SessionLog::begin() {
+	blockCount = store.size() / SESSION_LOG_BLOCK;
+	if (blockCount < 2 * BLOCKS_PER_SECTOR) {
+		blockCount = 0;
+		return false;
+	}
+	count = 0;
+	used = SESSION_LOG_HEADER_SIZE;
+
+	// the newest block: any header whose sequence matches its address
+	bool found = false;
+	uint32_t newest = 0;
+	for (uint32_t b = 0; b < blockCount; b++) {
+		uint8_t header[SESSION_LOG_HEADER_SIZE];
+		if (store.read(b * SESSION_LOG_BLOCK, header, sizeof(header)) && get16(&header[0]) == SESSION_LOG_MAGIC) {
+			uint32_t sequence = get32(&header[4]);
+			if (sequence % blockCount == b && (!found || sequence > newest)) {
+				newest = sequence;
+				found = true;
+			}
+		}
+	}
+	if (!found) {
+		next = 0;
+		return true;
+	}
+
+	// then every block still in the ring, oldest first
+	uint32_t oldest = newest + 1 > blockCount ? newest + 1 - blockCount : 0;
+	for (uint32_t s = oldest; s <= newest; s++) {
+		uint8_t header[SESSION_LOG_HEADER_SIZE];
+		if (readHeader(s, header)) {
+			indexBlock(get16(&header[2]), s, get32(&header[8]));
+		}
+	}
+	next = (newest / BLOCKS_PER_SECTOR + 1) * BLOCKS_PER_SECTOR;
+	nextId = count > 0 ? table[count - 1].id + 1 : 1;
+	nextId = nextId == 0 ? 1 : nextId;
+	return true;
+}
+
+void SessionLog::startSession() {
+	endSession();
+	current = nextId++;
+	nextId = nextId == 0 ? 1 : nextId;
+	active = true;
+}
+
+void SessionLog::endSession() {
+	if (!active) {
+		return;
+	}
+	flush();
+	active = false;
+}
+
+bool SessionLog::addValues(uint8_t type, uint32_t timeUs, const int32_t *values) {
+	if (!active || !mounted()) {
+		return false;
+	}
+	if (!frames.addValues(type, timeUs, values)) {
+		closeFrame();
+		frames.addValues(type, timeUs, values);
+	}
+	++recorded;
+	return true;
+}
+
+// the frame being built goes into the block, the block to flash first if the frame does not fit
+void SessionLog::closeFrame() {
+	if (frames.empty()) {
+		return;
+	}
+	size_t size = frames.finish();
+	if (used + 1 + size > SESSION_LOG_BLOCK) {
+		writeBlock();
+	}
+	if (used == SESSION_LOG_HEADER_SIZE) {
+		blockTime = get32(&frames.data()[4]);
+	}
+	block[used++] = size;
+	memcpy(&block[used], frames.data(), size);
+	used += size;
+}
+
+void SessionLog::flush() {
+	closeFrame();
+	writeBlock();
+}
+
+uint32_t SessionLog::age(uint32_t nowUs) const {
+	if (used > SESSION_LOG_HEADER_SIZE) {
+		return nowUs - blockTime;
+	}
+	return frames.age(nowUs);
+}
+
+void SessionLog::writeBlock() {
+	if (used == SESSION_LOG_HEADER_SIZE) {
+		return;
+	}
+	uint32_t sequence = next++;
+	if (sequence % BLOCKS_PER_SECTOR == 0) {
+		if (sequence + BLOCKS_PER_SECTOR > blockCount) {
+			trim(sequence + BLOCKS_PER_SECTOR - blockCount);
+		}
+		if (store.erase((sequence % blockCount) * SESSION_LOG_BLOCK)) {
+			++erasedSectors;
+		} else {
+			++failed;
+		}
+	}
+	uint16_t length = used - SESSION_LOG_HEADER_SIZE;
+	put16(&block[0], SESSION_LOG_MAGIC);
+	put16(&block[2], current);
+	put32(&block[4], sequence);
+	put32(&block[8], blockTime);
+	put16(&block[12], length);
+	uint16_t crc = plankCrc16(&block[SESSION_LOG_HEADER_SIZE], length, plankCrc16(block, 14));
+	put16(&block[14], crc);
+
+	uint32_t address = (sequence % blockCount) * SESSION_LOG_BLOCK;
+	if (store.program(address + SESSION_LOG_HEADER_SIZE, &block[SESSION_LOG_HEADER_SIZE], length)
+			&& store.program(address, block, SESSION_LOG_HEADER_SIZE)) {
+		indexBlock(current, sequence, blockTime);
+		++written;
+		payload += length;
+	} else {
+		++failed;
+	}
+	used = SESSION_LOG_HEADER_SIZE;
+}
+
+void SessionLog::indexBlock(uint16_t id, uint32_t sequence, uint32_t time) {
+	if (count > 0 && table[count - 1].id == id) {
+		table[count - 1].blocks = sequence - table[count - 1].first + 1;
+		return;
+	}
+	if (count == SESSION_LOG_MAX_SESSIONS) {
+		memmove(&table[0], &table[1], (count - 1) * sizeof(SessionInfo));
+		--count;
+	}
+	SessionInfo &info = table[count++];
+	info.id = id;
+	info.first = sequence;
+	info.blocks = 1;
+	info.time = time;
+}
+
+// the blocks before 'oldest' are about to be erased
+void SessionLog::trim(uint32_t oldest) {
+	while (count > 0 && table[0].first < oldest) {
+		SessionInfo &info = table[0];
+		uint32_t lost = oldest - info.first;
+		if (lost >= info.blocks) {
+			memmove(&table[0], &table[1], (count - 1) * sizeof(SessionInfo));
+			--count;
+			continue;
+		}
+		info.first = oldest;
+		info.blocks -= lost;
+		uint8_t header[SESSION_LOG_HEADER_SIZE];
+		if (readHeader(oldest, header)) {
+			info.time = get32(&header[8]);
+		}
+	}
+}
+
+bool SessionLog::erase() {
+	if (!mounted()) {
+		return false;
+	}
+	bool ok = true;
+	for (uint32_t address = 0; address < blockCount * SESSION_LOG_BLOCK; address += FLASH_SECTOR_SIZE) {
+		ok = store.erase(address) && ok;
+	}
+	if (!frames.empty()) {
+		frames.finish();
+	}
+	used = SESSION_LOG_HEADER_SIZE;
+	next = 0;
+	count = 0;
+	return ok;
+}
+
+const SessionInfo *SessionLog::find(uint16_t id) const {
+	for (uint8_t i = 0; i < count; i++) {
+		if (table[i].id == id) {
+			return &table[i];
+		}
+	}
+	return NULL;
+}
+
+size_t SessionLog::listSessions(uint8_t *out, size_t capacity, uint8_t first) const {
+	if (capacity < SESSION_LIST_HEADER_SIZE) {
+		return 0;
+	}
+	out[0] = 'L';
+	out[1] = count;
+	out[2] = first;
+	size_t size = SESSION_LIST_HEADER_SIZE;
+	for (uint8_t i = first; i < count && size + SESSION_LIST_ENTRY_SIZE <= capacity; i++) {
+		put16(&out[size], table[i].id);
+		put32(&out[size + 2], table[i].first);
+		put32(&out[size + 6], table[i].blocks);
+		put32(&out[size + 10], table[i].time);
+		size += SESSION_LIST_ENTRY_SIZE;
+	}
+	return size;
+}
+
+size_t SessionLog::readBlock(uint32_t sequence, uint8_t *out) {
+	if (!mounted() || !readHeader(sequence, out)) {
+		return 0;
+	}
+	uint16_t length = get16(&out[12]);
+	uint32_t address = (sequence % blockCount) * SESSION_LOG_BLOCK;
+	if (!store.read(address + SESSION_LOG_HEADER_SIZE, &out[SESSION_LOG_HEADER_SIZE], length)
+			|| plankCrc16(&out[SESSION_LOG_HEADER_SIZE], length, plankCrc16(out, 14)) != get16(&out[14])) {
+		++corrupt;
+		return 0;
+	}
+	return SESSION_LOG_HEADER_SIZE + length;
+}
+
+SessionDownload::SessionDownload(SessionLog &log) : log(log) {
+	size = 0;
+	offset = 0;
+	sending = false;
+	session = 0;
+	loaded = 0;
+	sequence = 0;
+	end = 0;
+	sent = 0;
+	skipped = 0;
+}
+
+bool SessionDownload::start(uint16_t id, uint32_t from) {
+	const SessionInfo *info = log.find(id);
+	if (info == NULL) {
+		return false;
+	}
+	session = id;
+	sequence = from > info->first ? from : info->first;
+	end = info->first + info->blocks;
+	size = 0;
+	offset = 0;
+	sent = 0;
+	sending = true;
+	return true;
+}
+
+size_t SessionDownload::nextChunk(uint8_t *out, size_t capacity) {
+	if (!sending || capacity <= SESSION_CHUNK_HEADER_SIZE) {
+		return 0;
+	}
+	while (offset >= size) {
+		if (sequence >= end) {
+			out[0] = 'F';
+			put16(&out[1], session);
+			put32(&out[3], sent);
+			sending = false;
+			return SESSION_END_SIZE;
+		}
+		loaded = sequence++;
+		size = log.readBlock(loaded, block);
+		offset = 0;
+		if (size > 0) {
+			++sent;
+		} else {
+			++skipped;
+		}
+	}
+	size_t n = capacity - SESSION_CHUNK_HEADER_SIZE;
+	n = size - offset < n ? size - offset : n;
+	out[0] = 'D';
+	put16(&out[1], session);
+	put32(&out[3], loaded);
+	put16(&out[7], offset);
+	memcpy(&out[SESSION_CHUNK_HEADER_SIZE], &block[offset], n);
+	offset += n;
+	return SESSION_CHUNK_HEADER_SIZE + n;
+}
@@ -0,0 +1,171 @@
+/*
+  SessionLog.h - sensor samples recorded to flash while no one listens, and sent back in bulk later.
+
+  The samples go through a SensorStreamWriter of their own, packed (SensorStream.h, DeltaCodec.h),
+  and its frames are gathered into SESSION_LOG_BLOCK byte blocks in RAM. Only whole blocks are
+  programmed, at block-aligned addresses, and a sector is erased once each time the log comes round
+  to it: the flash wears evenly and sees one large write for dozens of samples.
+
+    block header: magic (u16) | session (u16) | sequence (u32) | time of the first sample (u32, us) |
+                  payload length (u16) | CRC-16 of the header and payload (u16)
+    payload:      frames, each a length (u8) then a SensorStream frame
+
+  Blocks fill the store as a ring numbered by a sequence that only grows: block s lives at
+  s % capacity(), so the sequence is also its address. A session is a run of consecutive sequences;
+  when the ring comes back round, the oldest sessions lose their oldest blocks. The payload is
+  programmed before the header, so a block whose header reads back was written completely.
+
+  begin() rebuilds the index of the sessions from the block headers, newest SESSION_LOG_MAX_SESSIONS
+  only, and starts writing at the next sector: a block cut short by a reset is never programmed over.
+  Not thread-safe: record, list and download from one task.
+*/
+#ifndef SESSION_LOG_h
+#define SESSION_LOG_h
+
+#include <Arduino.h>
+#include "FlashStore.h"
+#include "SensorStream.h"
+
+#define SESSION_LOG_BLOCK 1024		// bytes, divides FLASH_SECTOR_SIZE
+#define SESSION_LOG_HEADER_SIZE 16
+#define SESSION_LOG_MAGIC 0x4C53	// "SL"
+#ifndef SESSION_LOG_MAX_SESSIONS
+#define SESSION_LOG_MAX_SESSIONS 16
+#endif
+
+// Download chunks, little endian:
+//   'L' | sessions (u8) | first listed (u8) | per session: id (u16) | first block (u32) | blocks (u32) |
+//         time of its first sample (u32)
+//   'D' | session (u16) | block sequence (u32) | offset in the block (u16) | bytes of the block
+//   'F' | session (u16) | blocks sent (u32), after the last 'D' chunk of a session
+#define SESSION_LIST_HEADER_SIZE 3
+#define SESSION_LIST_ENTRY_SIZE 14
+#define SESSION_CHUNK_HEADER_SIZE 9
+#define SESSION_END_SIZE 7
+
+struct SessionInfo
+{
+	uint16_t id;
+	uint32_t first;		// sequence of its oldest block still in the log
+	uint32_t blocks;
+	uint32_t time;		// us, first sample of that block
+};
+
+class SessionLog
+{
+	static_assert(FLASH_SECTOR_SIZE % SESSION_LOG_BLOCK == 0, "SESSION_LOG_BLOCK must divide FLASH_SECTOR_SIZE");
+	static_assert(SESSION_LOG_BLOCK - SESSION_LOG_HEADER_SIZE >= STREAM_FRAME_MAX + 1, "SESSION_LOG_BLOCK too small for a stream frame");
+
+	public:
+		SessionLog(FlashStore &store);
+
+		// mounts the store: false if it is missing or smaller than two sectors
+		bool begin();
+		bool mounted() const { return blockCount > 0; }
+		uint32_t capacity() const { return blockCount; }	// blocks
+
+		// a new session; the current one is closed first
+		void startSession();
+		// writes what is left of the session and stops recording
+		void endSession();
+		bool recording() const { return active; }
+		uint16_t sessionId() const { return current; }	// of the session recorded, or the last one
+
+		// one sample of a sensor record type, like SensorStreamWriter::addSample; false when not recording
+		bool addValues(uint8_t type, uint32_t timeUs, const int32_t *values);
+		template <typename T>
+		bool addSample(uint8_t type, uint32_t timeUs, const T *values) {
+			int32_t v[DELTA_MAX_CHANNELS];
+			for (uint8_t i = 0; i < streamChannels(type); i++) {
+				v[i] = (int32_t) values[i];
+			}
+			return addValues(type, timeUs, v);
+		}
+
+		// writes the block being filled as it is; what is left of it stays unused
+		void flush();
+		// time since the oldest sample not in flash yet, what a reset would lose
+		uint32_t age(uint32_t nowUs) const;
+
+		// erases the whole store; the samples not in flash yet are dropped too
+		bool erase();
+
+		// the index, oldest session first
+		uint8_t sessions() const { return count; }
+		const SessionInfo &session(uint8_t i) const { return table[i]; }
+		const SessionInfo *find(uint16_t id) const;
+		// the 'L' chunk, sessions from 'first' on, as many as fit
+		size_t listSessions(uint8_t *out, size_t capacity, uint8_t first) const;
+
+		// one block, header and payload, into out (SESSION_LOG_BLOCK bytes); returns its size, 0 when
+		// the block was overwritten, never written or is corrupt
+		size_t readBlock(uint32_t sequence, uint8_t *out);
+
+		uint32_t samples() const { return recorded; }
+		uint32_t blocksWritten() const { return written; }
+		uint32_t sectorsErased() const { return erasedSectors; }
+		uint32_t payloadBytes() const { return payload; }	// of the blocks written
+		uint32_t failures() const { return failed; }		// erases and programs the store refused
+		uint32_t corruptBlocks() const { return corrupt; }	// found by readBlock()
+
+	private:
+		bool readHeader(uint32_t sequence, uint8_t *header);
+		void closeFrame();
+		void writeBlock();
+		void indexBlock(uint16_t id, uint32_t sequence, uint32_t time);
+		void trim(uint32_t oldest);
+
+		FlashStore &store;
+		SensorStreamWriter frames;
+		uint8_t block[SESSION_LOG_BLOCK];
+		size_t used;			// bytes of block, header included
+		uint32_t blockTime;		// us, first sample of the block
+		uint32_t blockCount;
+		uint32_t next;			// sequence of the next block written
+		SessionInfo table[SESSION_LOG_MAX_SESSIONS];
+		uint8_t count;
+		bool active;
+		uint16_t current;		// id of the session recorded
+		uint16_t nextId;
+		uint32_t recorded;
+		uint32_t written;
+		uint32_t erasedSectors;
+		uint32_t payload;
+		uint32_t failed;
+		uint32_t corrupt;
+};
+
+// a session out of the log in chunks, as fast as the caller sends them; blocks that went missing
+// meanwhile are skipped, the receiver sees their sequence missing
+class SessionDownload
+{
+	public:
+		SessionDownload(SessionLog &log);
+
+		// from block sequence 'from' on (0: the whole session), to resume a download; false if the
+		// session is not in the log
+		bool start(uint16_t id, uint32_t from = 0);
+		void stop() { sending = false; }
+		bool active() const { return sending; }
+
+		// next 'D' chunk, or the 'F' chunk that ends the session; 0 when idle or capacity is too small
+		size_t nextChunk(uint8_t *out, size_t capacity);
+
+		uint32_t blocksSent() const { return sent; }
+		uint32_t blocksSkipped() const { return skipped; }
+
+	private:
+		SessionLog &log;
+		uint8_t block[SESSION_LOG_BLOCK];
+		size_t size;		// of the block loaded, 0 if missing
+		size_t offset;
+		bool sending;
+		uint16_t session;
+		uint32_t loaded;	// sequence of the block loaded
+		uint32_t sequence;	// next to load
+		uint32_t end;
+		uint32_t sent;
+		uint32_t skipped;
+};
+
+#endif /* SESSION_LOG_h */
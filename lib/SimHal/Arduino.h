@@ -0,0 +1,183 @@
+/*
+  Arduino.h - minimal Arduino core shim for the native (host) environments.
+  Every pin and timing call is routed to the simulated board in SimHal.h.
+*/
+#ifndef SIM_ARDUINO_h
+#define SIM_ARDUINO_h
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <math.h>
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+#define HIGH 0x1
+#define LOW  0x0
+
+#define INPUT        0x0
+#define OUTPUT       0x1
+#define INPUT_PULLUP 0x2
+
+#define DEC 10
+#define HEX 16
+
+// ATmega2560 analog pin numbering; the ESP32 firmware uses raw GPIO numbers below 40
+#define A0  54
+#define A1  55
+#define A2  56
+#define A3  57
+#define A4  58
+#define A5  59
+#define A6  60
+#define A7  61
+#define A8  62
+#define A9  63
+#define A10 64
+#define A11 65
+#define A12 66
+#define A13 67
+#define A14 68
+#define A15 69
+
+#define bitRead(value, bit) (((value) >> (bit)) & 0x01)
+#define bitSet(value, bit) ((value) |= (1UL << (bit)))
+#define bitClear(value, bit) ((value) &= ~(1UL << (bit)))
+#define bitWrite(value, bit, bitvalue) ((bitvalue) ? bitSet(value, bit) : bitClear(value, bit))
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t val);
+int digitalRead(uint8_t pin);
+int analogRead(uint8_t pin);
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+
+long map(long x, long in_min, long in_max, long out_min, long out_max);
+
+// AVR ADC registers as used by ADCTouch and ADCTouchScanner. Starting a conversion (ADSC) with ADIE
+// clear charges the conversion time to the running CPU and completes immediately; with ADIE set the
+// conversion runs in the background and the host delivers its interrupt (SimHal::takeAdcResult)
+class SimAdcRegister
+{
+	public:
+		SimAdcRegister() : value(0) {}
+		operator uint8_t() const { return value; }
+		SimAdcRegister &operator=(uint8_t v);
+		SimAdcRegister &operator|=(uint8_t v) { return *this = value | v; }
+		SimAdcRegister &operator&=(uint8_t v) { return *this = value & v; }
+	private:
+		uint8_t value;
+};
+
+extern SimAdcRegister ADMUX;
+extern SimAdcRegister ADCSRA;
+extern SimAdcRegister ADCSRB;
+
+#define ADPS0 0
+#define ADPS1 1
+#define ADPS2 2
+#define ADIE 3
+#define ADIF 4
+#define ADSC 6
+#define ADEN 7
+#define MUX5 3
+#define REFS0 6
+
+// there is nothing to mask on the host: interrupt handlers run between loop() passes
+inline void noInterrupts() {}
+inline void interrupts() {}
+
+// Arduino String, backed by std::string on the host
+#include <string>
+
+class String
+{
+	public:
+		String() {}
+		String(const char *s) : str(s) {}
+		String(const std::string &s) : str(s) {}
+
+		String &operator=(const char *s) { str = s; return *this; }
+		String &operator+=(char c) { str += c; return *this; }
+		String &operator+=(const char *s) { str += s; return *this; }
+
+		unsigned int length() const { return str.length(); }
+		char &operator[](unsigned int i) { return str[i]; }
+		char operator[](unsigned int i) const { return str[i]; }
+		const char *c_str() const { return str.c_str(); }
+
+		bool startsWith(const char *prefix) const { return str.compare(0, strlen(prefix), prefix) == 0; }
+		String substring(unsigned int from, unsigned int to) const {
+			if (from > str.length()) {
+				return String();
+			}
+			return String(str.substr(from, to > from ? to - from : 0));
+		}
+
+	private:
+		std::string str;
+};
+
+class Print
+{
+	public:
+		virtual ~Print() {}
+		virtual size_t write(uint8_t c) = 0;
+		virtual size_t write(const uint8_t *buffer, size_t size);
+
+		size_t print(const char *s);
+		size_t print(char c);
+		size_t print(int n, int base = DEC);
+		size_t print(unsigned int n, int base = DEC);
+		size_t print(long n, int base = DEC);
+		size_t print(unsigned long n, int base = DEC);
+		size_t print(double n, int digits = 2);
+
+		size_t println();
+		template <typename T> size_t println(T v) { size_t n = print(v); return n + println(); }
+		template <typename T> size_t println(T v, int f) { size_t n = print(v, f); return n + println(); }
+};
+
+// a serial port that can also be read (HardwareSerial on the targets)
+class Stream : public Print
+{
+	public:
+		virtual int available() = 0;
+		virtual int read() = 0;
+		virtual int peek() = 0;
+};
+
+// USB serial of the simulated board; writes go to stdout unless muted
+class SimConsole : public Print
+{
+	public:
+		SimConsole() : muted(false) {}
+		void begin(unsigned long) {}
+		void setMuted(bool mute) { muted = mute; }
+		using Print::write;
+		size_t write(uint8_t c);
+	private:
+		bool muted;
+};
+
+extern SimConsole Serial;
+
+#define SIM_CPU_MHZ 240
+
+// the ESP32 core's CPU cycle counter (CCOUNT), counted on the selected CPU's clock at SIM_CPU_MHZ
+class SimEsp
+{
+	public:
+		uint32_t getCycleCount();
+		uint32_t getCpuFreqMHz() { return SIM_CPU_MHZ; }
+};
+
+extern SimEsp ESP;
+
+#endif /* SIM_ARDUINO_h */
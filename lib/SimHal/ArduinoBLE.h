@@ -0,0 +1,124 @@
+/*
+  ArduinoBLE.h - stand-in for the ArduinoBLE peripheral API: the characteristics record what the
+  firmware notifies, and the host plays the central. It connects (BLE.setConnected), which subscribes
+  it to every notifying characteristic, and writes values as a central would (centralWrite).
+*/
+#ifndef SIM_ARDUINO_BLE_h
+#define SIM_ARDUINO_BLE_h
+
+#include <stdint.h>
+#include <functional>
+#include <vector>
+
+#define BLERead 0x02
+#define BLEWriteWithoutResponse 0x04
+#define BLEWrite 0x08
+#define BLENotify 0x10
+#define BLEIndicate 0x20
+
+class BLECharacteristic
+{
+	public:
+		typedef std::function<void(const uint8_t *data, int length)> Listener;
+
+		BLECharacteristic(const char *uuid, uint8_t properties, int valueSize)
+			: id(uuid), props(properties), size(valueSize), fresh(false), writes(0), bytes(0) {}
+
+		// same contract as the library: values longer than the characteristic are refused, a subscribed
+		// central is notified
+		int writeValue(const uint8_t *data, int length);
+
+		bool subscribed() const;
+		// a central wrote the value since the last call
+		bool written() {
+			bool w = fresh;
+			fresh = false;
+			return w;
+		}
+		const uint8_t *value() const { return stored.data(); }
+		int valueLength() const { return stored.size(); }
+		const char *uuid() const { return id; }
+
+		// the central's side
+		void centralWrite(const uint8_t *data, int length) {
+			stored.assign(data, data + length);
+			fresh = true;
+		}
+		// every notification the central gets
+		void setListener(const Listener &l) { listener = l; }
+		// sees every notification before the listener, e.g. to log what a receiver would get
+		void setRecorder(const Listener &r) { recorder = r; }
+
+		uint32_t notifications() const { return writes; }
+		uint64_t payloadBytes() const { return bytes; }
+
+	private:
+		const char *id;
+		uint8_t props;
+		int size;
+		bool fresh;
+		uint32_t writes;
+		uint64_t bytes;
+		std::vector<uint8_t> stored;
+		Listener listener;
+		Listener recorder;
+};
+
+class BLEService
+{
+	public:
+		BLEService(const char *uuid) : id(uuid) {}
+		void addCharacteristic(BLECharacteristic &) {}
+		const char *uuid() const { return id; }
+
+	private:
+		const char *id;
+};
+
+class BLELocalDevice
+{
+	public:
+		BLELocalDevice() : central(false) {}
+
+		int begin() { return 1; }
+		void setLocalName(const char *) {}
+		void setAdvertisedService(const BLEService &) {}
+		void setAdvertisedServiceUuid(const char *) {}
+		void addService(BLEService &) {}
+		int advertise() { return 1; }
+		void poll() {}
+		bool connected() const { return central; }
+
+		// the central's side
+		void setConnected(bool connected) { central = connected; }
+
+	private:
+		bool central;
+};
+
+extern BLELocalDevice BLE;
+
+inline bool BLECharacteristic::subscribed() const {
+	return (props & (BLENotify | BLEIndicate)) && BLE.connected();
+}
+
+inline int BLECharacteristic::writeValue(const uint8_t *data, int length) {
+	if (length > size) {
+		return 0;
+	}
+	stored.assign(data, data + length);
+	if (!subscribed()) {
+		return 1;
+	}
+	++writes;
+	bytes += length;
+	if (recorder) {
+		recorder(data, length);
+	}
+	if (listener) {
+		listener(data, length);
+	}
+	return 1;
+}
+
+#endif /* SIM_ARDUINO_BLE_h */
@@ -0,0 +1,58 @@
+#include <Arduino.h>
+#include <SimAnalog.h>
+
+#define SIM_SAMPLE_HOLD_PF 14.0f
+
+float simNoise(uint32_t &seed) {
+	// xorshift32, mapped to [-1, 1)
+	seed ^= seed << 13;
+	seed ^= seed >> 17;
+	seed ^= seed << 5;
+	return (seed >> 8) * (2.0f / 16777216.0f) - 1.0f;
+}
+
+SimCapacitivePad::SimCapacitivePad(uint8_t pin, float pad, float touchDelta, uint16_t scale) {
+	padPf = pad;
+	touchPf = touchDelta;
+	driftPf = 0;
+	driftPeriodS = 3600;
+	noise = 1.0f;
+	fullScale = scale;
+	seed = 0x9E3779B9u ^ pin;
+	SimHal::attach(pin, this);
+}
+
+int SimCapacitivePad::analogValue(uint8_t pin) {
+	uint64_t now = SimHal::nanos();
+	float c = padPf;
+	if (touch) {
+		c += touchPf * touch(now);
+	}
+	if (driftPf != 0) {
+		c += driftPf * sinf(2.0f * (float) M_PI * (now / 1e9f) / driftPeriodS);
+	}
+	float v = fullScale * c / (c + SIM_SAMPLE_HOLD_PF) + noise * simNoise(seed);
+	if (v < 0) {
+		v = 0;
+	}
+	return v > fullScale ? fullScale : (int) v;
+}
+
+SimPiezo::SimPiezo(uint8_t pin, uint16_t scale, float reference) {
+	fullScale = scale;
+	vref = reference;
+	SimHal::attach(pin, this);
+}
+
+int SimPiezo::analogValue(uint8_t pin) {
+	return reading(SimHal::nanos());
+}
+
+int SimPiezo::reading(uint64_t atNs) {
+	float v = wave ? wave(atNs) : 0.0f;
+	int counts = (int) (v / vref * fullScale + 0.5f);
+	if (counts < 0) {
+		return 0;
+	}
+	return counts > fullScale ? fullScale : counts;
+}
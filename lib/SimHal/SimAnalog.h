@@ -0,0 +1,68 @@
+/*
+  SimAnalog.h - analog front-end models for the simulated plank.
+  SimCapacitivePad: an ADCTouch electrode. The charged pad shares its charge with the discharged
+  sample-and-hold capacitor, so the reading is full scale * Cpad / (Cpad + Csh); a finger adds
+  capacitance, humidity and temperature drift it slowly.
+  SimPiezo: a piezo disc on an ESP32 ADC pin, 12-bit over 0-3.3V.
+*/
+#ifndef SIM_ANALOG_h
+#define SIM_ANALOG_h
+
+#include <stdint.h>
+#include <functional>
+#include <SimHal.h>
+
+class SimCapacitivePad : public SimPinDevice
+{
+	public:
+		// returns the touch strength in [0, 1] at a given time
+		typedef std::function<float(uint64_t nowNs)> TouchProfile;
+
+		SimCapacitivePad(uint8_t pin, float padPf = 20.0f, float touchPf = 12.0f, uint16_t fullScale = 1023);
+
+		void setTouch(const TouchProfile &profile) { touch = profile; }
+		// slow baseline wander: peak capacitance change (pF) and period
+		void setDrift(float pf, float periodSeconds) { driftPf = pf; driftPeriodS = periodSeconds; }
+		void setNoise(float counts) { noise = counts; }
+
+		int pinLevel(uint8_t) { return 1; }
+		void pinWritten(uint8_t, int) {}
+		int analogValue(uint8_t pin);
+
+	private:
+		float padPf;
+		float touchPf;
+		float driftPf;
+		float driftPeriodS;
+		float noise;
+		uint16_t fullScale;
+		uint32_t seed;
+		TouchProfile touch;
+};
+
+class SimPiezo : public SimPinDevice
+{
+	public:
+		// returns the voltage at the ADC pin at a given time
+		typedef std::function<float(uint64_t nowNs)> Waveform;
+
+		SimPiezo(uint8_t pin, uint16_t fullScale = 4095, float vref = 3.3f);
+
+		void setWaveform(const Waveform &w) { wave = w; }
+
+		int pinLevel(uint8_t) { return 0; }
+		void pinWritten(uint8_t, int) {}
+		int analogValue(uint8_t pin);
+		// the reading of a conversion at a given time, for ADC DMA stand-ins
+		int reading(uint64_t atNs);
+
+	private:
+		uint16_t fullScale;
+		float vref;
+		Waveform wave;
+};
+
+// small deterministic noise source shared by the models
+float simNoise(uint32_t &seed);
+
+#endif /* SIM_ANALOG_h */
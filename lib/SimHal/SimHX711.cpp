@@ -0,0 +1,89 @@
+#include <Arduino.h>
+#include <SimHX711.h>
+
+#define SIM_HX711_POWER_DOWN_NS 60000ULL
+
+SimHX711::SimHX711(uint8_t pd_sck, uint8_t dout, uint16_t sps) {
+	sckPin = pd_sck;
+	doutPin = dout;
+	periodNs = sps ? 1000000000ULL / sps : 0;
+	readyAt = SimHal::nanos() + periodNs;
+	highSince = 0;
+	clockHigh = false;
+	ready = false;
+	pulses = 0;
+	latched = 0;
+	nextInput = A128;
+	readouts = 0;
+	downs = 0;
+	setValue(0);
+
+	SimHal::attach(sckPin, this);
+	SimHal::attach(doutPin, this);
+}
+
+void SimHX711::setSource(const Source &src) {
+	source = src;
+}
+
+void SimHX711::setValue(int32_t raw) {
+	source = [raw](uint64_t, Input) { return raw; };
+}
+
+void SimHX711::update() {
+	uint64_t now = SimHal::nanos();
+
+	// the gain pulses are over once the clock is back low and DOUT gets sampled again
+	if (pulses >= 25 && !clockHigh) {
+		nextInput = pulses == 26 ? B32 : (pulses == 27 ? A64 : A128);
+		pulses = 0;
+		ready = false;
+		++readouts;
+		readyAt = readyAt + periodNs > now ? readyAt + periodNs : now;
+	}
+
+	if (pulses == 0 && !ready && now >= readyAt) {
+		latched = source(now, nextInput) & 0x00FFFFFF;
+		ready = true;
+	}
+}
+
+int SimHX711::pinLevel(uint8_t pin) {
+	if (pin == sckPin) {
+		return clockHigh ? HIGH : LOW;
+	}
+	update();
+	if (pulses == 0) {
+		return ready ? LOW : HIGH;
+	}
+	if (pulses <= 24) {
+		return (latched >> (24 - pulses)) & 1;
+	}
+	return HIGH;
+}
+
+void SimHX711::pinWritten(uint8_t pin, int level) {
+	if (pin != sckPin) {
+		return;
+	}
+	uint64_t now = SimHal::nanos();
+
+	if (level == HIGH && !clockHigh) {
+		clockHigh = true;
+		highSince = now;
+		update();
+		if (ready && pulses < 27) {
+			++pulses;
+		}
+	} else if (level == LOW && clockHigh) {
+		clockHigh = false;
+		if (now - highSince > SIM_HX711_POWER_DOWN_NS) {
+			// power down and reset: the chip comes back on channel A, gain 128
+			++downs;
+			pulses = 0;
+			ready = false;
+			nextInput = A128;
+			readyAt = now + 4 * periodNs;
+		}
+	}
+}
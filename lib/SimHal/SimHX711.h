@@ -0,0 +1,56 @@
+/*
+  SimHX711.h - behavioural model of one HX711 24-bit bridge ADC on the simulated board.
+  Follows the datasheet timing: DOUT low when a conversion is ready, bits shifted out MSB first
+  on PD_SCK rising edges, 25/26/27 pulses select A128/B32/A64 for the next conversion, and
+  PD_SCK held high for more than 60us powers the chip down.
+*/
+#ifndef SIM_HX711_h
+#define SIM_HX711_h
+
+#include <stdint.h>
+#include <functional>
+#include <SimHal.h>
+
+class SimHX711 : public SimPinDevice
+{
+	public:
+		enum Input { A128 = 0, B32 = 1, A64 = 2 };
+
+		// produces the raw 24-bit conversion result for a given time and input
+		typedef std::function<int32_t(uint64_t nowNs, Input input)> Source;
+
+		// sps: output data rate; 0 means a conversion is always ready
+		SimHX711(uint8_t pd_sck, uint8_t dout, uint16_t sps = 10);
+
+		void setSource(const Source &source);
+		void setValue(int32_t raw);
+
+		// input/gain the next conversion will be taken on
+		Input input() const { return nextInput; }
+
+		uint32_t conversions() const { return readouts; }
+		uint32_t powerDowns() const { return downs; }
+		uint64_t nextReadyNs() const { return readyAt; }
+
+		int pinLevel(uint8_t pin);
+		void pinWritten(uint8_t pin, int level);
+
+	private:
+		void update();
+
+		uint8_t sckPin;
+		uint8_t doutPin;
+		uint64_t periodNs;
+		uint64_t readyAt;
+		uint64_t highSince;
+		bool clockHigh;
+		bool ready;
+		uint8_t pulses;
+		int32_t latched;
+		Input nextInput;
+		Source source;
+		uint32_t readouts;
+		uint32_t downs;
+};
+
+#endif /* SIM_HX711_h */
@@ -0,0 +1,306 @@
+#include <Arduino.h>
+#include <ArduinoBLE.h>
+#include <SimHal.h>
+#include <stdio.h>
+
+SimConsole Serial;
+SimAdcRegister ADMUX;
+SimAdcRegister ADCSRA;
+SimAdcRegister ADCSRB;
+
+struct SimCpu {
+	uint64_t nanos;
+	uint32_t callCostNs;
+	uint32_t analogCostNs;
+	uint64_t clockOffsetNs;
+	double clockRate;		// crystal ticks per simulated ns
+};
+
+static SimCpu cpus[SIM_CPU_COUNT];
+static SimCpu *cpu = &cpus[0];
+static uint64_t accesses = 0;
+static SimPinDevice *devices[SIM_PIN_COUNT][SIM_DEVICES_PER_PIN];
+static uint8_t latches[SIM_PIN_COUNT];
+static uint8_t modes[SIM_PIN_COUNT];
+static uint64_t adcDoneAt;		// 0 while no background conversion runs
+static uint8_t adcChannel;		// MUX5:0 when it started
+
+// what the selected CPU's crystal reads
+static inline uint64_t localNanos() {
+	return cpu->clockOffsetNs + (uint64_t) (cpu->nanos * cpu->clockRate);
+}
+
+static inline void charge() {
+	cpu->nanos += cpu->callCostNs;
+	++accesses;
+}
+
+static int levelOf(uint8_t pin) {
+	if (pin >= SIM_PIN_COUNT) {
+		return LOW;
+	}
+	if (devices[pin][0] != NULL) {
+		return devices[pin][0]->pinLevel(pin);
+	}
+	if (modes[pin] == INPUT_PULLUP) {
+		return HIGH;
+	}
+	return latches[pin];
+}
+
+static void setLevel(uint8_t pin, int level) {
+	if (pin >= SIM_PIN_COUNT) {
+		return;
+	}
+	latches[pin] = level ? HIGH : LOW;
+	for (int i = 0; i < SIM_DEVICES_PER_PIN && devices[pin][i] != NULL; ++i) {
+		devices[pin][i]->pinWritten(pin, latches[pin]);
+	}
+}
+
+namespace SimHal
+{
+	void reset() {
+		for (int i = 0; i < SIM_CPU_COUNT; ++i) {
+			cpus[i].nanos = 0;
+			cpus[i].callCostNs = 50;
+			cpus[i].analogCostNs = 10000;
+			cpus[i].clockOffsetNs = 0;
+			cpus[i].clockRate = 1.0;
+		}
+		cpu = &cpus[0];
+		accesses = 0;
+		memset(devices, 0, sizeof(devices));
+		memset(latches, 0, sizeof(latches));
+		memset(modes, 0, sizeof(modes));
+		adcDoneAt = 0;
+	}
+
+	uint64_t nanos() {
+		return cpu->nanos;
+	}
+
+	void advanceNanos(uint64_t ns) {
+		cpu->nanos += ns;
+	}
+
+	void selectCpu(uint8_t n) {
+		cpu = &cpus[n < SIM_CPU_COUNT ? n : 0];
+	}
+
+	uint8_t currentCpu() {
+		return cpu - cpus;
+	}
+
+	uint64_t cpuNanos(uint8_t n) {
+		return cpus[n < SIM_CPU_COUNT ? n : 0].nanos;
+	}
+
+	void setClock(uint64_t offsetUs, double ppm) {
+		cpu->clockOffsetNs = offsetUs * 1000ULL;
+		cpu->clockRate = 1.0 + ppm * 1e-6;
+	}
+
+	void setCallCostNs(uint32_t ns) {
+		cpu->callCostNs = ns;
+	}
+
+	void setAnalogCostNs(uint32_t ns) {
+		cpu->analogCostNs = ns;
+	}
+
+	uint64_t pinAccesses() {
+		return accesses;
+	}
+
+	void attach(uint8_t pin, SimPinDevice *device) {
+		if (pin >= SIM_PIN_COUNT) {
+			return;
+		}
+		for (int i = 0; i < SIM_DEVICES_PER_PIN; ++i) {
+			if (devices[pin][i] == NULL || devices[pin][i] == device) {
+				devices[pin][i] = device;
+				return;
+			}
+		}
+	}
+
+	int outputLevel(uint8_t pin) {
+		return pin < SIM_PIN_COUNT ? latches[pin] : LOW;
+	}
+
+	uint64_t adcCompletionNs() {
+		return adcDoneAt;
+	}
+
+	bool adcInterruptPending() {
+		return adcDoneAt != 0 && cpu->nanos >= adcDoneAt;
+	}
+
+	uint16_t takeAdcResult() {
+		adcDoneAt = 0;
+		if ((adcChannel & 0x1F) == 0x1F) {
+			return 0;
+		}
+		// ATmega2560 single-ended channels: MUX2:0 selects A0-A7, MUX5 adds 8
+		uint8_t pin = A0 + (adcChannel & 0x07) + ((adcChannel & 0x20) ? 8 : 0);
+		if (devices[pin][0] != NULL) {
+			return devices[pin][0]->analogValue(pin);
+		}
+		return levelOf(pin) == HIGH ? 1023 : 0;
+	}
+
+	uint32_t readInputRegister(uint8_t bank) {
+		charge();
+		uint32_t value = 0;
+		for (uint8_t bit = 0; bit < 32; ++bit) {
+			if (levelOf(bank * 32 + bit) == HIGH) {
+				value |= 1UL << bit;
+			}
+		}
+		return value;
+	}
+
+	void writeOutputRegister(uint8_t bank, uint32_t setMask, uint32_t clearMask) {
+		charge();
+		for (uint8_t bit = 0; bit < 32; ++bit) {
+			if (setMask & (1UL << bit)) {
+				setLevel(bank * 32 + bit, HIGH);
+			} else if (clearMask & (1UL << bit)) {
+				setLevel(bank * 32 + bit, LOW);
+			}
+		}
+	}
+}
+
+void pinMode(uint8_t pin, uint8_t mode) {
+	charge();
+	if (pin < SIM_PIN_COUNT) {
+		modes[pin] = mode;
+	}
+}
+
+void digitalWrite(uint8_t pin, uint8_t val) {
+	charge();
+	setLevel(pin, val);
+}
+
+int digitalRead(uint8_t pin) {
+	charge();
+	return levelOf(pin);
+}
+
+int analogRead(uint8_t pin) {
+	charge();
+	cpu->nanos += cpu->analogCostNs;
+	if (pin < SIM_PIN_COUNT && devices[pin][0] != NULL) {
+		return devices[pin][0]->analogValue(pin);
+	}
+	return levelOf(pin) == HIGH ? 4095 : 0;
+}
+
+SimAdcRegister &SimAdcRegister::operator=(uint8_t v) {
+	if (this == &ADCSRA && (v & (1 << ADSC))) {
+		charge();
+		if (v & (1 << ADIE)) {
+			adcChannel = (ADMUX & 0x1F) | ((ADCSRB & (1 << MUX5)) ? 0x20 : 0);
+			adcDoneAt = cpu->nanos + cpu->analogCostNs;
+		} else {
+			cpu->nanos += cpu->analogCostNs;
+		}
+		v &= ~(1 << ADSC);
+	}
+	value = v;
+	return *this;
+}
+
+unsigned long millis() {
+	return (unsigned long) (localNanos() / 1000000ULL);
+}
+
+unsigned long micros() {
+	return (unsigned long) (localNanos() / 1000ULL);
+}
+
+uint32_t SimEsp::getCycleCount() {
+	return (uint32_t) (localNanos() * SIM_CPU_MHZ / 1000ULL);
+}
+
+SimEsp ESP;
+BLELocalDevice BLE;
+
+void delay(unsigned long ms) {
+	cpu->nanos += (uint64_t) ms * 1000000ULL;
+}
+
+void delayMicroseconds(unsigned int us) {
+	cpu->nanos += (uint64_t) us * 1000ULL;
+}
+
+long map(long x, long in_min, long in_max, long out_min, long out_max) {
+	return (x - in_min) * (out_max - out_min) / (in_max - in_min) + out_min;
+}
+
+size_t Print::write(const uint8_t *buffer, size_t size) {
+	size_t n = 0;
+	while (size--) {
+		n += write(*buffer++);
+	}
+	return n;
+}
+
+size_t Print::print(const char *s) {
+	return write((const uint8_t *) s, strlen(s));
+}
+
+size_t Print::print(char c) {
+	return write((uint8_t) c);
+}
+
+size_t Print::print(int n, int base) {
+	return print((long) n, base);
+}
+
+size_t Print::print(unsigned int n, int base) {
+	return print((unsigned long) n, base);
+}
+
+size_t Print::print(long n, int base) {
+	if (base == DEC && n < 0) {
+		return print('-') + print((unsigned long) -n, base);
+	}
+	return print((unsigned long) n, base);
+}
+
+size_t Print::print(unsigned long n, int base) {
+	char buf[8 * sizeof(long) + 1];
+	char *str = &buf[sizeof(buf) - 1];
+	*str = '\0';
+	if (base < 2) {
+		base = 10;
+	}
+	do {
+		unsigned long m = n;
+		n /= base;
+		char c = m - base * n;
+		*--str = c < 10 ? c + '0' : c + 'A' - 10;
+	} while (n);
+	return print(str);
+}
+
+size_t Print::print(double n, int digits) {
+	char buf[48];
+	snprintf(buf, sizeof(buf), "%.*f", digits, n);
+	return print(buf);
+}
+
+size_t Print::println() {
+	return print("\r\n");
+}
+
+size_t SimConsole::write(uint8_t c) {
+	if (!muted) {
+		fputc(c, stdout);
+	}
+	return 1;
+}
@@ -0,0 +1,76 @@
+/*
+  SimHal.h - simulated board behind the Arduino.h shim.
+  Time is virtual: it only moves when the firmware calls into the HAL (each call
+  is charged callCostNs) or when the host advances it explicitly.
+  Several MCUs can share the board: each one runs on its own clock, selected with selectCpu(),
+  and the host scheduler always resumes the one that is furthest behind.
+*/
+#ifndef SIM_HAL_h
+#define SIM_HAL_h
+
+#include <stdint.h>
+
+#define SIM_PIN_COUNT 96
+#define SIM_CPU_COUNT 4
+#define SIM_DEVICES_PER_PIN 8
+
+// a simulated peripheral that drives and/or listens to board pins
+class SimPinDevice
+{
+	public:
+		virtual ~SimPinDevice() {}
+		// level the device drives onto the pin
+		virtual int pinLevel(uint8_t pin) = 0;
+		// the firmware wrote a new level to a pin the device listens to
+		virtual void pinWritten(uint8_t pin, int level) = 0;
+		// analogRead() result, in the resolution of the MCU reading it
+		virtual int analogValue(uint8_t pin) { return pinLevel(pin) ? 4095 : 0; }
+};
+
+namespace SimHal
+{
+	// drops all devices, levels and counters and rewinds the clock
+	void reset();
+
+	// clock of the selected CPU
+	uint64_t nanos();
+	void advanceNanos(uint64_t ns);
+
+	// switches the CPU whose clock the HAL calls run on
+	void selectCpu(uint8_t cpu);
+	uint8_t currentCpu();
+	uint64_t cpuNanos(uint8_t cpu);
+
+	// crystal of the selected CPU: its millis() and micros() read offsetUs plus its clock running ppm
+	// fast (negative: slow). The simulated time itself, nanos(), stays common to every CPU.
+	void setClock(uint64_t offsetUs, double ppm);
+
+	// virtual CPU time charged to the selected CPU for every pin access
+	void setCallCostNs(uint32_t ns);
+	// conversion time of analogRead() and of an ADSC-started conversion on the selected CPU
+	void setAnalogCostNs(uint32_t ns);
+
+	// number of pin accesses (digitalRead/digitalWrite/register reads) since reset
+	uint64_t pinAccesses();
+
+	// connects a device to a pin; several devices may listen to one pin (e.g. a shared PD_SCK),
+	// the first one attached drives the level read back
+	void attach(uint8_t pin, SimPinDevice *device);
+
+	// output latch of a pin, as last written by the firmware
+	int outputLevel(uint8_t pin);
+
+	// background ADC conversion (ADSC written with ADIE set): when it completes, 0 if none is running
+	uint64_t adcCompletionNs();
+	bool adcInterruptPending();
+	// result of the completed conversion, from the pad on the multiplexed analog pin (0 for the GND
+	// channel); ends the conversion
+	uint16_t takeAdcResult();
+
+	// one-shot read of 32 input levels, like GPIO_IN_REG (bank 0) / GPIO_IN1_REG (bank 1)
+	uint32_t readInputRegister(uint8_t bank);
+	// one-shot write of the output set/clear registers
+	void writeOutputRegister(uint8_t bank, uint32_t setMask, uint32_t clearMask);
+}
+
+#endif /* SIM_HAL_h */
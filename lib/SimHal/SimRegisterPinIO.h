@@ -0,0 +1,87 @@
+/*
+  SimRegisterPinIO.h - host counterpart of HX711Esp32PinIO: drives PD_SCK through the simulated
+  set/clear registers and latches every DOUT line with one simulated input-register read per edge.
+  SimRegisterPins is the same for HX711Static: the pin set of HX711Pins on the ESP32, on SimHal.
+*/
+#ifndef SIM_REGISTER_PINIO_h
+#define SIM_REGISTER_PINIO_h
+
+#include <Arduino.h>
+#include <HX711-pinio.h>
+#include <HX711-static.h>
+#include <SimHal.h>
+
+class SimRegisterPinIO : public HX711PinIO
+{
+	private:
+		uint8_t clockBank;
+		uint32_t clockMask;
+		bool needBank1;
+		byte COUNT;
+		byte SHIFT[32];
+
+	public:
+		void begin(byte pd_sck, const byte *dout, byte count) {
+			COUNT = count > 32 ? 32 : count;
+			clockBank = pd_sck >= 32;
+			clockMask = 1UL << (pd_sck & 31);
+			needBank1 = false;
+			pinMode(pd_sck, OUTPUT);
+			for (int j = 0; j < COUNT; ++j) {
+				pinMode(dout[j], INPUT);
+				SHIFT[j] = dout[j] & 63;
+				if (dout[j] >= 32) {
+					needBank1 = true;
+				}
+			}
+		}
+
+		void writeClock(bool high) {
+			SimHal::writeOutputRegister(clockBank, high ? clockMask : 0, high ? 0 : clockMask);
+		}
+
+		uint32_t readDataLines() {
+			uint64_t in = SimHal::readInputRegister(0);
+			if (needBank1) {
+				in |= (uint64_t) SimHal::readInputRegister(1) << 32;
+			}
+			uint32_t lines = 0;
+			for (int j = 0; j < COUNT; ++j) {
+				lines |= (uint32_t) ((in >> SHIFT[j]) & 1) << j;
+			}
+			return lines;
+		}
+};
+
+template <byte PD_SCK, byte... DOUT>
+class SimRegisterPins
+{
+	private:
+		typedef HX711DoutSet<DOUT...> Dout;
+
+		static inline uint64_t levels() {
+			uint64_t in = SimHal::readInputRegister(0);
+			if (Dout::BANK1) {
+				in |= (uint64_t) SimHal::readInputRegister(1) << 32;
+			}
+			return in;
+		}
+
+	public:
+		static const byte COUNT = Dout::COUNT;
+
+		static void begin() {
+			pinMode(PD_SCK, OUTPUT);
+			Dout::begin();
+		}
+
+		static inline void clock(bool high) {
+			uint32_t mask = 1UL << (PD_SCK & 31);
+			SimHal::writeOutputRegister(PD_SCK >= 32, high ? mask : 0, high ? 0 : mask);
+		}
+
+		static inline bool ready() { return (levels() & Dout::MASK) == 0; }
+		static inline void shift(uint32_t *words) { Dout::shift(levels(), words); }
+};
+
+#endif /* SIM_REGISTER_PINIO_h */
@@ -0,0 +1,81 @@
+#include <SimUart.h>
+#include <SimHal.h>
+
+SimUart::SimUart() {
+	peer = NULL;
+	lineFreeAt = 0;
+	written = 0;
+	dropped = corrupted = 0;
+	setLoss(0, 0);
+	begin(115200);
+}
+
+void SimUart::connect(SimUart &a, SimUart &b) {
+	a.peer = &b;
+	b.peer = &a;
+}
+
+void SimUart::begin(unsigned long baud) {
+	byteNs = 10ULL * 1000000000ULL / baud;
+}
+
+void SimUart::setLoss(double dropRate, double flipRate, uint32_t seed) {
+	this->dropRate = dropRate;
+	this->flipRate = flipRate;
+	this->seed = seed ? seed : 1;
+}
+
+// xorshift32, uniform in [0, 1)
+double SimUart::random() {
+	seed ^= seed << 13;
+	seed ^= seed >> 17;
+	seed ^= seed << 5;
+	return seed / 4294967296.0;
+}
+
+void SimUart::deliver(uint8_t value, uint64_t arrivalNs) {
+	InFlight f = { arrivalNs, value };
+	rx.push_back(f);
+}
+
+int SimUart::available() {
+	uint64_t now = SimHal::nanos();
+	int n = 0;
+	for (std::deque<InFlight>::const_iterator it = rx.begin(); it != rx.end() && it->arrivalNs <= now; ++it) {
+		++n;
+	}
+	return n;
+}
+
+int SimUart::peek() {
+	if (rx.empty() || rx.front().arrivalNs > SimHal::nanos()) {
+		return -1;
+	}
+	return rx.front().value;
+}
+
+int SimUart::read() {
+	int c = peek();
+	if (c >= 0) {
+		rx.pop_front();
+	}
+	return c;
+}
+
+size_t SimUart::write(uint8_t c) {
+	uint64_t now = SimHal::nanos();
+	lineFreeAt = (lineFreeAt > now ? lineFreeAt : now) + byteNs;
+	++written;
+	if (dropRate > 0 && random() < dropRate) {
+		++dropped;
+		return 1;
+	}
+	if (flipRate > 0 && random() < flipRate) {
+		c ^= 1 << (seed & 7);
+		++corrupted;
+	}
+	if (peer != NULL) {
+		peer->deliver(c, lineFreeAt);
+	}
+	return 1;
+}
@@ -0,0 +1,57 @@
+/*
+  SimUart.h - one end of a simulated serial line. Bytes written on one end arrive on the
+  connected end after their wire time at the configured baud rate (10 bits per byte, 8N1).
+  setLoss() makes the line from this end lossy: bytes go missing or arrive with one bit flipped.
+*/
+#ifndef SIM_UART_h
+#define SIM_UART_h
+
+#include <Arduino.h>
+#include <deque>
+
+class SimUart : public Stream
+{
+	public:
+		SimUart();
+
+		// wires two ends together, both ways
+		static void connect(SimUart &a, SimUart &b);
+
+		void begin(unsigned long baud);
+
+		// probabilities per byte written on this end
+		void setLoss(double dropRate, double flipRate, uint32_t seed = 1);
+
+		int available();
+		int read();
+		int peek();
+
+		using Print::write;
+		size_t write(uint8_t c);
+
+		uint32_t bytesWritten() const { return written; }
+		uint32_t bytesDropped() const { return dropped; }
+		uint32_t bytesCorrupted() const { return corrupted; }
+
+	private:
+		struct InFlight {
+			uint64_t arrivalNs;
+			uint8_t value;
+		};
+
+		void deliver(uint8_t value, uint64_t arrivalNs);
+		double random();
+
+		SimUart *peer;
+		std::deque<InFlight> rx;
+		uint64_t byteNs;
+		uint64_t lineFreeAt;	// when the transmitter finishes the byte in progress
+		uint32_t written;
+		double dropRate;
+		double flipRate;
+		uint32_t seed;
+		uint32_t dropped;
+		uint32_t corrupted;
+};
+
+#endif /* SIM_UART_h */
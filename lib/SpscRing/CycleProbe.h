@@ -0,0 +1,138 @@
+/*
+  CycleProbe.h - what a stretch of code costs on the target, in CPU cycles: count, min, mean, max and
+  a histogram, in fixed memory.
+
+  PROBE_SCOPE(probe) at the top of a block reads the cycle counter (CCOUNT on the ESP32, one RSR
+  instruction) there and again when the block is left, and records the difference: two counter reads,
+  a leading-zero count and a few adds, some 20 to 30 cycles. Unlike TaskMeter's micros() the cycles
+  show a cache miss or an interrupt in the middle of the block. The count is per core: a probe is
+  recorded and read by the one task that owns it, and the block must not migrate to the other core,
+  which pinned tasks do not. A block longer than 2^32 cycles (17 s at 240 MHz) wraps.
+
+  Building with -DPLANK_PROBES=0 compiles every PROBE_SCOPE out; the probes then stay empty.
+
+  Histogram bucket i counts the passes of 2^(i + PROBE_BUCKET_SHIFT) cycles up to twice that; the
+  first bucket also takes the shorter ones, the last the longer ones: 2 us to 35 ms at 240 MHz.
+*/
+#ifndef CYCLE_PROBE_h
+#define CYCLE_PROBE_h
+
+#include <Arduino.h>
+
+#ifndef PLANK_PROBES
+#define PLANK_PROBES 1
+#endif
+
+#define PROBE_BUCKETS 16
+#define PROBE_BUCKET_SHIFT 8
+#define PROBE_PACKET_SIZE(nameLength) (19 + PROBE_BUCKETS * 2 + (nameLength))
+
+class CycleProbe
+{
+	public:
+		CycleProbe(const char *name) : label(name) { reset(); }
+
+		void record(uint32_t cycles) {
+			++count;
+			total += cycles;
+			least = cycles < least ? cycles : least;
+			most = cycles > most ? cycles : most;
+			uint8_t top = cycles >> PROBE_BUCKET_SHIFT ? 31 - __builtin_clz(cycles) - PROBE_BUCKET_SHIFT : 0;
+			++histogram[top < PROBE_BUCKETS ? top : PROBE_BUCKETS - 1];
+		}
+
+		void reset() {
+			count = 0;
+			total = 0;
+			least = UINT32_MAX;
+			most = 0;
+			memset(histogram, 0, sizeof(histogram));
+		}
+
+		const char *name() const { return label; }
+		uint32_t passes() const { return count; }
+		uint32_t minCycles() const { return count ? least : 0; }
+		uint32_t maxCycles() const { return most; }
+		uint32_t meanCycles() const { return count ? (uint32_t) (total / count) : 0; }
+		uint32_t bucket(uint8_t i) const { return histogram[i]; }
+
+	private:
+		const char *label;
+		uint32_t count;
+		uint64_t total;
+		uint32_t least;
+		uint32_t most;
+		uint32_t histogram[PROBE_BUCKETS];
+};
+
+class ProbeScope
+{
+	public:
+		ProbeScope(CycleProbe &probe) : probe(probe), start(ESP.getCycleCount()) {}
+		~ProbeScope() { probe.record(ESP.getCycleCount() - start); }
+
+	private:
+		CycleProbe &probe;
+		uint32_t start;
+};
+
+#if PLANK_PROBES
+#define PROBE_JOIN(a, b) a##b
+#define PROBE_NAME(line) PROBE_JOIN(probeScope, line)
+#define PROBE_SCOPE(probe) ProbeScope PROBE_NAME(__LINE__)(probe)
+#else
+#define PROBE_SCOPE(probe) do {} while (0)
+#endif
+
+// "updateBLEData: 1200 passes, 3100/4550/98000 cycles min/mean/max, 19.0 us mean" and the non-empty
+// buckets, "  >= 4096: 1150"
+inline void printCycleProbe(Print &out, const CycleProbe &probe) {
+	uint32_t mhz = ESP.getCpuFreqMHz();
+	out.print(probe.name());
+	out.print(": ");
+	out.print(probe.passes());
+	out.print(" passes, ");
+	out.print(probe.minCycles());
+	out.print("/");
+	out.print(probe.meanCycles());
+	out.print("/");
+	out.print(probe.maxCycles());
+	out.print(" cycles min/mean/max, ");
+	out.print(mhz ? (float) probe.meanCycles() / mhz : 0.0f, 1);
+	out.println(" us mean");
+	for (uint8_t i = 0; i < PROBE_BUCKETS; i++) {
+		if (probe.bucket(i) == 0) {
+			continue;
+		}
+		out.print(i == 0 ? "  <  " : "  >= ");
+		out.print(1UL << (PROBE_BUCKET_SHIFT + (i == 0 ? 1 : i)));
+		out.print(": ");
+		out.println(probe.bucket(i));
+	}
+}
+
+// one probe for a notification, little endian:
+//   index (u8) | passes (u32) | min (u32) | mean (u32) | max (u32) | buckets (u8) |
+//   bucket counts (u16 each, saturated) | name length (u8) | name
+inline size_t packCycleProbe(uint8_t *out, uint8_t index, const CycleProbe &probe) {
+	uint32_t words[4] = {probe.passes(), probe.minCycles(), probe.meanCycles(), probe.maxCycles()};
+	size_t at = 0;
+	out[at++] = index;
+	for (uint8_t w = 0; w < 4; w++) {
+		for (uint8_t b = 0; b < 4; b++) {
+			out[at++] = (words[w] >> (8 * b)) & 0xFF;
+		}
+	}
+	out[at++] = PROBE_BUCKETS;
+	for (uint8_t i = 0; i < PROBE_BUCKETS; i++) {
+		uint16_t n = probe.bucket(i) > 0xFFFF ? 0xFFFF : probe.bucket(i);
+		out[at++] = n & 0xFF;
+		out[at++] = n >> 8;
+	}
+	size_t length = strlen(probe.name());
+	out[at++] = length;
+	memcpy(&out[at], probe.name(), length);
+	return at + length;
+}
+
+#endif /* CYCLE_PROBE_h */
@@ -0,0 +1,67 @@
+/*
+  SpscRing.h - lock-free single-producer/single-consumer ring buffer.
+  One context (ISR or task) pushes, one other context pops; no locks, no heap.
+  Indices are free-running 32-bit counters, so it is meant for 32-bit targets (ESP32, host).
+*/
+#ifndef SPSC_RING_h
+#define SPSC_RING_h
+
+#include <stdint.h>
+#include <stddef.h>
+
+template <typename T, uint32_t N>
+class SpscRing
+{
+	static_assert(N >= 2 && (N & (N - 1)) == 0, "SpscRing size must be a power of two");
+
+	private:
+		T items[N];
+		uint32_t head;		// next slot to write, owned by the producer
+		uint32_t tail;		// next slot to read, owned by the consumer
+		uint32_t drops;		// pushes refused because the ring was full
+		uint32_t peak;		// most items ever waiting, seen by the producer
+
+	public:
+		SpscRing() : head(0), tail(0), drops(0), peak(0) {}
+
+		// producer side; returns false and counts a drop when the ring is full
+		bool push(const T &item) {
+			uint32_t h = head;
+			uint32_t waiting = h - __atomic_load_n(&tail, __ATOMIC_ACQUIRE);
+			if (waiting >= N) {
+				__atomic_store_n(&drops, drops + 1, __ATOMIC_RELAXED);
+				return false;
+			}
+			items[h & (N - 1)] = item;
+			__atomic_store_n(&head, h + 1, __ATOMIC_RELEASE);
+			if (waiting + 1 > peak) {
+				__atomic_store_n(&peak, waiting + 1, __ATOMIC_RELAXED);
+			}
+			return true;
+		}
+
+		// consumer side; returns false when the ring is empty
+		bool pop(T &item) {
+			uint32_t t = tail;
+			if (__atomic_load_n(&head, __ATOMIC_ACQUIRE) == t) {
+				return false;
+			}
+			item = items[t & (N - 1)];
+			__atomic_store_n(&tail, t + 1, __ATOMIC_RELEASE);
+			return true;
+		}
+
+		size_t size() const {
+			return __atomic_load_n(&head, __ATOMIC_ACQUIRE) - __atomic_load_n(&tail, __ATOMIC_ACQUIRE);
+		}
+
+		bool empty() const { return size() == 0; }
+
+		static size_t capacity() { return N; }
+
+		uint32_t dropped() const { return __atomic_load_n(&drops, __ATOMIC_RELAXED); }
+		// high-water mark: capacity() means the ring has been full, a drop was one push away
+		uint32_t highWater() const { return __atomic_load_n(&peak, __ATOMIC_RELAXED); }
+};
+
+#endif /* SPSC_RING_h */
@@ -0,0 +1,112 @@
+/*
+  TaskMeter.h - what a task costs: time spent working, passes of work, longest pass.
+  The task brackets every pass with begin()/end(); any other task may read the totals, no locks.
+  Busy time is micros() between begin() and end(), so it includes preemption by higher priority tasks
+  of the same core. Totals are 32-bit and wrap after 71 minutes: loads compare two readings.
+*/
+#ifndef TASK_METER_h
+#define TASK_METER_h
+
+#include <Arduino.h>
+
+class TaskMeter
+{
+	public:
+		TaskMeter(const char *name)
+			: label(name), handle(NULL), pinned(-1), prio(0), started(0), busy(0), count(0), longest(0),
+			  lastBusy(0), lastTime(0) {}
+
+		// where the task runs, for the reports: FreeRTOS handle (stack high-water mark), core (-1: any)
+		void place(void *task, int8_t core, uint8_t priority) {
+			handle = task;
+			pinned = core;
+			prio = priority;
+		}
+
+		void begin() { started = micros(); }
+		void end() {
+			uint32_t spent = micros() - started;
+			__atomic_store_n(&busy, busy + spent, __ATOMIC_RELAXED);
+			__atomic_store_n(&count, count + 1, __ATOMIC_RELAXED);
+			if (spent > longest) {
+				__atomic_store_n(&longest, spent, __ATOMIC_RELAXED);
+			}
+		}
+
+		const char *name() const { return label; }
+		void *task() const { return handle; }
+		int8_t core() const { return pinned; }
+		uint8_t priority() const { return prio; }
+		uint32_t busyMicros() const { return __atomic_load_n(&busy, __ATOMIC_RELAXED); }
+		uint32_t passes() const { return __atomic_load_n(&count, __ATOMIC_RELAXED); }
+		uint32_t longestMicros() const { return __atomic_load_n(&longest, __ATOMIC_RELAXED); }
+
+		// busy share of the time since the previous call, in per mille; for the one task that reports
+		uint16_t takeLoad() {
+			uint32_t now = micros();
+			uint32_t total = busyMicros();
+			uint32_t elapsed = now - lastTime;
+			uint16_t load = elapsed ? (uint16_t) ((uint64_t) (total - lastBusy) * 1000 / elapsed) : 0;
+			lastBusy = total;
+			lastTime = now;
+			return load;
+		}
+
+	private:
+		const char *label;
+		void *handle;
+		int8_t pinned;
+		uint8_t prio;
+		uint32_t started;
+		uint32_t busy;		// us
+		uint32_t count;
+		uint32_t longest;	// us
+		uint32_t lastBusy;	// at the previous takeLoad()
+		uint32_t lastTime;
+};
+
+// "hx711: core 1, priority 6, CPU 1.2 %, 3000 passes, longest 310 us[, free stack 1800 bytes]",
+// the CPU share since the previous report
+inline void printTaskMeter(Print &out, TaskMeter &meter) {
+	uint16_t load = meter.takeLoad();
+	out.print(meter.name());
+	out.print(": core ");
+	if (meter.core() < 0) {
+		out.print("any");
+	} else {
+		out.print((int) meter.core());
+	}
+	out.print(", priority ");
+	out.print((int) meter.priority());
+	out.print(", CPU ");
+	out.print(load / 10);
+	out.print(".");
+	out.print(load % 10);
+	out.print(" %, ");
+	out.print(meter.passes());
+	out.print(" passes, longest ");
+	out.print(meter.longestMicros());
+	out.print(" us");
+#if defined(ARDUINO_ARCH_ESP32)
+	if (NULL != meter.task()) {
+		out.print(", free stack ");
+		out.print(uxTaskGetStackHighWaterMark((TaskHandle_t) meter.task()));
+		out.print(" bytes");
+	}
+#endif
+	out.println();
+}
+
+// "piezo blocks: 3 of 8 at most, 0 dropped"
+inline void printQueueStats(Print &out, const char *name, uint32_t highWater, uint32_t capacity, uint32_t dropped) {
+	out.print(name);
+	out.print(": ");
+	out.print(highWater);
+	out.print(" of ");
+	out.print(capacity);
+	out.print(" at most, ");
+	out.print(dropped);
+	out.println(" dropped");
+}
+
+#endif /* TASK_METER_h */
@@ -1,6 +1,11 @@
 #include <Arduino.h>
 #include <ArduinoBLE.h>
 #include <HX711-multi.h>
+#include <SensorHub.h>
+#include <TaskMeter.h>
+#include <CycleProbe.h>
+#include <PlankLog.h>
+#include <SessionLog.h>
 
 #define CLK 18
 #define DOUT1 25
@@ -10,34 +15,113 @@
 
 #define AIN1 36    // A0
 #define AIN2 39    // A1
-#define AIN3 15    // A4
+#define AIN3 15    // A4, on ADC2: not sampled by the DMA, read with analogRead()
 #define AIN4 35    // A3
 
-#define PIEZO_COUNT 4
-#define CHANNEL_COUNT 4
+// 1: the SPI controller clocks the HX711 readouts, four DOUT lines in one quad read (HX711SpiPinIO)
+// 0: the acquisition task clocks them through the GPIO registers
+#ifndef HX711_SPI_READOUT
+#define HX711_SPI_READOUT 0
+#endif
+
+#define PIEZO_COUNT PLANK_PIEZO_COUNT
+#define CHANNEL_COUNT PLANK_STRAIN_COUNT
 #define TARE_TIMEOUT_SECONDS 4
+#define AUTO_TARE_SAMPLES 50      // 5 s at rest (10 SPS) before the zero is corrected
+#define AUTO_TARE_MAX_DRIFT 20000 // raw counts, about 24 units of the strain scaling
+
+// 1: one hit event per piezo and knock on the hit characteristic, no piezo levels
+// 0: the peak level of every piezo every 20 ms
+#define PIEZO_HIT_MODE 1
+
+// Tasks. Acquisition runs on core 1, away from the BLE controller that preempts everything on core 0;
+// processing and publishing share core 0 with it, so a slow notification only holds up the publishing
+// task. Debug output goes through PlankLog: a few bytes into its ring, written out by the log task.
+// What the link, process and publish tasks run is the SensorHub's (lib/PlankEsp32), which the
+// simulation in src/native runs as well.
+//   core 1  piezo    7  ADC DMA frames -> piezo blocks (PiezoSampler)
+//           hx711    6  DOUT edges -> strain samples (HX711MULTI::beginAsync)
+//           link     5  UART bytes from the Mega -> ACKs, frames; time requests to the Mega
+//   core 0  process  4  piezo blocks -> peaks, hits, captures
+//           publish  2  characteristics, BLE.poll(), serial commands; the samples to flash while no
+//                       central is connected, and the recorded sessions back out once one is
+//           log      1  PlankLog records -> USB serial port
+// Queues, all lock-free single-producer/single-consumer rings, and what a full one does:
+//   piezo blocks     piezo -> process     newest block dropped and counted
+//   strain samples   hx711 -> publish     newest sample dropped and counted; publish keeps the latest only
+//   link frames      link -> publish      the link task waits: frames stay in the link window, frames
+//                                         beyond it go unacknowledged and the Mega retransmits them
+//   piezo hits       process -> publish   newest hit dropped and counted
+//   piezo peaks      process -> publish   newest peaks dropped (level mode)
+//   captures         process <-> publish  one at a time, triggers meanwhile are counted as missed
+//   log records      any task -> log      newest record dropped, its sequence number goes missing
+// "tasks" on the serial port prints the CPU time of every task and the high-water mark of every queue.
+// An erase or program of the log partition turns the flash cache off and stalls both cores, up to
+// ~45 ms for a sector erase: the piezo block ring covers 128 ms, the UART driver buffer 22 ms of link
+// bytes the Mega retransmits if they overflow.
+#define ACQUISITION_CORE 1
+#define PROCESSING_CORE 0
+#define PIEZO_TASK_PRIORITY 7
+#define HX711_TASK_PRIORITY 6
+#define LINK_TASK_PRIORITY 5
+#define PROCESS_TASK_PRIORITY 4
+#define PUBLISH_TASK_PRIORITY 2
+#define LOG_TASK_PRIORITY 1
+#define LINK_POLL_MS 2         // the UART driver buffers 256 bytes, 22 ms at 115200 baud
+#define LINK_RX_TIMEOUT 1      // symbols of silence before the UART hands over a partial FIFO
+#define LOG_DRAIN_MS 10        // the log ring holds PLANK_LOG_BUFFER bytes, the TX FIFO 128
 
 const int piezoPins[PIEZO_COUNT] = {AIN1, AIN2, AIN3, AIN4};
 byte DOUTS[CHANNEL_COUNT] = {DOUT1, DOUT2, DOUT3, DOUT4};
+#if HX711_SPI_READOUT
+HX711SpiPinIO hx711Pins;  // the SPI controller clocks the readouts: PD_SCK immune to BLE interrupts
+HX711MULTI scales(CHANNEL_COUNT, DOUTS, CLK, 128, &hx711Pins);
+#else
 HX711MULTI scales(CHANNEL_COUNT, DOUTS, CLK);
+#endif
 
-const int numCapacitivePins = 16;
-const int numStrainGauges = CHANNEL_COUNT;
-int capacitiveData[numCapacitivePins];
-uint8_t strainGaugeData[numStrainGauges];
-uint16_t piezoData[PIEZO_COUNT];
+HX711Calibrator calibrator(scales);
+TaskMeter linkMeter("link");
+TaskMeter processMeter("process");
+TaskMeter publishMeter("publish");
+TaskMeter logMeter("log");
+PartitionStore logPartition;
+SensorHub hub(scales, Serial2, logPartition, piezoPins);
 
-BLEService sensorService("4fafc201-1fb5-459e-8fcc-c5c9c331914b");
-BLECharacteristic capacitiveCharacteristic("beb5483e-36e1-4688-b7f5-ea07361b26a8", BLERead | BLENotify, numCapacitivePins * 2 + 2);
-BLECharacteristic strainGaugeCharacteristic("cc54f4ce-1037-4b73-9e5a-cdcd53e85145", BLERead | BLENotify, numStrainGauges + 2);
-BLECharacteristic piezoCharacteristic("beb5483e-36e1-4688-b7f5-ea07361b26a9", BLERead | BLENotify, 10); 
+void tare();
+void startTask(TaskFunction_t body, TaskMeter &meter, uint32_t stack, uint8_t priority, int8_t core);
+void startProcessTask();
+void linkTask(void *);
+void publishTask(void *);
+void logTask(void *);
 
 void setup() {
   Serial.begin(115200);  // Pour le débogage via USB
   Serial2.begin(115200, SERIAL_8N1, 17, 16); // RX, TX pour la communication inter-contrôleurs
+  // Time replies reach the link task as soon as they end rather than after the default FIFO timeout,
+  // which would add to their round trip only
+  Serial2.setRxTimeout(LINK_RX_TIMEOUT);
 
   // Initialize strain gauge sensors
+  if (!scales.load_calibration()) {
+    Serial.println("No stored strain gauge calibration, using the default scaling");
+    for (int i = 0; i < CHANNEL_COUNT; i++) {
+      scales.set_calibration(i, HX711Calibration::fromFloat(STRAIN_DEFAULT_UNITS_PER_COUNT));
+    }
+  }
   tare();
+  scales.set_auto_tare(AUTO_TARE_SAMPLES, AUTO_TARE_MAX_DRIFT);
+
+  hub.setPiezoHitMode(PIEZO_HIT_MODE);
+  hub.setCalibrator(&calibrator);
+  if (!logPartition.begin() || !hub.beginRecording()) {
+    Serial.println("No plank partition, samples are not recorded while disconnected");
+  }
+
+  // From here on conversions are clocked out by a background task as soon as DOUT signals them
+  if (!scales.beginAsync(HX711_TASK_PRIORITY, ACQUISITION_CORE)) {
+    Serial.println("Starting HX711 acquisition task failed!");
+  }
 
   // Initialize BLE
   if (!BLE.begin()) {
@@ -46,22 +130,33 @@ void setup() {
   }
 
   BLE.setLocalName("ESP32_Multi_Sensor");
-  BLE.setAdvertisedService(sensorService);
-  sensorService.addCharacteristic(capacitiveCharacteristic);
-  sensorService.addCharacteristic(strainGaugeCharacteristic);
-  sensorService.addCharacteristic(piezoCharacteristic);
-  BLE.addService(sensorService);
-
-  // Set the UUID of the service to be advertised
-  BLE.setAdvertisedServiceUuid(sensorService.uuid());
+  hub.addService();
 
   // Set piezo pins as INPUT
   for (int i = 0; i < PIEZO_COUNT; i++) {
     pinMode(piezoPins[i], INPUT);
   }
 
+  // From here on the ADC1 piezos are sampled continuously by the ADC DMA
+  startProcessTask();
+  if (!hub.sampler().begin(piezoPins, PIEZO_COUNT, PIEZO_DEFAULT_RATE, PIEZO_TASK_PRIORITY, ACQUISITION_CORE)) {
+    Serial.println("Starting piezo ADC DMA failed, reading the piezos with analogRead");
+  }
+  for (int i = 0; i < PIEZO_COUNT; i++) {
+    if (hub.sampler().running() && !hub.sampler().sampled(i)) {
+      Serial.print("Piezo ");
+      Serial.print(i);
+      Serial.println(" is not on ADC1, read with analogRead");
+    }
+  }
+
   BLE.advertise();
   Serial.println("BLE Multi-Sensor Beacon started");
+
+  // From here on loop() is out of the picture: the link and publish tasks take over
+  startTask(linkTask, linkMeter, 3072, LINK_TASK_PRIORITY, ACQUISITION_CORE);
+  startTask(publishTask, publishMeter, 8192, PUBLISH_TASK_PRIORITY, PROCESSING_CORE);
+  startTask(logTask, logMeter, 2048, LOG_TASK_PRIORITY, PROCESSING_CORE);
 }
 
 void tare() {
@@ -78,176 +173,210 @@ void tare() {
   }
 }
 
-void readCapacitiveSensors() {
-  static String buffer;
-  
-  while (Serial2.available()) {
-    char c = Serial2.read();
-    buffer += c;
-    
-    if (c == '>') {
-      if (buffer.startsWith("<")) {
-        String data = buffer.substring(1, buffer.length() - 1);
-        
-        int index = 0;
-        char* token = strtok(&data[0], ",");
-        while (token != NULL && index < numCapacitivePins) {
-          capacitiveData[index++] = atoi(token);
-          token = strtok(NULL, ",");
-        }
-        
-        if (index == numCapacitivePins) {
-          Serial2.write('A');
-          
-          // Nouvel affichage uniformisé
-          Serial.println("\n--- Capacitive Sensor Data ---");
-          for (int i = 0; i < numCapacitivePins; i++) {
-            Serial.print("Sensor ");
-            Serial.print(i);
-            Serial.print(" - Raw: ");
-            Serial.print(capacitiveData[i]);
-            Serial.print(", Scaled: ");  // Dans ce cas, Raw = Scaled car pas de conversion
-            Serial.println(capacitiveData[i]);
-          }
-        }
-      }
-      buffer = "";
-    }
-    
-    if (buffer.length() > 100) {
-      buffer = "";
-    }
+// CPU time since the previous call
+void printTaskStats() {
+  TaskMeter *const meters[] = {&hub.sampler().taskMeter(), &scales.taskMeter(), &linkMeter, &processMeter, &publishMeter, &logMeter};
+  for (TaskMeter *meter : meters) {
+    printTaskMeter(plankLog, *meter);
   }
+  printQueueStats(plankLog, "piezo blocks", hub.sampler().queueHighWater(), PIEZO_RING_BLOCKS, hub.sampler().droppedBlocks());
+  printQueueStats(plankLog, "strain samples", scales.queueHighWater(), HX711_RING_SIZE, scales.droppedSamples());
+  printQueueStats(plankLog, "link frames", hub.frameQueue().highWater(), LINK_FRAME_QUEUE, hub.link().stats().overruns);
+  printQueueStats(plankLog, "piezo hits", hub.impactDetector().hitQueueHighWater(), IMPACT_HIT_RING, hub.impactDetector().droppedHits());
+  printQueueStats(plankLog, "log bytes", plankLog.highWater(), plankLog.capacity(), plankLog.dropped());
 }
 
-void readStrainGauges() {
-  long results[CHANNEL_COUNT];
-  scales.read(results);
-  
-  Serial.println("\n--- Strain Gauge Data ---");
-  for (int i = 0; i < CHANNEL_COUNT; i++) {
-    if (results[i] < 0) {
-      results[i] = 0;
-    }
-    strainGaugeData[i] = static_cast<uint8_t>((results[i]/842)*255/2500);
-    
-    Serial.print("Gauge ");
-    Serial.print(i);
-    Serial.print(" - Raw: ");
-    Serial.print(results[i]);
-    Serial.print(", Scaled: ");
-    Serial.println(strainGaugeData[i]);
+void printProbes() {
+#if !PLANK_PROBES
+  plankLog.println("Probes compiled out (PLANK_PROBES=0)");
+#endif
+  for (int i = 0; i < SensorHub::PROBE_COUNT; i++) {
+    printCycleProbe(plankLog, hub.probe(i));
   }
 }
 
-void readPiezo() {
-  Serial.println("\n--- Piezo Sensor Data ---");
-  for (int i = 0; i < PIEZO_COUNT; i++) {
-    int reading = analogRead(piezoPins[i]);
-    piezoData[i] = map(reading, 0, 4095, 0, 65535);
-    
-    Serial.print("Piezo ");
-    Serial.print(i);
-    Serial.print(" - Raw: ");
-    Serial.print(reading);
-    Serial.print(", Mapped: ");
-    Serial.println(piezoData[i]);
+void printRecordingStats() {
+  const SessionLog &sessionLog = hub.sessions();
+  plankLog.print("Session log: ");
+  plankLog.print(sessionLog.capacity());
+  plankLog.print(" blocks, ");
+  plankLog.print(sessionLog.sessions());
+  plankLog.print(" sessions, recording: ");
+  plankLog.println(sessionLog.recording() ? "yes" : "no");
+  for (uint8_t i = 0; i < sessionLog.sessions(); i++) {
+    const SessionInfo &info = sessionLog.session(i);
+    plankLog.print("  session ");
+    plankLog.print(info.id);
+    plankLog.print(": blocks ");
+    plankLog.print(info.first);
+    plankLog.print(" + ");
+    plankLog.print(info.blocks);
+    plankLog.print(", from ");
+    plankLog.print(info.time);
+    plankLog.println(" us");
   }
+  plankLog.print("Samples: ");
+  plankLog.print(sessionLog.samples());
+  plankLog.print(", blocks written: ");
+  plankLog.print(sessionLog.blocksWritten());
+  plankLog.print(" (");
+  plankLog.print(sessionLog.payloadBytes());
+  plankLog.print(" bytes), sectors erased: ");
+  plankLog.print(sessionLog.sectorsErased());
+  plankLog.print(", failures: ");
+  plankLog.print(sessionLog.failures());
+  plankLog.print(", corrupt blocks: ");
+  plankLog.println(sessionLog.corruptBlocks());
 }
 
-void updateBLEData(char sensorType) {
-  switch(sensorType) {
-    case 'C':  // Capacitive sensors only
-      {
-        const uint8_t CAPACITIVE_START = 0x3C;
-        const uint8_t CAPACITIVE_END = 0x3E;
-
-        uint8_t capacitiveDataBytes[numCapacitivePins * 2 + 2];
-        capacitiveDataBytes[0] = CAPACITIVE_START;
-        for (int i = 0; i < numCapacitivePins; i++) {
-          capacitiveDataBytes[i*2 + 1] = capacitiveData[i] & 0xFF;
-          capacitiveDataBytes[i*2 + 2] = (capacitiveData[i] >> 8) & 0xFF;
-        }
-        capacitiveDataBytes[numCapacitivePins * 2 + 1] = CAPACITIVE_END;
-        capacitiveCharacteristic.writeValue(capacitiveDataBytes, sizeof(capacitiveDataBytes));
-
-        // Print BLE packet data
-        Serial.print("\nCapacitive BLE packet: ");
-        for (int i = 0; i < sizeof(capacitiveDataBytes); i++) {
-          Serial.print(capacitiveDataBytes[i], HEX);
-          Serial.print(" ");
-        }
-        Serial.println();
-      }
-      break;
-
-    case 'S':  // Strain Gauges only
-      {
-        const uint8_t STRAIN_START = 0x28;
-        const uint8_t STRAIN_END = 0x29;
-
-        uint8_t strainGaugeDataBytes[numStrainGauges + 2];
-        strainGaugeDataBytes[0] = STRAIN_START;
-        memcpy(&strainGaugeDataBytes[1], strainGaugeData, numStrainGauges);
-        strainGaugeDataBytes[numStrainGauges + 1] = STRAIN_END;
-        strainGaugeCharacteristic.writeValue(strainGaugeDataBytes, sizeof(strainGaugeDataBytes));
-
-        Serial.print("Strain Gauge BLE packet: ");
-        for (int i = 0; i < sizeof(strainGaugeDataBytes); i++) {
-          Serial.print(strainGaugeDataBytes[i], HEX);
-          Serial.print(" ");
-        }
-        Serial.println();
-      }
-      break;
-
-    case 'P':  // Piezo sensors
-      {
-        uint8_t piezoPacket[10];
-        piezoPacket[0] = 0x2D;
-        piezoPacket[1] = 0x3E;
-        for (int i = 0; i < PIEZO_COUNT; i++) {
-          piezoPacket[2 + i * 2] = (piezoData[i] >> 8) & 0xFF;
-          piezoPacket[3 + i * 2] = piezoData[i] & 0xFF;
-        }
-        piezoPacket[8] = 0x3C;
-        piezoPacket[9] = 0x2D;
-        piezoCharacteristic.writeValue(piezoPacket, 10);
-
-        Serial.print("Piezo BLE packet: ");
-        for (int i = 0; i < 10; i++) {
-          Serial.print(piezoPacket[i], HEX);
-          Serial.print(" ");
-        }
-        Serial.println();
-      }
-      break;
+// Strain gauge calibration over the USB serial port, plank empty and tared:
+//   "cal <channel>"  start calibrating a channel
+//   "pt <weight>"    reference weight placed over that channel's cell, in the units the readings should have;
+//                    averaged over the next 20 strain samples (2 s), "Point added" once they are in
+//   "fit [2]"        first (or second) order fit through the points, applied at once
+//   "save"           keep the calibration in NVS
+// and "link" for the statistics of the UART link from the Mega and of its clock estimate, "piezo" for the piezo ADC DMA,
+// "tasks" for the tasks and their queues, "record" for the sessions recorded to flash, "probes" for the
+// cycle probes of the publish task ("probes reset" starts them over). The answers are printed to
+// PlankLog: the log task writes them out between its frames.
+// The auto-tare is held off from "cal" until a fit succeeds, so that it does not zero a reference weight.
+void handleSerialCommand() {
+  static bool pointPending = false;
+  if (pointPending && !calibrator.collecting()) {
+    plankLog.println("Point added");
+    pointPending = false;
+  }
+  if (!Serial.available()) {
+    return;
+  }
+  String line = Serial.readStringUntil('\n');
+  line.trim();
+
+  if (line.startsWith("cal ")) {
+    calibrator.begin(line.substring(4).toInt());
+    pointPending = false;
+    plankLog.println("Calibration started");
+  } else if (line.startsWith("pt ")) {
+    if (calibrator.collecting()) {
+      plankLog.println("Still taking the previous point");
+    } else if (calibrator.addPoint(line.substring(3).toFloat())) {
+      pointPending = true;
+    } else {
+      plankLog.println("Point table full");
+    }
+  } else if (line.startsWith("fit")) {
+    if (calibrator.collecting()) {
+      plankLog.println("Still taking the previous point");
+    } else {
+      bool ok = calibrator.fit(line.endsWith("2"));
+      plankLog.println(ok ? "Calibration applied" : "Not enough points");
+    }
+  } else if (line == "save") {
+    plankLog.println(scales.save_calibration() ? "Calibration saved" : "Saving calibration failed");
+  } else if (line == "link") {
+    printLinkStats(plankLog, hub.link().stats());
+    printClockStats(plankLog, hub.link().clock());
+  } else if (line == "piezo") {
+    const ImpactDetector &impacts = hub.impactDetector();
+    const WaveformCapture &capture = hub.waveformCapture();
+    plankLog.print("Piezo blocks: ");
+    plankLog.print(hub.sampler().blocks());
+    plankLog.print(", dropped: ");
+    plankLog.print(hub.sampler().droppedBlocks());
+    plankLog.print(", DMA overruns: ");
+    plankLog.print(hub.sampler().overruns());
+    plankLog.print(", misaligned samples: ");
+    plankLog.println(hub.sampler().misaligned());
+    plankLog.print("Impacts: ");
+    plankLog.print(impacts.impacts());
+    plankLog.print(", hits: ");
+    plankLog.print(impacts.hits());
+    plankLog.print(", noise floors (mV):");
+    for (int i = 0; i < PIEZO_COUNT; i++) {
+      plankLog.print(" ");
+      plankLog.print(impacts.noiseFloor(i));
+    }
+    plankLog.println();
+    plankLog.print("Captures: ");
+    plankLog.print(capture.captures());
+    plankLog.print(", missed: ");
+    plankLog.println(capture.missed());
+  } else if (line == "tasks") {
+    printTaskStats();
+  } else if (line == "record") {
+    printRecordingStats();
+  } else if (line == "probes") {
+    printProbes();
+  } else if (line == "probes reset") {
+    hub.resetProbes();
   }
 }
 
-void loop() {
-  static unsigned long lastCapacitiveStrainReadTime = 0;
-  static unsigned long lastPiezoReadTime = 0;
+void startTask(TaskFunction_t body, TaskMeter &meter, uint32_t stack, uint8_t priority, int8_t core) {
+  TaskHandle_t handle;
+  if (xTaskCreatePinnedToCore(body, meter.name(), stack, NULL, priority, &handle, core) != pdPASS) {
+    Serial.print("Starting task ");
+    Serial.print(meter.name());
+    Serial.println(" failed!");
+    while (1);
+  }
+  meter.place(handle, core, priority);
+}
 
-  unsigned long currentTime = millis();
+// Bytes from the Mega into the link, which ACKs them at once, and in-order frames on to the publish
+// task. When the queue is full the frames wait in the link: its window holds the Mega back.
+// While a time request is out the task only yields between passes, so that the reply is timestamped
+// when it arrives rather than up to LINK_POLL_MS later; that is a few ms every PLANK_LINK_SYNC_MS.
+void linkTask(void *) {
+  for (;;) {
+    linkMeter.begin();
+    hub.linkPass();
+    linkMeter.end();
+    if (hub.link().awaitingTime()) {
+      taskYIELD();
+    } else {
+      vTaskDelay(pdMS_TO_TICKS(LINK_POLL_MS));
+    }
+  }
+}
+
+// Woken by the piezo task for every block; the timeout keeps it going if the sampler stops
+void processTask(void *) {
+  for (;;) {
+    ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(100));
+    processMeter.begin();
+    hub.processPiezoBlocks();
+    processMeter.end();
+  }
+}
 
-  // Read and send capacitive sensor data (every 100ms)
-  if (currentTime - lastCapacitiveStrainReadTime >= 100) {
-    readCapacitiveSensors();
-    updateBLEData('C');
+void startProcessTask() {
+  startTask(processTask, processMeter, 4096, PROCESS_TASK_PRIORITY, PROCESSING_CORE);
+  hub.sampler().notifyOnBlock(processMeter.task());
+}
 
-  // Read and send strain gauge data (every 100ms)
-    readStrainGauges();
-    updateBLEData('S');
-    lastCapacitiveStrainReadTime = currentTime;
+void publishTask(void *) {
+  for (;;) {
+    publishMeter.begin();
+    hub.publish();
+    handleSerialCommand();
+    publishMeter.end();
+    vTaskDelay(1);  // the idle task of core 0 has to run, the task watchdog watches it
   }
+}
 
-  // Read and send piezo data (every 20ms)
-  if (currentTime - lastPiezoReadTime >= 20) {
-    readPiezo();
-    updateBLEData('P');
-    lastPiezoReadTime = currentTime;
+// The lowest priority of all: the log waits for every other task, the ring holds what comes meanwhile.
+// Only as many frames as the UART driver takes without blocking.
+void logTask(void *) {
+  for (;;) {
+    logMeter.begin();
+    plankLog.drain(Serial, Serial.availableForWrite());
+    logMeter.end();
+    vTaskDelay(pdMS_TO_TICKS(LOG_DRAIN_MS));
   }
+}
 
-  BLE.poll();
+// The tasks started by setup() do the work
+void loop() {
+  vTaskDelete(NULL);
 }
\ No newline at end of file
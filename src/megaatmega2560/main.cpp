@@ -1,21 +1,27 @@
-#include "ADCTouch.h"
 #include <Arduino.h>
+#include <CapacitiveNode.h>
+#include <PlankLink.h>
+#include <PlankLog.h>
 
 #ifndef A15
     #define A15 69
 #endif
 
-const int numPins = 16; // Number of analog pins
+const int numPins = PLANK_CAPACITIVE_COUNT; // Number of analog pins
 int analogPins[numPins] = {A0,A1,A2,A3,A4,A5,A6,A7,A8,A9,A10,A11,A12,A13,A14,A15};
-int refValues[numPins]; // Array to store reference values for the offset 
-int values[numPins]; // Array to store current ADC values
+// Scans, lignes de base, appuis et trames vers l'ESP32 (lib/PlankMega, partagé avec la simulation)
+CapacitiveNode node(Serial3);
 
-unsigned long lastSendTime = 0;
-const unsigned long SEND_INTERVAL = 100;  // Intervalle d'envoi en millisecondes
+// 1 : seuls les appuis, relâchements et changements de force sont envoyés, dès le scan qui les détecte,
+//     et l'état complet au moins toutes les 2 s
+// 0 : les 16 valeurs toutes les 100 ms
+#define CAPACITIVE_EVENT_MODE 1
 
-bool waitingAck = false;
-unsigned long lastAckTime = 0;
-const unsigned long ACK_TIMEOUT = 50;  // Timeout pour l'ACK en millisecondes
+// Bruit au repos mesuré au démarrage, à comparer aux seuils de TOUCH_DEFAULT_CONFIG (voir CAPACITIVE_SAMPLES)
+#define NOISE_SCANS 32
+
+unsigned long lastStatsTime = 0;
+const unsigned long STATS_INTERVAL = 10000;  // Statistiques du lien toutes les 10 s
 
 void setup() {
   Serial.begin(115200);
@@ -23,77 +29,62 @@ void setup() {
 
   Serial.println("Initializing capacitive sensors...");
 
-  // Calibrate the capacitive sensors
-  for (int i = 0; i < numPins; ++i) {
-    if (i == 0){
-      refValues[i] += 27;
-    }
-
-    if (i == 1){
-      refValues[i] += 10;
-    }
+  // A partir d'ici l'ADC appartient au scanner
+  node.setEventMode(CAPACITIVE_EVENT_MODE);
+  node.begin(analogPins);
 
-    refValues[i] = ADCTouch.read(analogPins[i], 20);
+  // Lignes de base initiales : le premier scan complet, planche au repos
+  while (!node.takeBaseline());
+  for (int i = 0; i < numPins; ++i) {
     Serial.print("Reference value for pin A");
     Serial.print(i);
     Serial.print(": ");
-    Serial.println(refValues[i]);
-    delay(1);
+    Serial.println(node.tracker().baseline(i));
   }
 
-  Serial.println("Initialization complete. Starting synchronized data transmission...");
-}
-
-void checkAck() {
-  if (Serial3.available()) {
-    char ack = Serial3.read();
-    if (ack == 'A') {  // ACK reçu
-      waitingAck = false;
-      lastAckTime = millis();
+  // Ecart type de chaque patin sur NOISE_SCANS scans, planche toujours au repos
+  long sums[numPins] = {};
+  unsigned long squares[numPins] = {};
+  int scan[numPins];
+  for (int n = 0; n < NOISE_SCANS; ) {
+    if (node.scanner().read(scan)) {
+      for (int i = 0; i < numPins; ++i) {
+        int d = scan[i] - node.tracker().baseline(i);
+        sums[i] += d;
+        squares[i] += (long) d * d;
+      }
+      ++n;
     }
   }
-  
-  // Gestion du timeout
-  if (waitingAck && (millis() - lastAckTime > ACK_TIMEOUT)) {
-    waitingAck = false;  // Reset si pas de réponse
-    Serial.println("ACK timeout");
+  for (int i = 0; i < numPins; ++i) {
+    float mean = (float) sums[i] / NOISE_SCANS;
+    float variance = (float) squares[i] / NOISE_SCANS - mean * mean;
+    Serial.print("Rest noise for pin A");
+    Serial.print(i);
+    Serial.print(": ");
+    Serial.print(sqrt(variance > 0 ? variance : 0), 2);
+    Serial.print(" counts rms at ");
+    Serial.print(CAPACITIVE_SAMPLES);
+    Serial.println(" samples");
   }
-}
 
-void sendData() {
-  if (!waitingAck) {  // Envoyer seulement si pas en attente d'un ACK
-    Serial.println("Sending data:");
-    Serial.print("<");
-    Serial3.print("<");
-    
-    for (int i = 0; i < numPins; ++i) {
-      values[i] = ADCTouch.read(analogPins[i]) - refValues[i];
-      
-      Serial.print(values[i]);
-      Serial3.print(values[i]);
-      
-      if (i < numPins - 1) {
-        Serial.print(",");
-        Serial3.print(",");
-      }
-    }
-    
-    Serial.println(">");
-    Serial3.println(">");
-    
-    waitingAck = true;
-    lastAckTime = millis();
-    Serial.println("Data sent, waiting for ACK...");
-  }
+  Serial.println("Initialization complete. Starting synchronized data transmission...");
 }
 
 void loop() {
   unsigned long currentTime = millis();
-  
-  checkAck();  // Vérifier si ACK reçu
-  
-  if (currentTime - lastSendTime >= SEND_INTERVAL && !waitingAck) {
-    sendData();
-    lastSendTime = currentTime;
+
+  node.loop();
+
+  // Par le journal, comme le reste de la sortie USB : pas de texte au milieu de ses trames
+  if (currentTime - lastStatsTime >= STATS_INTERVAL) {
+    const LinkSenderStats &stats = node.link().stats();
+    PLOG_INFO(LOG_LINK_SENDER, stats.sent, stats.acked, stats.retransmits, stats.fastRetransmits, stats.refused,
+              stats.badAcks, stats.timeReplies, stats.crcErrors);
+    PLOG_INFO(LOG_SCAN_RATE, node.scanner().scansPerSecond());
+    lastStatsTime = currentTime;
   }
-}
\ No newline at end of file
+
+  // Le journal, sans attendre l'UART : ce qui ne tient pas dans son tampon part au passage suivant
+  plankLog.drain(Serial, Serial.availableForWrite());
+}
@@ -0,0 +1,912 @@
+// Native simulation of the plank (PlatformIO env:native).
+// Runs the firmware's processing, CapacitiveNode (lib/PlankMega) for the ATmega2560 and SensorHub
+// (lib/PlankEsp32) for the ESP32, against the simulated board in lib/SimHal: 16 capacitive pads on
+// the Mega, a UART line between the two MCUs, four HX711 chips and four piezos on the ESP32 (three of
+// them sampled through the ADC DMA), and the ArduinoBLE stand-in, this program playing the central.
+// The two ESP32 cores run on clocks of their own: the acquisition tasks on one, processing and
+// publishing on the other, handing data over through the firmware's queues. What the firmware's
+// tasks and setup() do around the libraries is re-enacted here.
+// Usage: native [simulated seconds] [UART byte error rate] [stream] [MTU] [packed] [notification log] [capture]
+// "stream" sends all 16 capacitive values every 100 ms instead of touch events.
+// MTU is the ATT MTU the BLE receiver negotiated for the batched stream (247 by default, 0: no stream);
+// "packed" asks for DeltaCodec-packed stream records.
+// A notification log path records every BLE notification for env:receiver (NotificationLog.h), "-" none.
+// A capture path records the raw sensor data the firmware reads, for env:replay (SensorCapture.h).
+// The error rate splits evenly between dropped bytes and flipped bits, in both directions.
+// The Mega's crystal runs MEGA_CLOCK_PPM fast and its micros() wraps a minute into the run; the
+// ESP32 estimates that clock over the link and the report compares the capacitive frame times with
+// the truth.
+// No central is connected for the first half of the run: the samples go to a flash log in a host
+// file, and the receiver downloads every recorded session once it connects.
+#include <Arduino.h>
+#include <ArduinoBLE.h>
+#include <HX711-multi.h>
+#include <CapacitiveNode.h>
+#include <SensorHub.h>
+#include <FirmwareObserver.h>
+#include <TaskMeter.h>
+#include <CycleProbe.h>
+#include <PlankLog.h>
+#include <SessionLog.h>
+#include <NotificationLog.h>
+#include <SensorCapture.h>
+#include <CapturePinIO.h>
+#include <CaptureStream.h>
+#include <SimHal.h>
+#include <SimHX711.h>
+#include <SimAnalog.h>
+#include <SimUart.h>
+#include <chrono>
+#include <stdio.h>
+
+#define CPU_MEGA 0
+#define CPU_ESP32 1      // core 0: process and publish tasks
+#define CPU_ESP32_ACQ 2  // core 1: piezo, hx711 and link tasks
+#define IDLE_TICK_NS 100000ULL
+#define MEGA_CLOCK_OFFSET_US (0x100000000ULL - 60000000ULL)
+#define MEGA_CLOCK_PPM 100.0
+#define FLASH_LOG_BYTES 65536
+#define FLASH_ERASE_NS 45000000ULL   // a 4 KB sector, typical of the ESP32's SPI flash
+#define FLASH_PAGE_NS 700000ULL      // programming a 256 byte page
+#define FLASH_READ_NS_PER_BYTE 25ULL // 40 MHz quad I/O
+
+// ---------------------------------------------------------------- stage accounting
+
+struct Stage {
+  const char *name;
+  uint64_t calls;
+  double hostNs;
+  uint64_t simNs;
+};
+
+enum {
+  STAGE_MEGA_SCAN,
+  STAGE_MEGA_TOUCH,
+  STAGE_MEGA_SEND,
+  STAGE_MEGA_LINK,
+  STAGE_ESP_HX711,
+  STAGE_ESP_LINK,
+  STAGE_ESP_CAPACITIVE,
+  STAGE_ESP_STRAIN,
+  STAGE_ESP_PIEZO_DMA,
+  STAGE_ESP_PIEZO_BLOCKS,
+  STAGE_ESP_PIEZO,
+  STAGE_ESP_BLE,
+  STAGE_ESP_RECORD,
+  STAGE_ESP_LOG,
+  STAGE_COUNT
+};
+
+static Stage stages[STAGE_COUNT] = {
+  {"mega ADC interrupt", 0, 0, 0},
+  {"mega touch tracking", 0, 0, 0},
+  {"mega sendData encode", 0, 0, 0},
+  {"mega link service", 0, 0, 0},
+  {"esp32 HX711 poll", 0, 0, 0},
+  {"esp32 link task", 0, 0, 0},
+  {"esp32 readCapacitiveSensors", 0, 0, 0},
+  {"esp32 readStrainGauges", 0, 0, 0},
+  {"esp32 piezo DMA task", 0, 0, 0},
+  {"esp32 piezo block processing", 0, 0, 0},
+  {"esp32 readPiezo", 0, 0, 0},
+  {"esp32 BLE notifications", 0, 0, 0},
+  {"esp32 session log", 0, 0, 0},
+  {"esp32 log task", 0, 0, 0},
+};
+
+template <typename F>
+static void timed(int stage, F body) {
+  uint64_t simStart = SimHal::nanos();
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  body();
+  stages[stage].hostNs += std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+  stages[stage].simNs += SimHal::nanos() - simStart;
+  stages[stage].calls++;
+}
+
+// ---------------------------------------------------------------- USB serial ports
+
+// what test/PlankLog.py reads: every log frame checked, records missing from the sequence counted
+class SimLogPort : public Print {
+  public:
+    uint32_t bytes = 0;
+    uint32_t records = 0;
+    uint32_t missing = 0;
+    using Print::write;
+    size_t write(uint8_t c) {
+      ++bytes;
+      if (decoder.feed(c) && decoder.type() == PLANK_FRAME_LOG) {
+        missing += (uint8_t) (decoder.sequence() - next);
+        next = decoder.sequence() + 1;
+        ++records;
+      }
+      return 1;
+    }
+  private:
+    FrameDecoder decoder;
+    uint8_t next = 0;
+};
+
+// ---------------------------------------------------------------- SPI flash
+
+// the flash the log partition lives in, taking as long as the real one on the clock of the CPU that
+// waits for it
+class SimFlashStore : public FileStore {
+  public:
+    bool erase(uint32_t address) {
+      SimHal::advanceNanos(FLASH_ERASE_NS);
+      return FileStore::erase(address);
+    }
+    bool program(uint32_t address, const uint8_t *data, size_t length) {
+      SimHal::advanceNanos((length + 255) / 256 * FLASH_PAGE_NS);
+      return FileStore::program(address, data, length);
+    }
+    bool read(uint32_t address, uint8_t *data, size_t length) {
+      SimHal::advanceNanos(length * FLASH_READ_NS_PER_BYTE);
+      return FileStore::read(address, data, length);
+    }
+};
+
+// ---------------------------------------------------------------- raw sensor capture
+
+SensorCaptureWriter sensorCapture;
+
+void captureScan(uint32_t time, uint8_t flags, const int *raw) {
+  if (!sensorCapture.isOpen()) {
+    return;
+  }
+  uint8_t payload[PLANK_CAPACITIVE_COUNT * 2];
+  for (int i = 0; i < PLANK_CAPACITIVE_COUNT; i++) {
+    payload[2 * i] = raw[i] & 0xFF;
+    payload[2 * i + 1] = (raw[i] >> 8) & 0xFF;
+  }
+  sensorCapture.write(time, CAPTURE_TOUCH_SCAN, flags, payload, sizeof(payload));
+}
+
+// ---------------------------------------------------------------- firmware stages
+
+// the stages of the firmware's passes (FirmwareObserver.h) onto the table above, -1: not timed
+class StageObserver : public FirmwareObserver {
+  public:
+    explicit StageObserver(const int *map) : map(map) {}
+    void stageBegin(uint8_t stage) {
+      simStart[stage] = SimHal::nanos();
+      hostStart[stage] = std::chrono::steady_clock::now();
+    }
+    void stageEnd(uint8_t stage) {
+      if (map[stage] < 0) {
+        return;
+      }
+      Stage &s = stages[map[stage]];
+      s.hostNs += std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - hostStart[stage]).count();
+      s.simNs += SimHal::nanos() - simStart[stage];
+      s.calls++;
+    }
+  private:
+    const int *map;
+    uint64_t simStart[PLANK_STAGE_COUNT];
+    std::chrono::steady_clock::time_point hostStart[PLANK_STAGE_COUNT];
+};
+
+// ---------------------------------------------------------------- ATmega2560 (src/megaatmega2560)
+
+namespace mega {
+
+SimUart Serial3;
+SimLogPort logPort;
+PlankLog plankLog;
+
+int analogPins[PLANK_CAPACITIVE_COUNT] = {A0,A1,A2,A3,A4,A5,A6,A7,A8,A9,A10,A11,A12,A13,A14,A15};
+CapacitiveNode node(Serial3, plankLog);
+
+// every scan the tracker takes goes to the raw sensor capture
+class Observer : public StageObserver {
+  public:
+    Observer() : StageObserver(stageMap) {}
+    void scanned(uint32_t time, const int *raw) { captureScan(time, 0, raw); }
+  private:
+    static const int stageMap[PLANK_STAGE_COUNT];
+};
+
+const int Observer::stageMap[PLANK_STAGE_COUNT] = {STAGE_MEGA_TOUCH, STAGE_MEGA_SEND, STAGE_MEGA_LINK, -1, -1, -1, -1, -1};
+Observer observer;
+
+void serviceAdc();
+
+void setup() {
+  node.setObserver(&observer);
+  node.begin(analogPins);
+  while (!node.takeBaseline()) {
+    SimHal::advanceNanos(IDLE_TICK_NS / 10);
+    serviceAdc();
+  }
+  captureScan(micros(), CAPTURE_FLAG_START, node.lastScan());
+}
+
+// stands in for ISR(ADC_vect): delivered between loop() passes
+void serviceAdc() {
+  while (SimHal::adcInterruptPending()) {
+    timed(STAGE_MEGA_SCAN, [] { node.scanner().onConversion(SimHal::takeAdcResult()); });
+  }
+}
+
+void loop() {
+  node.loop();
+  plankLog.drain(logPort, 64);  // the HardwareSerial TX buffer
+}
+
+}
+
+// ---------------------------------------------------------------- ESP32 (src/dfrobot_firebeetle2_esp32e)
+
+namespace esp32 {
+
+#define CLK 18
+#define CHANNEL_COUNT PLANK_STRAIN_COUNT
+#define PIEZO_HIT_MODE 1
+
+#define LINK_POLL_MS 2
+#define LINK_YIELD_NS 20000  // a pass of the link task and a yield, while a time reply is due
+#define LOG_DRAIN_MS 10
+#define LOG_DRAIN_BUDGET 128  // the UART TX FIFO
+
+SimUart Serial2;
+TaskMeter linkMeter("link");
+TaskMeter processMeter("process");
+TaskMeter publishMeter("publish");
+TaskMeter logMeter("log");
+SimLogPort logPort;
+PlankLog plankLog;
+
+const int piezoPins[PLANK_PIEZO_COUNT] = {36, 39, 15, 35};
+byte DOUTS[CHANNEL_COUNT] = {25, 26, 0, 14};
+HX711MULTI *scales;
+SimFlashStore logPartition;
+SensorHub *hub;
+uint64_t connectNs = 0;  // the central connects then
+
+SimHX711 *chips[CHANNEL_COUNT];
+SimPiezo *piezos[PLANK_PIEZO_COUNT];
+uint8_t dmaPattern[PLANK_PIEZO_COUNT];  // piezos in the DMA's conversion order
+uint8_t dmaChannels = 0;
+uint64_t dmaStartNs = 0;
+uint64_t dmaConversions = 0;
+uint32_t capacitiveFrames = 0;
+uint32_t touchDowns = 0;
+uint64_t touchLatencyNs = 0;
+uint32_t timedFrames = 0;     // stamped from the Mega's clock
+uint32_t untimedFrames = 0;   // before the first clock point: stamped on arrival
+double timeErrorSum = 0;
+int32_t timeErrorMax = 0;
+
+uint64_t touchStartNs(int pad, uint64_t nowNs);
+
+// error of a frame's time against the scan time the Mega's crystal gave it, us
+int32_t frameTimeError(const LinkFrame &frame) {
+  uint64_t nowNs = SimHal::nanos();
+  uint32_t megaNowUs = (uint32_t) ((MEGA_CLOCK_OFFSET_US * 1000ULL + (uint64_t) (nowNs * (1.0 + MEGA_CLOCK_PPM * 1e-6))) / 1000ULL);
+  double ageUs = (int32_t) (megaNowUs - frameTime(frame.payload)) / (1.0 + MEGA_CLOCK_PPM * 1e-6);
+  return (int32_t) (frame.time - (uint32_t) llround(nowNs / 1e3 - ageUs));
+}
+
+// every frame the publish task applies: its time against the truth, the touch latency
+class Observer : public StageObserver {
+  public:
+    Observer() : StageObserver(stageMap) {}
+    void frameApplied(const LinkFrame &frame) {
+      capacitiveFrames++;
+      uint8_t events = frame.type == PLANK_FRAME_TOUCH ? frameTouchEvents(frame.length) : 0;
+      for (int i = 0; i < events; i++) {
+        TouchEvent event = frameTouchEvent(frame.payload, i);
+        if (event.kind == TOUCH_EVENT_DOWN) {
+          touchDowns++;
+          touchLatencyNs += SimHal::nanos() - touchStartNs(event.pad, SimHal::nanos());
+        }
+      }
+      if (!hub->link().clock().synced()) {
+        untimedFrames++;
+        return;
+      }
+      int32_t error = frameTimeError(frame);
+      timedFrames++;
+      timeErrorSum += abs(error);
+      timeErrorMax = abs(error) > timeErrorMax ? abs(error) : timeErrorMax;
+    }
+  private:
+    static const int stageMap[PLANK_STAGE_COUNT];
+};
+
+const int Observer::stageMap[PLANK_STAGE_COUNT] = {-1, -1, -1, STAGE_ESP_CAPACITIVE, STAGE_ESP_STRAIN, STAGE_ESP_PIEZO,
+                                                   STAGE_ESP_BLE, STAGE_ESP_RECORD};
+Observer observer;
+
+void setup() {
+  // the conversions and the link bytes are recorded on their way to the firmware
+  static HX711DefaultPinIO pins;
+  static HX711CapturePinIO capturePins(pins, sensorCapture);
+  static CaptureStream captureUart(Serial2, sensorCapture);
+  scales = new HX711MULTI(CHANNEL_COUNT, DOUTS, CLK, 128, sensorCapture.isOpen() ? &capturePins : NULL);
+  hub = new SensorHub(*scales, sensorCapture.isOpen() ? (Stream &) captureUart : (Stream &) Serial2, logPartition,
+                      piezoPins, plankLog);
+  hub->setObserver(&observer);
+  hub->setPiezoHitMode(PIEZO_HIT_MODE);
+  for (int i = 0; i < CHANNEL_COUNT; i++) {
+    scales->set_calibration(i, HX711Calibration::fromFloat(STRAIN_DEFAULT_UNITS_PER_COUNT));
+  }
+  bool tared = false;
+  unsigned long start = millis();
+  while (!tared && millis() < start + 4000) {
+    tared = scales->tare(20, 10000);
+  }
+
+  logPartition.open(NULL, FLASH_LOG_BYTES);
+  hub->beginRecording();
+  BLE.begin();
+  hub->addService();
+  BLE.advertise();
+
+  uint8_t dmaStart[5 + PLANK_PIEZO_COUNT] = {PIEZO_DEFAULT_RATE & 0xFF, (PIEZO_DEFAULT_RATE >> 8) & 0xFF, 0, 0, PLANK_PIEZO_COUNT};
+  for (int i = 0; i < PLANK_PIEZO_COUNT; i++) {
+    dmaStart[5 + i] = piezoPins[i];
+  }
+  sensorCapture.write(micros(), CAPTURE_PIEZO_DMA, CAPTURE_FLAG_START, dmaStart, sizeof(dmaStart));
+  hub->sampler().begin(piezoPins, PLANK_PIEZO_COUNT);
+  dmaStartNs = SimHal::nanos();
+  hub->sampler().taskMeter().place(NULL, 1, 7);
+  scales->taskMeter().place(NULL, 1, 6);
+  linkMeter.place(NULL, 1, 5);
+  processMeter.place(NULL, 0, 4);
+  publishMeter.place(NULL, 0, 2);
+  logMeter.place(NULL, 0, 1);
+  for (int adc = 0; adc < PIEZO_ADC1_CHANNELS; adc++) {
+    for (int i = 0; i < PLANK_PIEZO_COUNT; i++) {
+      if (piezoAdc1Channel(piezoPins[i]) == adc) {
+        dmaPattern[dmaChannels++] = i;
+      }
+    }
+  }
+}
+
+// stands in for the DOUT interrupt and acquisition task started by beginAsync()
+void serviceHX711() {
+  uint64_t due = chips[0]->nextReadyNs();
+  for (int i = 1; i < CHANNEL_COUNT; i++) {
+    if (chips[i]->nextReadyNs() > due) {
+      due = chips[i]->nextReadyNs();
+    }
+  }
+  if (SimHal::nanos() >= due) {
+    timed(STAGE_ESP_HX711, [] {
+      scales->taskMeter().begin();
+      scales->poll();
+      scales->taskMeter().end();
+    });
+  }
+}
+
+// stands in for the ADC DMA and the task started by PiezoSampler::begin(): every DMA frame whose last
+// conversion is due, the ADC1 piezos converted round-robin at their exact times
+void serviceSampler() {
+  const uint32_t frame = PIEZO_DMA_FRAME_BYTES / 2;
+  uint64_t conversionsPerS = (uint64_t) PIEZO_DEFAULT_RATE * dmaChannels;
+  while (dmaStartNs + (dmaConversions + frame) * 1000000000ULL / conversionsPerS <= SimHal::nanos()) {
+    uint16_t words[frame];
+    for (uint32_t k = 0; k < frame; k++) {
+      uint64_t n = dmaConversions + k;
+      uint8_t piezo = dmaPattern[n % dmaChannels];
+      uint64_t at = dmaStartNs + n * 1000000000ULL / conversionsPerS;
+      words[k] = (piezoAdc1Channel(piezoPins[piezo]) << 12) | piezos[piezo]->reading(at);
+    }
+    dmaConversions += frame;
+    sensorCapture.write(micros(), CAPTURE_PIEZO_DMA, 0, (const uint8_t *) words, sizeof(words));
+    timed(STAGE_ESP_PIEZO_DMA, [&words] {
+      hub->sampler().taskMeter().begin();
+      hub->sampler().onConversions(words, frame);
+      hub->sampler().taskMeter().end();
+    });
+  }
+}
+
+// the link task, woken every LINK_POLL_MS, or spinning while a time reply is due
+void serviceLinkTask() {
+  static uint64_t nextNs = 0;
+  if (SimHal::nanos() < nextNs) {
+    return;
+  }
+  timed(STAGE_ESP_LINK, [] {
+    linkMeter.begin();
+    hub->linkPass();
+    linkMeter.end();
+  });
+  nextNs = SimHal::nanos() + (hub->link().awaitingTime() ? LINK_YIELD_NS : LINK_POLL_MS * 1000000ULL);
+}
+
+// core 1: the acquisition tasks, each when its event is due
+void acquisitionLoop() {
+  serviceHX711();
+  serviceSampler();
+  serviceLinkTask();
+}
+
+// the process task, woken by every block the piezo task queues
+void processTask() {
+  static uint32_t seen = 0;
+  if (hub->sampler().blocks() == seen) {
+    return;
+  }
+  seen = hub->sampler().blocks();
+  processMeter.begin();
+  timed(STAGE_ESP_PIEZO_BLOCKS, [] { hub->processPiezoBlocks(); });
+  processMeter.end();
+}
+
+// the publish task: one pass, then a 1 ms tick for the idle task
+void publishTask() {
+  static uint64_t nextNs = 0;
+  if (SimHal::nanos() < nextNs) {
+    return;
+  }
+  publishMeter.begin();
+  hub->publish();
+  publishMeter.end();
+  nextNs = SimHal::nanos() + 1000000ULL;
+}
+
+// the log task, every LOG_DRAIN_MS, as much as the TX FIFO takes
+void logTask() {
+  static uint64_t nextNs = 0;
+  if (SimHal::nanos() < nextNs) {
+    return;
+  }
+  timed(STAGE_ESP_LOG, [] {
+    logMeter.begin();
+    plankLog.drain(logPort, LOG_DRAIN_BUDGET);
+    logMeter.end();
+  });
+  nextNs = SimHal::nanos() + LOG_DRAIN_MS * 1000000ULL;
+}
+
+// core 0, in order of priority
+void processingLoop() {
+  processTask();
+  publishTask();
+  logTask();
+}
+
+}
+
+// ---------------------------------------------------------------- plank scenario
+
+// pad i is touched for 1.5 s once a minute, staggered across the pads
+static float padTouch(int pad, uint64_t nowNs) {
+  double t = fmod(nowNs / 1e9, 60.0) - 10.0 - pad * 3.0;
+  return (t >= 0 && t < 1.5) ? 1.0f : 0.0f;
+}
+
+// start of the touch of 'pad' in the minute of nowNs
+uint64_t esp32::touchStartNs(int pad, uint64_t nowNs) {
+  return nowNs / 60000000000ULL * 60000000000ULL + (uint64_t) ((10.0 + pad * 3.0) * 1e9);
+}
+
+// someone stands on the plank 30 s out of every 90 s, after the initial tare
+static int32_t strainRaw(int cell, uint64_t nowNs, uint32_t &seed) {
+  double t = fmod(nowNs / 1e9, 90.0);
+  double load = (nowNs > 10000000000ULL && t >= 60.0) ? 400.0 + 150.0 * cell : 0.0;
+  return (int32_t) (load * 842.0 + 2000.0 * simNoise(seed));
+}
+
+// background hum plus a decaying 2 kHz ring every 2.5 s, reaching the piezos with a small lag
+#define KNOCK_PERIOD_S 2.5
+#define KNOCK_LAG_S 0.0004
+
+static float piezoVolts(int piezo, uint64_t nowNs, uint32_t &seed) {
+  double t = fmod(nowNs / 1e9, KNOCK_PERIOD_S) - KNOCK_LAG_S * piezo;
+  double v = 0.05 + 0.01 * simNoise(seed);
+  if (t >= 0) {
+    v += 1.2 * exp(-t / 0.005) * sin(2 * M_PI * 2000.0 * t);
+  }
+  return v < 0 ? 0 : (float) v;
+}
+
+// the receiver connects, which subscribes it to every notifying characteristic; it sets up the stream
+// (every sensor, frames as large as its MTU takes) and asks for the list of the recorded sessions
+static void connectCentral(int mtu, bool packed) {
+  BLE.setConnected(true);
+  if (mtu > 0) {
+    uint8_t config[] = {0xFF, (uint8_t) ((mtu - 3) & 0xFF), (uint8_t) ((mtu - 3) >> 8), (uint8_t) (packed ? 1 : 0)};
+    esp32::hub->streamConfigCharacteristic().centralWrite(config, sizeof(config));
+  }
+  uint8_t list = 'L';
+  esp32::hub->recordingCharacteristic().centralWrite(&list, 1);
+}
+
+int main(int argc, char **argv) {
+  double seconds = argc > 1 ? atof(argv[1]) : 600.0;
+  uint64_t endNs = (uint64_t) (seconds * 1e9);
+  double errorRate = argc > 2 ? atof(argv[2]) : 0.0;
+  bool eventMode = !(argc > 3 && !strcmp(argv[3], "stream"));
+  int mtu = argc > 4 ? atoi(argv[4]) : 247;
+  bool packed = argc > 5 && !strcmp(argv[5], "packed");
+  esp32::connectNs = endNs / 2;
+  static NotificationLogWriter notificationLog;
+  if (argc > 6 && strcmp(argv[6], "-") != 0 && !notificationLog.open(argv[6])) {
+    fprintf(stderr, "cannot write %s\n", argv[6]);
+    return 1;
+  }
+  if (argc > 7 && !sensorCapture.open(argv[7])) {
+    fprintf(stderr, "cannot write %s\n", argv[7]);
+    return 1;
+  }
+
+  SimHal::reset();
+  Serial.setMuted(true);
+  SimUart::connect(mega::Serial3, esp32::Serial2);
+  mega::Serial3.setLoss(errorRate / 2, errorRate / 2, 17);
+  esp32::Serial2.setLoss(errorRate / 2, errorRate / 2, 29);
+
+  // ATmega2560 @ 16 MHz: pin calls cost microseconds, a conversion takes 13 ADC clocks at 125 kHz
+  SimHal::selectCpu(CPU_MEGA);
+  SimHal::setCallCostNs(3000);
+  SimHal::setAnalogCostNs(104000);
+  SimHal::setClock(MEGA_CLOCK_OFFSET_US, MEGA_CLOCK_PPM);
+  static SimCapacitivePad *pads[PLANK_CAPACITIVE_COUNT];
+  for (int i = 0; i < PLANK_CAPACITIVE_COUNT; i++) {
+    pads[i] = new SimCapacitivePad(mega::analogPins[i]);
+    pads[i]->setTouch([i](uint64_t now) { return padTouch(i, now); });
+    pads[i]->setDrift(1.5f, 7200.0f);
+  }
+
+  // ESP32 @ 240 MHz, both cores
+  SimHal::selectCpu(CPU_ESP32_ACQ);
+  SimHal::setCallCostNs(100);
+  SimHal::setAnalogCostNs(10000);
+  SimHal::selectCpu(CPU_ESP32);
+  SimHal::setCallCostNs(100);
+  SimHal::setAnalogCostNs(10000);
+  static uint32_t seeds[PLANK_STRAIN_COUNT + PLANK_PIEZO_COUNT];
+  for (int i = 0; i < CHANNEL_COUNT; i++) {
+    seeds[i] = 1234567u * (i + 1);
+    esp32::chips[i] = new SimHX711(CLK, esp32::DOUTS[i], 10);
+    esp32::chips[i]->setSource([i](uint64_t now, SimHX711::Input) { return strainRaw(i, now, seeds[i]); });
+  }
+  for (int i = 0; i < PLANK_PIEZO_COUNT; i++) {
+    seeds[CHANNEL_COUNT + i] = 7654321u * (i + 1);
+    SimPiezo *piezo = esp32::piezos[i] = new SimPiezo(esp32::piezoPins[i]);
+    piezo->setWaveform([i](uint64_t now) { return piezoVolts(i, now, seeds[CHANNEL_COUNT + i]); });
+  }
+
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+  SimHal::selectCpu(CPU_MEGA);
+  mega::node.setEventMode(eventMode);
+  mega::setup();
+  SimHal::selectCpu(CPU_ESP32);
+  esp32::setup();
+
+  // the receiver end of the stream: checks every frame and its sequence
+  static uint32_t streamRecords = 0, streamErrors = 0;
+  static uint16_t streamNext = 0;
+  esp32::hub->streamCharacteristic().setListener([](const uint8_t *data, int length) {
+    SensorStreamReader reader;
+    if (!reader.begin(data, length) || reader.sequence() != streamNext) {
+      ++streamErrors;
+    }
+    streamNext = reader.sequence() + 1;
+    int32_t values[DELTA_MAX_CHANNELS];
+    while (reader.next()) {
+      if (reader.values(values) == 0) {
+        ++streamErrors;
+      }
+      ++streamRecords;
+    }
+  });
+
+  // the receiver of the hits: compares them with the knocks of the scenario
+  static uint32_t hitCount[PLANK_PIEZO_COUNT], hitErrors = 0;
+  static double onsetError = 0, delayError = 0, peakSum = 0, riseSum = 0;
+  esp32::hub->hitCharacteristic().setListener([](const uint8_t *data, int length) {
+    PiezoHit hit = unpackPiezoHit(data);
+    if (length != HIT_PACKET_SIZE || hit.channel >= PLANK_PIEZO_COUNT) {
+      ++hitErrors;
+      return;
+    }
+    double knock = floor((hit.time / 1e6) / KNOCK_PERIOD_S + 0.5) * KNOCK_PERIOD_S;
+    double lag = KNOCK_LAG_S * hit.channel;
+    hitCount[hit.channel]++;
+    onsetError += hit.time - (knock + lag) * 1e6;
+    // every sampled piezo sees the knock; piezo 0 first
+    delayError += fabs(hit.delay - lag * 1e6);
+    peakSum += hit.peak;
+    riseSum += hit.rise;
+  });
+
+  // the receiver of the captures: reassembles them and finds the knock in piezo 0's waveform
+  static std::vector<uint8_t> captureData;
+  static uint32_t captureStart = 0, captureRate = 0, captureBytes = 0, capturesReceived = 0, captureErrors = 0;
+  static uint16_t capturePre = 0, captureSamples = 0, captureNextChunk = 0;
+  static double knockOffsetSum = 0, capturePeakSum = 0;
+  esp32::hub->captureCharacteristic().setListener([](const uint8_t *data, int length) {
+    uint16_t index = data[1] | (data[2] << 8);
+    const uint8_t *body = data + CAPTURE_CHUNK_HEADER_SIZE;
+    if (index == 0) {
+      captureStart = body[0] | (body[1] << 8) | (body[2] << 16) | ((uint32_t) body[3] << 24);
+      captureRate = body[4] | (body[5] << 8) | (body[6] << 16) | ((uint32_t) body[7] << 24);
+      capturePre = body[10] | (body[11] << 8);
+      captureSamples = body[12] | (body[13] << 8);
+      captureBytes = __builtin_popcount(body[9]) * captureSamples * 2;
+      captureData.clear();
+    } else if (index != captureNextChunk) {
+      ++captureErrors;
+    } else {
+      captureData.insert(captureData.end(), body, data + length);
+    }
+    captureNextChunk = index + 1;
+    if (index > 0 && captureData.size() == captureBytes) {
+      // piezo 0 is the first row; the knock is where it first rises 0.3 V above its start
+      int16_t first = (int16_t) (captureData[0] | (captureData[1] << 8));
+      int16_t peak = first;
+      int knock = -1;
+      for (int i = 0; i < captureSamples; i++) {
+        int16_t mv = (int16_t) (captureData[2 * i] | (captureData[2 * i + 1] << 8));
+        if (knock < 0 && mv - first > 300) {
+          knock = i;
+        }
+        peak = mv > peak ? mv : peak;
+      }
+      double knockUs = captureStart + (knock - 0.5) * 1e6 / captureRate;
+      knockOffsetSum += knockUs - floor(knockUs / 1e6 / KNOCK_PERIOD_S + 0.5) * KNOCK_PERIOD_S * 1e6;
+      capturePeakSum += peak;
+      capturesReceived += knock >= capturePre - 1 ? 1 : 0;
+      captureErrors += knock < capturePre - 1 ? 1 : 0;
+    }
+  });
+
+  // the receiver of the recorded sessions: asks for the list as soon as it connects, then downloads the
+  // sessions one after the other, checking every block and decoding its frames
+  static std::vector<SessionInfo> listed;
+  static std::vector<uint8_t> block;
+  static uint32_t nextBlock = 0, missingBlocks = 0, blocksReceived = 0, recordedSamples = 0, downloadErrors = 0;
+  static uint32_t sessionsReceived = 0;
+  static uint64_t downloadStartNs = 0, downloadEndNs = 0, downloadBytes = 0;
+  esp32::hub->recordingCharacteristic().setListener([](const uint8_t *data, int length) {
+    if (data[0] == 'L') {
+      for (int at = SESSION_LIST_HEADER_SIZE; at + SESSION_LIST_ENTRY_SIZE <= length; at += SESSION_LIST_ENTRY_SIZE) {
+        SessionInfo info;
+        info.id = data[at] | (data[at + 1] << 8);
+        info.first = data[at + 2] | (data[at + 3] << 8) | (data[at + 4] << 16) | ((uint32_t) data[at + 5] << 24);
+        listed.push_back(info);
+      }
+      downloadStartNs = SimHal::nanos();
+      if (listed.size() < data[1]) {
+        uint8_t command[] = {'L', (uint8_t) listed.size()};
+        esp32::hub->recordingCharacteristic().centralWrite(command, sizeof(command));
+        return;
+      }
+    } else if (data[0] == 'D') {
+      uint32_t sequence = data[3] | (data[4] << 8) | (data[5] << 16) | ((uint32_t) data[6] << 24);
+      uint16_t offset = data[7] | (data[8] << 8);
+      downloadBytes += length;
+      if (offset == 0) {
+        missingBlocks += sequence - nextBlock;
+        nextBlock = sequence + 1;
+        block.clear();
+      }
+      if (offset != block.size()) {
+        ++downloadErrors;
+        return;
+      }
+      block.insert(block.end(), data + SESSION_CHUNK_HEADER_SIZE, data + length);
+      uint16_t payload = block.size() >= SESSION_LOG_HEADER_SIZE ? block[12] | (block[13] << 8) : 0;
+      if (block.size() < SESSION_LOG_HEADER_SIZE || block.size() != (size_t) SESSION_LOG_HEADER_SIZE + payload) {
+        return;
+      }
+      ++blocksReceived;
+      if (plankCrc16(&block[SESSION_LOG_HEADER_SIZE], payload, plankCrc16(&block[0], 14)) != (block[14] | (block[15] << 8))) {
+        ++downloadErrors;
+        return;
+      }
+      int32_t values[DELTA_MAX_CHANNELS];
+      for (size_t at = SESSION_LOG_HEADER_SIZE; at < block.size(); at += 1 + block[at]) {
+        SensorStreamReader reader;
+        if (at + 1 + block[at] > block.size() || !reader.begin(&block[at + 1], block[at])) {
+          ++downloadErrors;
+          break;
+        }
+        while (reader.next()) {
+          downloadErrors += reader.values(values) == 0 ? 1 : 0;
+          ++recordedSamples;
+        }
+      }
+      return;
+    } else if (data[0] == 'F') {
+      ++sessionsReceived;
+    }
+    // the next session on the list, if any
+    if (sessionsReceived < listed.size()) {
+      const SessionInfo &next = listed[sessionsReceived];
+      nextBlock = next.first;
+      uint8_t command[] = {'R', (uint8_t) (next.id & 0xFF), (uint8_t) (next.id >> 8)};
+      esp32::hub->recordingCharacteristic().centralWrite(command, sizeof(command));
+    } else {
+      downloadEndNs = SimHal::nanos();
+    }
+  });
+
+  if (notificationLog.isOpen()) {
+    struct { BLECharacteristic *characteristic; uint8_t channel; } logged[] = {
+      {&esp32::hub->capacitiveCharacteristic(), PLANK_CHANNEL_CAPACITIVE}, {&esp32::hub->strainCharacteristic(), PLANK_CHANNEL_STRAIN},
+      {&esp32::hub->piezoCharacteristic(), PLANK_CHANNEL_PIEZO}, {&esp32::hub->streamCharacteristic(), PLANK_CHANNEL_STREAM},
+      {&esp32::hub->hitCharacteristic(), PLANK_CHANNEL_HIT}, {&esp32::hub->captureCharacteristic(), PLANK_CHANNEL_CAPTURE},
+      {&esp32::hub->recordingCharacteristic(), PLANK_CHANNEL_RECORDING}};
+    for (auto &l : logged) {
+      uint8_t channel = l.channel;
+      l.characteristic->setRecorder([channel](const uint8_t *data, int length) {
+        notificationLog.write(SimHal::nanos() / 1000, channel, data, length);
+      });
+    }
+  }
+
+  // the tasks start once setup() is over
+  SimHal::selectCpu(CPU_ESP32_ACQ);
+  SimHal::advanceNanos(SimHal::cpuNanos(CPU_ESP32));
+
+  // always resume the CPU whose clock is furthest behind
+  for (;;) {
+    uint8_t cpu = CPU_MEGA;
+    for (uint8_t c = CPU_ESP32; c <= CPU_ESP32_ACQ; c++) {
+      if (SimHal::cpuNanos(c) < SimHal::cpuNanos(cpu)) {
+        cpu = c;
+      }
+    }
+    if (SimHal::cpuNanos(cpu) >= endNs) {
+      break;
+    }
+    SimHal::selectCpu(cpu);
+    uint64_t before = SimHal::nanos();
+    uint64_t idle = IDLE_TICK_NS;
+    if (cpu == CPU_MEGA) {
+      mega::serviceAdc();
+      mega::loop();
+      // an idle Mega wakes up for the next ADC interrupt
+      uint64_t adcDue = SimHal::adcCompletionNs();
+      if (adcDue > before && adcDue - before < idle) {
+        idle = adcDue - before;
+      }
+    } else if (cpu == CPU_ESP32) {
+      if (!BLE.connected() && SimHal::nanos() >= esp32::connectNs) {
+        connectCentral(mtu, packed);
+      }
+      esp32::processingLoop();
+    } else {
+      esp32::acquisitionLoop();
+    }
+    if (SimHal::nanos() == before) {
+      SimHal::advanceNanos(idle);
+    }
+  }
+
+  double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  printf("simulated %.1f s in %.2f s of host time (x%.0f)\n\n", seconds, wall, seconds / wall);
+
+  printf("%-30s %10s %14s %14s %12s\n", "stage", "calls", "sim us/call", "host ns/call", "sim CPU %");
+  for (int i = 0; i < STAGE_COUNT; i++) {
+    const Stage &s = stages[i];
+    if (s.calls == 0) {
+      continue;
+    }
+    printf("%-30s %10llu %14.1f %14.1f %12.2f\n", s.name, (unsigned long long) s.calls,
+           s.simNs / 1e3 / s.calls, s.hostNs / s.calls, 100.0 * s.simNs / endNs);
+  }
+
+  printf("\nUART: %u bytes Mega->ESP32 (%u dropped, %u corrupted), %u bytes ESP32->Mega (%u dropped, %u corrupted)\n",
+         mega::Serial3.bytesWritten(), mega::Serial3.bytesDropped(), mega::Serial3.bytesCorrupted(),
+         esp32::Serial2.bytesWritten(), esp32::Serial2.bytesDropped(), esp32::Serial2.bytesCorrupted());
+  fflush(stdout);
+  Serial.setMuted(false);
+  printf("Mega ");
+  printLinkStats(Serial, mega::node.link().stats());
+  printf("ESP32 ");
+  printLinkStats(Serial, esp32::hub->link().stats());
+  printf("%u capacitive frames used, %u scans on the Mega (%.1f scans/s)\n", esp32::capacitiveFrames,
+         mega::node.scanner().scans(), mega::node.scanner().scansPerSecond());
+  const ClockSync &clock = esp32::hub->link().clock();
+  printf("Clock sync: %u exchanges, %u points, round trip %u us, last error %+d us, drift %+.1f ppm (truth %+.1f), %u restarts\n",
+         clock.exchanges(), clock.exchanges() / CLOCK_SYNC_BURST, clock.roundTrip(), clock.lastError(),
+         clock.driftPpb() / 1000.0, MEGA_CLOCK_PPM, clock.restarts());
+  if (esp32::timedFrames > 0) {
+    printf("Capacitive frame times: %.1f us mean, %d us max off the scan, %u frames (%u stamped on arrival before the first point)\n",
+           esp32::timeErrorSum / esp32::timedFrames, esp32::timeErrorMax, esp32::timedFrames, esp32::untimedFrames);
+  }
+  if (esp32::touchDowns > 0) {
+    printf("%u touches, %.1f ms from touch to the ESP32\n", esp32::touchDowns, esp32::touchLatencyNs / 1e6 / esp32::touchDowns);
+  }
+  printf("Piezo ADC DMA: %u blocks of %u samples, %u dropped, %u misaligned samples\n", esp32::hub->sampler().blocks(),
+         PIEZO_BLOCK_SAMPLES, esp32::hub->sampler().droppedBlocks(), esp32::hub->sampler().misaligned());
+#if PIEZO_HIT_MODE
+  {
+    // notified to a subscribed central only
+    uint32_t hits = 0;
+    printf("Piezo hits per piezo (%u knocks while connected):", (unsigned) ((endNs - esp32::connectNs) / 1e9 / KNOCK_PERIOD_S));
+    for (int i = 0; i < PLANK_PIEZO_COUNT; i++) {
+      printf(" %u%s", hitCount[i], esp32::hub->sampler().sampled(i) ? "" : " (not sampled)");
+      hits += hitCount[i];
+    }
+    printf(", %u impacts, %u bad packets\n", esp32::hub->impactDetector().impacts(), hitErrors);
+    if (hits > 0) {
+      printf("Piezo hits: onset %+.1f us from the knock, delay %.1f us off the truth, peak %.0f mV, rise %.0f us (means)\n",
+             onsetError / hits, delayError / hits, peakSum / hits, riseSum / hits);
+    }
+  }
+#endif
+  if (esp32::hub->waveformCapture().captures() > 0) {
+    printf("Piezo captures: %u sent, %u missed, %u received with the knock after the pre-trigger part, %u errors;"
+           " knock %.0f us from the truth, peak %.0f mV (means)\n", esp32::hub->waveformCapture().captures(), esp32::hub->waveformCapture().missed(),
+           capturesReceived, captureErrors, knockOffsetSum / capturesReceived, capturePeakSum / capturesReceived);
+  }
+  printf("ESP32 tasks over the run:\n");
+  TaskMeter *const meters[] = {&esp32::hub->sampler().taskMeter(), &esp32::scales->taskMeter(), &esp32::linkMeter,
+                               &esp32::processMeter, &esp32::publishMeter, &esp32::logMeter};
+  for (TaskMeter *meter : meters) {
+    SimHal::selectCpu(meter->core() == 1 ? CPU_ESP32_ACQ : CPU_ESP32);
+    printf("  ");
+    printTaskMeter(Serial, *meter);
+  }
+  printf("ESP32 publish task probes, cycles of the simulated clock (pin, ADC and flash time only):\n");
+  SimHal::selectCpu(CPU_ESP32);
+  for (int i = 0; i < SensorHub::PROBE_COUNT; i++) {
+    printf("  ");
+    printCycleProbe(Serial, esp32::hub->probe(i));
+  }
+  printf("ESP32 queues, high-water mark:\n  ");
+  printQueueStats(Serial, "piezo blocks", esp32::hub->sampler().queueHighWater(), PIEZO_RING_BLOCKS, esp32::hub->sampler().droppedBlocks());
+  printf("  ");
+  printQueueStats(Serial, "strain samples", esp32::scales->queueHighWater(), HX711_RING_SIZE, esp32::scales->droppedSamples());
+  printf("  ");
+  printQueueStats(Serial, "link frames", esp32::hub->frameQueue().highWater(), LINK_FRAME_QUEUE, esp32::hub->link().stats().overruns);
+  printf("  ");
+  printQueueStats(Serial, "piezo hits", esp32::hub->impactDetector().hitQueueHighWater(), IMPACT_HIT_RING, esp32::hub->impactDetector().droppedHits());
+  printf("  ");
+  printQueueStats(Serial, "log bytes", esp32::plankLog.highWater(), esp32::plankLog.capacity(), esp32::plankLog.dropped());
+  printf("Log on the USB serial ports (level %d): ESP32 %u records in %u bytes (%.1f bytes/s), %u missing;"
+         " Mega %u records in %u bytes, %u missing\n", PLANK_LOG_LEVEL, esp32::logPort.records, esp32::logPort.bytes,
+         esp32::logPort.bytes / seconds, esp32::logPort.missing, mega::logPort.records, mega::logPort.bytes,
+         mega::logPort.missing);
+  printf("HX711: %u conversions, %u samples dropped\n", esp32::chips[0]->conversions(), esp32::scales->droppedSamples());
+  struct { const char *name; BLECharacteristic *characteristic; } chars[] = {
+    {"capacitive", &esp32::hub->capacitiveCharacteristic()}, {"strain", &esp32::hub->strainCharacteristic()},
+    {"piezo", &esp32::hub->piezoCharacteristic()}, {"stream", &esp32::hub->streamCharacteristic()},
+    {"hit", &esp32::hub->hitCharacteristic()}, {"capture", &esp32::hub->captureCharacteristic()},
+    {"recording", &esp32::hub->recordingCharacteristic()}, {"diagnostics", &esp32::hub->diagnosticsCharacteristic()}};
+  for (auto &c : chars) {
+    printf("BLE %-11s %8u notifications %10llu bytes\n", c.name, c.characteristic->notifications(),
+           (unsigned long long) c.characteristic->payloadBytes());
+  }
+  if (mtu > 0) {
+    const SensorStreamWriter &stream = esp32::hub->sensorStream();
+    printf("BLE stream frames of %u bytes%s: %u samples, %.1f per notification, %u too large, %u bad frames\n",
+           (unsigned) stream.getCapacity(), stream.isPacked() ? ", packed" : "", streamRecords,
+           esp32::hub->streamCharacteristic().notifications() ? (double) streamRecords / esp32::hub->streamCharacteristic().notifications() : 0.0, stream.dropped(), streamErrors);
+  }
+  const SessionLog &log = esp32::hub->sessions();
+  printf("Recorded while disconnected (%.0f s): %u samples in %u blocks of %u (%.0f%% full), %u sectors erased,"
+         " most erased %u times, %u bad programs, %u failures; %.1f ms of publish task time (flash included)\n",
+         esp32::connectNs / 1e9, log.samples(), log.blocksWritten(), SESSION_LOG_BLOCK,
+         log.blocksWritten() ? 100.0 * log.payloadBytes() / log.blocksWritten() / (SESSION_LOG_BLOCK - SESSION_LOG_HEADER_SIZE) : 0.0,
+         log.sectorsErased(), esp32::logPartition.mostErases(), esp32::logPartition.violations(), log.failures(),
+         stages[STAGE_ESP_RECORD].simNs / 1e6);
+  if (downloadEndNs > 0) {
+    printf("Downloaded once connected: %u of %u sessions, %u blocks, %u samples, %u blocks missing (overwritten),"
+           " %u errors; %llu bytes in %.1f ms\n", sessionsReceived, log.sessions(), blocksReceived, recordedSamples,
+           missingBlocks, downloadErrors, (unsigned long long) downloadBytes, (downloadEndNs - downloadStartNs) / 1e6);
+  }
+  if (notificationLog.isOpen()) {
+    printf("%u notifications logged to %s\n", notificationLog.written(), argv[6]);
+    notificationLog.close();
+  }
+  if (sensorCapture.isOpen()) {
+    printf("Raw sensor capture: %u records, %.1f MB (%.1f KB/s) in %s\n", sensorCapture.written(),
+           sensorCapture.size() / 1e6, sensorCapture.size() / 1e3 / seconds, argv[7]);
+    sensorCapture.close();
+  }
+  return 0;
+}
@@ -0,0 +1,97 @@
+#include "Bench.h"
+#include <new>
+#include <stdlib.h>
+
+static uint64_t allocationCount = 0;
+
+void *operator new(size_t size) {
+  ++allocationCount;
+  void *p = malloc(size ? size : 1);
+  if (p == NULL) {
+    throw std::bad_alloc();
+  }
+  return p;
+}
+
+void *operator new[](size_t size) {
+  return operator new(size);
+}
+
+void operator delete(void *p) noexcept {
+  free(p);
+}
+
+void operator delete[](void *p) noexcept {
+  free(p);
+}
+
+void operator delete(void *p, size_t) noexcept {
+  free(p);
+}
+
+void operator delete[](void *p, size_t) noexcept {
+  free(p);
+}
+
+namespace bench {
+
+uint64_t allocations() {
+  return allocationCount;
+}
+
+void Suite::printTable(FILE *out) const {
+  fprintf(out, "%-36s %12s %12s %12s\n", "benchmark", "iterations", "ns/op", "allocs/op");
+  for (size_t i = 0; i < results.size(); i++) {
+    const Result &r = results[i];
+    fprintf(out, "%-36s %12llu %12.1f %12.2f\n", r.name.c_str(), (unsigned long long) r.iterations,
+            r.nsPerOp, r.allocsPerOp);
+  }
+}
+
+bool Suite::writeJson(const char *path, const char *label) const {
+  FILE *f = fopen(path, "w");
+  if (f == NULL) {
+    return false;
+  }
+  fprintf(f, "{\n  \"label\": \"%s\",\n  \"results\": [\n", label);
+  for (size_t i = 0; i < results.size(); i++) {
+    const Result &r = results[i];
+    fprintf(f, "    {\"name\": \"%s\", \"iterations\": %llu, \"ns_per_op\": %.3f, \"allocs_per_op\": %.4f%s%s}%s\n",
+            r.name.c_str(), (unsigned long long) r.iterations, r.nsPerOp, r.allocsPerOp,
+            r.extra.empty() ? "" : ", ", r.extra.c_str(), i + 1 < results.size() ? "," : "");
+  }
+  fprintf(f, "  ]\n}\n");
+  fclose(f);
+  return true;
+}
+
+int Suite::compare(const char *baselinePath, double tolerance, FILE *out) const {
+  FILE *f = fopen(baselinePath, "r");
+  if (f == NULL) {
+    fprintf(out, "cannot read %s\n", baselinePath);
+    return -1;
+  }
+  int regressions = 0;
+  char line[512];
+  fprintf(out, "\n%-36s %12s %12s %8s\n", "benchmark", "base ns/op", "ns/op", "ratio");
+  while (fgets(line, sizeof(line), f) != NULL) {
+    char name[128];
+    double ns;
+    if (sscanf(line, " {\"name\": \"%127[^\"]\", \"iterations\": %*u, \"ns_per_op\": %lf", name, &ns) != 2) {
+      continue;
+    }
+    for (size_t i = 0; i < results.size(); i++) {
+      if (results[i].name != name) {
+        continue;
+      }
+      double ratio = results[i].nsPerOp / ns;
+      bool slower = ratio > tolerance;
+      regressions += slower;
+      fprintf(out, "%-36s %12.1f %12.1f %7.2fx%s\n", name, ns, results[i].nsPerOp, ratio, slower ? "  REGRESSION" : "");
+    }
+  }
+  fclose(f);
+  return regressions;
+}
+
+}
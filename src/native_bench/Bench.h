@@ -0,0 +1,84 @@
+// Minimal benchmark harness for env:native_bench: ns/op, heap allocations/op, JSON report
+#ifndef BENCH_h
+#define BENCH_h
+
+#include <stdint.h>
+#include <stdio.h>
+#include <chrono>
+#include <string>
+#include <vector>
+
+namespace bench {
+
+// operator new calls since start, counted by the replacement in Bench.cpp
+uint64_t allocations();
+
+template <typename T>
+inline void doNotOptimize(T const &value) {
+  asm volatile("" : : "r,m"(value) : "memory");
+}
+
+struct Result {
+  std::string name;
+  uint64_t iterations;
+  double nsPerOp;
+  double allocsPerOp;
+  std::string extra;  // additional JSON members, e.g. "\"conv_per_s\": 1234"
+};
+
+class Suite {
+  public:
+    explicit Suite(double minSeconds = 0.2) : minSeconds(minSeconds) {}
+
+    // runs op() repeatedly, growing the batch until one batch lasts minSeconds;
+    // reports the best of three batches
+    template <typename F>
+    Result &run(const char *name, F op) {
+      uint64_t n = 1;
+      double elapsed = 0;
+      for (;;) {
+        elapsed = timeBatch(op, n);
+        if (elapsed >= minSeconds * 1e9 || n >= (1ULL << 40)) {
+          break;
+        }
+        n = elapsed > 1e6 ? (uint64_t) (n * minSeconds * 1.2e9 / elapsed) + 1 : n * 10;
+      }
+      uint64_t allocStart = allocations();
+      double best = elapsed;
+      for (int r = 0; r < 2; r++) {
+        double t = timeBatch(op, n);
+        best = t < best ? t : best;
+      }
+      Result res;
+      res.name = name;
+      res.iterations = n;
+      res.nsPerOp = best / n;
+      res.allocsPerOp = (double) (allocations() - allocStart) / (2.0 * n);
+      results.push_back(res);
+      return results.back();
+    }
+
+    void printTable(FILE *out) const;
+    bool writeJson(const char *path, const char *label) const;
+
+    // compares against a report written by writeJson; prints the ns/op ratio of every
+    // benchmark present in both and returns how many got slower than 'tolerance' (1.10 = +10%)
+    int compare(const char *baselinePath, double tolerance, FILE *out) const;
+
+  private:
+    template <typename F>
+    static double timeBatch(F &op, uint64_t n) {
+      std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+      for (uint64_t i = 0; i < n; i++) {
+        op();
+      }
+      return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    double minSeconds;
+    std::vector<Result> results;
+};
+
+}
+
+#endif /* BENCH_h */
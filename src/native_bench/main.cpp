@@ -0,0 +1,1180 @@
+// Host benchmarks for the plank firmware hot paths (PlatformIO env:native_bench)
+// Usage: native_bench [--json results.json] [--label revision] [--baseline old.json] [--filter substring] [--quick]
+//                     [--waveform piezo.raw]
+// With --baseline the exit status is the number of benchmarks more than 10% slower than the baseline.
+// --waveform replaces the synthesized piezo signal: a recording of the four piezos in millivolts,
+// int16 little endian, one sample of every piezo after the other, PIEZO_DEFAULT_RATE samples per second.
+#include <Arduino.h>
+#include <ADCTouch.h>
+#include <ADCTouchScanner.h>
+#include <HX711-multi.h>
+#include <HX711-static.h>
+#include <SensorPackets.h>
+#include <SensorStream.h>
+#include <CapacitiveLink.h>
+#include <PlankLink.h>
+#include <ClockSync.h>
+#include <TouchTracker.h>
+#include <PiezoSampler.h>
+#include <ImpactDetector.h>
+#include <WaveformCapture.h>
+#include <SimHal.h>
+#include <SimHX711.h>
+#include <SimAnalog.h>
+#include <SimRegisterPinIO.h>
+#include <SpscRing.h>
+#include <TaskMeter.h>
+#include <CycleProbe.h>
+#include <PlankLog.h>
+#include <SessionLog.h>
+#include <PlankReceiver.h>
+#include <atomic>
+#include <thread>
+#include <stdio.h>
+#include "Bench.h"
+
+#define CLK 18
+#define CHANNEL_COUNT 4
+
+static byte DOUTS[CHANNEL_COUNT] = {25, 26, 0, 14};
+typedef SimRegisterPins<CLK, 25, 26, 0, 14> StaticPins;	// DOUTS, for HX711Static
+static const char *filter = NULL;
+static const char *waveformPath = NULL;
+
+static bool selected(const char *name) {
+  return filter == NULL || strstr(name, filter) != NULL;
+}
+
+// four always-ready simulated chips on the firmware's pins
+struct SimScales {
+  SimHX711 *chips[CHANNEL_COUNT];
+  HX711MULTI *scales;
+
+  explicit SimScales(HX711PinIO *io) {
+    SimHal::reset();
+    for (int i = 0; i < CHANNEL_COUNT; i++) {
+      chips[i] = new SimHX711(CLK, DOUTS[i], 0);
+      chips[i]->setValue(-1000 * (i + 1));
+    }
+    scales = new HX711MULTI(CHANNEL_COUNT, DOUTS, CLK, 128, io);
+  }
+
+  ~SimScales() {
+    delete scales;
+    for (int i = 0; i < CHANNEL_COUNT; i++) {
+      delete chips[i];
+    }
+  }
+};
+
+// a bus that costs nothing, to time the readout itself: the input register is a word in memory that
+// takes the next pseudo-random value on each rising edge and reads all low (ready) while the clock is low
+struct MemoryBus {
+  static uint64_t levels;
+  static bool high;
+
+  static void clock(bool rising) {
+    if (rising) {
+      levels = levels * 6364136223846793005ULL + 1442695040888963407ULL;
+    }
+    high = rising;
+  }
+  static uint64_t read() { return high ? levels : 0; }
+};
+uint64_t MemoryBus::levels = 1;
+bool MemoryBus::high = false;
+
+// HX711MULTI's side of it: the gather of SimRegisterPinIO, behind the virtual calls
+class MemoryPinIO : public HX711PinIO {
+  private:
+    byte COUNT;
+    byte SHIFT[32];
+
+  public:
+    void begin(byte, const byte *dout, byte count) {
+      COUNT = count;
+      for (int j = 0; j < COUNT; ++j) {
+        SHIFT[j] = dout[j] & 63;
+      }
+    }
+    void writeClock(bool high) { MemoryBus::clock(high); }
+    uint32_t readDataLines() {
+      uint64_t in = MemoryBus::read();
+      uint32_t lines = 0;
+      for (int j = 0; j < COUNT; ++j) {
+        lines |= (uint32_t) ((in >> SHIFT[j]) & 1) << j;
+      }
+      return lines;
+    }
+};
+
+// HX711Static's side of it
+template <byte... DOUT>
+struct MemoryPins {
+  typedef HX711DoutSet<DOUT...> Dout;
+  static const byte COUNT = Dout::COUNT;
+  static void begin() {}
+  static void clock(bool high) { MemoryBus::clock(high); }
+  static bool ready() { return (MemoryBus::read() & Dout::MASK) == 0; }
+  static void shift(uint32_t *words) { Dout::shift(MemoryBus::read(), words); }
+};
+
+// Print that only counts, like a UART whose driver never blocks
+class CountingPrint : public Print {
+  public:
+    size_t count = 0;
+    using Print::write;
+    size_t write(uint8_t) { ++count; return 1; }
+};
+
+// bytes written by one end of a link, read back by the other
+class LoopbackPrint : public Print {
+  public:
+    uint8_t data[256];
+    size_t length = 0;
+    using Print::write;
+    size_t write(uint8_t c) {
+      if (length < sizeof(data)) {
+        data[length++] = c;
+      }
+      return 1;
+    }
+};
+
+// readRaw of one set of scales; besides host time, reports the modelled bus cost: simulated time per
+// clock edge (each HAL access charged 50 ns) and HAL accesses per edge
+template <class Scales>
+static void benchReadRaw(bench::Suite &suite, const char *name, Scales &scales) {
+  long results[CHANNEL_COUNT];
+  uint64_t accessStart = SimHal::pinAccesses();
+  uint64_t simStart = SimHal::nanos();
+  uint64_t conversions = 0;
+  bench::Result &r = suite.run(name, [&] {
+    scales.readRaw(results);
+    bench::doNotOptimize(results[0]);
+    ++conversions;
+  });
+  // 24 data pulses + 1 gain pulse, rising and falling edge each
+  double edges = conversions * 25.0 * 2;
+  char extra[160];
+  snprintf(extra, sizeof(extra), "\"sim_ns_per_edge\": %.2f, \"accesses_per_edge\": %.3f, \"host_conv_per_s\": %.0f",
+           (SimHal::nanos() - simStart) / edges, (SimHal::pinAccesses() - accessStart) / edges, 1e9 / r.nsPerOp);
+  r.extra = extra;
+}
+
+// HX711MULTI through a pin backend
+static void benchReadout(bench::Suite &suite, const char *name, HX711PinIO *io) {
+  if (!selected(name)) {
+    return;
+  }
+  SimScales sim(io);
+  benchReadRaw(suite, name, *sim.scales);
+}
+
+static void benchHX711(bench::Suite &suite) {
+  if (selected("hx711 deinterleave+sign")) {
+    uint32_t lines[24];
+    uint32_t seed = 0x12345678;
+    for (int i = 0; i < 24; i++) {
+      seed = seed * 1664525u + 1013904223u;
+      lines[i] = seed >> 28;
+    }
+    long results[CHANNEL_COUNT];
+    suite.run("hx711 deinterleave+sign", [&] {
+      bench::doNotOptimize(lines[0]);
+      HX711MULTI::deinterleave(lines, CHANNEL_COUNT, results);
+      bench::doNotOptimize(results[3]);
+    });
+  }
+
+  HX711DigitalPinIO digitalIO;
+  benchReadout(suite, "hx711 readRaw digitalRead (sim)", &digitalIO);
+  SimRegisterPinIO registerIO;
+  benchReadout(suite, "hx711 readRaw register (sim)", &registerIO);
+  if (selected("hx711 readRaw static register (sim)")) {
+    // same chips and register accesses, pins and gain fixed at compile time
+    SimScales sim(&registerIO);
+    HX711Static<StaticPins> scales;
+    benchReadRaw(suite, "hx711 readRaw static register (sim)", scales);
+  }
+
+  // the readout alone, on a bus that costs nothing
+  if (selected("hx711 readRaw memory bus")) {
+    MemoryPinIO io;
+    HX711MULTI scales(CHANNEL_COUNT, DOUTS, CLK, 128, &io);
+    long results[CHANNEL_COUNT];
+    suite.run("hx711 readRaw memory bus", [&] {
+      scales.readRaw(results);
+      bench::doNotOptimize(results[0]);
+    });
+  }
+  if (selected("hx711 readRaw static memory bus")) {
+    HX711Static<MemoryPins<25, 26, 0, 14> > scales;
+    long results[CHANNEL_COUNT];
+    suite.run("hx711 readRaw static memory bus", [&] {
+      scales.readRaw(results);
+      bench::doNotOptimize(results[0]);
+    });
+  }
+
+  if (selected("hx711 poll+drain A128/B32 (sim)")) {
+    // alternating inputs, each conversion routed to the ring of the input it was measured on
+    SimRegisterPinIO io;
+    SimScales sim(&io);
+    static const byte gains[] = {128, 32};
+    sim.scales->set_schedule(gains, 2);
+    HX711Sample sample;
+    uint64_t routed[HX711_INPUTS] = {0, 0, 0};
+    bench::Result &r = suite.run("hx711 poll+drain A128/B32 (sim)", [&] {
+      sim.scales->poll();
+      for (byte input = HX711_A128; input <= HX711_B32; input++) {
+        routed[input] += sim.scales->drain(&sample, 1, input);
+      }
+    });
+    char extra[96];
+    snprintf(extra, sizeof(extra), "\"a128\": %llu, \"b32\": %llu", (unsigned long long) routed[HX711_A128],
+             (unsigned long long) routed[HX711_B32]);
+    r.extra = extra;
+  }
+
+  if (selected("hx711 tare(20) (sim)")) {
+    SimRegisterPinIO io;
+    SimScales sim(&io);
+    suite.run("hx711 tare(20) (sim)", [&] {
+      bench::doNotOptimize(sim.scales->tare(20, 10000));
+    });
+  }
+}
+
+// 16 simulated pads on the Mega's analog pins, pin calls and conversions costed like the ATmega2560
+struct SimPads {
+  int pins[PLANK_CAPACITIVE_COUNT];
+  SimCapacitivePad *pads[PLANK_CAPACITIVE_COUNT];
+
+  SimPads() {
+    SimHal::reset();
+    SimHal::setCallCostNs(3000);
+    SimHal::setAnalogCostNs(104000);
+    for (int i = 0; i < PLANK_CAPACITIVE_COUNT; i++) {
+      pins[i] = A0 + i;
+      pads[i] = new SimCapacitivePad(pins[i]);
+    }
+  }
+
+  ~SimPads() {
+    for (int i = 0; i < PLANK_CAPACITIVE_COUNT; i++) {
+      delete pads[i];
+    }
+  }
+};
+
+// one 16-pad scan at 16 samples per pad; besides host time, reports the simulated Mega CPU time
+// the scan keeps busy (sim_cpu_us_per_scan) and how long it takes to complete (sim_us_per_scan)
+static void benchScan(bench::Suite &suite) {
+  if (selected("mega capacitive scan ADCTouch.read (sim)")) {
+    SimPads sim;
+    int values[PLANK_CAPACITIVE_COUNT];
+    uint64_t scans = 0;
+    uint64_t simStart = SimHal::nanos();
+    bench::Result &r = suite.run("mega capacitive scan ADCTouch.read (sim)", [&] {
+      for (int i = 0; i < PLANK_CAPACITIVE_COUNT; i++) {
+        values[i] = ADCTouch.read(sim.pins[i], 16);
+      }
+      bench::doNotOptimize(values[0]);
+      ++scans;
+    });
+    double us = (SimHal::nanos() - simStart) / 1e3 / scans;
+    char extra[96];
+    snprintf(extra, sizeof(extra), "\"sim_cpu_us_per_scan\": %.0f, \"sim_us_per_scan\": %.0f", us, us);
+    r.extra = extra;
+  }
+
+  if (selected("mega capacitive scan interrupt (sim)")) {
+    // the host plays the ADC: every conversion is delivered as soon as it completes
+    SimPads sim;
+    ADCTouchScanner scanner;
+    int values[PLANK_CAPACITIVE_COUNT];
+    uint64_t handlerNs = 0;
+    uint64_t simStart = SimHal::nanos();
+    scanner.begin(sim.pins, PLANK_CAPACITIVE_COUNT, 16);
+    uint32_t scansStart = scanner.scans();
+    bench::Result &r = suite.run("mega capacitive scan interrupt (sim)", [&] {
+      do {
+        SimHal::advanceNanos(SimHal::adcCompletionNs() - SimHal::nanos());
+        uint64_t start = SimHal::nanos();
+        scanner.onConversion(SimHal::takeAdcResult());
+        handlerNs += SimHal::nanos() - start;
+      } while (!scanner.read(values));
+      bench::doNotOptimize(values[0]);
+    });
+    uint32_t scans = scanner.scans() - scansStart;
+    scanner.end();
+    char extra[96];
+    snprintf(extra, sizeof(extra), "\"sim_cpu_us_per_scan\": %.0f, \"sim_us_per_scan\": %.0f",
+             handlerNs / 1e3 / scans, (SimHal::nanos() - simStart) / 1e3 / scans);
+    r.extra = extra;
+  }
+}
+
+static void benchCapacitive(bench::Suite &suite) {
+  // worst case frame: 16 four-digit negative values
+  int values[PLANK_CAPACITIVE_COUNT];
+  for (int i = 0; i < PLANK_CAPACITIVE_COUNT; i++) {
+    values[i] = -1000 - 37 * i;
+  }
+
+  if (selected("mega capacitive ASCII format")) {
+    CountingPrint out;
+    suite.run("mega capacitive ASCII format", [&] {
+      printCapacitiveFrame(out, values, PLANK_CAPACITIVE_COUNT);
+      bench::doNotOptimize(out.count);
+    });
+  }
+
+  if (selected("mega touch tracker update")) {
+    // idle pads with a little noise, and one pad pressed and released every 64 scans
+    int raw[PLANK_CAPACITIVE_COUNT];
+    for (int i = 0; i < PLANK_CAPACITIVE_COUNT; i++) {
+      raw[i] = 600 + i;
+    }
+    TouchTracker tracker;
+    tracker.reset(raw);
+    TouchEvent events[PLANK_CAPACITIVE_COUNT];
+    uint32_t scan = 0;
+    uint32_t seed = 7;
+    uint64_t emitted = 0;
+    bench::Result &r = suite.run("mega touch tracker update", [&] {
+      seed = seed * 1664525u + 1013904223u;
+      raw[seed >> 28] = 600 + (seed >> 28) + ((seed >> 20) & 3) - 1;
+      raw[5] = 605 + ((++scan & 63) < 16 ? 100 : 0);
+      emitted += tracker.update(raw, events);
+      bench::doNotOptimize(events[0]);
+    });
+    char extra[64];
+    snprintf(extra, sizeof(extra), "\"events_per_scan\": %.3f", (double) emitted / scan);
+    r.extra = extra;
+  }
+
+  if (selected("mega touch frame encode")) {
+    TouchEvent events[2] = {{3, TOUCH_EVENT_DOWN, 104}, {9, TOUCH_EVENT_UP, 12}};
+    uint8_t frame[TOUCH_FRAME_SIZE(2)];
+    uint8_t seq = 0;
+    suite.run("mega touch frame encode", [&] {
+      bench::doNotOptimize(events[0]);
+      bench::doNotOptimize(encodeTouchFrame(frame, seq++, 1000000, events, 2));
+    });
+  }
+
+  if (selected("mega capacitive frame encode")) {
+    uint8_t frame[CAPACITIVE_FRAME_SIZE];
+    uint8_t seq = 0;
+    suite.run("mega capacitive frame encode", [&] {
+      bench::doNotOptimize(values[0]);
+      bench::doNotOptimize(encodeCapacitiveFrame(frame, seq++, 1000000, values));
+    });
+  }
+
+  if (selected("esp32 capacitive frame decode")) {
+    uint8_t frame[CAPACITIVE_FRAME_SIZE];
+    size_t n = encodeCapacitiveFrame(frame, 0, 1000000, values);
+    FrameDecoder decoder;
+    int decoded[PLANK_CAPACITIVE_COUNT];
+    suite.run("esp32 capacitive frame decode", [&] {
+      for (size_t i = 0; i < n; i++) {
+        if (decoder.feed(frame[i])) {
+          for (int j = 0; j < PLANK_CAPACITIVE_COUNT; j++) {
+            decoded[j] = frameCapacitive(decoder.payload(), j);
+          }
+        }
+      }
+      bench::doNotOptimize(decoded[0]);
+    });
+  }
+
+  if (selected("esp32 capacitive frame decode, 1% corrupt")) {
+    // a long stream with one flipped bit per ~100 bytes, decoded in one pass per op
+    static uint8_t stream[CAPACITIVE_FRAME_SIZE * 256];
+    size_t n = 0;
+    for (int f = 0; f < 256; f++) {
+      n += encodeCapacitiveFrame(&stream[n], f, 1000000 + f * 40000, values);
+    }
+    uint32_t seed = 42;
+    for (size_t i = 0; i < n; i++) {
+      seed = seed * 1664525u + 1013904223u;
+      if ((seed >> 16) % 100 == 0) {
+        stream[i] ^= 1 << ((seed >> 8) & 7);
+      }
+    }
+    FrameDecoder decoder;
+    bench::Result &r = suite.run("esp32 capacitive frame decode, 1% corrupt", [&] {
+      for (size_t i = 0; i < n; i++) {
+        bench::doNotOptimize(decoder.feed(stream[i]));
+      }
+    });
+    char extra[96];
+    snprintf(extra, sizeof(extra), "\"frames_per_op\": 256, \"ns_per_byte\": %.2f", r.nsPerOp / n);
+    r.extra = extra;
+  }
+
+  if (selected("link frame round trip")) {
+    // Mega encodes and sends, ESP32 receives, ACKs and reads, Mega takes the ACK: one frame per op
+    LoopbackPrint toEsp, toMega;
+    LinkSender sender(toEsp);
+    LinkReceiver receiver(toMega);
+    int decoded[PLANK_CAPACITIVE_COUNT];
+    suite.run("link frame round trip", [&] {
+      sender.send(encodeCapacitiveFrame(sender.frameBuffer(), sender.sequence(), micros(), values));
+      for (size_t i = 0; i < toEsp.length; i++) {
+        receiver.feed(toEsp.data[i]);
+      }
+      toEsp.length = 0;
+      while (receiver.read()) {
+        for (int j = 0; j < PLANK_CAPACITIVE_COUNT; j++) {
+          decoded[j] = frameCapacitive(receiver.payload(), j);
+        }
+      }
+      for (size_t i = 0; i < toMega.length; i++) {
+        sender.feed(toMega.data[i]);
+      }
+      toMega.length = 0;
+      bench::doNotOptimize(decoded[0]);
+    });
+  }
+
+  if (selected("esp32 clock sync exchange")) {
+    // one request/reply pair into the estimate, a least-squares fit every CLOCK_SYNC_BURST of them;
+    // the remote clock runs 100 ppm fast, the round trips jitter by up to 600 us
+    ClockSync clock;
+    uint32_t t = 0, seed = 7;
+    suite.run("esp32 clock sync exchange", [&] {
+      seed = seed * 1664525u + 1013904223u;
+      t += 250000;
+      uint32_t remote = 123456789u + t + t / 10000;
+      clock.add(t, remote + 1650 + (seed >> 8) % 600, remote + 1700, t + 3400);
+      bench::doNotOptimize(clock.driftPpb());
+    });
+  }
+
+  if (selected("esp32 clock sync toLocal")) {
+    ClockSync clock;
+    for (uint32_t t = 0; t < 32 * 250000; t += 250000) {
+      uint32_t remote = 123456789u + t + t / 10000;
+      clock.add(t, remote + 1650, remote + 1700, t + 3400);
+    }
+    uint32_t remote = 123456789u;
+    suite.run("esp32 clock sync toLocal", [&] {
+      bench::doNotOptimize(clock.toLocal(remote += 57000));
+    });
+  }
+
+  if (selected("esp32 capacitive parse (String)")) {
+    // the ASCII parser the firmware used before the binary frames; typical frame that fits the parser's 100 character limit
+    char frame[128];
+    int len = 0;
+    len += snprintf(frame + len, sizeof(frame) - len, "<");
+    for (int i = 0; i < PLANK_CAPACITIVE_COUNT; i++) {
+      len += snprintf(frame + len, sizeof(frame) - len, i ? ",%d" : "%d", 150 - 23 * i);
+    }
+    len += snprintf(frame + len, sizeof(frame) - len, ">\r\n");
+    CapacitiveFrameParser parser;
+    suite.run("esp32 capacitive parse (String)", [&] {
+      bool complete = false;
+      for (int i = 0; i < len; i++) {
+        complete |= parser.feed(frame[i]);
+      }
+      bench::doNotOptimize(complete);
+    });
+  }
+}
+
+static void benchPackets(bench::Suite &suite) {
+  long raw[CHANNEL_COUNT] = {1500000, 12000, -3000, 840000};
+  long strain[PLANK_STRAIN_COUNT];
+  uint8_t strainBytes[PLANK_STRAIN_COUNT];
+  int capacitive[PLANK_CAPACITIVE_COUNT];
+  uint16_t piezo[PLANK_PIEZO_COUNT] = {1200, 65535, 0, 31000};
+  uint8_t packet[CAPACITIVE_PACKET_SIZE];
+  for (int i = 0; i < PLANK_CAPACITIVE_COUNT; i++) {
+    capacitive[i] = 40 * i - 300;
+  }
+
+  if (selected("esp32 strain legacy divide x4")) {
+    // the (raw / 842) * 255 / 2500 scaling the firmware used before per-channel calibration
+    suite.run("esp32 strain legacy divide x4", [&] {
+      bench::doNotOptimize(raw[0]);
+      for (int i = 0; i < CHANNEL_COUNT; i++) {
+        strainBytes[i] = static_cast<uint8_t>((raw[i] / 842) * 255 / 2500);
+      }
+      bench::doNotOptimize(strainBytes[0]);
+    });
+  }
+  HX711Calibration linear = HX711Calibration::fromFloat(STRAIN_DEFAULT_UNITS_PER_COUNT);
+  HX711Calibration quadratic = HX711Calibration::fromFloat(STRAIN_DEFAULT_UNITS_PER_COUNT, 1e-12f);
+  if (selected("esp32 strain calibrate linear x4")) {
+    suite.run("esp32 strain calibrate linear x4", [&] {
+      bench::doNotOptimize(raw[0]);
+      for (int i = 0; i < CHANNEL_COUNT; i++) {
+        strain[i] = linear.apply(raw[i]);
+      }
+      bench::doNotOptimize(strain[0]);
+    });
+  }
+  if (selected("esp32 strain calibrate quadratic x4")) {
+    suite.run("esp32 strain calibrate quadratic x4", [&] {
+      bench::doNotOptimize(raw[0]);
+      for (int i = 0; i < CHANNEL_COUNT; i++) {
+        strain[i] = quadratic.apply(raw[i]);
+      }
+      bench::doNotOptimize(strain[0]);
+    });
+  }
+  if (selected("esp32 piezo map x4")) {
+    int readings[PLANK_PIEZO_COUNT] = {100, 4095, 0, 2048};
+    suite.run("esp32 piezo map x4", [&] {
+      bench::doNotOptimize(readings[0]);
+      for (int i = 0; i < PLANK_PIEZO_COUNT; i++) {
+        piezo[i] = mapPiezo(readings[i]);
+      }
+      bench::doNotOptimize(piezo[0]);
+    });
+  }
+  if (selected("esp32 pack capacitive")) {
+    suite.run("esp32 pack capacitive", [&] {
+      bench::doNotOptimize(capacitive[0]);
+      bench::doNotOptimize(packCapacitive(packet, capacitive, 1000000));
+    });
+  }
+  if (selected("esp32 pack strain")) {
+    suite.run("esp32 pack strain", [&] {
+      bench::doNotOptimize(strain[0]);
+      bench::doNotOptimize(packStrain(packet, strain, 1000000));
+    });
+  }
+  if (selected("esp32 pack piezo")) {
+    suite.run("esp32 pack piezo", [&] {
+      bench::doNotOptimize(piezo[0]);
+      bench::doNotOptimize(packPiezo(packet, piezo, 1000000));
+    });
+  }
+  if (selected("esp32 stream add piezo")) {
+    // one piezo sample into 244-byte stream frames, finishing each frame when it is full
+    SensorStreamWriter stream;
+    stream.setCapacity(STREAM_FRAME_MAX);
+    uint32_t now = 0;
+    uint64_t frames = 0, samples = 0;
+    bench::Result &r = suite.run("esp32 stream add piezo", [&] {
+      now += 20000;
+      if (!stream.addSample(STREAM_RECORD_PIEZO, now, piezo)) {
+        bench::doNotOptimize(stream.finish());
+        ++frames;
+        stream.addSample(STREAM_RECORD_PIEZO, now, piezo);
+      }
+      ++samples;
+    });
+    char extra[64];
+    snprintf(extra, sizeof(extra), "\"samples_per_frame\": %.1f", frames ? (double) samples / frames : 0.0);
+    r.extra = extra;
+  }
+}
+
+// 10 minutes of the native simulation's scenario as the ESP32 streams it, one 100 ms window per
+// frame: capacitive strengths (a touch per pad and minute) and strain (someone standing on the plank
+// 30 s out of 90) once, piezo readings (hum and a 2 kHz ring every 2.5 s) five times
+struct CodecSession {
+  static const int WINDOWS = 6000;
+  std::vector<int32_t> capacitive, strain, piezo;
+
+  CodecSession() {
+    uint32_t seed = 99;
+    for (int w = 0; w < WINDOWS; w++) {
+      double t = w * 0.1;
+      for (int i = 0; i < PLANK_CAPACITIVE_COUNT; i++) {
+        double since = fmod(t, 60.0) - 10.0 - i * 3.0;
+        capacitive.push_back((since >= 0 && since < 1.5 ? 104 : 0) + (int) lround(simNoise(seed)));
+      }
+      for (int i = 0; i < PLANK_STRAIN_COUNT; i++) {
+        double load = fmod(t, 90.0) >= 60.0 ? 400.0 + 150.0 * i : 0.0;
+        strain.push_back((int32_t) lround(load + 2.4 * simNoise(seed)));
+      }
+      for (int k = 0; k < 5; k++) {
+        for (int i = 0; i < PLANK_PIEZO_COUNT; i++) {
+          double since = fmod(t + k * 0.02, 2.5) - 0.0004 * i;
+          double v = 0.05 + 0.01 * simNoise(seed);
+          if (since >= 0) {
+            v += 1.2 * exp(-since / 0.005) * sin(2 * M_PI * 2000.0 * since);
+          }
+          piezo.push_back(v < 0 ? 0 : (int32_t) (v / 3.3 * 4095 + 0.5));
+        }
+      }
+    }
+  }
+
+  // the records of one window
+  void add(SensorStreamWriter &stream, int w) const {
+    uint32_t t = w * 100000;
+    stream.addValues(STREAM_RECORD_CAPACITIVE, t, &capacitive[w * PLANK_CAPACITIVE_COUNT]);
+    stream.addValues(STREAM_RECORD_STRAIN, t + 10, &strain[w * PLANK_STRAIN_COUNT]);
+    for (int k = 0; k < 5; k++) {
+      stream.addValues(STREAM_RECORD_PIEZO, t + k * 20000, &piezo[(w * 5 + k) * PLANK_PIEZO_COUNT]);
+    }
+  }
+};
+
+// bytes of the session in 244-byte stream frames; with 'check', decodes every frame and compares
+static uint64_t sessionBytes(const CodecSession &session, bool packed, bool check) {
+  SensorStreamWriter stream;
+  stream.setCapacity(STREAM_FRAME_MAX);
+  stream.setPacked(packed);
+  uint64_t bytes = 0;
+  for (int w = 0; w < CodecSession::WINDOWS; w++) {
+    session.add(stream, w);
+    size_t size = stream.finish();
+    bytes += size;
+    if (!check) {
+      continue;
+    }
+    SensorStreamReader reader;
+    int32_t values[DELTA_MAX_CHANNELS];
+    int piezoSample = w * 5;
+    bool ok = reader.begin(stream.data(), size) && reader.count() == 7;
+    while (ok && reader.next()) {
+      uint8_t n = reader.values(values);
+      const int32_t *expected = reader.baseType() == STREAM_RECORD_CAPACITIVE ? &session.capacitive[w * n]
+                              : reader.baseType() == STREAM_RECORD_STRAIN ? &session.strain[w * n]
+                              : &session.piezo[piezoSample++ * n];
+      ok = n != 0 && memcmp(values, expected, n * sizeof(int32_t)) == 0;
+    }
+    if (!ok) {
+      fprintf(stderr, "stream codec: window %d does not round-trip\n", w);
+      exit(1);
+    }
+  }
+  return bytes;
+}
+
+static void benchCodec(bench::Suite &suite) {
+  if (!selected("esp32 stream frame") && !selected("host stream frame decode")) {
+    return;
+  }
+  CodecSession session;
+  uint64_t plainBytes = sessionBytes(session, false, true);
+  uint64_t packedBytes = sessionBytes(session, true, true);
+
+  for (int packed = 0; packed < 2; packed++) {
+    const char *name = packed ? "esp32 stream frame packed" : "esp32 stream frame plain";
+    if (!selected(name)) {
+      continue;
+    }
+    SensorStreamWriter stream;
+    stream.setCapacity(STREAM_FRAME_MAX);
+    stream.setPacked(packed);
+    int w = 0;
+    bench::Result &r = suite.run(name, [&] {
+      session.add(stream, w);
+      bench::doNotOptimize(stream.finish());
+      w = w + 1 == CodecSession::WINDOWS ? 0 : w + 1;
+    });
+    char extra[128];
+    snprintf(extra, sizeof(extra), "\"bytes_per_frame\": %.1f, \"compression_ratio\": %.2f",
+             (double) (packed ? packedBytes : plainBytes) / CodecSession::WINDOWS, (double) plainBytes / packedBytes);
+    r.extra = extra;
+  }
+
+  if (selected("host stream frame decode packed")) {
+    std::vector<uint8_t> frames;
+    std::vector<size_t> sizes;
+    SensorStreamWriter stream;
+    stream.setCapacity(STREAM_FRAME_MAX);
+    stream.setPacked(true);
+    for (int w = 0; w < CodecSession::WINDOWS; w++) {
+      session.add(stream, w);
+      size_t size = stream.finish();
+      frames.insert(frames.end(), stream.data(), stream.data() + size);
+      sizes.push_back(size);
+    }
+    size_t at = 0;
+    int w = 0;
+    int32_t values[DELTA_MAX_CHANNELS];
+    suite.run("host stream frame decode packed", [&] {
+      SensorStreamReader reader;
+      reader.begin(&frames[at], sizes[w]);
+      while (reader.next()) {
+        bench::doNotOptimize(reader.values(values));
+      }
+      at += sizes[w];
+      if (++w == CodecSession::WINDOWS) {
+        w = 0;
+        at = 0;
+      }
+    });
+  }
+}
+
+// the piezo signal the block chain runs on: a recording (--waveform) or 10 s of the native
+// simulation's scenario, hum and a decaying 2 kHz ring every 2.5 s
+struct PiezoWaveform {
+  std::vector<int16_t> mv;  // PLANK_PIEZO_COUNT interleaved
+  size_t frames;
+
+  PiezoWaveform() {
+    if (waveformPath != NULL) {
+      FILE *f = fopen(waveformPath, "rb");
+      if (f == NULL) {
+        fprintf(stderr, "cannot read %s\n", waveformPath);
+        exit(1);
+      }
+      int16_t frame[PLANK_PIEZO_COUNT];
+      while (fread(frame, sizeof(frame), 1, f) == 1) {
+        mv.insert(mv.end(), frame, frame + PLANK_PIEZO_COUNT);
+      }
+      fclose(f);
+    } else {
+      uint32_t seed = 4242;
+      for (int n = 0; n < 10 * PIEZO_DEFAULT_RATE; n++) {
+        for (int i = 0; i < PLANK_PIEZO_COUNT; i++) {
+          double since = fmod((double) n / PIEZO_DEFAULT_RATE, 2.5) - 0.0004 * i;
+          double v = 0.05 + 0.01 * simNoise(seed);
+          if (since >= 0) {
+            v += 1.2 * exp(-since / 0.005) * sin(2 * M_PI * 2000.0 * since);
+          }
+          mv.push_back(v < 0 ? 0 : (int16_t) lround(v * 1000));
+        }
+      }
+    }
+    frames = mv.size() / PLANK_PIEZO_COUNT;
+    if (frames < PIEZO_BLOCK_SAMPLES) {
+      fprintf(stderr, "piezo waveform: fewer than %d samples\n", PIEZO_BLOCK_SAMPLES);
+      exit(1);
+    }
+  }
+};
+
+static void benchPiezo(bench::Suite &suite) {
+  const char *const blockBenches[] = {"esp32 piezo peak hold block", "esp32 piezo impact detector block",
+                                      "esp32 piezo capture block", "esp32 piezo capture chunk"};
+  bool anyBlockBench = false;
+  for (const char *name : blockBenches) {
+    anyBlockBench = anyBlockBench || selected(name);
+  }
+  if (!selected("esp32 piezo DMA frame to blocks") && !anyBlockBench) {
+    return;
+  }
+  PiezoWaveform wave;
+  // the firmware's pins: three piezos on ADC1, the DMA converts them in ADC channel order
+  const int pins[PLANK_PIEZO_COUNT] = {36, 39, 15, 35};
+
+  if (selected("esp32 piezo DMA frame to blocks")) {
+    // the whole waveform as the sampling task receives it, TYPE1 words of ideal 12-bit readings
+    std::vector<uint16_t> words;
+    for (size_t n = 0; n < wave.frames; n++) {
+      for (int adc = 0; adc < PIEZO_ADC1_CHANNELS; adc++) {
+        for (int i = 0; i < PLANK_PIEZO_COUNT; i++) {
+          if (piezoAdc1Channel(pins[i]) == adc) {
+            words.push_back((adc << 12) | piezoReading(wave.mv[n * PLANK_PIEZO_COUNT + i]));
+          }
+        }
+      }
+    }
+    const size_t frame = PIEZO_DMA_FRAME_BYTES / 2;
+    size_t frames = words.size() / frame;
+    PiezoSampler sampler;
+    sampler.begin(pins, PLANK_PIEZO_COUNT);
+    PiezoBlock block;
+    size_t at = 0;
+    bench::Result &r = suite.run("esp32 piezo DMA frame to blocks", [&] {
+      sampler.onConversions(&words[at * frame], frame);
+      while (sampler.readBlock(block)) {
+        bench::doNotOptimize(block.mv[0][0]);
+      }
+      at = at + 1 == frames ? 0 : at + 1;
+    });
+    char extra[64];
+    snprintf(extra, sizeof(extra), "\"ns_per_conversion\": %.2f", r.nsPerOp / frame);
+    r.extra = extra;
+  }
+
+  if (!anyBlockBench) {
+    return;
+  }
+  std::vector<PiezoBlock> blocks;
+  PiezoBlockAssembler assembler;
+  assembler.begin(PLANK_PIEZO_COUNT, 0x0F, PIEZO_DEFAULT_RATE, 0);
+  for (size_t n = 0; n < wave.frames; n++) {
+    if (assembler.addFrame(&wave.mv[n * PLANK_PIEZO_COUNT])) {
+      blocks.push_back(assembler.block());
+    }
+  }
+
+  if (selected("esp32 piezo peak hold block")) {
+    PiezoPeakHold peaks;
+    int16_t peak[PIEZO_MAX_CHANNELS];
+    size_t b = 0;
+    suite.run("esp32 piezo peak hold block", [&] {
+      peaks.process(blocks[b]);
+      bench::doNotOptimize(peaks.take(peak));
+      b = b + 1 == blocks.size() ? 0 : b + 1;
+    });
+  }
+
+  if (selected("esp32 piezo impact detector block")) {
+    // one pass over the waveform first, for the hits it holds
+    ImpactDetector detector;
+    for (size_t b = 0; b < blocks.size(); b++) {
+      detector.process(blocks[b]);
+    }
+    uint32_t hits = detector.hits();
+    PiezoHit hit;
+    size_t b = 0;
+    bench::Result &r = suite.run("esp32 piezo impact detector block", [&] {
+      detector.process(blocks[b]);
+      while (detector.readHit(hit)) {
+        bench::doNotOptimize(hit.time);
+      }
+      b = b + 1 == blocks.size() ? 0 : b + 1;
+    });
+    char extra[96];
+    snprintf(extra, sizeof(extra), "\"ns_per_sample\": %.2f, \"hits_in_waveform\": %u",
+             r.nsPerOp / (PIEZO_BLOCK_SAMPLES * PLANK_PIEZO_COUNT), hits);
+    r.extra = extra;
+  }
+
+  if (selected("esp32 piezo capture block")) {
+    // the history copy every block pays, no capture pending
+    WaveformCapture capture;
+    size_t b = 0;
+    suite.run("esp32 piezo capture block", [&] {
+      capture.process(blocks[b]);
+      b = b + 1 == blocks.size() ? 0 : b + 1;
+    });
+  }
+
+  if (selected("esp32 piezo capture chunk")) {
+    // one default-size notification of a full-window capture, the next capture triggered once one is sent
+    // the window ends with the history, the capture is taken at once by the block after the trigger
+    WaveformCapture capture;
+    const size_t historyBlocks = CAPTURE_HISTORY / PIEZO_BLOCK_SAMPLES;
+    for (size_t b = 0; b < historyBlocks - 1; b++) {
+      capture.process(blocks[b % blocks.size()]);
+    }
+    const PiezoBlock &last = blocks[(historyBlocks - 1) % blocks.size()];
+    const uint32_t windowStart = blocks[0].timestamp;
+    capture.setWindow(0, CAPTURE_HISTORY < CAPTURE_POST_MAX ? CAPTURE_HISTORY : CAPTURE_POST_MAX);
+    uint8_t chunk[STREAM_FRAME_MAX];
+    suite.run("esp32 piezo capture chunk", [&] {
+      if (!capture.busy()) {
+        capture.trigger(windowStart);
+        capture.process(last);
+      }
+      bench::doNotOptimize(capture.nextChunk(chunk, sizeof(chunk)));
+    });
+  }
+}
+
+// the hand-overs between the firmware tasks
+static void benchPipeline(bench::Suite &suite) {
+  if (selected("esp32 task queue link frame")) {
+    // link task -> publish task, one frame pushed and popped per op
+    SpscRing<LinkFrame, 8> ring;
+    LinkFrame in, out;
+    memset(&in, 0, sizeof(in));
+    in.type = PLANK_FRAME_TOUCH;
+    in.length = TOUCH_PAYLOAD_SIZE(3);
+    suite.run("esp32 task queue link frame", [&] {
+      ring.push(in);
+      ring.pop(out);
+      bench::doNotOptimize(out.length);
+    });
+  }
+
+  if (selected("esp32 task queue piezo block, two threads")) {
+    // piezo task -> process task, the producer waiting while the ring is full; both yield rather than
+    // spin, so that a single host core still runs them
+    SpscRing<PiezoBlock, PIEZO_RING_BLOCKS> ring;
+    std::atomic<bool> stop(false);
+    std::thread consumer([&] {
+      PiezoBlock block;
+      while (!stop.load(std::memory_order_relaxed)) {
+        if (ring.pop(block)) {
+          bench::doNotOptimize(block.mv[0][0]);
+        } else {
+          std::this_thread::yield();
+        }
+      }
+    });
+    PiezoBlock block;
+    memset(&block, 0, sizeof(block));
+    suite.run("esp32 task queue piezo block, two threads", [&] {
+      while (ring.size() == ring.capacity()) {
+        std::this_thread::yield();
+      }
+      ring.push(block);
+      ++block.sequence;
+    });
+    stop = true;
+    consumer.join();
+  }
+
+  if (selected("esp32 task meter pass")) {
+    TaskMeter meter("bench");
+    suite.run("esp32 task meter pass", [&] {
+      meter.begin();
+      meter.end();
+    });
+  }
+
+  if (selected("esp32 cycle probe record")) {
+    // what PROBE_SCOPE adds to a block besides the two cycle counter reads, over every bucket
+    CycleProbe probe("bench");
+    uint32_t cycles = 12345;
+    suite.run("esp32 cycle probe record", [&] {
+      probe.record(cycles);
+      cycles = cycles * 1103515245u + 12345u;
+    });
+    bench::doNotOptimize(probe.meanCycles());
+  }
+}
+
+static void benchLog(bench::Suite &suite) {
+  PiezoHit hit = {7, 1, 123456789, 412, 1111, 236};
+  if (selected("esp32 hit text print")) {
+    // what sendHits() printed for every hit before PlankLog, into a UART driver that never blocks
+    CountingPrint out;
+    suite.run("esp32 hit text print", [&] {
+      out.print("Hit - Piezo ");
+      out.print(hit.channel);
+      out.print(", impact ");
+      out.print(hit.impact);
+      out.print(" at ");
+      out.print(hit.time);
+      out.print(" us (+");
+      out.print(hit.delay);
+      out.print(" us), peak ");
+      out.print(hit.peak);
+      out.print(" mV, rise ");
+      out.print(hit.rise);
+      out.println(" us");
+      bench::doNotOptimize(out.count);
+    });
+  }
+  if (selected("esp32 log hit record and drain")) {
+    PlankLog log;
+    CountingPrint out;
+    // the call in sendHits(), then the log task writing the frame out
+    suite.run("esp32 log hit record and drain", [&] {
+      log.write<LOG_HIT>(hit.channel, hit.impact, hit.time, hit.delay, hit.peak, hit.rise);
+      bench::doNotOptimize(log.drain(out, SIZE_MAX));
+    });
+  }
+}
+
+// what a receiver does with every value it decodes
+struct ReceiverSink : public PlankHandler {
+  int64_t sum = 0;
+  void onCapacitive(const Notification &, const CapacitivePacket &p) {
+    for (size_t i = 0; i < p.values.size(); i++) {
+      sum += p.values[i];
+    }
+  }
+  void onStrain(const Notification &, const StrainPacket &p) {
+    for (size_t i = 0; i < p.values.size(); i++) {
+      sum += p.values[i];
+    }
+  }
+  void onStreamFrame(const Notification &, SensorStreamReader &reader) {
+    int32_t values[DELTA_MAX_CHANNELS];
+    while (reader.next()) {
+      sum += reader.values(values) > 0 ? values[0] : 0;
+    }
+  }
+};
+
+// notifications out of a log in memory, as env:receiver decodes a recorded one: every window of the
+// codec session as a capacitive and a strain packet and a packed stream frame
+static void benchReceiver(bench::Suite &suite) {
+  if (!selected("host receiver")) {
+    return;
+  }
+  CodecSession session;
+  std::vector<uint8_t> log(NOTIFICATION_LOG_HEADER_SIZE, 0);
+  memcpy(log.data(), NOTIFICATION_LOG_MAGIC, 4);
+  log[4] = NOTIFICATION_LOG_VERSION;
+  auto append = [&log](uint32_t time, uint8_t channel, const uint8_t *value, size_t length) {
+    uint8_t header[NOTIFICATION_RECORD_HEADER_SIZE] = {(uint8_t) time, (uint8_t) (time >> 8), (uint8_t) (time >> 16),
+                                                       (uint8_t) (time >> 24), channel, 0, (uint8_t) length, (uint8_t) (length >> 8)};
+    log.insert(log.end(), header, header + sizeof(header));
+    log.insert(log.end(), value, value + length);
+  };
+  SensorStreamWriter stream;
+  stream.setCapacity(STREAM_FRAME_MAX);
+  stream.setPacked(true);
+  uint32_t notifications = 0;
+  for (int w = 0; w < CodecSession::WINDOWS; w++) {
+    uint32_t time = w * 100000;
+    int capacitive[PLANK_CAPACITIVE_COUNT];
+    long strain[PLANK_STRAIN_COUNT];
+    for (int i = 0; i < PLANK_CAPACITIVE_COUNT; i++) {
+      capacitive[i] = session.capacitive[w * PLANK_CAPACITIVE_COUNT + i];
+    }
+    for (int i = 0; i < PLANK_STRAIN_COUNT; i++) {
+      strain[i] = session.strain[w * PLANK_STRAIN_COUNT + i];
+    }
+    uint8_t packet[CAPACITIVE_PACKET_SIZE];
+    append(time, PLANK_CHANNEL_CAPACITIVE, packet, packCapacitive(packet, capacitive, time));
+    append(time, PLANK_CHANNEL_STRAIN, packet, packStrain(packet, strain, time));
+    session.add(stream, w);
+    size_t size = stream.finish();
+    append(time, PLANK_CHANNEL_STREAM, stream.data(), size);
+    notifications += 3;
+  }
+
+  if (selected("host receiver decode capacitive packet")) {
+    Notification n;
+    parseNotification(&log[NOTIFICATION_LOG_HEADER_SIZE], log.size() - NOTIFICATION_LOG_HEADER_SIZE, n);
+    PlankDecoder decoder;
+    ReceiverSink sink;
+    suite.run("host receiver decode capacitive packet", [&] {
+      bench::doNotOptimize(decoder.decode(n, sink));
+      bench::doNotOptimize(sink.sum);
+    });
+  }
+  if (selected("host receiver decode log")) {
+    MemoryNotificationSource source(log.data(), log.size());
+    PlankDecoder decoder;
+    ReceiverSink sink;
+    bench::Result &r = suite.run("host receiver decode log", [&] {
+      Notification n;
+      if (!source.next(n)) {
+        source.rewind();
+        source.next(n);
+      }
+      bench::doNotOptimize(decoder.decode(n, sink));
+    });
+    char extra[128];
+    snprintf(extra, sizeof(extra), "\"m_notifications_per_s\": %.2f, \"mb_per_s\": %.1f, \"bad\": %u", 1e3 / r.nsPerOp,
+             (double) (log.size() - NOTIFICATION_LOG_HEADER_SIZE) / notifications * 1e3 / r.nsPerOp, decoder.stats().badPackets);
+    r.extra = extra;
+  }
+}
+
+// the recording path on the host file that stands in for the log partition: what it costs per sample,
+// and the write and download throughput it reaches
+static void benchRecording(bench::Suite &suite) {
+  const uint32_t storeBytes = 1024 * 1024;
+  if (selected("esp32 session log strain sample")) {
+    FileStore store;
+    store.open(NULL, storeBytes);
+    SessionLog log(store);
+    log.begin();
+    log.startSession();
+    int32_t values[PLANK_STRAIN_COUNT] = {12000, -3400, 560, 78000};
+    uint32_t time = 0;
+    bench::Result &r = suite.run("esp32 session log strain sample", [&] {
+      values[time % PLANK_STRAIN_COUNT] += 37;
+      bench::doNotOptimize(log.addValues(STREAM_RECORD_STRAIN, time * 100000, values));
+      ++time;
+    });
+    char extra[96];
+    snprintf(extra, sizeof(extra), "\"flash_bytes_per_sample\": %.2f, \"blocks\": %u",
+             log.samples() ? (double) log.blocksWritten() * SESSION_LOG_BLOCK / log.samples() : 0.0, log.blocksWritten());
+    r.extra = extra;
+  }
+  if (selected("host file store program block")) {
+    FileStore store;
+    store.open(NULL, storeBytes);
+    uint8_t block[SESSION_LOG_BLOCK];
+    for (size_t i = 0; i < sizeof(block); i++) {
+      block[i] = i * 7;
+    }
+    uint32_t address = 0;
+    bench::Result &r = suite.run("host file store program block", [&] {
+      if (address % FLASH_SECTOR_SIZE == 0) {
+        store.erase(address);
+      }
+      bench::doNotOptimize(store.program(address, block, sizeof(block)));
+      address = (address + SESSION_LOG_BLOCK) % storeBytes;
+    });
+    char extra[64];
+    snprintf(extra, sizeof(extra), "\"mb_per_s\": %.1f", SESSION_LOG_BLOCK * 1e3 / r.nsPerOp);
+    r.extra = extra;
+  }
+  if (selected("esp32 session download chunk")) {
+    FileStore store;
+    store.open(NULL, storeBytes);
+    SessionLog log(store);
+    log.begin();
+    log.startSession();
+    int32_t values[PLANK_STRAIN_COUNT] = {12000, -3400, 560, 78000};
+    for (uint32_t i = 0; i < 20000; i++) {
+      values[i % PLANK_STRAIN_COUNT] += 37;
+      log.addValues(STREAM_RECORD_STRAIN, i * 100000, values);
+    }
+    log.endSession();
+    SessionDownload download(log);
+    uint8_t chunk[STREAM_FRAME_MAX];
+    uint64_t bytes = 0, chunks = 0;
+    bench::Result &r = suite.run("esp32 session download chunk", [&] {
+      if (!download.active()) {
+        download.start(log.sessionId());
+      }
+      size_t size = download.nextChunk(chunk, STREAM_FRAME_MAX);
+      bytes += size;
+      ++chunks;
+      bench::doNotOptimize(chunk[0]);
+    });
+    char extra[64];
+    snprintf(extra, sizeof(extra), "\"chunk_bytes\": %.1f, \"mb_per_s\": %.1f", (double) bytes / chunks,
+             (double) bytes / chunks * 1e3 / r.nsPerOp);
+    r.extra = extra;
+  }
+}
+
+int main(int argc, char **argv) {
+  const char *jsonPath = NULL;
+  const char *label = "local";
+  const char *baselinePath = NULL;
+  double minSeconds = 0.2;
+
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--json") && i + 1 < argc) {
+      jsonPath = argv[++i];
+    } else if (!strcmp(argv[i], "--label") && i + 1 < argc) {
+      label = argv[++i];
+    } else if (!strcmp(argv[i], "--baseline") && i + 1 < argc) {
+      baselinePath = argv[++i];
+    } else if (!strcmp(argv[i], "--filter") && i + 1 < argc) {
+      filter = argv[++i];
+    } else if (!strcmp(argv[i], "--quick")) {
+      minSeconds = 0.02;
+    } else if (!strcmp(argv[i], "--waveform") && i + 1 < argc) {
+      waveformPath = argv[++i];
+    } else {
+      fprintf(stderr, "usage: %s [--json file] [--label name] [--baseline file] [--filter substring] [--quick]"
+              " [--waveform file]\n", argv[0]);
+      return 2;
+    }
+  }
+
+  Serial.setMuted(true);
+  bench::Suite suite(minSeconds);
+  benchHX711(suite);
+  benchScan(suite);
+  benchCapacitive(suite);
+  benchPackets(suite);
+  benchCodec(suite);
+  benchPiezo(suite);
+  benchPipeline(suite);
+  benchLog(suite);
+  benchRecording(suite);
+  benchReceiver(suite);
+
+  suite.printTable(stdout);
+  if (jsonPath != NULL && !suite.writeJson(jsonPath, label)) {
+    fprintf(stderr, "cannot write %s\n", jsonPath);
+    return 1;
+  }
+  if (baselinePath != NULL) {
+    int regressions = suite.compare(baselinePath, 1.10, stdout);
+    return regressions < 0 ? 1 : regressions;
+  }
+  return 0;
+}
@@ -0,0 +1,190 @@
+// Host receiver of the plank's notifications (PlatformIO env:receiver).
+// Decodes a notification log (lib/PlankReceiver/NotificationLog.h) written by
+// test/BluetoothPlank.py --log or by the simulation, checks every packet and frame, and measures how
+// fast the decoding runs.
+// Usage: receiver <log | -> [--print] [--repeat N]
+// "-" reads the log from stdin. --print shows every sample; --repeat decodes the log N times from
+// memory and reports the decoding throughput.
+#include <Arduino.h>
+#include <PlankReceiver.h>
+#include <chrono>
+#include <vector>
+#include <stdio.h>
+
+// counts what comes out of the decoder, and prints it with --print
+class SampleCounter : public PlankHandler {
+  public:
+    bool print = false;
+    uint64_t capacitive = 0;
+    uint64_t strain = 0;
+    uint64_t piezo = 0;
+    uint64_t streamSamples = 0;
+    uint64_t streamErrors = 0;
+    uint64_t hits = 0;
+    uint64_t captureSamples = 0;
+    uint64_t sessionBytes = 0;
+    int64_t checksum = 0;  // of every value, so that none of the decoding is left out
+
+    void onCapacitive(const Notification &, const CapacitivePacket &p) {
+      ++capacitive;
+      for (size_t i = 0; i < p.values.size(); i++) {
+        checksum += p.values[i];
+      }
+      if (print) {
+        printf("[%u us] capacitive:", p.time);
+        for (size_t i = 0; i < p.values.size(); i++) {
+          printf(" %d", p.values[i]);
+        }
+        printf("\n");
+      }
+    }
+
+    void onStrain(const Notification &, const StrainPacket &p) {
+      ++strain;
+      for (size_t i = 0; i < p.values.size(); i++) {
+        checksum += p.values[i];
+      }
+      if (print) {
+        printf("[%u us] strain: %u %u %u %u\n", p.time, p.values[0], p.values[1], p.values[2], p.values[3]);
+      }
+    }
+
+    void onPiezo(const Notification &, const PiezoPacket &p) {
+      ++piezo;
+      for (size_t i = 0; i < p.values.size(); i++) {
+        checksum += p.values[i];
+      }
+      if (print) {
+        printf("[%u us] piezo: %u %u %u %u\n", p.time, p.values[0], p.values[1], p.values[2], p.values[3]);
+      }
+    }
+
+    void onStreamFrame(const Notification &, SensorStreamReader &reader) {
+      int32_t values[DELTA_MAX_CHANNELS];
+      while (reader.next()) {
+        uint8_t channels = reader.values(values);
+        if (channels == 0) {
+          ++streamErrors;
+          continue;
+        }
+        ++streamSamples;
+        for (uint8_t i = 0; i < channels; i++) {
+          checksum += values[i];
+        }
+        if (print) {
+          printf("[%u us] stream %u:", reader.timeUs(), reader.baseType());
+          for (uint8_t i = 0; i < channels; i++) {
+            printf(" %d", values[i]);
+          }
+          printf("\n");
+        }
+      }
+    }
+
+    void onHit(const Notification &, const PiezoHit &hit) {
+      ++hits;
+      checksum += hit.peak;
+      if (print) {
+        printf("[%u us] hit %u on piezo %u: +%d us, peak %u mV, rise %u us\n", hit.time, hit.impact, hit.channel,
+               hit.delay, hit.peak, hit.rise);
+      }
+    }
+
+    void onCaptureChunk(const Notification &, const CaptureChunk &chunk) {
+      captureSamples += chunk.data.size();
+      for (size_t i = 0; i < chunk.data.size(); i++) {
+        checksum += chunk.data[i];
+      }
+      if (print && chunk.index == 0) {
+        printf("[%u us] capture %u: %u samples at %u Hz, %u before the trigger\n", chunk.time, chunk.capture,
+               chunk.samples, chunk.rate, chunk.pre);
+      }
+    }
+
+    void onSessionChunk(const Notification &, const SessionChunk &chunk) {
+      sessionBytes += chunk.data.size();
+    }
+};
+
+static void printStats(const PlankReceiverStats &s, const SampleCounter &c) {
+  printf("%u notifications, %llu bytes: %u decoded, %u bad, %u unknown\n", s.notifications,
+         (unsigned long long) s.bytes, s.decoded, s.badPackets, s.unknown);
+  printf("capacitive %llu, strain %llu, piezo %llu packets; stream %u frames, %llu samples, %u frames lost,"
+         " %llu bad records; %llu hits; %llu capture samples, %u chunks lost; %llu session bytes, %u blocks lost\n",
+         (unsigned long long) c.capacitive, (unsigned long long) c.strain, (unsigned long long) c.piezo,
+         s.streamFrames, (unsigned long long) c.streamSamples, s.streamLost, (unsigned long long) c.streamErrors,
+         (unsigned long long) c.hits, (unsigned long long) c.captureSamples, s.captureChunksLost,
+         (unsigned long long) c.sessionBytes, s.sessionBlocksLost);
+}
+
+static bool readAll(const char *path, std::vector<uint8_t> &out) {
+  FILE *f = fopen(path, "rb");
+  if (f == NULL) {
+    return false;
+  }
+  uint8_t chunk[65536];
+  size_t n;
+  while ((n = fread(chunk, 1, sizeof(chunk), f)) > 0) {
+    out.insert(out.end(), chunk, chunk + n);
+  }
+  fclose(f);
+  return true;
+}
+
+int main(int argc, char **argv) {
+  const char *path = NULL;
+  bool print = false;
+  int repeat = 0;
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--print")) {
+      print = true;
+    } else if (!strcmp(argv[i], "--repeat") && i + 1 < argc) {
+      repeat = atoi(argv[++i]);
+    } else if (path == NULL) {
+      path = argv[i];
+    } else {
+      path = NULL;
+      break;
+    }
+  }
+  if (path == NULL) {
+    fprintf(stderr, "usage: %s <log | -> [--print] [--repeat N]\n", argv[0]);
+    return 2;
+  }
+
+  // one pass straight from the file, as a live receiver would
+  NotificationLogReader reader;
+  if (!reader.open(path)) {
+    fprintf(stderr, "%s is not a notification log\n", path);
+    return 1;
+  }
+  PlankDecoder decoder;
+  SampleCounter counter;
+  counter.print = print;
+  decoder.run(reader, counter);
+  printStats(decoder.stats(), counter);
+  if (reader.corrupt()) {
+    printf("the log ends on a truncated or corrupt record\n");
+  }
+  reader.close();
+
+  if (repeat > 0 && strcmp(path, "-") != 0) {
+    std::vector<uint8_t> log;
+    readAll(path, log);
+    MemoryNotificationSource source(log.data(), log.size());
+    SampleCounter quiet;
+    PlankDecoder timed;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int i = 0; i < repeat; i++) {
+      source.rewind();
+      timed.run(source, quiet);
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    const PlankReceiverStats &s = timed.stats();
+    uint64_t samples = quiet.capacitive + quiet.strain + quiet.piezo + quiet.streamSamples + quiet.hits;
+    printf("decoded %d times in %.3f s: %.2f M notifications/s, %.1f MB/s, %.2f M samples/s (checksum %lld)\n",
+           repeat, seconds, s.notifications / seconds / 1e6, s.bytes / seconds / 1e6, samples / seconds / 1e6,
+           (long long) quiet.checksum);
+  }
+  return decoder.stats().badPackets > 0 ? 1 : 0;
+}
@@ -0,0 +1,429 @@
+// Replay of a raw sensor capture through the firmware's processing stages (PlatformIO env:replay).
+// A capture (lib/SensorCapture/SensorCapture.h), written by the simulation, holds what the firmware
+// read: ADCTouch scans, HX711 conversions, piezo DMA frames and the UART bytes from the Mega. Each
+// source goes through the stage that read it, on a simulated clock set to the captured times:
+//   scans           TouchTracker (the Mega)
+//   HX711 words     HX711MULTI through HX711ReplayPinIO: setup's tare, then poll(), drain() and calibration
+//   DMA frames      PiezoSampler, then PiezoPeakHold, ImpactDetector and WaveformCapture
+//   UART bytes      LinkReceiver, its ACKs and time requests going nowhere
+// What the stages make of it is written as CAPTURE_OUT_* records and hashed, so that two builds can
+// be compared on the same session bit for bit.
+// Usage: replay <capture> [--realtime] [--out file] [--compare file]
+// --realtime paces the records at their captured times, otherwise they go as fast as the host runs
+// them; --out writes the outputs; --compare checks them against the outputs of an earlier replay and
+// stops at the first difference.
+#include <Arduino.h>
+#include <HX711-multi.h>
+#include <SensorPackets.h>
+#include <PlankLink.h>
+#include <PlankBytes.h>
+#include <TouchTracker.h>
+#include <SensorStream.h>
+#include <PiezoSampler.h>
+#include <ImpactDetector.h>
+#include <WaveformCapture.h>
+#include <SensorCapture.h>
+#include <CapturePinIO.h>
+#include <SimHal.h>
+#include <chrono>
+#include <thread>
+#include <stdio.h>
+
+#define CPU_MEGA 0
+#define CPU_ESP32 1
+#define CLK 18
+
+// ---------------------------------------------------------------- captured sources
+
+// the records of one source, in order: every source reads the capture with a reader of its own
+struct Source {
+  uint8_t source;
+  uint8_t cpu;
+  SensorCaptureReader reader;
+  CaptureRecord record;
+  bool ready = false;
+  int64_t us = 0;      // of the record, from the clock origin of the CPU, wraps undone
+  uint32_t last = 0;
+  uint32_t records = 0;
+
+  bool advance() {
+    ready = reader.next(record, source);
+    if (ready) {
+      us += (int32_t) (record.time - last);
+      last = record.time;
+      ++records;
+    }
+    return ready;
+  }
+};
+
+enum { STREAM_SCAN, STREAM_HX711, STREAM_PIEZO, STREAM_UART, STREAM_COUNT };
+
+static Source streams[STREAM_COUNT];
+static uint32_t origin[2];  // micros() of each CPU at the start of the replay
+
+// the CPU of the stream, its clock moved on to the stream's record
+static void clockTo(const Source &s) {
+  SimHal::selectCpu(s.cpu);
+  uint64_t ns = s.us > 0 ? (uint64_t) s.us * 1000ULL : 0;
+  if (ns > SimHal::nanos()) {
+    SimHal::advanceNanos(ns - SimHal::nanos());
+  }
+}
+
+// ---------------------------------------------------------------- outputs
+
+static SensorCaptureWriter outputFile;
+static SensorCaptureReader reference;
+static bool comparing = false;
+static uint64_t outputs = 0;
+static uint64_t mismatches = 0;
+static uint64_t digest = 1469598103934665603ULL;  // FNV-1a over every output record
+static uint32_t outputCounts[128];
+
+static void hash(const uint8_t *data, size_t length) {
+  for (size_t i = 0; i < length; i++) {
+    digest = (digest ^ data[i]) * 1099511628211ULL;
+  }
+}
+
+static void output(uint8_t source, const uint8_t *payload, uint16_t length) {
+  uint32_t time = micros();
+  uint8_t header[CAPTURE_RECORD_HEADER_SIZE] = {0};
+  put32(&header[0], time);
+  header[4] = source;
+  put16(&header[6], length);
+  hash(header, sizeof(header));
+  hash(payload, length);
+  outputFile.write(time, source, 0, payload, length);
+  ++outputs;
+  ++outputCounts[source & 0x7F];
+  if (comparing) {
+    CaptureRecord r;
+    if (!reference.next(r) || r.time != time || r.source != source || r.length != length || memcmp(r.payload, payload, length) != 0) {
+      if (mismatches++ == 0) {
+        printf("first difference at output %llu: '%c' of %u bytes at %u us\n", (unsigned long long) outputs, source, length, time);
+      }
+    }
+  }
+}
+
+// ---------------------------------------------------------------- Mega: touch tracking
+
+static TouchTracker tracker;
+static bool trackerReset = false;
+
+static void replayScan(const CaptureRecord &r) {
+  int raw[PLANK_CAPACITIVE_COUNT];
+  if (r.length != sizeof(raw) / sizeof(raw[0]) * 2) {
+    return;
+  }
+  for (int i = 0; i < PLANK_CAPACITIVE_COUNT; i++) {
+    raw[i] = get16(&r.payload[2 * i]);
+  }
+  if ((r.flags & CAPTURE_FLAG_START) || !trackerReset) {
+    tracker.reset(raw);
+    trackerReset = true;
+    return;
+  }
+  TouchEvent events[PLANK_CAPACITIVE_COUNT];
+  uint8_t count = tracker.update(raw, events);
+  if (count > 0) {
+    uint8_t payload[PLANK_CAPACITIVE_COUNT * 4];
+    for (uint8_t i = 0; i < count; i++) {
+      payload[4 * i] = events[i].pad;
+      payload[4 * i + 1] = events[i].kind;
+      put16(&payload[4 * i + 2], events[i].strength);
+    }
+    output(CAPTURE_OUT_TOUCH, payload, count * 4);
+  }
+}
+
+// ---------------------------------------------------------------- ESP32: strain gauges
+
+static byte DOUTS[HX711_MAX_CHANNELS] = {25, 26, 0, 14, 27, 4, 2, 13};
+static HX711MULTI *scales = NULL;
+static uint8_t chipCount = 0;
+
+// the next conversion of the capture, on its captured time
+static bool nextConversion(long *words) {
+  Source &s = streams[STREAM_HX711];
+  if (!s.ready) {
+    return false;
+  }
+  clockTo(s);
+  for (uint8_t j = 0; j < chipCount; j++) {
+    words[j] = (long) (int32_t) get32(&s.record.payload[4 * j]);
+  }
+  s.advance();
+  return true;
+}
+
+static HX711ReplayPinIO replayPins(nextConversion);
+
+// the setup() of the ESP32 firmware, the tare reading the first conversions of the capture
+static void setupScales() {
+  chipCount = streams[STREAM_HX711].record.length / 4;
+  chipCount = chipCount > HX711_MAX_CHANNELS ? HX711_MAX_CHANNELS : chipCount;
+  scales = new HX711MULTI(chipCount, DOUTS, CLK, 128, &replayPins);
+  for (int i = 0; i < chipCount; i++) {
+    scales->set_calibration(i, HX711Calibration::fromFloat(STRAIN_DEFAULT_UNITS_PER_COUNT));
+  }
+  bool tared = false;
+  unsigned long start = millis();
+  while (!tared && millis() < start + 4000 && streams[STREAM_HX711].ready) {
+    tared = scales->tare(20, 10000);
+  }
+}
+
+static void replayConversion() {
+  if (scales == NULL) {
+    setupScales();
+    return;
+  }
+  if (!scales->poll()) {
+    streams[STREAM_HX711].advance();
+    return;
+  }
+  HX711Sample sample;
+  while (scales->drain(&sample, 1) == 1) {
+    scales->apply_calibration(sample.values);
+    uint8_t payload[4 + HX711_MAX_CHANNELS * 4];
+    put32(&payload[0], sample.timestamp);
+    for (uint8_t j = 0; j < chipCount; j++) {
+      put32(&payload[4 + 4 * j], (uint32_t) sample.values[j]);
+    }
+    output(CAPTURE_OUT_STRAIN, payload, 4 + chipCount * 4);
+  }
+}
+
+// ---------------------------------------------------------------- ESP32: piezos
+
+static PiezoSampler piezoSampler;
+static PiezoPeakHold piezoPeaks;
+static ImpactDetector impacts;
+static WaveformCapture capture;
+static uint16_t capturedImpact = 0;
+
+static void replayDmaFrame(const CaptureRecord &r) {
+  if (r.flags & CAPTURE_FLAG_START) {
+    int pins[PIEZO_MAX_CHANNELS];
+    uint8_t count = r.length >= 5 ? r.payload[4] : 0;
+    if (count > PIEZO_MAX_CHANNELS || r.length < 5 + count) {
+      return;
+    }
+    for (uint8_t i = 0; i < count; i++) {
+      pins[i] = r.payload[5 + i];
+    }
+    piezoSampler.end();
+    piezoSampler.begin(pins, count, get32(&r.payload[0]));
+    return;
+  }
+  uint16_t words[CAPTURE_MAX_PAYLOAD / 2];
+  size_t count = r.length / 2;
+  for (size_t k = 0; k < count; k++) {
+    words[k] = get16(&r.payload[2 * k]);
+  }
+  piezoSampler.onConversions(words, count);
+
+  static PiezoBlockProcessor *const processors[] = {&piezoPeaks, &impacts, &capture};
+  piezoSampler.drain(processors, 3);
+  int16_t peaks[PIEZO_MAX_CHANNELS];
+  piezoPeaks.take(peaks);
+  PiezoHit hit;
+  while (impacts.readHit(hit)) {
+    uint8_t packet[HIT_PACKET_SIZE];
+    output(CAPTURE_OUT_HIT, packet, packPiezoHit(packet, hit));
+    if (hit.impact != capturedImpact) {
+      capture.trigger(hit.time - hit.delay);
+      capturedImpact = hit.impact;
+    }
+  }
+  uint8_t chunk[STREAM_FRAME_MAX];
+  size_t size;
+  while ((size = capture.nextChunk(chunk, sizeof(chunk))) > 0) {
+    output(CAPTURE_OUT_CAPTURE, chunk, size);
+  }
+}
+
+// ---------------------------------------------------------------- ESP32: link from the Mega
+
+// what the link sends back, one output record per pass
+class LinkOutput : public Print {
+  public:
+    uint8_t bytes[256];
+    uint16_t count = 0;
+    using Print::write;
+    size_t write(uint8_t c) {
+      if (count == sizeof(bytes)) {
+        flush();
+      }
+      bytes[count++] = c;
+      return 1;
+    }
+    void flush() {
+      if (count > 0) {
+        output(CAPTURE_OUT_LINK_TX, bytes, count);
+        count = 0;
+      }
+    }
+};
+
+static LinkOutput linkOutput;
+static LinkReceiver capacitiveLink(linkOutput);
+
+static void replayUart(const CaptureRecord &r) {
+  for (uint16_t i = 0; i < r.length; i++) {
+    capacitiveLink.feed(r.payload[i]);
+  }
+  capacitiveLink.poll();
+  linkOutput.flush();
+  LinkFrame frame;
+  while (capacitiveLink.read(frame)) {
+    uint8_t payload[6 + PLANK_FRAME_MAX_PAYLOAD];
+    payload[0] = frame.type;
+    payload[1] = frame.sequence;
+    put32(&payload[2], frame.time);
+    memcpy(&payload[6], frame.payload, frame.length);
+    output(CAPTURE_OUT_FRAME, payload, 6 + frame.length);
+  }
+}
+
+// ---------------------------------------------------------------- driver
+
+int main(int argc, char **argv) {
+  const char *path = NULL;
+  const char *outPath = NULL;
+  const char *comparePath = NULL;
+  bool realtime = false;
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--realtime")) {
+      realtime = true;
+    } else if (!strcmp(argv[i], "--out") && i + 1 < argc) {
+      outPath = argv[++i];
+    } else if (!strcmp(argv[i], "--compare") && i + 1 < argc) {
+      comparePath = argv[++i];
+    } else if (path == NULL) {
+      path = argv[i];
+    } else {
+      path = NULL;
+      break;
+    }
+  }
+  if (path == NULL) {
+    fprintf(stderr, "usage: %s <capture> [--realtime] [--out file] [--compare file]\n", argv[0]);
+    return 2;
+  }
+  if (outPath != NULL && !outputFile.open(outPath)) {
+    fprintf(stderr, "cannot write %s\n", outPath);
+    return 1;
+  }
+  if (comparePath != NULL && !(comparing = reference.open(comparePath))) {
+    fprintf(stderr, "%s is not a sensor capture\n", comparePath);
+    return 1;
+  }
+
+  const uint8_t sources[STREAM_COUNT] = {CAPTURE_TOUCH_SCAN, CAPTURE_HX711, CAPTURE_PIEZO_DMA, CAPTURE_UART};
+  for (int i = 0; i < STREAM_COUNT; i++) {
+    Source &s = streams[i];
+    s.source = sources[i];
+    s.cpu = i == STREAM_SCAN ? CPU_MEGA : CPU_ESP32;
+    if (!s.reader.open(path)) {
+      fprintf(stderr, "%s is not a sensor capture\n", path);
+      return 1;
+    }
+    s.advance();
+  }
+  // each CPU's clock starts at the earliest of its sources
+  bool started[2] = {false, false};
+  for (int i = 0; i < STREAM_COUNT; i++) {
+    Source &s = streams[i];
+    if (s.ready && (!started[s.cpu] || (int32_t) (s.record.time - origin[s.cpu]) < 0)) {
+      origin[s.cpu] = s.record.time;
+      started[s.cpu] = true;
+    }
+  }
+  SimHal::reset();
+  Serial.setMuted(true);
+  for (int i = 0; i < STREAM_COUNT; i++) {
+    Source &s = streams[i];
+    s.us = (int32_t) (s.record.time - origin[s.cpu]);
+    s.last = s.record.time;
+  }
+  for (uint8_t cpu = CPU_MEGA; cpu <= CPU_ESP32; cpu++) {
+    SimHal::selectCpu(cpu);
+    SimHal::setClock(origin[cpu], 0);
+    SimHal::setCallCostNs(0);
+    SimHal::setAnalogCostNs(0);
+  }
+
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  int64_t lastUs = 0;
+  for (;;) {
+    // the earliest record of any source next
+    int next = -1;
+    for (int i = 0; i < STREAM_COUNT; i++) {
+      if (streams[i].ready && (next < 0 || streams[i].us < streams[next].us)) {
+        next = i;
+      }
+    }
+    if (next < 0) {
+      break;
+    }
+    Source &s = streams[next];
+    lastUs = s.us > lastUs ? s.us : lastUs;
+    if (realtime) {
+      std::this_thread::sleep_until(start + std::chrono::microseconds(s.us));
+    }
+    clockTo(s);
+    switch (s.source) {
+      case CAPTURE_TOUCH_SCAN:
+        replayScan(s.record);
+        s.advance();
+        break;
+      case CAPTURE_HX711:
+        replayConversion();  // takes its records itself, through the pins
+        break;
+      case CAPTURE_PIEZO_DMA:
+        replayDmaFrame(s.record);
+        s.advance();
+        break;
+      case CAPTURE_UART:
+        replayUart(s.record);
+        s.advance();
+        break;
+    }
+  }
+  double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  printf("replayed %.1f s of capture in %.3f s (x%.0f)\n", lastUs / 1e6, wall, lastUs / 1e6 / wall);
+  printf("inputs: %u touch scans, %u HX711 conversions, %u piezo DMA frames, %u UART reads\n",
+         streams[STREAM_SCAN].records, streams[STREAM_HX711].records, streams[STREAM_PIEZO].records,
+         streams[STREAM_UART].records);
+  printf("outputs: %u touch event sets, %u strain samples, %u hits, %u capture chunks, %u link frames, %u link writes\n",
+         outputCounts[CAPTURE_OUT_TOUCH], outputCounts[CAPTURE_OUT_STRAIN], outputCounts[CAPTURE_OUT_HIT],
+         outputCounts[CAPTURE_OUT_CAPTURE], outputCounts[CAPTURE_OUT_FRAME], outputCounts[CAPTURE_OUT_LINK_TX]);
+  printf("output digest %016llx over %llu records\n", (unsigned long long) digest, (unsigned long long) outputs);
+  for (int i = 0; i < STREAM_COUNT; i++) {
+    if (streams[i].reader.corrupt()) {
+      printf("the capture ends on a truncated or corrupt record\n");
+      break;
+    }
+  }
+  if (outputFile.isOpen()) {
+    printf("%u outputs written to %s\n", outputFile.written(), outPath);
+    outputFile.close();
+  }
+  if (comparing) {
+    CaptureRecord r;
+    uint64_t extra = 0;
+    while (reference.next(r)) {
+      ++extra;
+    }
+    printf("compared with %s: %s (%llu different, %llu more in the reference)\n", comparePath,
+           mismatches == 0 && extra == 0 ? "identical" : "DIFFERENT", (unsigned long long) mismatches,
+           (unsigned long long) extra);
+    return mismatches == 0 && extra == 0 ? 0 : 1;
+  }
+  return 0;
+}
@@ -1,7 +1,10 @@
 import asyncio
 import struct
+import sys
 from bleak import BleakScanner, BleakClient
 import logging
+import time
+from PlankLog import crc16
 
 # Configuration du logging pour un affichage clair
 logging.basicConfig(
@@ -10,16 +13,54 @@ logging.basicConfig(
 )
 
 # UUIDs du service et des caractéristiques
+# Chaque paquet porte l'heure de son échantillon (u32, micros() de l'ESP32, little endian) avant le
+# marqueur de fin ; les scans capacitifs y sont ramenés depuis l'horloge du Mega (lib/PlankCore/ClockSync.h)
 SERVICE_UUID = "4fafc201-1fb5-459e-8fcc-c5c9c331914b"
 CAPACITIVE_UUID = "beb5483e-36e1-4688-b7f5-ea07361b26a8"
 STRAIN_GAUGE_UUID = "cc54f4ce-1037-4b73-9e5a-cdcd53e85145"
 PIEZO_UUID = "beb5483e-36e1-4688-b7f5-ea07361b26a9"
+# Flux groupé (lib/PlankCore/SensorStream.h), activé avec --stream
+STREAM_UUID = "beb5483e-36e1-4688-b7f5-ea07361b26aa"
+STREAM_CONFIG_UUID = "beb5483e-36e1-4688-b7f5-ea07361b26ab"
+STREAM_RECORDS = {1: ('capacitifs', '<16h'), 2: ('jauges', '<4i'), 3: ('piézo', '<4H')}
+STREAM_TICK_US = 10
+# Coups détectés sur les piézos (lib/PiezoAdc/ImpactDetector.h)
+HIT_UUID = "beb5483e-36e1-4688-b7f5-ea07361b26ac"
+# Formes d'onde autour des coups (lib/PiezoAdc/WaveformCapture.h), enregistrées avec --capture
+CAPTURE_UUID = "beb5483e-36e1-4688-b7f5-ea07361b26ad"
+# Sessions enregistrées en flash hors connexion (lib/SessionLog/SessionLog.h), téléchargées avec --download
+RECORDING_UUID = "beb5483e-36e1-4688-b7f5-ea07361b26ae"
+SESSION_BLOCK_HEADER = 16
+# Sondes de cycles de la tâche publish (lib/SpscRing/CycleProbe.h), lues avec --probes
+DIAGNOSTICS_UUID = "beb5483e-36e1-4688-b7f5-ea07361b26af"
+PROBE_BUCKET_SHIFT = 8
+# Journal des notifications reçues (lib/PlankReceiver/NotificationLog.h), écrit avec --log <fichier>
+# et décodé par le récepteur C++ (pio run -e receiver)
+LOG_CHANNELS = {CAPACITIVE_UUID: b'C', STRAIN_GAUGE_UUID: b'S', PIEZO_UUID: b'P', STREAM_UUID: b'F',
+                HIT_UUID: b'H', CAPTURE_UUID: b'W', RECORDING_UUID: b'R'}
 
 class BLETestReceiver:
-    def __init__(self):
+    def __init__(self, stream=False, capture=False, download=False, probes=False, log=None):
         self.NUM_CAPACITIVE = 16
         self.NUM_STRAIN = 4
         self.NUM_PIEZO = 4
+        self.stream = stream
+        self.stream_next = None
+        self.capture = capture
+        self.capture_info = None
+        self.capture_data = bytearray()
+        self.capture_next = 0
+        self.sessions = []
+        self.session_blocks = {}
+        self.block = bytearray()
+        self.block_next = None
+        self.download_sessions = download
+        self.read_probes = probes
+        self.log = None
+        if log:
+            self.log = open(log, 'wb')
+            self.log.write(b'PKNL\x01\x00\x00\x00')
+        self.downloads = None
 
     def parse_capacitive(self, sender, data):
         """Affiche les données des capteurs capacitifs"""
@@ -33,8 +74,9 @@ class BLETestReceiver:
             for i in range(self.NUM_CAPACITIVE):
                 value = struct.unpack_from('<H', data, offset=1+i*2)[0]
                 values.append(value)
+            t = struct.unpack_from('<I', data, 1 + self.NUM_CAPACITIVE * 2)[0]
             
-            logging.info(f"Données capacitives: {values}")
+            logging.info(f"[{t} us] Données capacitives: {values}")
             logging.debug(f"Données brutes (hex): {data.hex()}")
         except Exception as e:
             logging.error(f"Erreur parsing capacitif: {str(e)}")
@@ -49,7 +91,8 @@ class BLETestReceiver:
                 return
 
             values = [data[i+1] for i in range(self.NUM_STRAIN)]
-            logging.info(f"Données des jauges: {values}")
+            t = struct.unpack_from('<I', data, 1 + self.NUM_STRAIN)[0]
+            logging.info(f"[{t} us] Données des jauges: {values}")
             logging.debug(f"Données brutes (hex): {data.hex()}")
         except Exception as e:
             logging.error(f"Erreur parsing jauge: {str(e)}")
@@ -68,13 +111,179 @@ class BLETestReceiver:
             for i in range(self.NUM_PIEZO):
                 value = struct.unpack_from('>H', data, offset=2+i*2)[0]
                 values.append(value)
+            t = struct.unpack_from('<I', data, 2 + self.NUM_PIEZO * 2)[0]
             
-            logging.info(f"Données piézo: {values}")
+            logging.info(f"[{t} us] Données piézo: {values}")
             logging.debug(f"Données brutes (hex): {data.hex()}")
         except Exception as e:
             logging.error(f"Erreur parsing piézo: {str(e)}")
             logging.error(f"Données brutes (hex): {data.hex()}")
 
+    def parse_stream(self, sender, data):
+        """Affiche les échantillons d'une trame du flux groupé"""
+        try:
+            seq, mask, count, t0 = struct.unpack_from('<HBBI', data, 0)
+            if self.stream_next is not None and seq != self.stream_next:
+                logging.warning(f"Trames du flux perdues: {(seq - self.stream_next) & 0xFFFF}")
+            self.stream_next = (seq + 1) & 0xFFFF
+
+            offset = 8
+            for _ in range(count):
+                # décalage signé : un scan capacitif peut précéder le début de la trame
+                kind, length, ticks = struct.unpack_from('<BBh', data, offset)
+                offset += 4
+                t = (t0 + ticks * STREAM_TICK_US) & 0xFFFFFFFF
+                if kind in STREAM_RECORDS:
+                    name, fmt = STREAM_RECORDS[kind]
+                    values = list(struct.unpack_from(fmt, data, offset))
+                    logging.info(f"[{t} us] Données {name}: {values}")
+                offset += length
+        except Exception as e:
+            logging.error(f"Erreur parsing flux: {str(e)}")
+            logging.error(f"Données brutes (hex): {data.hex()}")
+
+    def parse_hit(self, sender, data):
+        """Affiche un coup détecté sur un piézo"""
+        try:
+            impact, channel, t, delay, peak, rise = struct.unpack('<HBIhHH', data)
+            logging.info(f"[{t} us] Coup {impact} sur le piézo {channel}: +{delay} us, crête {peak} mV, montée {rise} us")
+        except Exception as e:
+            logging.error(f"Erreur parsing coup: {str(e)}")
+            logging.error(f"Données brutes (hex): {data.hex()}")
+
+    def parse_capture(self, sender, data):
+        """Réassemble une capture et l'enregistre au format de native_bench --waveform"""
+        try:
+            capture, index = struct.unpack_from('<BH', data, 0)
+            if index == 0:
+                self.capture_info = struct.unpack_from('<IIBBHH', data, 3)
+                self.capture_data = bytearray()
+            elif self.capture_info is None or index != self.capture_next:
+                logging.warning(f"Capture {capture}: morceau {self.capture_next} perdu")
+                self.capture_info = None
+                return
+            else:
+                self.capture_data += data[3:]
+            self.capture_next = index + 1
+
+            t, rate, channels, active, pre, samples = self.capture_info
+            rows = [c for c in range(channels) if active & (1 << c)]
+            if index == 0 or len(self.capture_data) < len(rows) * samples * 2:
+                return
+            values = struct.unpack(f'<{len(rows) * samples}h', self.capture_data)
+            peaks = {c: max(values[r * samples:(r + 1) * samples]) for r, c in enumerate(rows)}
+            logging.info(f"[{t} us] Capture {capture}: {samples} échantillons à {rate} Hz dont {pre} avant le coup, crêtes {peaks} mV")
+            if self.capture:
+                frames = bytearray()
+                for i in range(samples):
+                    frame = [0] * self.NUM_PIEZO
+                    for r, c in enumerate(rows):
+                        frame[c] = values[r * samples + i]
+                    frames += struct.pack(f'<{self.NUM_PIEZO}h', *frame)
+                with open(f"capture_{t}.raw", "wb") as f:
+                    f.write(frames)
+            self.capture_info = None
+        except Exception as e:
+            logging.error(f"Erreur parsing capture: {str(e)}")
+            logging.error(f"Données brutes (hex): {data.hex()}")
+
+    def parse_recording(self, sender, data):
+        """Liste des sessions, puis blocs d'une session réassemblés et vérifiés"""
+        try:
+            kind = chr(data[0])
+            if kind == 'L':
+                total, first = struct.unpack_from('<BB', data, 1)
+                for offset in range(3, len(data) - 13, 14):
+                    self.sessions.append(struct.unpack_from('<HIII', data, offset))
+                self.downloads.put_nowait(('L', total))
+            elif kind == 'D':
+                session, sequence, offset = struct.unpack_from('<HIH', data, 1)
+                if offset == 0:
+                    if self.block_next is not None and sequence != self.block_next:
+                        logging.warning(f"Session {session}: blocs {self.block_next} à {sequence - 1} écrasés")
+                    self.block = bytearray()
+                    self.block_next = sequence + 1
+                elif offset != len(self.block):
+                    logging.warning(f"Session {session}: bloc {sequence} incomplet")
+                    return
+                self.block += data[9:]
+                if len(self.block) < SESSION_BLOCK_HEADER:
+                    return
+                length, crc = struct.unpack_from('<HH', self.block, 12)
+                if len(self.block) < SESSION_BLOCK_HEADER + length:
+                    return
+                if crc16(self.block[SESSION_BLOCK_HEADER:], crc16(self.block[:14])) != crc:
+                    logging.warning(f"Session {session}: CRC du bloc {sequence} invalide")
+                    return
+                self.session_blocks.setdefault(session, bytearray()).extend(self.block)
+            elif kind == 'F':
+                session, sent = struct.unpack_from('<HI', data, 1)
+                self.downloads.put_nowait(('F', session, sent))
+        except Exception as e:
+            logging.error(f"Erreur parsing session: {str(e)}")
+            logging.error(f"Données brutes (hex): {data.hex()}")
+
+    async def download(self, client):
+        """Télécharge toutes les sessions enregistrées dans session_<id>.bin : les blocs bout à bout"""
+        self.downloads = asyncio.Queue()
+        await client.start_notify(RECORDING_UUID, self.logged(RECORDING_UUID, self.parse_recording))
+        # les morceaux prennent la taille des trames du flux : aucune source, toute la MTU
+        await client.write_gatt_char(STREAM_CONFIG_UUID, struct.pack('<BH', 0, client.mtu_size - 3), response=True)
+        while True:
+            await client.write_gatt_char(RECORDING_UUID, struct.pack('<cB', b'L', len(self.sessions)), response=True)
+            _, total = await self.downloads.get()
+            if len(self.sessions) >= total:
+                break
+        logging.info(f"{len(self.sessions)} sessions enregistrées")
+        for session, first, blocks, t in self.sessions:
+            start = asyncio.get_running_loop().time()
+            self.block_next = first
+            await client.write_gatt_char(RECORDING_UUID, struct.pack('<cH', b'R', session), response=True)
+            _, _, sent = await self.downloads.get()
+            data = self.session_blocks.get(session, bytearray())
+            with open(f"session_{session}.bin", "wb") as f:
+                f.write(data)
+            elapsed = asyncio.get_running_loop().time() - start
+            logging.info(f"[{t} us] Session {session}: {sent} blocs sur {blocks}, {len(data)} octets en {elapsed:.1f} s"
+                         f" ({len(data) / 1024 / max(elapsed, 1e-3):.1f} Ko/s)")
+
+    def parse_probe(self, sender, data):
+        """Une sonde : passages, cycles min/moyen/max et histogramme en puissances de deux"""
+        try:
+            index, passes, least, mean, most, buckets = struct.unpack_from('<BIIIIB', data, 0)
+            counts = struct.unpack_from(f'<{buckets}H', data, 18)
+            length = data[18 + 2 * buckets]
+            name = data[19 + 2 * buckets:19 + 2 * buckets + length].decode()
+            logging.info(f"{name}: {passes} passages, {least}/{mean}/{most} cycles min/moyen/max")
+            for i, n in enumerate(counts):
+                if n:
+                    bound = 1 << (PROBE_BUCKET_SHIFT + (1 if i == 0 else i))
+                    logging.info(f"  {'< ' if i == 0 else '>='} {bound}: {n}")
+        except Exception as e:
+            logging.error(f"Erreur parsing sonde: {str(e)}")
+            logging.error(f"Données brutes (hex): {data.hex()}")
+
+    async def probes(self, client):
+        """Affiche les sondes de cycles, puis les remet à zéro"""
+        await client.start_notify(DIAGNOSTICS_UUID, self.parse_probe)
+        # une sonde par notification, jusqu'à 72 octets : des trames à la taille de la MTU
+        await client.write_gatt_char(STREAM_CONFIG_UUID, struct.pack('<BH', 0, client.mtu_size - 3), response=True)
+        await client.write_gatt_char(DIAGNOSTICS_UUID, b'D', response=True)
+        await asyncio.sleep(2)
+        await client.write_gatt_char(DIAGNOSTICS_UUID, b'Z', response=True)
+
+    def logged(self, uuid, parse):
+        """Le décodeur de la caractéristique, précédé de l'écriture de chaque notification au journal"""
+        if self.log is None:
+            return parse
+        channel = LOG_CHANNELS[uuid]
+
+        def record(sender, data):
+            t = (time.monotonic_ns() // 1000) & 0xFFFFFFFF
+            self.log.write(struct.pack('<IcBH', t, channel, 0, len(data)) + bytes(data))
+            parse(sender, data)
+        return record
+
     async def run(self):
         """Boucle principale de réception des données"""
         try:
@@ -94,10 +303,25 @@ class BLETestReceiver:
             async with BleakClient(device) as client:
                 logging.info(f"Connecté à: {device.name}")
 
+                if self.download_sessions:
+                    await self.download(client)
+                    return
+                if self.read_probes:
+                    await self.probes(client)
+                    return
+
                 # Activation des notifications pour chaque caractéristique
-                await client.start_notify(CAPACITIVE_UUID, self.parse_capacitive)
-                await client.start_notify(STRAIN_GAUGE_UUID, self.parse_strain_gauge)
-                await client.start_notify(PIEZO_UUID, self.parse_piezo)
+                await client.start_notify(CAPACITIVE_UUID, self.logged(CAPACITIVE_UUID, self.parse_capacitive))
+                await client.start_notify(STRAIN_GAUGE_UUID, self.logged(STRAIN_GAUGE_UUID, self.parse_strain_gauge))
+                await client.start_notify(PIEZO_UUID, self.logged(PIEZO_UUID, self.parse_piezo))
+                await client.start_notify(HIT_UUID, self.logged(HIT_UUID, self.parse_hit))
+                await client.start_notify(CAPTURE_UUID, self.logged(CAPTURE_UUID, self.parse_capture))
+
+                if self.stream:
+                    # Toutes les sources, trames à la taille de la MTU négociée
+                    await client.start_notify(STREAM_UUID, self.logged(STREAM_UUID, self.parse_stream))
+                    await client.write_gatt_char(STREAM_CONFIG_UUID, struct.pack('<BH', 0xFF, client.mtu_size - 3), response=True)
+                    logging.info(f"Flux groupé actif, MTU {client.mtu_size}")
 
                 logging.info("En attente de données... (Ctrl+C pour arrêter)")
                 
@@ -111,5 +335,7 @@ class BLETestReceiver:
             logging.error(f"Erreur de connexion: {str(e)}")
 
 if __name__ == "__main__":
-    receiver = BLETestReceiver()
+    log = sys.argv[sys.argv.index('--log') + 1] if '--log' in sys.argv[:-1] else None
+    receiver = BLETestReceiver(stream='--stream' in sys.argv, capture='--capture' in sys.argv,
+                               download='--download' in sys.argv, probes='--probes' in sys.argv, log=log)
     asyncio.run(receiver.run())
\ No newline at end of file
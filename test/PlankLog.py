@@ -0,0 +1,157 @@
+"""Remet en texte le journal PlankLog (lib/PlankCore/PlankLog.h) du port série USB de l'ESP32 ou du Mega.
+
+Usage : python PlankLog.py <port série | fichier | -> [baud]
+
+Les trames PLANK_FRAME_LOG sont décodées avec les formats de lib/PlankCore/PlankLogFormats.h, à
+prendre dans la révision qui a servi à compiler le firmware ; le texte autour passe tel quel.
+Chaque ligne du journal commence par l'heure de l'enregistrement, en secondes depuis le démarrage.
+"""
+import os
+import re
+import struct
+import sys
+
+FORMATS_PATH = os.path.join(os.path.dirname(__file__), '..', 'lib', 'PlankCore', 'PlankLogFormats.h')
+SYNC = b'\xA5\x5A'
+FRAME_LOG = 0x03
+MAX_PAYLOAD = 52
+CONVERSION = re.compile(r'%%|%l?([ducxf])')
+
+
+def load_formats(path=FORMATS_PATH):
+    """Les formats dans l'ordre de PLANK_LOG_FORMATS : l'indice est l'identifiant"""
+    with open(path, encoding='utf-8') as f:
+        return [bytes(fmt, 'utf-8').decode('unicode_escape')
+                for _, fmt in re.findall(r'X\((\w+),\s*"((?:[^"\\]|\\.)*)"\)', f.read())]
+
+
+def crc16(data, crc=0xFFFF):
+    """CRC-16/CCITT des trames (PlankFrame.h)"""
+    for b in data:
+        crc ^= b << 8
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x1021) if crc & 0x8000 else crc << 1
+        crc &= 0xFFFF
+    return crc
+
+
+def varints(data):
+    values, value, shift = [], 0, 0
+    for b in data:
+        value |= (b & 0x7F) << shift
+        shift += 7
+        if not b & 0x80:
+            values.append(value)
+            value, shift = 0, 0
+    return values
+
+
+def expand(fmt, args):
+    """Les arguments (varints) selon les conversions du format"""
+    args = iter(args)
+
+    def convert(match):
+        kind = match.group(1)
+        if kind is None:
+            return '%'
+        raw = next(args, 0)
+        if kind == 'f':
+            return '%g' % struct.unpack('<f', struct.pack('<I', raw & 0xFFFFFFFF))[0]
+        signed = (raw >> 1) ^ -(raw & 1)
+        if kind == 'd':
+            return str(signed)
+        if kind == 'c':
+            return chr(signed & 0xFF)
+        unsigned = signed & 0xFFFFFFFF
+        return '%x' % unsigned if kind == 'x' else str(unsigned)
+
+    return CONVERSION.sub(convert, fmt)
+
+
+class LogDecoder:
+    def __init__(self, formats, out=sys.stdout):
+        self.formats = formats
+        self.out = out
+        self.buffer = bytearray()
+        self.time = 0
+        self.next = None
+        self.missing = 0
+
+    def feed(self, data):
+        self.buffer += data
+        while True:
+            start = self.buffer.find(SYNC)
+            if start < 0:
+                # un 0xA5 final peut être le début d'une trame
+                keep = 1 if self.buffer.endswith(SYNC[:1]) else 0
+                self.text(self.buffer[:len(self.buffer) - keep])
+                del self.buffer[:len(self.buffer) - keep]
+                return
+            self.text(self.buffer[:start])
+            del self.buffer[:start]
+            if len(self.buffer) < 3:
+                return
+            length = self.buffer[2]
+            size = 5 + length + 2
+            if length > MAX_PAYLOAD:
+                self.text(self.buffer[:1])
+                del self.buffer[:1]
+                continue
+            if len(self.buffer) < size:
+                return
+            frame = bytes(self.buffer[:size])
+            if crc16(frame[2:size - 2]) != struct.unpack_from('<H', frame, size - 2)[0] or frame[4] != FRAME_LOG:
+                # pas une trame du journal : du texte qui contenait la synchro
+                self.text(self.buffer[:1])
+                del self.buffer[:1]
+                continue
+            del self.buffer[:size]
+            self.record(frame[3], frame[5:size - 2])
+
+    def text(self, data):
+        if data:
+            self.out.write(data.decode('utf-8', errors='replace'))
+
+    def record(self, sequence, payload):
+        if self.next is not None and sequence != self.next:
+            lost = (sequence - self.next) & 0xFF
+            self.missing += lost
+            self.out.write(f'[{lost} enregistrements perdus]\n')
+        self.next = (sequence + 1) & 0xFF
+        values = varints(payload[1:])
+        if not values:
+            return
+        self.time += values[0]
+        fmt = self.formats[payload[0]] if payload[0] < len(self.formats) else f'format {payload[0]} inconnu %d %d %d %d %d %d %d %d'
+        self.out.write(f'[{self.time / 1e6:12.6f}] {expand(fmt, values[1:])}\n')
+        self.out.flush()
+
+
+def main():
+    if len(sys.argv) < 2:
+        print(__doc__)
+        return 2
+    decoder = LogDecoder(load_formats())
+    source = sys.argv[1]
+    port = source != '-' and not os.path.isfile(source)
+    if port:
+        import serial
+        stream = serial.Serial(source, int(sys.argv[2]) if len(sys.argv) > 2 else 115200, timeout=0.1)
+    else:
+        stream = sys.stdin.buffer if source == '-' else open(source, 'rb')
+    try:
+        while True:
+            data = stream.read(256) if port else stream.read1(256)
+            if data:
+                decoder.feed(data)
+            elif not port:
+                break
+    except KeyboardInterrupt:
+        pass
+    if decoder.missing:
+        print(f'{decoder.missing} enregistrements perdus au total', file=sys.stderr)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,228 @@
+// FrameDecoder against damaged UART streams: bit flips, truncated frames, bytes split across feeds,
+// garbage between frames. Every intact frame has to come out, and every damaged one be counted once.
+// usage : pio test -e native -f test_frame_decoder
+#include <Arduino.h>
+#include <unity.h>
+
+#include <PlankFrame.h>
+#include <vector>
+
+#define FRAMES 40
+
+typedef std::vector<uint8_t> Bytes;
+
+static FrameDecoder *decoder;
+static std::vector<Bytes> decoded;	// sequence, type, payload of every frame the decoder returned
+
+void setUp(void) {
+	decoder = new FrameDecoder();
+	decoded.clear();
+}
+
+void tearDown(void) {
+	delete decoder;
+}
+
+// frame n: every length from 0 to PLANK_FRAME_MAX_PAYLOAD, bytes below 0x80 so that no payload holds
+// a sync byte
+static Bytes frame(int n) {
+	uint8_t payload[PLANK_FRAME_MAX_PAYLOAD];
+	uint8_t length = (n * 11) % (PLANK_FRAME_MAX_PAYLOAD + 1);
+	for (int i = 0; i < length; ++i) {
+		payload[i] = (n * 7 + i * 3) & 0x7F;
+	}
+	uint8_t out[PLANK_FRAME_MAX_SIZE];
+	size_t size = encodeFrame(out, PLANK_FRAME_CAPACITIVE, n, payload, length);
+	return Bytes(out, out + size);
+}
+
+// what the decoder returns for frame n
+static Bytes contents(int n) {
+	Bytes f = frame(n);
+	return Bytes(f.begin() + 3, f.end() - PLANK_FRAME_CRC_SIZE);
+}
+
+static void feed(const uint8_t *data, size_t length) {
+	for (size_t i = 0; i < length; ++i) {
+		if (decoder->feed(data[i])) {
+			Bytes d;
+			d.push_back(decoder->sequence());
+			d.push_back(decoder->type());
+			d.insert(d.end(), decoder->payload(), decoder->payload() + decoder->length());
+			decoded.push_back(d);
+		}
+	}
+}
+
+static void feed(const Bytes &bytes) {
+	feed(bytes.data(), bytes.size());
+}
+
+// idle line after the stream: the bytes the decoder queued for rescanning come out
+static void flush() {
+	Bytes idle(PLANK_FRAME_MAX_SIZE * 2, 0);
+	feed(idle);
+}
+
+// the frames whose numbers are in 'intact', in order, and nothing else
+static void assertDecoded(const std::vector<int> &intact) {
+	TEST_ASSERT_EQUAL(intact.size(), decoded.size());
+	for (size_t i = 0; i < intact.size() && i < decoded.size(); ++i) {
+		Bytes expected = contents(intact[i]);
+		TEST_ASSERT_EQUAL(expected.size(), decoded[i].size());
+		TEST_ASSERT_EQUAL_MEMORY(expected.data(), decoded[i].data(), expected.size());
+	}
+	TEST_ASSERT_EQUAL(intact.size(), decoder->frames());
+}
+
+void test_clean_stream(void) {
+	std::vector<int> all;
+	for (int n = 0; n < FRAMES; ++n) {
+		feed(frame(n));
+		all.push_back(n);
+	}
+	flush();
+	assertDecoded(all);
+	TEST_ASSERT_EQUAL(0, decoder->crcErrors());
+	TEST_ASSERT_EQUAL(0, decoder->lengthErrors());
+}
+
+// one bit flipped in every third frame, walking through its length, sequence, type, payload and CRC
+// bytes; a flipped length byte makes the frame swallow part of the next one or stop short
+void test_bit_flips(void) {
+	std::vector<int> intact;
+	uint32_t flipped = 0;
+	for (int n = 0; n < FRAMES; ++n) {
+		Bytes f = frame(n);
+		if (n % 3 == 1) {
+			size_t at = 3 + (n * 5) % (f.size() - 3);
+			f[at] ^= 1 << (n % 8);
+			++flipped;
+		} else {
+			intact.push_back(n);
+		}
+		feed(f);
+	}
+	flush();
+	assertDecoded(intact);
+	TEST_ASSERT_EQUAL(flipped, decoder->crcErrors() + decoder->lengthErrors());
+}
+
+// flips confined to the payload and the CRC: one CRC error each, the length stays right
+void test_bit_flips_in_body(void) {
+	std::vector<int> intact;
+	uint32_t flipped = 0;
+	for (int n = 0; n < FRAMES; ++n) {
+		Bytes f = frame(n);
+		if (n % 2 == 0) {
+			f[f.size() - 1 - n % (f.size() - PLANK_FRAME_HEADER_SIZE)] ^= 0x10;
+			++flipped;
+		} else {
+			intact.push_back(n);
+		}
+		feed(f);
+	}
+	flush();
+	assertDecoded(intact);
+	TEST_ASSERT_EQUAL(flipped, decoder->crcErrors());
+	TEST_ASSERT_EQUAL(0, decoder->lengthErrors());
+}
+
+// frames cut short, e.g. by a sender reset, at every point of the frame: the next one still comes out
+void test_truncated_frames(void) {
+	std::vector<int> intact;
+	uint32_t cutInBody = 0;
+	for (int n = 0; n < FRAMES; ++n) {
+		Bytes f = frame(n);
+		if (n % 4 == 2) {
+			size_t keep = 1 + n % (f.size() - 1);
+			f.resize(keep);
+			// past the length byte the decoder waits for the body and fails its CRC; before, it
+			// takes the next sync
+			cutInBody += keep >= 3 ? 1 : 0;
+		} else {
+			intact.push_back(n);
+		}
+		feed(f);
+	}
+	flush();
+	assertDecoded(intact);
+	TEST_ASSERT_EQUAL(cutInBody, decoder->crcErrors());
+	TEST_ASSERT_EQUAL(0, decoder->lengthErrors());
+}
+
+// the stream delivered in pieces of every size, split anywhere, frames carrying sync bytes in their
+// payload: the decoder keeps its state across feeds
+void test_fragmented_stream(void) {
+	Bytes stream;
+	std::vector<Bytes> sent;
+	for (int n = 0; n < FRAMES; ++n) {
+		uint8_t payload[8] = {PLANK_FRAME_SYNC1, PLANK_FRAME_SYNC2, (uint8_t) n, PLANK_FRAME_SYNC1, 0, PLANK_FRAME_SYNC2,
+		                      PLANK_FRAME_SYNC1, PLANK_FRAME_SYNC1};
+		uint8_t out[PLANK_FRAME_MAX_SIZE];
+		size_t size = encodeFrame(out, PLANK_FRAME_TOUCH, n, payload, sizeof(payload));
+		stream.insert(stream.end(), out, out + size);
+		Bytes c(out + 3, out + size - PLANK_FRAME_CRC_SIZE);
+		sent.push_back(c);
+	}
+	size_t at = 0;
+	for (int piece = 1; at < stream.size(); piece = piece % 17 + 1) {
+		size_t length = at + piece > stream.size() ? stream.size() - at : piece;
+		feed(&stream[at], length);
+		at += length;
+	}
+	flush();
+	TEST_ASSERT_EQUAL(sent.size(), decoded.size());
+	for (size_t i = 0; i < sent.size() && i < decoded.size(); ++i) {
+		TEST_ASSERT_EQUAL(sent[i].size(), decoded[i].size());
+		TEST_ASSERT_EQUAL_MEMORY(sent[i].data(), decoded[i].data(), sent[i].size());
+	}
+	TEST_ASSERT_EQUAL(0, decoder->crcErrors());
+	TEST_ASSERT_EQUAL(0, decoder->lengthErrors());
+}
+
+// between the frames: line noise, a lone sync byte, a header with an impossible length, a false header
+// whose body runs into the next frame
+void test_garbage_between_frames(void) {
+	static const uint8_t noise[] = {0x00, 0x13, 0x7F, 0x5A, 0xFF, 0x42};
+	static const uint8_t loneSync[] = {PLANK_FRAME_SYNC1, 0x00, PLANK_FRAME_SYNC2};
+	static const uint8_t badLength[] = {PLANK_FRAME_SYNC1, PLANK_FRAME_SYNC2, PLANK_FRAME_MAX_PAYLOAD + 1};
+	static const uint8_t falseHeader[] = {PLANK_FRAME_SYNC1, PLANK_FRAME_SYNC2, 3, 0x01, 0x02};
+	std::vector<int> all;
+	uint32_t lengths = 0, crcs = 0;
+	for (int n = 0; n < FRAMES; ++n) {
+		switch (n % 4) {
+			case 0:
+				feed(noise, sizeof(noise));
+				break;
+			case 1:
+				feed(loneSync, sizeof(loneSync));
+				break;
+			case 2:
+				feed(badLength, sizeof(badLength));
+				++lengths;
+				break;
+			case 3:
+				feed(falseHeader, sizeof(falseHeader));
+				++crcs;
+				break;
+		}
+		feed(frame(n));
+		all.push_back(n);
+	}
+	flush();
+	assertDecoded(all);
+	TEST_ASSERT_EQUAL(crcs, decoder->crcErrors());
+	TEST_ASSERT_EQUAL(lengths, decoder->lengthErrors());
+}
+
+int main(int, char **) {
+	UNITY_BEGIN();
+	RUN_TEST(test_clean_stream);
+	RUN_TEST(test_bit_flips);
+	RUN_TEST(test_bit_flips_in_body);
+	RUN_TEST(test_truncated_frames);
+	RUN_TEST(test_fragmented_stream);
+	RUN_TEST(test_garbage_between_frames);
+	return UNITY_END();
+}
@@ -0,0 +1,120 @@
+// HX711Calibrator against simulated chips with the background re-tare on: a light reference weight left
+// at rest longer than the re-tare window is not zeroed before its point is taken, the point is collected
+// from the samples the application reads anyway, and the re-tare resumes after the fit.
+// usage : pio test -e native -f test_hx711_calibration
+#include <Arduino.h>
+#include <unity.h>
+
+#include <HX711-multi.h>
+#include <SimHal.h>
+#include <SimHX711.h>
+
+#define CHANNELS 4
+#define CLK 18
+#define SPS 10
+#define PERIOD_NS (1000000000ULL / SPS)
+#define ZERO 100000
+#define REST_SAMPLES 50		// as the ESP32 firmware: 5 s at rest
+#define MAX_DRIFT 20000
+#define WEIGHT_COUNTS 5000	// a light reference weight, well within MAX_DRIFT
+#define POINT_SAMPLES 20
+
+static const byte DOUTS[CHANNELS] = {25, 26, 0, 14};
+static SimHX711 *chips[CHANNELS];
+static HX711MULTI *scales;
+static HX711Calibrator *calibrator;
+static long load;			// counts on channel 0
+static uint32_t dither;
+
+void setUp(void) {
+	SimHal::reset();
+	load = 0;
+	dither = 0;
+	for (int i = 0; i < CHANNELS; ++i) {
+		chips[i] = new SimHX711(CLK, DOUTS[i], SPS);
+		chips[i]->setSource([i](uint64_t, SimHX711::Input) {
+			return (int32_t) (ZERO + (i == 0 ? load : 0) + (int) (dither++ % 3) - 1);
+		});
+	}
+	scales = new HX711MULTI(CHANNELS, DOUTS, CLK, 128);
+	calibrator = new HX711Calibrator(*scales);
+	TEST_ASSERT_TRUE(scales->tare(10, 0xFFFF));
+	scales->set_auto_tare(REST_SAMPLES, MAX_DRIFT);
+}
+
+void tearDown(void) {
+	delete calibrator;
+	delete scales;
+	for (int i = 0; i < CHANNELS; ++i) {
+		delete chips[i];
+	}
+}
+
+// 'samples' conversions polled and read as the publish task does, fed to the calibrator if 'feed';
+// returns how many completed a point
+static int run(int samples, bool feed) {
+	int completed = 0;
+	long values[CHANNELS];
+	for (int n = 0; n < samples; ++n) {
+		SimHal::advanceNanos(PERIOD_NS);
+		TEST_ASSERT_TRUE(scales->poll());
+		TEST_ASSERT_TRUE(scales->readLatest(values));
+		if (feed && calibrator->feed(values)) {
+			++completed;
+		}
+	}
+	return completed;
+}
+
+// the reference: with the re-tare running, the resting weight is tared away
+void test_rest_zeroes_a_light_load(void) {
+	run(REST_SAMPLES, false);
+	uint32_t before = scales->get_auto_tare_count();
+	load = WEIGHT_COUNTS;
+	run(3 * REST_SAMPLES, false);
+	TEST_ASSERT_TRUE(scales->get_auto_tare_count() > before);
+}
+
+void test_weight_at_rest_before_point(void) {
+	run(REST_SAMPLES, false);
+	uint32_t before = scales->get_auto_tare_count();
+	calibrator->begin(0);
+	load = WEIGHT_COUNTS;
+	// the operator types "pt 100" long after placing the weight
+	run(3 * REST_SAMPLES, false);
+	TEST_ASSERT_TRUE(calibrator->addPoint(100.0f, POINT_SAMPLES));
+	TEST_ASSERT_TRUE(calibrator->collecting());
+	TEST_ASSERT_FALSE(calibrator->addPoint(200.0f, POINT_SAMPLES));
+	TEST_ASSERT_FALSE(calibrator->fit());
+	TEST_ASSERT_EQUAL(0, run(POINT_SAMPLES - 1, true));
+	TEST_ASSERT_EQUAL(1, run(1, true));
+	TEST_ASSERT_FALSE(calibrator->collecting());
+	TEST_ASSERT_EQUAL(1, calibrator->get_points());
+	TEST_ASSERT_EQUAL(before, scales->get_auto_tare_count());
+
+	TEST_ASSERT_TRUE(calibrator->fit());
+	TEST_ASSERT_INT_WITHIN(1, 100, scales->get_calibration(0).apply(WEIGHT_COUNTS));
+
+	// the re-tare is back once the calibration is applied
+	run(3 * REST_SAMPLES, false);
+	TEST_ASSERT_TRUE(scales->get_auto_tare_count() > before);
+}
+
+// a failed fit keeps the re-tare held: the operator is still adding points
+void test_failed_fit_keeps_holding(void) {
+	run(REST_SAMPLES, false);
+	uint32_t before = scales->get_auto_tare_count();
+	calibrator->begin(0);
+	TEST_ASSERT_FALSE(calibrator->fit());
+	load = WEIGHT_COUNTS;
+	run(3 * REST_SAMPLES, false);
+	TEST_ASSERT_EQUAL(before, scales->get_auto_tare_count());
+}
+
+int main(int, char **) {
+	UNITY_BEGIN();
+	RUN_TEST(test_rest_zeroes_a_light_load);
+	RUN_TEST(test_weight_at_rest_before_point);
+	RUN_TEST(test_failed_fit_keeps_holding);
+	return UNITY_END();
+}
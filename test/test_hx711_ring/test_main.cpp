@@ -0,0 +1,231 @@
+// SpscRing and the HX711 acquisition path (tare, poll, readLatest, drain) against simulated chips.
+// usage : pio test -e native -f test_hx711_ring
+#include <Arduino.h>
+#include <unity.h>
+
+#include <HX711-multi.h>
+#include <SimHal.h>
+#include <SimHX711.h>
+#include <SpscRing.h>
+
+#define CHANNELS 4
+#define CLK 18
+#define SPS 80
+#define PERIOD_NS (1000000000ULL / SPS)
+
+static const byte DOUTS[CHANNELS] = {25, 26, 0, 14};
+static SimHX711 *chips[CHANNELS];
+static HX711MULTI *scales;
+static int32_t counters[CHANNELS];	// conversions each chip has latched, so the order is visible
+
+// raw value chip 'channel' returns for conversion 'n'
+static long expected(int channel, int32_t n) {
+	return n * 16 + channel;
+}
+
+void setUp(void) {
+	SimHal::reset();
+	for (int i = 0; i < CHANNELS; ++i) {
+		counters[i] = 0;
+		chips[i] = new SimHX711(CLK, DOUTS[i], SPS);
+		chips[i]->setSource([i](uint64_t, SimHX711::Input) { return (int32_t) expected(i, counters[i]++); });
+	}
+	scales = new HX711MULTI(CHANNELS, DOUTS, CLK, 128);
+}
+
+void tearDown(void) {
+	delete scales;
+	for (int i = 0; i < CHANNELS; ++i) {
+		delete chips[i];
+	}
+}
+
+// lets the next conversion finish and polls it; false if the chips were not ready
+static bool pollNext() {
+	SimHal::advanceNanos(PERIOD_NS);
+	return scales->poll();
+}
+
+void test_ring_order(void) {
+	SpscRing<int, 8> ring;
+	int v;
+
+	TEST_ASSERT_TRUE(ring.empty());
+	TEST_ASSERT_FALSE(ring.pop(v));
+	for (int i = 0; i < 5; ++i) {
+		TEST_ASSERT_TRUE(ring.push(i));
+	}
+	TEST_ASSERT_EQUAL(5, ring.size());
+	for (int i = 0; i < 3; ++i) {
+		TEST_ASSERT_TRUE(ring.pop(v));
+		TEST_ASSERT_EQUAL(i, v);
+	}
+	// wraps around the end of the storage
+	for (int i = 5; i < 11; ++i) {
+		TEST_ASSERT_TRUE(ring.push(i));
+	}
+	for (int i = 3; i < 11; ++i) {
+		TEST_ASSERT_TRUE(ring.pop(v));
+		TEST_ASSERT_EQUAL(i, v);
+	}
+	TEST_ASSERT_FALSE(ring.pop(v));
+	TEST_ASSERT_EQUAL(0, ring.dropped());
+}
+
+void test_ring_overflow(void) {
+	SpscRing<int, 4> ring;
+	int v;
+
+	for (int i = 0; i < 4; ++i) {
+		TEST_ASSERT_TRUE(ring.push(i));
+	}
+	TEST_ASSERT_EQUAL(4, ring.highWater());
+	TEST_ASSERT_FALSE(ring.push(4));
+	TEST_ASSERT_FALSE(ring.push(5));
+	TEST_ASSERT_EQUAL(2, ring.dropped());
+	TEST_ASSERT_EQUAL(4, ring.size());
+
+	// the refused items are gone, the queued ones are intact
+	for (int i = 0; i < 4; ++i) {
+		TEST_ASSERT_TRUE(ring.pop(v));
+		TEST_ASSERT_EQUAL(i, v);
+	}
+	TEST_ASSERT_TRUE(ring.push(6));
+	TEST_ASSERT_TRUE(ring.pop(v));
+	TEST_ASSERT_EQUAL(6, v);
+	TEST_ASSERT_EQUAL(2, ring.dropped());
+}
+
+void test_ring_high_water(void) {
+	SpscRing<int, 8> ring;
+	int v;
+
+	TEST_ASSERT_EQUAL(0, ring.highWater());
+	ring.push(1);
+	ring.push(2);
+	ring.push(3);
+	TEST_ASSERT_EQUAL(3, ring.highWater());
+	ring.pop(v);
+	ring.pop(v);
+	ring.push(4);
+	// the peak stays, a lower fill does not lower it
+	TEST_ASSERT_EQUAL(3, ring.highWater());
+	for (int i = 0; i < 4; ++i) {
+		ring.push(i);
+	}
+	TEST_ASSERT_EQUAL(6, ring.highWater());
+}
+
+void test_poll_waits_for_ready(void) {
+	// the conversion under way is not finished: DOUT is high and poll() leaves the chips alone
+	TEST_ASSERT_FALSE(scales->poll());
+	TEST_ASSERT_TRUE(pollNext());
+	TEST_ASSERT_FALSE(scales->poll());
+}
+
+void test_drain_order_and_count(void) {
+	HX711Sample out[HX711_RING_SIZE];
+	int32_t first = counters[0];
+
+	for (int n = 0; n < 10; ++n) {
+		TEST_ASSERT_TRUE(pollNext());
+	}
+	TEST_ASSERT_EQUAL(10, scales->queueHighWater());
+
+	// 'max' bounds the copy, the rest stays queued in order
+	TEST_ASSERT_EQUAL(4, scales->drain(out, 4));
+	TEST_ASSERT_EQUAL(6, scales->drain(out + 4, HX711_RING_SIZE));
+	TEST_ASSERT_EQUAL(0, scales->drain(out, HX711_RING_SIZE));
+
+	for (int n = 0; n < 10; ++n) {
+		TEST_ASSERT_EQUAL(HX711_A128, out[n].input);
+		for (int j = 0; j < CHANNELS; ++j) {
+			TEST_ASSERT_EQUAL(expected(j, first + n), out[n].values[j]);
+		}
+		if (n > 0) {
+			TEST_ASSERT_GREATER_THAN(out[n - 1].timestamp, out[n].timestamp);
+		}
+	}
+	TEST_ASSERT_EQUAL(0, scales->droppedSamples());
+}
+
+void test_read_latest_newest_only(void) {
+	long values[CHANNELS];
+	unsigned long timestamp = 0;
+	int32_t first = counters[0];
+
+	TEST_ASSERT_FALSE(scales->readLatest(values, &timestamp));
+	for (int n = 0; n < 5; ++n) {
+		TEST_ASSERT_TRUE(pollNext());
+	}
+	TEST_ASSERT_TRUE(scales->readLatest(values, &timestamp));
+	for (int j = 0; j < CHANNELS; ++j) {
+		TEST_ASSERT_EQUAL(expected(j, first + 4), values[j]);
+	}
+	TEST_ASSERT_NOT_EQUAL(0, timestamp);
+
+	// the older ones were discarded with it
+	HX711Sample out[HX711_RING_SIZE];
+	TEST_ASSERT_EQUAL(0, scales->drain(out, HX711_RING_SIZE));
+	values[0] = -1;
+	TEST_ASSERT_FALSE(scales->readLatest(values));
+	TEST_ASSERT_EQUAL(-1, values[0]);
+}
+
+void test_poll_overflow(void) {
+	HX711Sample out[HX711_RING_SIZE];
+	int32_t first = counters[0];
+
+	for (int n = 0; n < HX711_RING_SIZE + 3; ++n) {
+		TEST_ASSERT_TRUE(pollNext());
+	}
+	TEST_ASSERT_EQUAL(3, scales->droppedSamples());
+	TEST_ASSERT_EQUAL(HX711_RING_SIZE, scales->queueHighWater());
+
+	// the ring keeps the oldest ones: the newest three were refused
+	TEST_ASSERT_EQUAL(HX711_RING_SIZE, scales->drain(out, HX711_RING_SIZE));
+	TEST_ASSERT_EQUAL(expected(0, first), out[0].values[0]);
+	TEST_ASSERT_EQUAL(expected(0, first + HX711_RING_SIZE - 1), out[HX711_RING_SIZE - 1].values[0]);
+}
+
+void test_poll_applies_tare(void) {
+	long values[CHANNELS];
+
+	TEST_ASSERT_TRUE(scales->tare(4));
+	int32_t next = counters[0];
+	TEST_ASSERT_TRUE(pollNext());
+	TEST_ASSERT_TRUE(scales->readLatest(values));
+	// the tare is the mean of four conversions counting up, the next one is 2.5 steps above it
+	for (int j = 0; j < CHANNELS; ++j) {
+		TEST_ASSERT_EQUAL(expected(j, next) - (expected(j, next - 4) + expected(j, next - 1)) / 2, values[j]);
+	}
+}
+
+// 0xFFFF is a tolerance like any other: four conversions 48 counts apart are within it
+void test_tare_tolerance_0xffff(void) {
+	TEST_ASSERT_FALSE(scales->tare(4, 16));
+	TEST_ASSERT_TRUE(scales->tare(4, 0xFFFF));
+}
+
+// the auto tolerance needs the noise learned first, which the rejected attempt does; conversions 16
+// counts apart are a noise of 11.3 counts, a tolerance of 68
+void test_tare_auto_learns_noise(void) {
+	TEST_ASSERT_FALSE(scales->tare_auto(HX711_NOISE_LEARN_SAMPLES + 1));
+	TEST_ASSERT_TRUE(scales->tare_auto(4));
+	TEST_ASSERT_FALSE(scales->tare_auto(6));
+}
+
+int main(int, char **) {
+	UNITY_BEGIN();
+	RUN_TEST(test_ring_order);
+	RUN_TEST(test_ring_overflow);
+	RUN_TEST(test_ring_high_water);
+	RUN_TEST(test_poll_waits_for_ready);
+	RUN_TEST(test_drain_order_and_count);
+	RUN_TEST(test_read_latest_newest_only);
+	RUN_TEST(test_poll_overflow);
+	RUN_TEST(test_poll_applies_tare);
+	RUN_TEST(test_tare_tolerance_0xffff);
+	RUN_TEST(test_tare_auto_learns_noise);
+	return UNITY_END();
+}
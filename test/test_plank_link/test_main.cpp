@@ -0,0 +1,196 @@
+// LinkSender and LinkReceiver over a UART that drops and damages bytes, and across a restart of the
+// sender (the Mega resetting) whatever sequence the receiver was waiting for.
+// usage : pio test -e native -f test_plank_link
+#include <Arduino.h>
+#include <unity.h>
+
+#include <SimHal.h>
+#include <PlankLink.h>
+#include <deque>
+#include <vector>
+
+#define STEP_LIMIT 20000	// 1 ms steps before a run is given up
+
+// one direction of the UART: what is written waits here until pump() hands it to the other end, some
+// bytes dropped or with a bit flipped
+class Line : public Print
+{
+	public:
+		using Print::write;
+
+		size_t write(uint8_t c) {
+			bytes.push_back(c);
+			return 1;
+		}
+
+		template <class End>
+		void pump(End &end) {
+			while (!bytes.empty()) {
+				uint8_t c = bytes.front();
+				bytes.pop_front();
+				if (cut) {
+					continue;
+				}
+				uint32_t r = next() % 1000;
+				if (r < dropPerMille) {
+					continue;
+				}
+				if (r < dropPerMille + flipPerMille) {
+					c ^= 1 << (next() % 8);
+				}
+				end.feed(c);
+			}
+		}
+
+		uint32_t dropPerMille = 0;
+		uint32_t flipPerMille = 0;
+		bool cut = false;
+		std::deque<uint8_t> bytes;
+
+	private:
+		uint32_t next() {
+			seed = seed * 1103515245 + 12345;
+			return seed >> 16;
+		}
+
+		uint32_t seed = 1;
+};
+
+static Line *toReceiver, *toSender;
+static LinkReceiver *receiver;
+static std::vector<int> delivered;	// frame numbers, in the order the receiver handed them over
+
+void setUp(void) {
+	SimHal::reset();
+	toReceiver = new Line();
+	toSender = new Line();
+	receiver = new LinkReceiver(*toSender);
+	delivered.clear();
+}
+
+void tearDown(void) {
+	delete receiver;
+	delete toSender;
+	delete toReceiver;
+}
+
+static bool sendNumber(LinkSender &sender, int n) {
+	uint8_t payload[2] = {(uint8_t) (n & 0xFF), (uint8_t) (n >> 8)};
+	return sender.send(PLANK_FRAME_CAPACITIVE, payload, sizeof(payload));
+}
+
+// one millisecond of both ends
+static void step(LinkSender &sender) {
+	SimHal::advanceNanos(1000000);
+	toReceiver->pump(*receiver);
+	while (receiver->read()) {
+		TEST_ASSERT_EQUAL_HEX8(PLANK_FRAME_CAPACITIVE, receiver->type());
+		delivered.push_back(receiver->payload()[0] | receiver->payload()[1] << 8);
+	}
+	receiver->poll();
+	toSender->pump(sender);
+	sender.poll();
+}
+
+// sends frames 'first' to 'first + count - 1' and runs until the sender has them all acknowledged
+static void transfer(LinkSender &sender, int first, int count) {
+	int n = first;
+	for (int i = 0; i < STEP_LIMIT; ++i) {
+		while (n < first + count && sender.canSend()) {
+			TEST_ASSERT_TRUE(sendNumber(sender, n++));
+		}
+		step(sender);
+		if (n == first + count && sender.inFlight() == 0) {
+			return;
+		}
+	}
+	TEST_FAIL_MESSAGE("the link locked up");
+}
+
+static void assertDelivered(int first, int count, size_t at) {
+	TEST_ASSERT_EQUAL(at + count, delivered.size());
+	for (int i = 0; i < count; ++i) {
+		TEST_ASSERT_EQUAL(first + i, delivered[at + i]);
+	}
+}
+
+void test_lossy_delivery(void) {
+	LinkSender sender(*toReceiver);
+	toReceiver->dropPerMille = toSender->dropPerMille = 5;
+	toReceiver->flipPerMille = toSender->flipPerMille = 5;
+	transfer(sender, 0, 600);
+	assertDelivered(0, 600, 0);
+	TEST_ASSERT_EQUAL(600, sender.stats().acked);
+	TEST_ASSERT_TRUE(sender.stats().retransmits + sender.stats().fastRetransmits > 0);
+	TEST_ASSERT_TRUE(receiver->stats().crcErrors > 0);
+	TEST_ASSERT_EQUAL(0, receiver->stats().resyncs);
+}
+
+// the sender restarts with the receiver at every 'expected' from 248 to 255, and its previous life
+// still has frames in flight the receiver never got
+void test_restart_near_wrap(void) {
+	for (int expected = 248; expected < 256; ++expected) {
+		tearDown();
+		setUp();
+		LinkSender *before = new LinkSender(*toReceiver);
+		transfer(*before, 0, expected);
+		toReceiver->cut = true;
+		for (int i = 0; i < 3; ++i) {
+			sendNumber(*before, 1000 + i);
+		}
+		step(*before);
+		toReceiver->cut = false;
+		delete before;
+
+		LinkSender after(*toReceiver);
+		transfer(after, 2000, 40);
+		assertDelivered(2000, 40, expected);
+		TEST_ASSERT_EQUAL(1, receiver->stats().resyncs);
+		TEST_ASSERT_EQUAL(0, receiver->stats().overruns);
+		TEST_ASSERT_EQUAL(0, after.stats().badAcks);
+		TEST_ASSERT_EQUAL(0, after.stats().retransmits);
+	}
+}
+
+// the restarted sender's flagged frame 0 is lost: the frames after it are taken for the previous
+// life's until its retransmission comes
+void test_restart_first_frame_lost(void) {
+	LinkSender *before = new LinkSender(*toReceiver);
+	transfer(*before, 0, 250);
+	delete before;
+
+	LinkSender after(*toReceiver);
+	sendNumber(after, 2000);
+	toReceiver->bytes.clear();
+	transfer(after, 2001, 40);
+	assertDelivered(2000, 41, 250);
+	TEST_ASSERT_EQUAL(1, receiver->stats().resyncs);
+	TEST_ASSERT_TRUE(after.stats().retransmits > 0);
+}
+
+// our ACK of the flagged frame 0 is lost: its retransmission is a duplicate, not another restart
+void test_retransmitted_first_frame(void) {
+	LinkSender sender(*toReceiver);
+	toSender->cut = true;
+	sendNumber(sender, 0);
+	step(sender);
+	toSender->cut = false;
+	for (int i = 0; i < PLANK_LINK_RTO_MS; ++i) {
+		step(sender);
+	}
+	TEST_ASSERT_EQUAL(0, sender.inFlight());
+	transfer(sender, 1, 20);
+	assertDelivered(0, 21, 0);
+	TEST_ASSERT_EQUAL(0, receiver->stats().resyncs);
+	TEST_ASSERT_EQUAL(1, receiver->stats().duplicates);
+	TEST_ASSERT_EQUAL(1, sender.stats().retransmits);
+}
+
+int main(int, char **) {
+	UNITY_BEGIN();
+	RUN_TEST(test_lossy_delivery);
+	RUN_TEST(test_restart_near_wrap);
+	RUN_TEST(test_restart_first_frame_lost);
+	RUN_TEST(test_retransmitted_first_frame);
+	return UNITY_END();
+}
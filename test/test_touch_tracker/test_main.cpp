@@ -0,0 +1,100 @@
+// TouchTracker's stuck-touch timeout: a lasting step on a pad is learned into its baseline after
+// stuckScans scans, a touch held for less stays down, and the pad still detects touches afterwards.
+// usage : pio test -e native -f test_touch_tracker
+#include <Arduino.h>
+#include <unity.h>
+
+#include <TouchTracker.h>
+
+#define PADS 2
+#define REST 500
+#define STUCK 50
+
+static TouchTracker *tracker;
+static int raw[PADS];
+static TouchEvent events[PADS];
+
+void setUp(void) {
+	tracker = new TouchTracker(PADS);
+	TouchConfig config = TOUCH_DEFAULT_CONFIG;
+	config.stuckScans = STUCK;
+	tracker->setConfig(config);
+	for (int i = 0; i < PADS; ++i) {
+		raw[i] = REST;
+	}
+	tracker->reset(raw);
+}
+
+void tearDown(void) {
+	delete tracker;
+}
+
+// 'scans' scans of pad 0 at 'level'; returns the events of pad 0 of the kind given
+static int scan(int level, int scans, uint8_t kind) {
+	int seen = 0;
+	raw[0] = level;
+	for (int i = 0; i < scans; ++i) {
+		uint8_t n = tracker->update(raw, events);
+		for (uint8_t j = 0; j < n; ++j) {
+			TEST_ASSERT_EQUAL(0, events[j].pad);
+			if (events[j].kind == kind) {
+				++seen;
+			}
+		}
+	}
+	return seen;
+}
+
+void test_held_touch_stays_down(void) {
+	TEST_ASSERT_EQUAL(1, scan(REST + 100, STUCK - 1, TOUCH_EVENT_DOWN));
+	TEST_ASSERT_TRUE(tracker->touched(0));
+	TEST_ASSERT_EQUAL(1, scan(REST, 5, TOUCH_EVENT_UP));
+	TEST_ASSERT_EQUAL(REST, tracker->baseline(0));
+}
+
+void test_step_released_after_timeout(void) {
+	TEST_ASSERT_EQUAL(1, scan(REST + 100, STUCK, TOUCH_EVENT_DOWN));
+	TEST_ASSERT_FALSE(tracker->touched(0));
+	TEST_ASSERT_EQUAL(REST + 100, tracker->baseline(0));
+	int levels[PADS];
+	tracker->levels(levels);
+	TEST_ASSERT_EQUAL(0, levels[0]);
+
+	// a touch on top of the new baseline, and its release
+	TEST_ASSERT_EQUAL(1, scan(REST + 200, 5, TOUCH_EVENT_DOWN));
+	TEST_ASSERT_EQUAL(1, scan(REST + 100, 5, TOUCH_EVENT_UP));
+}
+
+void test_step_released_reports_up_once(void) {
+	scan(REST + 100, STUCK, TOUCH_EVENT_DOWN);
+	TEST_ASSERT_EQUAL(0, scan(REST + 100, 10 * STUCK, TOUCH_EVENT_UP));
+	TEST_ASSERT_EQUAL(0, scan(REST + 100, 10 * STUCK, TOUCH_EVENT_DOWN));
+}
+
+// a step between the thresholds never touches the pad, but freezes its baseline all the same
+void test_step_below_touch_threshold(void) {
+	TEST_ASSERT_EQUAL(0, scan(REST + 20, STUCK - 1, TOUCH_EVENT_DOWN));
+	TEST_ASSERT_EQUAL(REST, tracker->baseline(0));
+	scan(REST + 20, 1, TOUCH_EVENT_DOWN);
+	TEST_ASSERT_EQUAL(REST + 20, tracker->baseline(0));
+	TEST_ASSERT_EQUAL(0, scan(REST + 45, 5, TOUCH_EVENT_DOWN));
+}
+
+void test_timeout_disabled(void) {
+	TouchConfig config = tracker->getConfig();
+	config.stuckScans = 0;
+	tracker->setConfig(config);
+	TEST_ASSERT_EQUAL(1, scan(REST + 100, 100 * STUCK, TOUCH_EVENT_DOWN));
+	TEST_ASSERT_TRUE(tracker->touched(0));
+	TEST_ASSERT_EQUAL(REST, tracker->baseline(0));
+}
+
+int main(int, char **) {
+	UNITY_BEGIN();
+	RUN_TEST(test_held_touch_stays_down);
+	RUN_TEST(test_step_released_after_timeout);
+	RUN_TEST(test_step_released_reports_up_once);
+	RUN_TEST(test_step_below_touch_threshold);
+	RUN_TEST(test_timeout_disabled);
+	return UNITY_END();
+}